@@ -43,5 +43,14 @@
 #  endif
 #endif /* !defined(fallthrough) */
 
+/* Prefetch memory for reading.  This is a hint and may be ignored. */
+#if !defined(pt_prefetch)
+#  if defined(__GNUC__) || defined(__clang__)
+#    define pt_prefetch(addr) __builtin_prefetch((addr), 0, 3)
+#  else
+#    define pt_prefetch(addr) ((void) (addr))
+#  endif
+#endif /* !defined(pt_prefetch) */
+
 
 #endif /* PT_COMPILER_H */
@@ -97,4 +97,21 @@ extern int pt_sec_posix_read(const struct pt_section *section, uint8_t *buffer,
 extern int pt_sec_posix_memsize(const struct pt_section *section,
 				uint64_t *size);
 
+/* Prefetch memory from a section.
+ *
+ * The caller checked that @offset lies within @section.
+ */
+extern void pt_sec_posix_prefetch(const struct pt_section *section,
+				  uint64_t offset);
+
+/* Access memory of a section directly.
+ *
+ * The caller checked that @offset and @size lie within @section.
+ *
+ * Returns @size on success, a negative error code otherwise.
+ */
+extern int pt_sec_posix_peek(const struct pt_section *section,
+			     const uint8_t **pbegin, uint16_t size,
+			     uint64_t offset);
+
 #endif /* PT_SECTION_POSIX_H */
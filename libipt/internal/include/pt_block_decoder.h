@@ -30,12 +30,34 @@
 #define PT_BLOCK_DECODER_H
 
 #include "pt_query_decoder.h"
+#include "pt_packet_decoder.h"
 #include "pt_image.h"
 #include "pt_retstack.h"
 #include "pt_ild.h"
 #include "pt_msec_cache.h"
 
 
+/* The decode state at a split point.
+ *
+ * See pt_pkt_find_split().
+ */
+struct pt_blk_split_state {
+	/* The trace offset of the split point's TIP packet. */
+	uint64_t offset;
+
+	/* The IP at which decode continues after the split point. */
+	uint64_t ip;
+
+	/* The execution mode at the split point. */
+	enum pt_exec_mode mode;
+
+	/* The address space at the split point. */
+	struct pt_asid asid;
+
+	/* The call/return stack at the split point. */
+	struct pt_retstack retstack;
+};
+
 /* A block decoder.
  *
  * It decodes Intel(R) Processor Trace into a sequence of instruction blocks
@@ -88,6 +110,45 @@ struct pt_block_decoder {
 	/* The current execution mode. */
 	enum pt_exec_mode mode;
 
+	/* The remaining number of instructions we may decode.
+	 *
+	 * This is only valid if @has_insn_budget is set.
+	 */
+	uint64_t budget_insn;
+
+	/* The trace offset at which the byte budget is exhausted.
+	 *
+	 * This is only valid if @has_byte_budget is set.
+	 */
+	uint64_t budget_offset;
+
+	/* The profile counters. */
+	struct pt_blk_profile profile;
+
+	/* A packet decoder for looking ahead in the trace.
+	 *
+	 * If @flags.variant.block.enable_prefetch is set, we peek at upcoming
+	 * IP packets to prefetch code.  This is how far we looked.
+	 */
+	struct pt_packet_decoder lookahead;
+
+	/* The last IP at @lookahead.pos. */
+	struct pt_last_ip lookahead_ip;
+
+	/* The split point at which we started decoding.
+	 *
+	 * Only @start.offset, @start.ip, and @start.mode are used.  This is
+	 * only valid if @is_split is set.
+	 */
+	struct pt_blk_split_state start;
+
+	/* The split point at which we stop decoding.
+	 *
+	 * This is only valid if @has_split is set.  All but @split.offset
+	 * are only valid if @split_reached is set.
+	 */
+	struct pt_blk_split_state split;
+
 	/* The status of the last successful decoder query.
 	 *
 	 * Errors are reported directly; the status is always a non-negative
@@ -126,6 +187,33 @@ struct pt_block_decoder {
 
 	/* - a ptwrite event has already been bound to @insn/@iext. */
 	uint32_t bound_ptwrite:1;
+
+	/* - the number of instructions to decode is limited. */
+	uint32_t has_insn_budget:1;
+
+	/* - the number of trace bytes to decode is limited. */
+	uint32_t has_byte_budget:1;
+
+	/* - we started decoding at a split point. */
+	uint32_t is_split:1;
+
+	/* - the return-address stack at @start is not known.
+	 *
+	 *   We may not pop from @retstack when it is empty.
+	 */
+	uint32_t unknown_retstack:1;
+
+	/* - a compressed return is waiting for @retstack to be patched.
+	 *
+	 *   The return has been accounted for and @ip is its IP.
+	 */
+	uint32_t pending_return:1;
+
+	/* - we stop decoding at @split. */
+	uint32_t has_split:1;
+
+	/* - we reached @split. */
+	uint32_t split_reached:1;
 };
 
 
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_BLOCK_STORE_H
+#define PT_BLOCK_STORE_H
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+
+
+enum {
+	/* The number of blocks in a chunk.
+	 *
+	 * All but the last chunk are full so the chunk containing a block can
+	 * be computed from the block's index.
+	 */
+	pt_bstore_chunk_nblocks	= 256,
+
+	/* The maximum size of a variable-length encoded 64-bit value. */
+	pt_bstore_max_varint	= 10
+};
+
+/* The columns of a chunk. */
+enum pt_bstore_column_id {
+	/* The difference to the previous block's IP. */
+	ptbc_ip,
+
+	/* The difference between end_ip and ip.
+	 *
+	 * This may be negative if the block ends with a backward jump.
+	 */
+	ptbc_size,
+
+	/* The number of instructions. */
+	ptbc_ninsn,
+
+	/* The difference to the previous block's time stamp count. */
+	ptbc_tsc,
+
+	/* The difference to the previous block's image section identifier. */
+	ptbc_isid,
+
+	ptbc_num
+};
+
+/* A column of variable-length encoded values. */
+struct pt_bstore_column {
+	/* The encoded values. */
+	uint8_t *data;
+
+	/* The size of @data in bytes. */
+	uint32_t size;
+
+	/* The number of bytes allocated for @data. */
+	uint32_t capacity;
+};
+
+/* A chunk of blocks.
+ *
+ * The differences in each chunk are relative to zero for the first block, so
+ * a chunk can be decoded independently of other chunks.
+ */
+struct pt_bstore_chunk {
+	/* The columns. */
+	struct pt_bstore_column column[ptbc_num];
+
+	/* The lowest and highest ip or end_ip of all blocks. */
+	uint64_t ip_min;
+	uint64_t ip_max;
+
+	/* The lowest and highest time stamp count of all blocks. */
+	uint64_t tsc_min;
+	uint64_t tsc_max;
+
+	/* The lowest and highest image section identifier of all blocks. */
+	int isid_min;
+	int isid_max;
+
+	/* The number of blocks. */
+	uint32_t nblocks;
+};
+
+/* An indexed execution trace store. */
+struct pt_block_store {
+	/* The chunks in the order in which blocks were added. */
+	struct pt_bstore_chunk *chunks;
+
+	/* The number of chunks in use and allocated. */
+	uint32_t nchunks;
+	uint32_t capacity;
+
+	/* The last block added to the last chunk.
+	 *
+	 * Used for computing differences.
+	 */
+	struct pt_bstore_entry last;
+};
+
+
+/* Initialize an execution trace store. */
+extern void pt_bstore_init(struct pt_block_store *store);
+
+/* Finalize an execution trace store. */
+extern void pt_bstore_fini(struct pt_block_store *store);
+
+/* Encode @value at @pos.
+ *
+ * There must be room for pt_bstore_max_varint bytes at @pos.
+ *
+ * Returns the number of bytes written.
+ */
+extern int pt_bstore_encode(uint8_t *pos, uint64_t value);
+
+/* Decode a value from [@pos; @end[ into @value.
+ *
+ * Returns the number of bytes read on success, a negative error code otherwise.
+ * Returns -pte_internal if @pos or @value is NULL.
+ * Returns -pte_bad_context if the encoding exceeds @end.
+ */
+extern int pt_bstore_decode(uint64_t *value, const uint8_t *pos,
+			    const uint8_t *end);
+
+#endif /* PT_BLOCK_STORE_H */
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_CODE_SNAPSHOT_H
+#define PT_CODE_SNAPSHOT_H
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct pt_section;
+
+
+/* Code snapshot parameters.
+ *
+ * A code snapshot is stored in little-endian byte order.  It starts with a
+ * header:
+ *
+ *   u32 magic, u16 version, u16 reserved, u32 number of sections
+ *
+ * followed by the sections:
+ *
+ *   u64 file offset, u64 size, u32 filename length, u32 number of load
+ *   addresses, u32 number of ranges, filename without terminating zero,
+ *   u64 load address[], range[]
+ *
+ * where each range is:
+ *
+ *   u64 offset into the section, u64 size, content
+ */
+enum {
+	/* The page size in bytes given as shift. */
+	pt_snap_page_shift		= 12,
+
+	/* The magic number identifying a code snapshot ("ptcs"). */
+	pt_snap_magic			= 0x73637470,
+
+	/* The version of the code snapshot format. */
+	pt_snap_version			= 1,
+
+	/* The size of the snapshot header in bytes. */
+	pt_snap_header_size		= 12,
+
+	/* The fixed size of a section header in bytes. */
+	pt_snap_section_header_size	= 28,
+
+	/* The size of a load address in bytes. */
+	pt_snap_vaddr_size		= 8,
+
+	/* The fixed size of a range header in bytes. */
+	pt_snap_range_header_size	= 16
+};
+
+/* A section in a code snapshot. */
+struct pt_snap_section {
+	/* The next section in the list. */
+	struct pt_snap_section *next;
+
+	/* The section.  We hold a reference. */
+	struct pt_section *section;
+
+	/* The addresses at which @section is loaded. */
+	uint64_t *vaddr;
+
+	/* The number of load addresses and the capacity of @vaddr. */
+	uint32_t nvaddr, vcapacity;
+
+	/* A bitmap of touched pages.
+	 *
+	 * Bit zero corresponds to the page containing @section's first byte.
+	 */
+	uint64_t *pages;
+
+	/* The number of pages spanned by @section. */
+	uint64_t npages;
+};
+
+/* An image section cache section mapped onto its snapshot section. */
+struct pt_snap_isid {
+	/* The next mapping in the list. */
+	struct pt_snap_isid *next;
+
+	/* The image section identifier. */
+	int isid;
+
+	/* The load address of the section. */
+	uint64_t vaddr;
+
+	/* The snapshot section. */
+	struct pt_snap_section *ssec;
+};
+
+/* A code snapshot. */
+struct pt_code_snapshot {
+	/* The image section cache mapping blocks and instructions onto
+	 * sections.
+	 */
+	struct pt_image_section_cache *iscache;
+
+	/* The sections we know about. */
+	struct pt_snap_section *sections;
+
+	/* The image section identifiers we know about. */
+	struct pt_snap_isid *isids;
+};
+
+
+/* Initialize a code snapshot. */
+extern int pt_snap_init(struct pt_code_snapshot *snap,
+			struct pt_image_section_cache *iscache);
+
+/* Finalize a code snapshot.  This drops all section references. */
+extern void pt_snap_fini(struct pt_code_snapshot *snap);
+
+/* Record the pages containing @size bytes at @ip in section @isid.
+ *
+ * The range is truncated at the end of the section.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_bad_image if @isid is not a valid image section identifier.
+ * Returns -pte_nomap if @ip does not lie within the section.
+ */
+extern int pt_snap_touch(struct pt_code_snapshot *snap, int isid, uint64_t ip,
+			 uint64_t size);
+
+#endif /* PT_CODE_SNAPSHOT_H */
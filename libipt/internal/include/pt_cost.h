@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_COST_H
+#define PT_COST_H
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+/* The weights of the decode cost estimation.
+ *
+ * They roughly model the work of the instruction flow and block decoders.
+ * Each conditional or indirect branch ends a block of instructions that
+ * needs to be decoded.  Indirect branches and asynchronous events further
+ * require looking up the branch target in the traced image.  An overflow
+ * requires re-synchronizing and usually comes in storms.
+ */
+enum {
+	pt_cost_tnt		= 4,
+	pt_cost_tip		= 8,
+	pt_cost_fup		= 4,
+	pt_cost_event		= 2,
+	pt_cost_timing		= 1,
+	pt_cost_ovf		= 64,
+	pt_cost_error		= 64,
+
+	/* Packets are parsed at a cost of one unit per 2^shr bytes. */
+	pt_cost_byte_shr	= 3
+};
+
+/* A decode cost profile. */
+struct pt_cost_profile {
+	/* The configuration of the trace to scan. */
+	struct pt_config config;
+
+	/* The PSB segments in trace order. */
+	struct pt_segment_cost *segments;
+
+	/* The number of used and allocated segments. */
+	size_t nsegments, capacity;
+};
+
+
+/* Initialize a decode cost profile.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+extern int pt_cost_init(struct pt_cost_profile *profile,
+			const struct pt_config *config);
+
+/* Finalize a decode cost profile. */
+extern void pt_cost_fini(struct pt_cost_profile *profile);
+
+/* Account for @packet in @cost.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @cost or @packet is NULL.
+ */
+extern int pt_cost_add(struct pt_segment_cost *cost,
+		       const struct pt_packet *packet);
+
+/* Estimate the decode cost of @cost based on its packet counts.
+ *
+ * Sets @cost->cost.
+ */
+extern void pt_cost_estimate(struct pt_segment_cost *cost);
+
+/* Split @nsegments segments into at most @nparts contiguous parts.
+ *
+ * Minimizes the cost of the most expensive part and uses as many parts as
+ * possible.  Provides the index of the first segment of each part in @first.
+ *
+ * Returns the number of parts on success, a negative error code otherwise.
+ * Returns -pte_internal if @first is NULL.
+ * Returns -pte_internal if @segments is NULL and @nsegments is not zero.
+ */
+extern int pt_cost_split(size_t *first, size_t nparts,
+			 const struct pt_segment_cost *segments,
+			 size_t nsegments);
+
+#endif /* PT_COST_H */
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_FOOTPRINT_H
+#define PT_FOOTPRINT_H
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+
+
+enum {
+	/* The shift amounts for translating an address into a 64-byte line,
+	 * a 4K page, and a 2M page number.
+	 */
+	pt_fp_line_shr		= 6,
+	pt_fp_4k_shr		= 12,
+	pt_fp_2m_shr		= 21,
+
+	/* The number of 4K pages in a 2M page.
+	 *
+	 * There are exactly 64 lines in a 4K page, so a single uint64_t
+	 * bitset covers a 4K page.
+	 */
+	pt_fp_region_npages	= 1 << (pt_fp_2m_shr - pt_fp_4k_shr),
+
+	/* The number of hash buckets for block summaries and regions.
+	 *
+	 * Both must be a power of two.
+	 */
+	pt_fp_nbuckets		= 1024,
+	pt_fp_nregions		= 256
+};
+
+/* The lines covered by a block of instructions. */
+struct pt_fp_block {
+	/* The next block in the same hash bucket. */
+	struct pt_fp_block *next;
+
+	/* The IP of the first instruction in the block. */
+	uint64_t ip;
+
+	/* The line numbers in fetch order.
+	 *
+	 * Consecutive instructions in the same line result in a single entry.
+	 */
+	uint64_t *lines;
+
+	/* The number of entries in @lines. */
+	uint32_t nlines;
+
+	/* The image section identifier. */
+	int isid;
+
+	/* The execution mode of all instructions in the block. */
+	enum pt_exec_mode mode;
+
+	/* The number of instructions in the block. */
+	uint16_t ninsn;
+};
+
+/* The touched lines in a 2M page. */
+struct pt_fp_region {
+	/* The next region in the same hash bucket. */
+	struct pt_fp_region *next;
+
+	/* The 2M page number. */
+	uint64_t page;
+
+	/* The touched lines per 4K page in the current analysis window. */
+	uint64_t window[pt_fp_region_npages];
+
+	/* The touched lines per 4K page over the entire trace. */
+	uint64_t total[pt_fp_region_npages];
+
+	/* A flag saying whether this region has been touched in the current
+	 * analysis window.
+	 */
+	uint32_t in_window:1;
+
+	/* A flag saying whether this region has been touched at all. */
+	uint32_t in_total:1;
+};
+
+/* A least-recently-used set-associative cache simulation. */
+struct pt_fp_lru {
+	/* The tags per set, most recently used first.
+	 *
+	 * This is NULL if the simulation is disabled.
+	 */
+	uint64_t *tag;
+
+	/* The number of sets and ways. */
+	uint32_t nsets;
+	uint32_t nways;
+};
+
+/* A code footprint analysis. */
+struct pt_footprint {
+	/* The configuration. */
+	struct pt_fp_config config;
+
+	/* The image section cache from which we read memory. */
+	struct pt_image_section_cache *iscache;
+
+	/* The block summaries hashed by their IP. */
+	struct pt_fp_block *block[pt_fp_nbuckets];
+
+	/* The regions hashed by their page number. */
+	struct pt_fp_region *region[pt_fp_nregions];
+
+	/* The most recently used region. */
+	struct pt_fp_region *last_region;
+
+	/* The instruction cache and TLB simulations. */
+	struct pt_fp_lru icache;
+	struct pt_fp_lru itlb_4k;
+	struct pt_fp_lru itlb_2m;
+
+	/* The last 4K and 2M page numbers that were looked up. */
+	uint64_t last_4k;
+	uint64_t last_2m;
+
+	/* The statistics of the current analysis window. */
+	struct pt_fp_stats window;
+
+	/* The statistics of the last closed analysis window. */
+	struct pt_fp_stats last;
+
+	/* The statistics of all closed analysis windows.
+	 *
+	 * The unique line and page counts are kept up-to-date.
+	 */
+	struct pt_fp_stats total;
+
+	/* A flag saying whether @last is valid. */
+	uint32_t have_last:1;
+};
+
+
+/* Initialize a code footprint analysis.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @fp or @config is NULL.
+ * Returns -pte_invalid if @config is invalid.
+ * Returns -pte_nomem if the simulated caches could not be allocated.
+ */
+extern int pt_fp_init(struct pt_footprint *fp,
+		      const struct pt_fp_config *config,
+		      struct pt_image_section_cache *iscache);
+
+/* Finalize a code footprint analysis. */
+extern void pt_fp_fini(struct pt_footprint *fp);
+
+/* Initialize a least-recently-used cache simulation.
+ *
+ * If either @nsets or @nways is zero, the simulation is disabled.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @lru is NULL.
+ * Returns -pte_nomem if the tags could not be allocated.
+ */
+extern int pt_fp_lru_init(struct pt_fp_lru *lru, uint32_t nsets,
+			  uint32_t nways);
+
+/* Finalize a least-recently-used cache simulation. */
+extern void pt_fp_lru_fini(struct pt_fp_lru *lru);
+
+/* Access @tag in a least-recently-used cache simulation.
+ *
+ * Returns a positive integer on a hit or if the simulation is disabled, zero on
+ * a miss, and a negative error code otherwise.
+ * Returns -pte_internal if @lru is NULL.
+ */
+extern int pt_fp_lru_access(struct pt_fp_lru *lru, uint64_t tag);
+
+/* Determine the lines covered by a block.
+ *
+ * Decodes the @block->ninsn instructions starting at @block->ip and records the
+ * lines they occupy in @fblock.  Reads memory from @block->isid in @iscache
+ * except for a truncated last instruction, which is taken from @block->raw.
+ *
+ * On success, the caller is responsible for freeing @fblock->lines.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @fblock or @block is NULL.
+ */
+extern int pt_fp_summarize(struct pt_fp_block *fblock,
+			   const struct pt_block *block,
+			   struct pt_image_section_cache *iscache);
+
+#endif /* PT_FOOTPRINT_H */
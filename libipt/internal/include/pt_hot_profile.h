@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_HOT_PROFILE_H
+#define PT_HOT_PROFILE_H
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+/* The number of hash buckets for functions and edges.
+ *
+ * This must be a power of two.
+ */
+enum {
+	pt_hot_nbuckets	= 1024
+};
+
+/* A symbol, i.e. a named range of file offsets. */
+struct pt_hot_symbol {
+	/* The begin and end of the symbol's file offset range. */
+	uint64_t begin, end;
+
+	/* The name of the symbol. */
+	char *name;
+
+	/* The hash of the symbol's file base name and name. */
+	uint32_t hash;
+};
+
+/* A file containing code. */
+struct pt_hot_file {
+	/* The next file in the list. */
+	struct pt_hot_file *next;
+
+	/* The filename as used in the image section cache. */
+	char *filename;
+
+	/* The base name of @filename, which we use to compare files. */
+	const char *basename;
+
+	/* The hash of @basename. */
+	uint32_t hash;
+
+	/* The symbols in this file sorted by their begin offset. */
+	struct pt_hot_symbol *symbols;
+
+	/* The number of symbols and the capacity of @symbols. */
+	size_t nsymbols, capacity;
+};
+
+/* An image section cache section mapped onto its file. */
+struct pt_hot_section {
+	/* The next section in the list. */
+	struct pt_hot_section *next;
+
+	/* The image section identifier. */
+	int isid;
+
+	/* The file containing the section. */
+	const struct pt_hot_file *file;
+
+	/* The load address, the file offset, and the size of the section. */
+	uint64_t vaddr, offset, size;
+};
+
+/* A function or, for code without symbols, a block. */
+struct pt_hot_func {
+	/* The next function in the same hash bucket. */
+	struct pt_hot_func *next;
+
+	/* The file containing the function. */
+	const struct pt_hot_file *file;
+
+	/* The name of the function or NULL if there is no symbol. */
+	const char *name;
+
+	/* The file offset of the function.
+	 *
+	 * This is the begin of the symbol or, if there is no symbol, the
+	 * begin of the block.
+	 */
+	uint64_t offset;
+
+	/* The number of executed blocks, instructions, and cycles. */
+	uint64_t nblocks, ninsn, cyc;
+
+	/* The hash of the function's identity. */
+	uint32_t hash;
+};
+
+/* A control transfer between two functions. */
+struct pt_hot_edge {
+	/* The next edge in the same hash bucket. */
+	struct pt_hot_edge *next;
+
+	/* The source and destination functions. */
+	const struct pt_hot_func *from, *to;
+
+	/* The number of control transfers. */
+	uint64_t count;
+
+	/* The hash of the edge's identity. */
+	uint32_t hash;
+};
+
+/* A hot path profile. */
+struct pt_hot_profile {
+	/* The image section cache mapping sections onto files. */
+	struct pt_image_section_cache *iscache;
+
+	/* The files we know about. */
+	struct pt_hot_file *files;
+
+	/* The sections we know about.
+	 *
+	 * The most recently used section is kept at the front.
+	 */
+	struct pt_hot_section *sections;
+
+	/* The functions hashed by their identity. */
+	struct pt_hot_func *funcs[pt_hot_nbuckets];
+
+	/* The edges hashed by their identity. */
+	struct pt_hot_edge *edges[pt_hot_nbuckets];
+
+	/* The function of the previous block or NULL after a gap. */
+	const struct pt_hot_func *last;
+
+	/* The total number of blocks, instructions, cycles, and control
+	 * transfers.
+	 */
+	uint64_t nblocks, ninsn, cyc, nedges;
+};
+
+
+/* Initialize a hot path profile.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @profile is NULL.
+ */
+extern int pt_hot_init(struct pt_hot_profile *profile,
+		       struct pt_image_section_cache *iscache);
+
+/* Finalize a hot path profile. */
+extern void pt_hot_fini(struct pt_hot_profile *profile);
+
+#endif /* PT_HOT_PROFILE_H */
@@ -125,4 +125,15 @@ extern void pt_ild_init(void);
  */
 extern int pt_ild_decode(struct pt_insn *insn, struct pt_insn_ext *iext);
 
+/* Decode one instruction from @raw.
+ *
+ * Same as pt_ild_decode() but reads at most @insn->size bytes of memory at
+ * @insn->ip from @raw instead of from @insn->raw.  Does not modify
+ * @insn->raw.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+extern int pt_ild_decode_raw(struct pt_insn *insn, struct pt_insn_ext *iext,
+			     const uint8_t *raw);
+
 #endif /* PT_ILD_H */
@@ -34,6 +34,7 @@
 #include "intel-pt.h"
 
 #include <stdint.h>
+#include <stddef.h>
 
 
 /* A list of sections. */
@@ -46,6 +47,34 @@ struct pt_section_list {
 
 	/* The image section identifier. */
 	int isid;
+
+	/* The sections this section was coalesced from - NULL if this section
+	 * was added directly.
+	 *
+	 * The parts are linked via @next and are kept so they can be removed
+	 * and copied individually.  They are not looked up.
+	 */
+	struct pt_section_list *parts;
+
+	/* The identifier of this list element.
+	 *
+	 * It is unique within the image.  List elements are never modified,
+	 * they are removed and replaced with new elements, instead.
+	 */
+	uint64_t id;
+};
+
+/* An element of a frozen image's lookup index. */
+struct pt_image_index {
+	/* The section list element. */
+	const struct pt_section_list *slist;
+
+	/* The end of this and all preceding elements' sections.
+	 *
+	 * Sections in different address spaces may overlap.  When looking up
+	 * an address, we use this to limit the search to candidate sections.
+	 */
+	uint64_t reach;
 };
 
 /* A traced image consisting of a collection of sections. */
@@ -56,6 +85,32 @@ struct pt_image {
 	/* The list of sections. */
 	struct pt_section_list *sections;
 
+	/* The generation of @sections.
+	 *
+	 * It is incremented whenever sections are removed, including when they
+	 * are replaced by new sections.
+	 */
+	uint64_t generation;
+
+	/* The identifier of the most recently added section list element. */
+	uint64_t lastid;
+
+	/* The lookup index of a frozen image sorted by section begin.
+	 *
+	 * A frozen image does not change, not even on lookup, and may be used
+	 * by several decoders concurrently.
+	 */
+	struct pt_image_index *index;
+
+	/* The number of elements in @index. */
+	size_t nindex;
+
+	/* A flag saying whether the image is frozen. */
+	uint32_t frozen:1;
+
+	/* A flag saying whether adjacent file sections are coalesced. */
+	uint32_t coalesce:1;
+
 	/* An optional read memory callback. */
 	struct {
 		/* The callback function. */
@@ -82,8 +137,13 @@ extern void pt_image_fini(struct pt_image *image);
  * removed to accomodate @section.  Absence of a section identifier is indicated
  * by an @isid of zero.
  *
+ * If coalescing is enabled for @image and @section directly follows or precedes
+ * another file section of the same file in the same address space and neither
+ * has a section identifier, both sections are coalesced into a single section.
+ *
  * Returns zero on success.
  * Returns -pte_internal if @image, @section, or @asid is NULL.
+ * Returns -pte_not_supported if @image is frozen.
  */
 extern int pt_image_add(struct pt_image *image, struct pt_section *section,
 			const struct pt_asid *asid, uint64_t vaddr, int isid);
@@ -93,6 +153,7 @@ extern int pt_image_add(struct pt_image *image, struct pt_section *section,
  * Returns zero on success.
  * Returns -pte_internal if @image, @section, or @asid is NULL.
  * Returns -pte_bad_image if @image does not contain @section at @vaddr.
+ * Returns -pte_not_supported if @image is frozen.
  */
 extern int pt_image_remove(struct pt_image *image, struct pt_section *section,
 			   const struct pt_asid *asid, uint64_t vaddr);
@@ -115,26 +176,34 @@ extern int pt_image_read(struct pt_image *image, int *isid, uint8_t *buffer,
  * success, takes a reference of @msec->section that the caller needs to put
  * after use.
  *
+ * If @tag is not NULL, also provide a tag for validating @msec later on.
+ *
  * Returns the section's identifier on success, a negative error code otherwise.
  * Returns -pte_internal if @image, @msec, or @asid is NULL.
  * Returns -pte_nomap if there is no such section in @image.
  */
 extern int pt_image_find(struct pt_image *image, struct pt_mapped_section *msec,
-			 const struct pt_asid *asid, uint64_t vaddr);
+			 struct pt_msec_tag *tag, const struct pt_asid *asid,
+			 uint64_t vaddr);
 
 /* Validate an image section.
  *
- * Validate that a lookup of @vaddr in @msec->asid in @image would result in
- * @msec identified by @isid.
+ * Validate that a lookup of @vaddr in @asid in @image would still result in
+ * @msec, which had been found together with @tag.
+ *
+ * Validation does not depend on the order of sections in @image.  It fails if
+ * @msec does not contain @vaddr, if @msec had been removed from @image, or if
+ * @tag had been taken in a different image or address space.
  *
- * Validation may fail sporadically.
+ * On success, updates @tag to @image's current generation.
  *
  * Returns zero on success, a negative error code otherwise.
- * Returns -pte_invalid if @image or @msec is NULL.
+ * Returns -pte_internal if @image, @msec, @tag, or @asid is NULL.
  * Returns -pte_nomap if validation failed.
  */
 extern int pt_image_validate(const struct pt_image *image,
 			     const struct pt_mapped_section *msec,
-			     uint64_t vaddr, int isid);
+			     struct pt_msec_tag *tag,
+			     const struct pt_asid *asid, uint64_t vaddr);
 
 #endif /* PT_IMAGE_H */
@@ -209,4 +209,20 @@ extern int pt_insn_range_is_contiguous(uint64_t begin, uint64_t end,
 				       const struct pt_asid *asid,
 				       size_t nsteps);
 
+/* Decode the instructions in @block.
+ *
+ * Reads the instructions in @block from @iscache and calls @callback with
+ * @context for each of them in order.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns the first negative value returned by @callback.
+ * Returns -pte_internal if @block or @callback is NULL.
+ */
+extern int pt_insn_walk_block(const struct pt_block *block,
+			      struct pt_image_section_cache *iscache,
+			      int (*callback)(const struct pt_insn *insn,
+					      const struct pt_insn_ext *iext,
+					      void *context),
+			      void *context);
+
 #endif /* PT_INSN_H */
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_INSN_MIX_H
+#define PT_INSN_MIX_H
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+
+
+/* The number of hash buckets per section.
+ *
+ * This must be a power of two.
+ */
+enum {
+	pt_mix_nbuckets	= 1024
+};
+
+/* A static summary of a block of instructions. */
+struct pt_mix_block {
+	/* The next summary in the same hash bucket. */
+	struct pt_mix_block *next;
+
+	/* The IP of the first instruction in the block. */
+	uint64_t ip;
+
+	/* The number of times this block has been executed. */
+	uint64_t count;
+
+	/* The execution mode of all instructions in the block. */
+	enum pt_exec_mode mode;
+
+	/* The number of instructions in the block. */
+	uint16_t ninsn;
+
+	/* The number of instructions per instruction class.
+	 *
+	 * This array is indexed by enum pt_insn_class.
+	 */
+	uint16_t iclass[pt_mix_num_iclass];
+};
+
+/* The block summaries for a single image section. */
+struct pt_mix_section {
+	/* The next section in the list. */
+	struct pt_mix_section *next;
+
+	/* The image section identifier. */
+	int isid;
+
+	/* The block summaries hashed by their IP. */
+	struct pt_mix_block *bucket[pt_mix_nbuckets];
+};
+
+/* A dynamic instruction mix profile. */
+struct pt_insn_mix {
+	/* The image section cache from which we read memory. */
+	struct pt_image_section_cache *iscache;
+
+	/* The list of sections for which we have block summaries.
+	 *
+	 * The most recently used section is kept at the front.
+	 */
+	struct pt_mix_section *sections;
+};
+
+
+/* Initialize an instruction mix profile.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @mix is NULL.
+ */
+extern int pt_mix_init(struct pt_insn_mix *mix,
+		       struct pt_image_section_cache *iscache);
+
+/* Finalize an instruction mix profile. */
+extern void pt_mix_fini(struct pt_insn_mix *mix);
+
+/* Summarize a block.
+ *
+ * Decodes the @block->ninsn instructions starting at @block->ip and counts them
+ * per instruction class in @mblock.  Reads memory from @block->isid in @iscache
+ * except for a truncated last instruction, which is taken from @block->raw.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @mblock or @block is NULL.
+ */
+extern int pt_mix_summarize(struct pt_mix_block *mblock,
+			    const struct pt_block *block,
+			    struct pt_image_section_cache *iscache);
+
+#endif /* PT_INSN_MIX_H */
@@ -61,6 +61,29 @@ struct pt_mapped_section {
 	uint64_t size;
 };
 
+/* A tag identifying where a mapped section had been found.
+ *
+ * It allows validating a copy of a mapped section without comparing the
+ * section itself.
+ */
+struct pt_msec_tag {
+	/* The image in which the section had been found.
+	 *
+	 * Generations are counted per image so a generation alone does not
+	 * identify a state of an image.
+	 */
+	const struct pt_image *image;
+
+	/* The address space in which the section had been looked up. */
+	struct pt_asid asid;
+
+	/* The image's generation when the tag was taken or last validated. */
+	uint64_t generation;
+
+	/* The identifier of the image's section list element. */
+	uint64_t id;
+};
+
 
 static inline void pt_msec_init(struct pt_mapped_section *msec,
 				struct pt_section *section,
@@ -196,4 +219,46 @@ static inline int pt_msec_read(const struct pt_mapped_section *msec,
 	return pt_section_read(section, buffer, size, offset);
 }
 
+/* Access memory of a mapped section directly.
+ *
+ * Provides a pointer to at most @size bytes at @vaddr in @pbegin.
+ *
+ * The caller must check @msec->asid.
+ * The caller must ensure that @msec->section is mapped.
+ *
+ * Returns the number of bytes provided on success.
+ * Returns a negative error code otherwise.
+ */
+static inline int pt_msec_peek(const struct pt_mapped_section *msec,
+			       const uint8_t **pbegin, uint16_t size,
+			       uint64_t vaddr)
+{
+	struct pt_section *section;
+	uint64_t begin, end, mbegin, mend, offset;
+
+	if (!msec)
+		return -pte_internal;
+
+	begin = vaddr;
+	end = begin + size;
+	if (end < begin)
+		end = UINT64_MAX;
+
+	mbegin = pt_msec_begin(msec);
+	mend = pt_msec_end(msec);
+
+	if (begin < mbegin || mend <= begin)
+		return -pte_nomap;
+
+	if (mend < end)
+		end = mend;
+
+	size = (uint16_t) (end - begin);
+
+	section = pt_msec_section(msec);
+	offset = pt_msec_unmap(msec, begin);
+
+	return pt_section_peek(section, pbegin, size, offset);
+}
+
 #endif /* PT_MAPPED_SECTION_H */
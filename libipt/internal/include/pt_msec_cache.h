@@ -51,6 +51,9 @@ struct pt_msec_cache {
 
 	/* The section identifier. */
 	int isid;
+
+	/* The image tag for validating @msec. */
+	struct pt_msec_tag tag;
 };
 
 /* Initialize the cache. */
@@ -65,8 +68,8 @@ extern int pt_msec_cache_invalidate(struct pt_msec_cache *cache);
 /* Read the cached section.
  *
  * If @cache is not empty and @image would find it when looking up @vaddr in
- * @*pmsec->asid, provide a pointer to the cached section in @pmsec and return
- * its image section identifier.
+ * @asid, provide a pointer to the cached section in @pmsec and return its
+ * image section identifier.
  *
  * The provided pointer remains valid until @cache is invalidated.
  *
@@ -74,7 +77,8 @@ extern int pt_msec_cache_invalidate(struct pt_msec_cache *cache);
  */
 extern int pt_msec_cache_read(struct pt_msec_cache *cache,
 			      const struct pt_mapped_section **pmsec,
-			      struct pt_image *image, uint64_t vaddr);
+			      struct pt_image *image,
+			      const struct pt_asid *asid, uint64_t vaddr);
 
 /* Fill the cache.
  *
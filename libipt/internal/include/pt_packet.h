@@ -108,4 +108,19 @@ extern int pt_pkt_read_pwrx(struct pt_packet_pwrx *packet, const uint8_t *pos,
 extern int pt_pkt_read_ptw(struct pt_packet_ptw *packet, const uint8_t *pos,
 			   const struct pt_config *config);
 
+/* Read a run of PAD packets.
+ *
+ * Counts the PAD packets starting at @pos up to a maximum of @max packets.
+ * The first packet is assumed to be a PAD.
+ *
+ * The run is scanned a word at a time so long runs of padding cost memory
+ * bandwidth rather than per-packet decode.
+ *
+ * Returns the size of the run in bytes on success.
+ * Returns -pte_eos if @pos is not inside @config's trace buffer.
+ * Returns -pte_internal if @pos or @config is NULL or if @max is not positive.
+ */
+extern int pt_pkt_read_pad(const uint8_t *pos, const struct pt_config *config,
+			   int max);
+
 #endif /* PT_PACKET_H */
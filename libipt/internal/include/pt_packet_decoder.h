@@ -29,6 +29,8 @@
 #ifndef PT_PACKET_DECODER_H
 #define PT_PACKET_DECODER_H
 
+#include "pt_window.h"
+
 #include "intel-pt.h"
 
 
@@ -42,6 +44,12 @@ struct pt_packet_decoder {
 
 	/* The position of the last PSB packet. */
 	const uint8_t *sync;
+
+	/* The trace offset of @sync. */
+	uint64_t sync_offset;
+
+	/* The window into the trace that @config's trace buffer refers to. */
+	struct pt_window window;
 };
 
 
@@ -52,6 +60,18 @@ struct pt_packet_decoder {
 extern int pt_pkt_decoder_init(struct pt_packet_decoder *,
 			       const struct pt_config *);
 
+/* Initialize the packet decoder sharing @window's fragment tables.
+ *
+ * This is like pt_pkt_decoder_init() but does not search for PSB packets
+ * around fragment boundaries again.  @window must remain valid until the
+ * packet decoder is finalized.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+extern int pt_pkt_decoder_init_shared(struct pt_packet_decoder *,
+				      const struct pt_config *,
+				      const struct pt_window *window);
+
 /* Finalize the packet decoder. */
 extern void pt_pkt_decoder_fini(struct pt_packet_decoder *);
 
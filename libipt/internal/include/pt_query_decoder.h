@@ -33,6 +33,7 @@
 #include "pt_tnt_cache.h"
 #include "pt_time.h"
 #include "pt_event_queue.h"
+#include "pt_window.h"
 
 #include "intel-pt.h"
 
@@ -50,6 +51,12 @@ struct pt_query_decoder {
 	/* The position of the last PSB packet. */
 	const uint8_t *sync;
 
+	/* The trace offset of @sync. */
+	uint64_t sync_offset;
+
+	/* The window into the trace that @config's trace buffer refers to. */
+	struct pt_window window;
+
 	/* The decoding function for the next packet. */
 	const struct pt_decoder_function *next;
 
@@ -68,6 +75,13 @@ struct pt_query_decoder {
 	/* Timing calibration. */
 	struct pt_time_cal tcal;
 
+	/* The timing calibration to start with after synchronizing.
+	 *
+	 * This only holds a fast-counter:cycles ratio estimation if the user
+	 * provided one.
+	 */
+	struct pt_time_cal tcal_seed;
+
 	/* Pending (incomplete) events. */
 	struct pt_event_queue evq;
 
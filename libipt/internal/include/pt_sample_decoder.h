@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_SAMPLE_DECODER_H
+#define PT_SAMPLE_DECODER_H
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+
+
+/* A synchronization point. */
+struct pt_smp_sync {
+	/* The trace offset of the PSB packet. */
+	uint64_t offset;
+
+	/* The time stamp count at the PSB packet. */
+	uint64_t tsc;
+};
+
+/* The execution context while decoding. */
+struct pt_smp_state {
+	/* The return addresses of active calls, outermost call first. */
+	uint64_t call[pt_smp_max_calls];
+
+	/* The most recent taken branches in a ring buffer. */
+	struct pt_branch branch[pt_smp_max_branches];
+
+	/* The number of valid entries in @call and @branch. */
+	uint8_t ncalls;
+	uint8_t nbranches;
+
+	/* The position in @branch at which to store the next branch. */
+	uint8_t next;
+
+	/* A flag saying whether the call stack is incomplete. */
+	uint32_t partial:1;
+};
+
+/* A sample context decoder. */
+struct pt_sample_decoder {
+	/* The instruction flow decoder. */
+	struct pt_insn_decoder *decoder;
+
+	/* The synchronization points indexed so far in increasing offset
+	 * order.
+	 */
+	struct pt_smp_sync *sync;
+
+	/* The number of used and allocated entries in @sync. */
+	uint32_t nsync;
+	uint32_t capacity;
+
+	/* A flag saying whether all synchronization points have been
+	 * indexed.
+	 */
+	uint32_t indexed:1;
+};
+
+
+/* Initialize a sample context decoder.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @smp or @decoder is NULL.
+ */
+extern int pt_smp_init(struct pt_sample_decoder *smp,
+		       struct pt_insn_decoder *decoder);
+
+/* Finalize a sample context decoder. */
+extern void pt_smp_fini(struct pt_sample_decoder *smp);
+
+/* Find the synchronization point from which to decode a sample at @tsc.
+ *
+ * This is the last synchronization point at or before @tsc or the first one
+ * if @tsc lies before the first synchronization point.
+ *
+ * Extends the index as far as needed.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_eos if there are no synchronization points.
+ * Returns -pte_internal if @sync or @smp is NULL.
+ */
+extern int pt_smp_find_sync(struct pt_smp_sync *sync,
+			    struct pt_sample_decoder *smp, uint64_t tsc);
+
+/* Update @state for executing @insn followed by the instruction at @ip. */
+extern void pt_smp_follow(struct pt_smp_state *state,
+			  const struct pt_insn *insn, uint64_t ip);
+
+/* Add a taken branch from @from to @to to @state. */
+extern void pt_smp_add_branch(struct pt_smp_state *state, uint64_t from,
+			      uint64_t to);
+
+/* Provide @state in @context. */
+extern void pt_smp_to_context(struct pt_sample_context *context,
+			      const struct pt_smp_state *state);
+
+#endif /* PT_SAMPLE_DECODER_H */
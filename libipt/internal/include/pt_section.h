@@ -39,6 +39,7 @@
 #include "intel-pt.h"
 
 struct pt_block_cache;
+struct pt_sec_memory;
 
 
 /* A section of contiguous memory loaded from a file. */
@@ -62,6 +63,14 @@ struct pt_section {
 	 */
 	void *status;
 
+	/* A pointer to the content of a memory section - NULL if the section
+	 * is backed by its file.
+	 *
+	 * Memory sections are mapped onto their content without accessing the
+	 * file.  The content is owned by the section.
+	 */
+	struct pt_sec_memory *memory;
+
 	/* A pointer to implementation-specific mapping information - NULL if
 	 * the section is currently not mapped.
 	 *
@@ -120,6 +129,25 @@ struct pt_section {
 	 */
 	int (*memsize)(const struct pt_section *section, uint64_t *size);
 
+	/* A pointer to the optional prefetch function - NULL if the section is
+	 * currently not mapped or if the mapping implementation does not
+	 * support prefetching.
+	 *
+	 * This field is set in pt_section_map() and owned by the mapping
+	 * implementation.
+	 */
+	void (*prefetch)(const struct pt_section *section, uint64_t offset);
+
+	/* A pointer to the optional peek function - NULL if the section is
+	 * currently not mapped or if the mapping implementation does not
+	 * provide direct access to the section's memory.
+	 *
+	 * This field is set in pt_section_map() and owned by the mapping
+	 * implementation.
+	 */
+	int (*peek)(const struct pt_section *section, const uint8_t **pbegin,
+		    uint16_t size, uint64_t offset);
+
 #if defined(FEATURE_THREADS)
 	/* A lock protecting this section.
 	 *
@@ -167,6 +195,23 @@ struct pt_section {
 extern struct pt_section *pt_mk_section(const char *file, uint64_t offset,
 					uint64_t size);
 
+/* Create a memory section.
+ *
+ * The returned section describes the contents of @file starting at @offset
+ * for @size bytes like a section created by pt_mk_section() but it does not
+ * access @file.  It provides the parts of @file given by @memory, instead.
+ *
+ * On success, the section takes ownership of @memory.
+ *
+ * The returned section is not mapped and starts with a user count of one and
+ * instruction caching enabled.
+ *
+ * Returns a new section on success, NULL otherwise.
+ */
+extern struct pt_section *pt_mk_section_memory(const char *file,
+					       uint64_t offset, uint64_t size,
+					       struct pt_sec_memory *memory);
+
 /* Lock a section.
  *
  * Locks @section.  The section must not be locked.
@@ -243,6 +288,9 @@ extern uint64_t pt_section_offset(const struct pt_section *section);
 /* Return the size of the section in bytes. */
 extern uint64_t pt_section_size(const struct pt_section *section);
 
+/* Return non-zero if @section is a memory section, zero otherwise. */
+extern int pt_section_is_memory(const struct pt_section *section);
+
 /* Return the amount of memory currently used by the section in bytes.
  *
  * We only consider the amount of memory required for mapping @section; we
@@ -389,4 +437,32 @@ extern int pt_section_unmap(struct pt_section *section);
 extern int pt_section_read(const struct pt_section *section, uint8_t *buffer,
 			   uint16_t size, uint64_t offset);
 
+/* Prefetch memory from a section.
+ *
+ * Hints that the memory at @offset in @section as well as the corresponding
+ * block cache entry, if @section has a block cache, will be read soon.
+ * @section must be mapped.
+ *
+ * This is a hint.  It does nothing if @offset is beyond the end of the
+ * section.
+ */
+extern void pt_section_prefetch(const struct pt_section *section,
+				uint64_t offset);
+
+/* Access memory of a section directly.
+ *
+ * Provides a pointer to at most @size bytes of @section at @offset in @pbegin.
+ * @section must be mapped.  The memory remains valid until @section is
+ * unmapped.
+ *
+ * Returns the number of bytes provided on success, a negative error code
+ * otherwise.
+ * Returns -pte_internal if @section or @pbegin are NULL.
+ * Returns -pte_nomap if @offset is beyond the end of the section.
+ * Returns -pte_not_supported if @section's memory can't be accessed directly.
+ */
+extern int pt_section_peek(const struct pt_section *section,
+			   const uint8_t **pbegin, uint16_t size,
+			   uint64_t offset);
+
 #endif /* PT_SECTION_H */
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_SECTION_MEMORY_H
+#define PT_SECTION_MEMORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct pt_section;
+
+
+/* A contiguous range of section memory. */
+struct pt_sec_memory_range {
+	/* The begin and end of the range as offset into the section. */
+	uint64_t begin, end;
+
+	/* The position of the range's content in the memory's @content. */
+	size_t pos;
+};
+
+/* The content of a memory section.
+ *
+ * A memory section is not backed by a file.  It provides only parts of the
+ * file it describes; reading other parts fails with -pte_nomap.
+ */
+struct pt_sec_memory {
+	/* The ranges sorted by their begin offset.
+	 *
+	 * Ranges do not overlap and adjacent ranges are merged.
+	 */
+	struct pt_sec_memory_range *ranges;
+
+	/* The number of ranges and the capacity of @ranges. */
+	size_t nranges, rcapacity;
+
+	/* The content of all ranges. */
+	uint8_t *content;
+
+	/* The number of content bytes and the capacity of @content. */
+	size_t size, capacity;
+};
+
+
+/* Allocate an empty section content object. */
+extern struct pt_sec_memory *pt_sec_memory_alloc(void);
+
+/* Free a section content object. */
+extern void pt_sec_memory_free(struct pt_sec_memory *memory);
+
+/* Add content to a section content object.
+ *
+ * Copies @size bytes from @buffer to @memory at @offset.  Ranges must be added
+ * in ascending order.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @memory or @buffer is NULL.
+ * Returns -pte_invalid if @offset lies below the end of the last range.
+ * Returns -pte_overflow if the range would overflow.
+ * Returns -pte_nomem if @memory can't be grown.
+ */
+extern int pt_sec_memory_add(struct pt_sec_memory *memory, uint64_t offset,
+			     const uint8_t *buffer, size_t size);
+
+/* Map a memory section.
+ *
+ * The caller has locked @section.
+ *
+ * On success, sets @section's mapping, unmap, read, memsize, prefetch, and
+ * peek pointers.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @section is NULL or not a memory section.
+ */
+extern int pt_sec_memory_map(struct pt_section *section);
+
+/* Unmap a memory section.
+ *
+ * On success, clears @section's mapping, unmap, read, memsize, prefetch, and
+ * peek pointers.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @section is NULL.
+ * Returns -pte_internal if @section has not been mapped.
+ */
+extern int pt_sec_memory_unmap(struct pt_section *section);
+
+/* Read memory from a memory section.
+ *
+ * Reads at most @size bytes from @section at @offset into @buffer.  Stops at
+ * the end of the range containing @offset.
+ *
+ * Returns the number of bytes read on success, a negative error code otherwise.
+ * Returns -pte_internal if @section or @buffer are NULL.
+ * Returns -pte_nomap if @offset is not contained in any range.
+ */
+extern int pt_sec_memory_read(const struct pt_section *section,
+			      uint8_t *buffer, uint16_t size, uint64_t offset);
+
+/* Compute the memory size of a memory section.
+ *
+ * On success, provides the number of content bytes of @section in @size.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @section or @size is NULL.
+ * Returns -pte_internal if @section has not been mapped.
+ */
+extern int pt_sec_memory_memsize(const struct pt_section *section,
+				 uint64_t *size);
+
+/* Prefetch memory from a memory section.
+ *
+ * Does nothing if @offset is not contained in any range.
+ */
+extern void pt_sec_memory_prefetch(const struct pt_section *section,
+				   uint64_t offset);
+
+/* Access memory of a memory section directly.
+ *
+ * Provides a pointer to at most @size bytes of @section at @offset in @pbegin.
+ * Stops at the end of the range containing @offset.
+ *
+ * Returns the number of bytes provided on success, a negative error code
+ * otherwise.
+ * Returns -pte_internal if @section or @pbegin are NULL.
+ * Returns -pte_nomap if @offset is not contained in any range.
+ */
+extern int pt_sec_memory_peek(const struct pt_section *section,
+			      const uint8_t **pbegin, uint16_t size,
+			      uint64_t offset);
+
+#endif /* PT_SECTION_MEMORY_H */
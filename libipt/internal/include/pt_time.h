@@ -30,6 +30,7 @@
 #define PT_TIME_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 struct pt_config;
 struct pt_packet_tsc;
@@ -37,6 +38,7 @@ struct pt_packet_cbr;
 struct pt_packet_tma;
 struct pt_packet_mtc;
 struct pt_packet_cyc;
+struct pt_time_calibration;
 
 
 /* Intel(R) Processor Trace timing. */
@@ -62,6 +64,9 @@ struct pt_time {
 	/* The number of lost CYC updates. */
 	uint32_t lost_cyc;
 
+	/* The accumulated CYC payload since @time was initialized. */
+	uint64_t cyc;
+
 	/* The core:bus ratio. */
 	uint8_t cbr;
 
@@ -105,6 +110,16 @@ extern int pt_time_query_tsc(uint64_t *tsc, uint32_t *lost_mtc,
  */
 extern int pt_time_query_cbr(uint32_t *cbr, const struct pt_time *time);
 
+/* Query the accumulated number of cycles.
+ *
+ * Provides the sum of all CYC packet payloads seen so far in @cyc.  Only the
+ * difference between two values is meaningful.
+ *
+ * Returns zero on success; a negative error code, otherwise.
+ * Returns -pte_internal if @cyc or @time is NULL.
+ */
+extern int pt_time_query_cyc(uint64_t *cyc, const struct pt_time *time);
+
 /* Update the time based on an Intel PT packet.
  *
  * Returns zero on success.
@@ -122,6 +137,18 @@ extern int pt_time_update_mtc(struct pt_time *, const struct pt_packet_mtc *,
 extern int pt_time_update_cyc(struct pt_time *, const struct pt_packet_cyc *,
 			      const struct pt_config *, uint64_t fcr);
 
+/* Update the time based on a run of @ncyc back-to-back CYC packets.
+ *
+ * The @cyc array holds the CYC packets' payloads in trace order.  The result
+ * is the same as calling pt_time_update_cyc() for each packet.
+ *
+ * Configuration errors for individual packets do not stop the update.  They
+ * are reported as -pte_bad_config after the entire run has been applied.
+ */
+extern int pt_time_update_cyc_run(struct pt_time *, const uint64_t *cyc,
+				  size_t ncyc, const struct pt_config *,
+				  uint64_t fcr);
+
 
 /* Timing calibration.
  *
@@ -203,6 +230,31 @@ extern int pt_tcal_fcr(uint64_t *fcr, const struct pt_time_cal *tcal);
  */
 extern int pt_tcal_set_fcr(struct pt_time_cal *tcal, uint64_t fcr);
 
+/* Provide the fast-counter:cycles ratio estimation to the user.
+ *
+ * Copies at most @size bytes of the estimated ratio and its bounds into
+ * @user and sets @user->size accordingly.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @user or @tcal is NULL.
+ * Returns -pte_invalid if @size is too small.
+ * Returns -pte_no_time if no information is available.
+ */
+extern int pt_tcal_to_user(struct pt_time_calibration *user,
+			   const struct pt_time_cal *tcal, size_t size);
+
+/* Set the fast-counter:cycles ratio estimation from the user.
+ *
+ * Replaces @tcal's estimated ratio and its bounds with the ones in @user,
+ * e.g. to start with an estimation obtained from a different decoder.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @tcal or @user is NULL.
+ * Returns -pte_invalid if @user does not contain a valid estimation.
+ */
+extern int pt_tcal_from_user(struct pt_time_cal *tcal,
+			     const struct pt_time_calibration *user);
+
 /* Update calibration based on an Intel PT packet.
  *
  * Returns zero on success, a negative error code otherwise.
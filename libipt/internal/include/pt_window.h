@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_WINDOW_H
+#define PT_WINDOW_H
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+/* The PSB packets around a fragment boundary. */
+struct pt_win_cut {
+	/* The trace offset of the last PSB before the boundary - zero if
+	 * there is none.
+	 */
+	uint64_t before;
+
+	/* The trace offset of the first PSB after the boundary - the trace
+	 * size if there is none.
+	 */
+	uint64_t after;
+};
+
+/* A window into a fragmented trace.
+ *
+ * The trace is the concatenation of one or more fragments.  We split the
+ * trace into windows of contiguous memory for decoding.
+ *
+ * Windows start and end at PSB packets that lie completely inside a fragment.
+ * Windows inside a single fragment refer to the fragment's memory.  Windows
+ * that span fragment boundaries are copied into a buffer.  They reach from
+ * the last PSB before a fragment boundary to the first PSB after it.
+ *
+ * Window boundaries only depend on the trace, not on the order in which
+ * windows are visited.
+ */
+struct pt_window {
+	/* The fragments or NULL for non-fragmented traces. */
+	const struct pt_fragment *fragments;
+
+	/* The number of fragments. */
+	size_t nfragments;
+
+	/* A single fragment for non-fragmented traces. */
+	struct pt_fragment single;
+
+	/* The offset of each fragment in the trace or NULL for non-fragmented
+	 * traces.
+	 *
+	 * There are @nfragments + 1 entries, the last giving the trace size.
+	 */
+	uint64_t *base;
+
+	/* The fragment offsets for non-fragmented traces. */
+	uint64_t single_base[2];
+
+	/* The PSB packets around the boundary at the beginning of each
+	 * fragment or NULL for non-fragmented traces.
+	 *
+	 * There are @nfragments entries.  The first entry is not used.
+	 */
+	struct pt_win_cut *cut;
+
+	/* A flag saying whether @base and @cut are owned by another window. */
+	uint32_t shared:1;
+
+	/* The current window's begin and end address. */
+	uint8_t *begin, *end;
+
+	/* The offset of @begin in the trace. */
+	uint64_t offset;
+
+	/* The buffer for windows spanning fragment boundaries. */
+	uint8_t *buffer;
+
+	/* The size of @buffer in bytes. */
+	size_t capacity;
+
+	/* The decoder configuration for searching inside a fragment. */
+	struct pt_config config;
+};
+
+
+/* Initialize a trace window.
+ *
+ * Takes the trace from @config's fragments or, if there are none, from
+ * @config's trace buffer.  Loads the first window.
+ *
+ * Updates @config's trace buffer to the window and clears its fragments.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @win or @config is NULL.
+ * Returns -pte_nomem if the window could not be loaded.
+ */
+extern int pt_win_init(struct pt_window *win, struct pt_config *config);
+
+/* Initialize a trace window sharing @other's fragment tables.
+ *
+ * This is like pt_win_init() for the same trace as @other but does not search
+ * for PSB packets around fragment boundaries again.  @other must remain valid
+ * until @win is finalized.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @win, @config, or @other is NULL.
+ * Returns -pte_nomem if the window could not be loaded.
+ */
+extern int pt_win_init_shared(struct pt_window *win, struct pt_config *config,
+			      const struct pt_window *other);
+
+/* Finalize a trace window. */
+extern void pt_win_fini(struct pt_window *win);
+
+/* Load the window containing @offset.
+ *
+ * If @offset is the trace size, loads the last window.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @win is NULL.
+ * Returns -pte_eos if @offset lies outside of the trace.
+ * Returns -pte_nomem if the window could not be loaded.
+ */
+extern int pt_win_load(struct pt_window *win, uint64_t offset);
+
+/* Provide the position of @offset in @pos.
+ *
+ * Loads the window containing @offset unless it is inside the current window.
+ * If @offset is the end of the current window, loads the next window, if
+ * there is one.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @win or @pos is NULL.
+ * Returns -pte_eos if @offset lies outside of the trace.
+ * Returns -pte_nomem if the window could not be loaded.
+ */
+extern int pt_win_seek(struct pt_window *win, const uint8_t **pos,
+		       uint64_t offset);
+
+/* Load the next window.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @win is NULL.
+ * Returns -pte_eos if the current window is the last window.
+ * Returns -pte_nomem if the window could not be loaded.
+ */
+extern int pt_win_next(struct pt_window *win);
+
+/* Load the previous window.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @win is NULL.
+ * Returns -pte_eos if the current window is the first window.
+ * Returns -pte_nomem if the window could not be loaded.
+ */
+extern int pt_win_prev(struct pt_window *win);
+
+/* Return the fragments of the trace. */
+static inline const struct pt_fragment *
+pt_win_fragments(const struct pt_window *win)
+{
+	return win->fragments ? win->fragments : &win->single;
+}
+
+/* Return the offsets of the fragments of the trace. */
+static inline const uint64_t *pt_win_bases(const struct pt_window *win)
+{
+	return win->base ? win->base : win->single_base;
+}
+
+/* Return the size of the trace in bytes. */
+static inline uint64_t pt_win_size(const struct pt_window *win)
+{
+	return pt_win_bases(win)[win->nfragments];
+}
+
+/* Check whether there is a window following the current one. */
+static inline int pt_win_has_next(const struct pt_window *win)
+{
+	if (!win || !win->nfragments)
+		return 0;
+
+	return (win->offset + (uint64_t) (win->end - win->begin)) <
+		pt_win_size(win);
+}
+
+/* Return the trace offset of @pos inside the current window. */
+static inline uint64_t pt_win_offset(const struct pt_window *win,
+				     const uint8_t *pos)
+{
+	return win->offset + (uint64_t) (int64_t) (pos - win->begin);
+}
+
+#endif /* PT_WINDOW_H */
@@ -29,6 +29,8 @@
 #include "pt_section.h"
 #include "pt_section_posix.h"
 #include "pt_section_file.h"
+#include "pt_section_memory.h"
+#include "pt_compiler.h"
 
 #include "intel-pt.h"
 
@@ -151,6 +153,8 @@ int pt_sec_posix_map(struct pt_section *section, int fd)
 	section->unmap = pt_sec_posix_unmap;
 	section->read = pt_sec_posix_read;
 	section->memsize = pt_sec_posix_memsize;
+	section->prefetch = pt_sec_posix_prefetch;
+	section->peek = pt_sec_posix_peek;
 
 	return 0;
 
@@ -211,6 +215,15 @@ int pt_section_map(struct pt_section *section)
 	if (section->mcount)
 		return pt_sec_posix_map_success(section);
 
+	/* Memory sections do not need their file. */
+	if (section->memory) {
+		errcode = pt_sec_memory_map(section);
+		if (errcode < 0)
+			goto out_unlock;
+
+		return pt_sec_posix_map_success(section);
+	}
+
 	if (section->mapping)
 		goto out_unlock;
 
@@ -275,6 +288,8 @@ int pt_sec_posix_unmap(struct pt_section *section)
 	section->unmap = NULL;
 	section->read = NULL;
 	section->memsize = NULL;
+	section->prefetch = NULL;
+	section->peek = NULL;
 
 	munmap(mapping->base, (size_t) mapping->size);
 	free(mapping);
@@ -329,3 +344,36 @@ int pt_sec_posix_memsize(const struct pt_section *section, uint64_t *size)
 
 	return 0;
 }
+
+void pt_sec_posix_prefetch(const struct pt_section *section, uint64_t offset)
+{
+	const struct pt_sec_posix_mapping *mapping;
+
+	if (!section)
+		return;
+
+	mapping = section->mapping;
+	if (!mapping)
+		return;
+
+	pt_prefetch(mapping->begin + offset);
+}
+
+int pt_sec_posix_peek(const struct pt_section *section, const uint8_t **pbegin,
+		      uint16_t size, uint64_t offset)
+{
+	const struct pt_sec_posix_mapping *mapping;
+
+	if (!section || !pbegin)
+		return -pte_internal;
+
+	mapping = section->mapping;
+	if (!mapping)
+		return -pte_internal;
+
+	/* We already checked in pt_section_peek() that the requested memory
+	 * lies within the section's boundaries.
+	 */
+	*pbegin = mapping->begin + offset;
+	return (int) size;
+}
@@ -87,10 +87,18 @@ static void pt_blk_reset(struct pt_block_decoder *decoder)
 	decoder->bound_paging = 0;
 	decoder->bound_vmcs = 0;
 	decoder->bound_ptwrite = 0;
+	decoder->is_split = 0;
+	decoder->unknown_retstack = 0;
+	decoder->pending_return = 0;
+	decoder->split_reached = 0;
 
 	memset(&decoder->event, 0, sizeof(decoder->event));
 	pt_retstack_init(&decoder->retstack);
 	pt_asid_init(&decoder->asid);
+
+	/* Restart looking ahead from wherever we are synchronized. */
+	decoder->lookahead.pos = NULL;
+	pt_last_ip_init(&decoder->lookahead_ip);
 }
 
 /* Initialize the query decoder flags based on our flags. */
@@ -131,9 +139,32 @@ int pt_blk_decoder_init(struct pt_block_decoder *decoder,
 	if (errcode < 0)
 		return errcode;
 
+	/* The lookahead reads the same trace as the query decoder.
+	 *
+	 * It keeps its own position and window buffer since it runs ahead of
+	 * the query decoder, but it shares the query decoder's fragment
+	 * boundaries.
+	 */
+	errcode = pt_pkt_decoder_init_shared(&decoder->lookahead, &config,
+					     &decoder->query.window);
+	if (errcode < 0)
+		return errcode;
+
 	pt_image_init(&decoder->default_image, NULL);
 	decoder->image = &decoder->default_image;
 
+	/* The decode budget is not limited by default. */
+	decoder->budget_insn = 0ull;
+	decoder->budget_offset = 0ull;
+	decoder->has_insn_budget = 0;
+	decoder->has_byte_budget = 0;
+
+	memset(&decoder->profile, 0, sizeof(decoder->profile));
+
+	/* We do not stop at a split point by default. */
+	memset(&decoder->split, 0, sizeof(decoder->split));
+	decoder->has_split = 0;
+
 	errcode = pt_msec_cache_init(&decoder->scache);
 	if (errcode < 0)
 		return errcode;
@@ -150,6 +181,7 @@ void pt_blk_decoder_fini(struct pt_block_decoder *decoder)
 
 	pt_msec_cache_fini(&decoder->scache);
 	pt_image_fini(&decoder->default_image);
+	pt_pkt_decoder_fini(&decoder->lookahead);
 	pt_qry_decoder_fini(&decoder->query);
 }
 
@@ -249,6 +281,184 @@ static int pt_blk_tick(struct pt_block_decoder *decoder, uint64_t ip)
 	return 1;
 }
 
+/* Read the time for annotating a block.
+ *
+ * Provides the time of the last query in @tsc and the accumulated number of
+ * cycles in @cyc.
+ *
+ * Returns a positive integer if @tsc provides wall-clock time.
+ * Returns zero if @tsc only provides relative time.
+ * Returns a negative error code otherwise.
+ */
+static int pt_blk_block_time(uint64_t *tsc, uint64_t *cyc, uint32_t *lost_mtc,
+			     uint32_t *lost_cyc,
+			     const struct pt_block_decoder *decoder)
+{
+	const struct pt_time *time;
+	int errcode;
+
+	if (!decoder)
+		return -pte_internal;
+
+	time = &decoder->query.last_time;
+
+	errcode = pt_time_query_cyc(cyc, time);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_time_query_tsc(tsc, lost_mtc, lost_cyc, time);
+	if (errcode < 0) {
+		if (errcode != -pte_no_time)
+			return errcode;
+
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Annotate @block with the time at its beginning.
+ *
+ * Temporarily stores the accumulated number of cycles in @block->cyc.
+ *
+ * Returns a non-negative integer on success, a negative error code otherwise.
+ */
+static int pt_blk_time_begin(struct pt_block *block,
+			     const struct pt_block_decoder *decoder)
+{
+	if (!block)
+		return -pte_internal;
+
+	return pt_blk_block_time(&block->tsc_begin, &block->cyc, NULL, NULL,
+				 decoder);
+}
+
+/* Annotate @block with the time at its end.
+ *
+ * Expects pt_blk_time_begin() to have been called for @block.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_blk_time_end(struct pt_block *block, int has_tsc,
+			   const struct pt_block_decoder *decoder)
+{
+	uint64_t cyc;
+	int status;
+
+	if (!block)
+		return -pte_internal;
+
+	status = pt_blk_block_time(&block->tsc_end, &cyc, &block->lost_mtc,
+				   &block->lost_cyc, decoder);
+	if (status < 0)
+		return status;
+
+	/* We lose the cycle count when the decoder is reset. */
+	if (cyc < block->cyc)
+		cyc = block->cyc;
+
+	block->cyc = cyc - block->cyc;
+
+	/* We only provide wall-clock time if we had it at both ends. */
+	if (has_tsc && status)
+		block->has_tsc = 1;
+
+	return 0;
+}
+
+enum {
+	/* The number of trace bytes to look ahead for prefetching code. */
+	pt_blk_lookahead	= 64
+};
+
+/* Prefetch code for upcoming branch targets.
+ *
+ * Peek at the IP packets in the next pt_blk_lookahead bytes of trace and
+ * prefetch the code and block cache entries for IPs in the current cached
+ * section.  Resolving IPs in other sections would cost more than it saves.
+ *
+ * We remember how far we looked so each packet is only looked at once.
+ *
+ * This is a hint.  Errors are ignored; the query decoder will report them.
+ */
+static void pt_blk_prefetch(struct pt_block_decoder *decoder)
+{
+	const struct pt_mapped_section *msec;
+	const struct pt_section *section;
+	struct pt_packet_decoder *pkt;
+	uint64_t offset, ahead, end;
+	int errcode;
+
+	pkt = &decoder->lookahead;
+
+	errcode = pt_qry_get_offset(&decoder->query, &offset);
+	if (errcode < 0)
+		return;
+
+	/* Start over if we fell behind or if we have been reset. */
+	errcode = pt_pkt_get_offset(pkt, &ahead);
+	if ((errcode < 0) || (ahead < offset)) {
+		errcode = pt_pkt_sync_set(pkt, offset);
+		if (errcode < 0)
+			return;
+
+		ahead = offset;
+		decoder->lookahead_ip = decoder->query.ip;
+	}
+
+	end = offset + pt_blk_lookahead;
+
+	msec = &decoder->scache.msec;
+	section = pt_msec_section(msec);
+
+	while (ahead < end) {
+		struct pt_packet packet;
+		uint64_t ip;
+
+		errcode = pt_pkt_next(pkt, &packet, sizeof(packet));
+		if (errcode < 0)
+			return;
+
+		errcode = pt_pkt_get_offset(pkt, &ahead);
+		if (errcode < 0)
+			return;
+
+		switch (packet.type) {
+		default:
+			break;
+
+		case ppt_psb:
+		case ppt_ovf:
+			pt_last_ip_init(&decoder->lookahead_ip);
+			break;
+
+		case ppt_tip:
+		case ppt_tip_pge:
+		case ppt_tip_pgd:
+		case ppt_fup:
+			errcode = pt_last_ip_update_ip(&decoder->lookahead_ip,
+						       &packet.payload.ip,
+						       &pkt->config);
+			if (errcode < 0)
+				return;
+
+			if (!section || (packet.type == ppt_tip_pgd))
+				break;
+
+			errcode = pt_last_ip_query(&ip, &decoder->lookahead_ip);
+			if (errcode < 0)
+				break;
+
+			if ((ip < pt_msec_begin(msec)) ||
+			    (pt_msec_end(msec) <= ip))
+				break;
+
+			pt_section_prefetch(section, pt_msec_unmap(msec, ip));
+			break;
+		}
+	}
+}
+
 /* Query an indirect branch.
  *
  * Returns zero on success, a negative error code otherwise.
@@ -256,19 +466,48 @@ static int pt_blk_tick(struct pt_block_decoder *decoder, uint64_t ip)
 static int pt_blk_indirect_branch(struct pt_block_decoder *decoder,
 				  uint64_t *ip)
 {
-	uint64_t evip;
-	int status, errcode;
+	uint64_t evip, begin, end;
+	int status, errcode, track_split;
 
-	if (!decoder)
+	if (!decoder || !ip)
 		return -pte_internal;
 
 	evip = decoder->ip;
 
+	/* We only need the trace offset while looking for the split point. */
+	track_split = decoder->has_split && !decoder->split_reached;
+	if (track_split) {
+		errcode = pt_qry_get_offset(&decoder->query, &begin);
+		if (errcode < 0)
+			return errcode;
+	} else
+		begin = 0ull;
+
 	status = pt_qry_indirect_branch(&decoder->query, ip);
 	if (status < 0)
 		return status;
 
-	if (decoder->flags.variant.block.enable_tick_events) {
+	/* Record the state at the split point when we pass it. */
+	if (track_split) {
+		errcode = pt_qry_get_offset(&decoder->query, &end);
+		if (errcode < 0)
+			return errcode;
+
+		if ((begin <= decoder->split.offset) &&
+		    (decoder->split.offset < end)) {
+			decoder->split.ip = *ip;
+			decoder->split.mode = decoder->mode;
+			decoder->split.asid = decoder->asid;
+			decoder->split.retstack = decoder->retstack;
+			decoder->split_reached = 1;
+		}
+	}
+
+	if (decoder->flags.variant.block.enable_prefetch)
+		pt_blk_prefetch(decoder);
+
+	if (decoder->flags.variant.block.enable_tick_events &&
+	    !decoder->flags.variant.block.enable_block_timing) {
 		errcode = pt_blk_tick(decoder, evip);
 		if (errcode < 0)
 			return errcode;
@@ -292,7 +531,8 @@ static int pt_blk_cond_branch(struct pt_block_decoder *decoder, int *taken)
 	if (status < 0)
 		return status;
 
-	if (decoder->flags.variant.block.enable_tick_events) {
+	if (decoder->flags.variant.block.enable_tick_events &&
+	    !decoder->flags.variant.block.enable_block_timing) {
 		errcode = pt_blk_tick(decoder, decoder->ip);
 		if (errcode < 0)
 			return errcode;
@@ -382,6 +622,37 @@ int pt_blk_sync_set(struct pt_block_decoder *decoder, uint64_t offset)
 	return pt_blk_start(decoder, status);
 }
 
+int pt_blk_sync_split(struct pt_block_decoder *decoder, uint64_t offset,
+		      uint64_t psb, enum pt_exec_mode mode)
+{
+	int errcode, status;
+
+	if (!decoder)
+		return -pte_invalid;
+
+	errcode = pt_blk_sync_reset(decoder);
+	if (errcode < 0)
+		return errcode;
+
+	status = pt_qry_sync_split(&decoder->query, &decoder->ip, offset, psb);
+	if (status < 0)
+		return status;
+
+	/* We do not know the execution mode and the return-address stack at
+	 * the split point.  We use the execution mode provided by our caller
+	 * and wait for the return-address stack to be patched when we need it.
+	 */
+	decoder->mode = mode;
+	decoder->unknown_retstack = 1;
+	decoder->is_split = 1;
+
+	decoder->start.offset = offset;
+	decoder->start.ip = decoder->ip;
+	decoder->start.mode = mode;
+
+	return pt_blk_start(decoder, status);
+}
+
 int pt_blk_get_offset(const struct pt_block_decoder *decoder, uint64_t *offset)
 {
 	if (!decoder)
@@ -415,6 +686,15 @@ int pt_blk_set_image(struct pt_block_decoder *decoder, struct pt_image *image)
 	if (!image)
 		image = &decoder->default_image;
 
+	/* The cached section belongs to the old image. */
+	if (image != decoder->image) {
+		int errcode;
+
+		errcode = pt_msec_cache_invalidate(&decoder->scache);
+		if (errcode < 0)
+			return errcode;
+	}
+
 	decoder->image = image;
 	return 0;
 }
@@ -445,6 +725,24 @@ int pt_blk_core_bus_ratio(struct pt_block_decoder *decoder, uint32_t *cbr)
 	return pt_qry_core_bus_ratio(&decoder->query, cbr);
 }
 
+int pt_blk_get_calibration(const struct pt_block_decoder *decoder,
+			   struct pt_time_calibration *cal, size_t size)
+{
+	if (!decoder)
+		return -pte_invalid;
+
+	return pt_qry_get_calibration(&decoder->query, cal, size);
+}
+
+int pt_blk_set_calibration(struct pt_block_decoder *decoder,
+			   const struct pt_time_calibration *cal)
+{
+	if (!decoder)
+		return -pte_invalid;
+
+	return pt_qry_set_calibration(&decoder->query, cal);
+}
+
 int pt_blk_asid(const struct pt_block_decoder *decoder, struct pt_asid *asid,
 		size_t size)
 {
@@ -487,6 +785,61 @@ static inline int pt_blk_fetch_event(struct pt_block_decoder *decoder)
 	return 1;
 }
 
+/* Check whether @ninsn instructions exceed the instruction budget.
+ *
+ * Returns non-zero if they do, zero otherwise.
+ */
+static inline int pt_blk_exceeds_budget(const struct pt_block_decoder *decoder,
+					uint16_t ninsn)
+{
+	/* We do not proceed beyond the split point. */
+	if (decoder->split_reached)
+		return 1;
+
+	if (!decoder->has_insn_budget)
+		return 0;
+
+	return (decoder->budget_insn < ninsn);
+}
+
+/* Check whether the decode budget has been exhausted.
+ *
+ * Returns a positive integer if it has, zero if it hasn't, and a negative error
+ * code otherwise.
+ */
+static int pt_blk_budget_exhausted(const struct pt_block_decoder *decoder)
+{
+	uint64_t offset;
+	int errcode;
+
+	if (!decoder)
+		return -pte_internal;
+
+	if (decoder->has_insn_budget && !decoder->budget_insn)
+		return 1;
+
+	if (!decoder->has_byte_budget && !decoder->has_split)
+		return 0;
+
+	errcode = pt_qry_get_offset(&decoder->query, &offset);
+	if (errcode < 0)
+		return errcode;
+
+	/* We also stop at the split point or when we missed it. */
+	if (decoder->has_split) {
+		if (decoder->split_reached)
+			return 1;
+
+		if (decoder->split.offset < offset)
+			return 1;
+	}
+
+	if (!decoder->has_byte_budget)
+		return 0;
+
+	return (decoder->budget_offset <= offset);
+}
+
 static inline int pt_blk_block_is_empty(const struct pt_block *block)
 {
 	if (!block)
@@ -593,6 +946,17 @@ static int pt_blk_next_ip(uint64_t *pip, struct pt_block_decoder *decoder,
 		if (!taken)
 			return -pte_bad_retcomp;
 
+		/* We need to wait for our return-address stack to be patched
+		 * if we started at a split point.
+		 */
+		if (decoder->unknown_retstack &&
+		    pt_retstack_is_empty(&decoder->retstack)) {
+			decoder->status = status;
+			decoder->pending_return = 1;
+
+			return -pte_retstack_empty;
+		}
+
 		errcode = pt_retstack_pop(&decoder->retstack, pip);
 		if (errcode < 0)
 			return errcode;
@@ -751,6 +1115,10 @@ static int pt_blk_proceed_one_insn(struct pt_block_decoder *decoder,
 	if (!ninsn)
 		return 0;
 
+	/* There's no room if we would exceed the decode budget. */
+	if (pt_blk_exceeds_budget(decoder, ninsn))
+		return 0;
+
 	/* The truncated instruction must be last. */
 	if (block->truncated)
 		return 0;
@@ -2142,10 +2510,13 @@ static int pt_blk_proceed_no_event_cached(struct pt_block_decoder *decoder,
 		return status;
 
 	/* If we don't find a valid cache entry, fill the cache. */
-	if (!pt_bce_is_valid(bce))
+	if (!pt_bce_is_valid(bce)) {
+		decoder->profile.bcache_misses += 1;
+
 		return pt_blk_proceed_no_event_fill_cache(decoder, block,
 							  bcache, msec,
 							  bcache_fill_steps);
+	}
 
 	/* If we switched sections, the origianl section must have been split
 	 * underneath us.  A split preserves the block cache of the original
@@ -2185,6 +2556,20 @@ static int pt_blk_proceed_no_event_cached(struct pt_block_decoder *decoder,
 	if (ninsn < binsn)
 		return 0;
 
+	/* If the way to the decision point exceeds the decode budget, we end
+	 * the block.
+	 *
+	 * If @block is still empty, the remaining budget is smaller than this
+	 * cache entry.  Proceed one instruction at a time on the slow path to
+	 * use up the remaining budget exactly.
+	 */
+	if (pt_blk_exceeds_budget(decoder, ninsn)) {
+		if (!binsn)
+			return pt_blk_proceed_no_event_uncached(decoder, block);
+
+		return 0;
+	}
+
 	/* Jump ahead to the decision point and proceed from there.
 	 *
 	 * We're not switching execution modes so even if @block already has an
@@ -2430,6 +2815,16 @@ static int pt_blk_proceed_no_event_cached(struct pt_block_decoder *decoder,
 		if (!taken)
 			return -pte_bad_retcomp;
 
+		/* We need to wait for our return-address stack to be patched
+		 * if we started at a split point.
+		 */
+		if (decoder->unknown_retstack &&
+		    pt_retstack_is_empty(&decoder->retstack)) {
+			decoder->pending_return = 1;
+
+			return -pte_retstack_empty;
+		}
+
 		return pt_retstack_pop(&decoder->retstack, &decoder->ip);
 	}
 
@@ -2473,6 +2868,8 @@ static int pt_blk_msec_fill(struct pt_block_decoder *decoder,
 	if (!decoder || !pmsec)
 		return -pte_internal;
 
+	decoder->profile.msec_refills += 1;
+
 	isid = pt_msec_cache_fill(&decoder->scache, &msec,  decoder->image,
 				  &decoder->asid, decoder->ip);
 	if (isid < 0)
@@ -2500,7 +2897,7 @@ static inline int pt_blk_msec_lookup(struct pt_block_decoder *decoder,
 		return -pte_internal;
 
 	isid = pt_msec_cache_read(&decoder->scache, pmsec, decoder->image,
-				  decoder->ip);
+				  &decoder->asid, decoder->ip);
 	if (isid < 0) {
 		if (isid != -pte_nomap)
 			return isid;
@@ -3033,20 +3430,59 @@ static int pt_blk_proceed_trailing_event(struct pt_block_decoder *decoder,
 	return pt_blk_status(decoder, 0);
 }
 
+/* Complete a compressed return that was waiting for the return-address stack
+ * to be patched.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_retstack_empty if we still need to wait.
+ */
+static int pt_blk_proceed_pending_return(struct pt_block_decoder *decoder)
+{
+	int errcode;
+
+	if (!decoder)
+		return -pte_internal;
+
+	if (!decoder->pending_return)
+		return 0;
+
+	if (decoder->unknown_retstack &&
+	    pt_retstack_is_empty(&decoder->retstack))
+		return -pte_retstack_empty;
+
+	errcode = pt_retstack_pop(&decoder->retstack, &decoder->ip);
+	if (errcode < 0)
+		return errcode;
+
+	decoder->pending_return = 0;
+
+	/* The return may have been postponed. */
+	if (decoder->process_insn)
+		return pt_blk_clear_postponed_insn(decoder);
+
+	return 0;
+}
+
 int pt_blk_next(struct pt_block_decoder *decoder, struct pt_block *ublock,
 		size_t size)
 {
 	struct pt_block block, *pblock;
-	int errcode, status;
+	int errcode, status, has_tsc;
 
 	if (!decoder || !ublock)
 		return -pte_invalid;
 
 	pblock = size == sizeof(block) ? ublock : &block;
+	has_tsc = 0;
 
 	/* Zero-initialize the block in case of error returns. */
 	memset(pblock, 0, sizeof(*pblock));
 
+	/* Complete the compressed return we stopped at, if any. */
+	errcode = pt_blk_proceed_pending_return(decoder);
+	if (errcode < 0)
+		return errcode;
+
 	/* Fill in a few things from the current decode state.
 	 *
 	 * This reflects the state of the last pt_blk_next() or pt_blk_start()
@@ -3060,16 +3496,208 @@ int pt_blk_next(struct pt_block_decoder *decoder, struct pt_block *ublock,
 	if (decoder->speculative)
 		pblock->speculative = 1;
 
+	/* Do not proceed if the decode budget has been exhausted.
+	 *
+	 * Indicate a fetched but not yet processed event so the user can
+	 * still process it.
+	 */
+	status = pt_blk_budget_exhausted(decoder);
+	if (status != 0) {
+		int flags;
+
+		if (status < 0)
+			return status;
+
+		flags = pts_budget;
+		if (decoder->process_event)
+			flags |= pts_event_pending;
+
+		errcode = block_to_user(ublock, size, pblock);
+		if (errcode < 0)
+			return errcode;
+
+		return pt_blk_status(decoder, flags);
+	}
+
+	/* Record the time at the beginning of the block. */
+	if (decoder->flags.variant.block.enable_block_timing) {
+		has_tsc = pt_blk_time_begin(pblock, decoder);
+		if (has_tsc < 0)
+			return has_tsc;
+	}
+
 	/* Proceed one block. */
 	status = pt_blk_proceed(decoder, pblock);
 
+	/* Account for the decoded instructions. */
+	if (decoder->has_insn_budget) {
+		if (decoder->budget_insn < pblock->ninsn)
+			return -pte_internal;
+
+		decoder->budget_insn -= pblock->ninsn;
+	}
+
+	if (pblock->ninsn) {
+		decoder->profile.nblocks += 1;
+		decoder->profile.ninsn += pblock->ninsn;
+	}
+
+	/* Record the time at the end of the block.
+	 *
+	 * We do this even on errors so the user gets the time at which we
+	 * stopped.
+	 */
+	if (decoder->flags.variant.block.enable_block_timing) {
+		errcode = pt_blk_time_end(pblock, has_tsc, decoder);
+		if (errcode < 0)
+			return errcode;
+	}
+
 	errcode = block_to_user(ublock, size, pblock);
 	if (errcode < 0)
 		return errcode;
 
+	/* Indicate an exhausted budget so the user may yield. */
+	if (status >= 0) {
+		errcode = pt_blk_budget_exhausted(decoder);
+		if (errcode < 0)
+			return errcode;
+
+		if (errcode)
+			status |= pts_budget;
+	}
+
 	return status;
 }
 
+int pt_blk_set_budget(struct pt_block_decoder *decoder, uint64_t ninsn,
+		      uint64_t nbytes)
+{
+	if (!decoder)
+		return -pte_invalid;
+
+	if (nbytes) {
+		uint64_t offset;
+		int errcode;
+
+		errcode = pt_qry_get_offset(&decoder->query, &offset);
+		if (errcode < 0)
+			return errcode;
+
+		/* Saturate instead of wrapping around. */
+		if (UINT64_MAX - offset < nbytes)
+			nbytes = UINT64_MAX - offset;
+
+		decoder->budget_offset = offset + nbytes;
+	}
+
+	decoder->budget_insn = ninsn;
+	decoder->has_insn_budget = ninsn ? 1 : 0;
+	decoder->has_byte_budget = nbytes ? 1 : 0;
+
+	return 0;
+}
+
+int pt_blk_set_split(struct pt_block_decoder *decoder, uint64_t offset)
+{
+	if (!decoder)
+		return -pte_invalid;
+
+	memset(&decoder->split, 0, sizeof(decoder->split));
+	decoder->split.offset = offset;
+	decoder->has_split = offset ? 1 : 0;
+	decoder->split_reached = 0;
+
+	return 0;
+}
+
+int pt_blk_patch_split(struct pt_block_decoder *spec,
+		       const struct pt_block_decoder *decoder)
+{
+	const struct pt_blk_split_state *split;
+	uint64_t stack[pt_retstack_size];
+	int errcode, nentries;
+
+	if (!spec || !decoder)
+		return -pte_invalid;
+
+	if (!spec->is_split || !decoder->has_split)
+		return -pte_invalid;
+
+	split = &decoder->split;
+	if (split->offset != spec->start.offset)
+		return -pte_invalid;
+
+	if (!decoder->split_reached) {
+		uint64_t offset;
+
+		errcode = pt_qry_get_offset(&decoder->query, &offset);
+		if (errcode < 0)
+			return errcode;
+
+		/* We may have missed the split point, e.g. due to an
+		 * overflow.
+		 */
+		if (split->offset < offset)
+			return -pte_bad_context;
+
+		return -pte_nosync;
+	}
+
+	/* Speculation failed if we did not start at the right place. */
+	if ((split->ip != spec->start.ip) ||
+	    (split->mode != spec->start.mode))
+		return -pte_bad_context;
+
+	/* We're already done if we had patched @spec before. */
+	if (!spec->unknown_retstack)
+		return 0;
+
+	/* Put @spec's return addresses on top of the ones at the split point.
+	 *
+	 * Since @spec could not pop from an empty return-address stack, it
+	 * only contains return addresses that were pushed after the split
+	 * point.
+	 */
+	for (nentries = 0; nentries < pt_retstack_size; ++nentries) {
+		errcode = pt_retstack_pop(&spec->retstack, &stack[nentries]);
+		if (errcode < 0) {
+			if (errcode != -pte_retstack_empty)
+				return errcode;
+
+			break;
+		}
+	}
+
+	spec->retstack = split->retstack;
+
+	while (nentries--) {
+		errcode = pt_retstack_push(&spec->retstack, stack[nentries]);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	/* Fill in the parts of the address space we did not know. */
+	if (((spec->asid.cr3 == pt_asid_no_cr3) &&
+	     (split->asid.cr3 != pt_asid_no_cr3)) ||
+	    ((spec->asid.vmcs == pt_asid_no_vmcs) &&
+	     (split->asid.vmcs != pt_asid_no_vmcs))) {
+		errcode = pt_msec_cache_invalidate(&spec->scache);
+		if (errcode < 0)
+			return errcode;
+
+		if (spec->asid.cr3 == pt_asid_no_cr3)
+			spec->asid.cr3 = split->asid.cr3;
+
+		if (spec->asid.vmcs == pt_asid_no_vmcs)
+			spec->asid.vmcs = split->asid.vmcs;
+	}
+
+	spec->unknown_retstack = 0;
+
+	return 0;
+}
+
 /* Process an enabled event.
  *
  * Returns zero on success, a negative error code otherwise.
@@ -3466,6 +4094,34 @@ int pt_blk_event(struct pt_block_decoder *decoder, struct pt_event *uevent,
 
 	memcpy(uevent, ev, size);
 
+	decoder->profile.nevents += 1;
+	if (ev->type == ptev_overflow)
+		decoder->profile.noverflows += 1;
+
 	/* Indicate further events. */
 	return pt_blk_proceed_trailing_event(decoder, NULL);
 }
+
+int pt_blk_get_profile(const struct pt_block_decoder *decoder,
+		       struct pt_blk_profile *profile, size_t size)
+{
+	if (!decoder || !profile)
+		return -pte_invalid;
+
+	/* Copy the profile to the user.  Make sure we're not writing beyond
+	 * the memory provided by the user.
+	 *
+	 * We truncate counters the user doesn't know about and clear counters
+	 * we don't know about.
+	 */
+	if (sizeof(decoder->profile) < size) {
+		memset((uint8_t *) profile + sizeof(decoder->profile), 0,
+		       size - sizeof(decoder->profile));
+
+		size = sizeof(decoder->profile);
+	}
+
+	memcpy(profile, &decoder->profile, size);
+
+	return 0;
+}
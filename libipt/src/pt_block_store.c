@@ -0,0 +1,506 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_block_store.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <limits.h>
+
+
+static uint64_t pt_bstore_zigzag(int64_t value)
+{
+	return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static int64_t pt_bstore_unzigzag(uint64_t value)
+{
+	return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+int pt_bstore_encode(uint8_t *pos, uint64_t value)
+{
+	int size;
+
+	for (size = 1; 0x7full < value; ++size, value >>= 7)
+		*pos++ = (uint8_t) (value | 0x80ull);
+
+	*pos = (uint8_t) value;
+
+	return size;
+}
+
+int pt_bstore_decode(uint64_t *value, const uint8_t *pos, const uint8_t *end)
+{
+	const uint8_t *begin;
+	uint64_t val;
+	uint8_t shl;
+
+	if (!value || !pos)
+		return -pte_internal;
+
+	begin = pos;
+	val = 0ull;
+	for (shl = 0; pos < end; shl += 7) {
+		uint8_t byte;
+
+		if (64 <= shl)
+			return -pte_bad_context;
+
+		byte = *pos++;
+		val |= (uint64_t) (byte & 0x7f) << shl;
+
+		if (!(byte & 0x80)) {
+			*value = val;
+			return (int) (pos - begin);
+		}
+	}
+
+	return -pte_bad_context;
+}
+
+void pt_bstore_init(struct pt_block_store *store)
+{
+	if (!store)
+		return;
+
+	memset(store, 0, sizeof(*store));
+}
+
+void pt_bstore_fini(struct pt_block_store *store)
+{
+	uint32_t chunk;
+
+	if (!store)
+		return;
+
+	for (chunk = 0; chunk < store->nchunks; ++chunk) {
+		int col;
+
+		for (col = 0; col < ptbc_num; ++col)
+			free(store->chunks[chunk].column[col].data);
+	}
+
+	free(store->chunks);
+}
+
+struct pt_block_store *pt_bstore_alloc(void)
+{
+	struct pt_block_store *store;
+
+	store = malloc(sizeof(*store));
+	if (!store)
+		return NULL;
+
+	pt_bstore_init(store);
+
+	return store;
+}
+
+void pt_bstore_free(struct pt_block_store *store)
+{
+	if (!store)
+		return;
+
+	pt_bstore_fini(store);
+	free(store);
+}
+
+/* Make room for another value in @column.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_bstore_reserve(struct pt_bstore_column *column)
+{
+	uint32_t capacity;
+	uint8_t *data;
+
+	if (!column)
+		return -pte_internal;
+
+	if ((column->size + pt_bstore_max_varint) <= column->capacity)
+		return 0;
+
+	capacity = column->capacity ? column->capacity * 2 : 64;
+	data = realloc(column->data, capacity);
+	if (!data)
+		return -pte_nomem;
+
+	column->data = data;
+	column->capacity = capacity;
+
+	return 0;
+}
+
+/* Release unused memory in the columns of a full @chunk. */
+static void pt_bstore_shrink(struct pt_bstore_chunk *chunk)
+{
+	int col;
+
+	if (!chunk)
+		return;
+
+	for (col = 0; col < ptbc_num; ++col) {
+		struct pt_bstore_column *column;
+		uint8_t *data;
+
+		column = &chunk->column[col];
+		if (column->size == column->capacity)
+			continue;
+
+		/* The data remains valid if we cannot shrink it. */
+		data = realloc(column->data, column->size);
+		if (!data)
+			continue;
+
+		column->data = data;
+		column->capacity = column->size;
+	}
+}
+
+/* Provide the chunk for the next block.
+ *
+ * Returns the chunk on success, NULL otherwise.
+ */
+static struct pt_bstore_chunk *
+pt_bstore_next_chunk(struct pt_block_store *store)
+{
+	struct pt_bstore_chunk *chunk;
+
+	if (!store)
+		return NULL;
+
+	if (store->nchunks) {
+		chunk = &store->chunks[store->nchunks - 1];
+		if (chunk->nblocks < pt_bstore_chunk_nblocks)
+			return chunk;
+	}
+
+	if (store->nchunks == store->capacity) {
+		struct pt_bstore_chunk *chunks;
+		uint32_t capacity;
+
+		capacity = store->capacity ? store->capacity * 2 : 16;
+		chunks = realloc(store->chunks, capacity * sizeof(*chunks));
+		if (!chunks)
+			return NULL;
+
+		store->chunks = chunks;
+		store->capacity = capacity;
+	}
+
+	if (store->nchunks)
+		pt_bstore_shrink(&store->chunks[store->nchunks - 1]);
+
+	chunk = &store->chunks[store->nchunks++];
+	memset(chunk, 0, sizeof(*chunk));
+	chunk->ip_min = UINT64_MAX;
+	chunk->tsc_min = UINT64_MAX;
+	chunk->isid_min = INT_MAX;
+	chunk->isid_max = INT_MIN;
+
+	/* Each chunk starts from scratch. */
+	memset(&store->last, 0, sizeof(store->last));
+
+	return chunk;
+}
+
+static inline uint64_t pt_bstore_min(uint64_t lhs, uint64_t rhs)
+{
+	return (lhs < rhs) ? lhs : rhs;
+}
+
+static inline uint64_t pt_bstore_max(uint64_t lhs, uint64_t rhs)
+{
+	return (lhs < rhs) ? rhs : lhs;
+}
+
+static void pt_bstore_append(struct pt_bstore_column *column, uint64_t value)
+{
+	column->size += (uint32_t) pt_bstore_encode(&column->data[column->size],
+						    value);
+}
+
+int pt_bstore_add_block(struct pt_block_store *store,
+			const struct pt_block *block, uint64_t tsc)
+{
+	struct pt_bstore_chunk *chunk;
+	struct pt_bstore_entry *last;
+	uint64_t ip_min, ip_max;
+	int col;
+
+	if (!store || !block)
+		return -pte_invalid;
+
+	if (!block->ninsn)
+		return 0;
+
+	chunk = pt_bstore_next_chunk(store);
+	if (!chunk)
+		return -pte_nomem;
+
+	/* Reserve space in all columns up front so we do not end up with
+	 * partially stored blocks.
+	 */
+	for (col = 0; col < ptbc_num; ++col) {
+		int errcode;
+
+		errcode = pt_bstore_reserve(&chunk->column[col]);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	last = &store->last;
+
+	pt_bstore_append(&chunk->column[ptbc_ip],
+			 pt_bstore_zigzag((int64_t) (block->ip - last->ip)));
+	pt_bstore_append(&chunk->column[ptbc_size],
+			 pt_bstore_zigzag((int64_t) (block->end_ip -
+						     block->ip)));
+	pt_bstore_append(&chunk->column[ptbc_ninsn], block->ninsn);
+	pt_bstore_append(&chunk->column[ptbc_tsc],
+			 pt_bstore_zigzag((int64_t) (tsc - last->tsc)));
+	pt_bstore_append(&chunk->column[ptbc_isid],
+			 pt_bstore_zigzag((int64_t) block->isid -
+					  (int64_t) last->isid));
+
+	/* A block may end with a backward direct jump. */
+	ip_min = pt_bstore_min(block->ip, block->end_ip);
+	ip_max = pt_bstore_max(block->ip, block->end_ip);
+
+	if (ip_min < chunk->ip_min)
+		chunk->ip_min = ip_min;
+
+	if (chunk->ip_max < ip_max)
+		chunk->ip_max = ip_max;
+
+	if (tsc < chunk->tsc_min)
+		chunk->tsc_min = tsc;
+
+	if (chunk->tsc_max < tsc)
+		chunk->tsc_max = tsc;
+
+	if (block->isid < chunk->isid_min)
+		chunk->isid_min = block->isid;
+
+	if (chunk->isid_max < block->isid)
+		chunk->isid_max = block->isid;
+
+	chunk->nblocks += 1;
+
+	last->ip = block->ip;
+	last->end_ip = block->end_ip;
+	last->tsc = tsc;
+	last->isid = block->isid;
+	last->ninsn = block->ninsn;
+
+	return 0;
+}
+
+/* A cursor for decoding the columns of a chunk. */
+struct pt_bstore_cursor {
+	/* The current position and the end of each column. */
+	const uint8_t *pos[ptbc_num];
+	const uint8_t *end[ptbc_num];
+
+	/* The last decoded block. */
+	struct pt_bstore_entry entry;
+};
+
+static void pt_bstore_cursor_init(struct pt_bstore_cursor *cursor,
+				  const struct pt_bstore_chunk *chunk)
+{
+	int col;
+
+	memset(cursor, 0, sizeof(*cursor));
+
+	for (col = 0; col < ptbc_num; ++col) {
+		cursor->pos[col] = chunk->column[col].data;
+		cursor->end[col] = chunk->column[col].data +
+			chunk->column[col].size;
+	}
+}
+
+/* Decode the next block.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_bstore_cursor_next(struct pt_bstore_cursor *cursor)
+{
+	uint64_t value[ptbc_num];
+	int col;
+
+	for (col = 0; col < ptbc_num; ++col) {
+		int size;
+
+		size = pt_bstore_decode(&value[col], cursor->pos[col],
+					cursor->end[col]);
+		if (size < 0)
+			return size;
+
+		cursor->pos[col] += size;
+	}
+
+	cursor->entry.ip += (uint64_t) pt_bstore_unzigzag(value[ptbc_ip]);
+	cursor->entry.end_ip = cursor->entry.ip +
+		(uint64_t) pt_bstore_unzigzag(value[ptbc_size]);
+	cursor->entry.ninsn = (uint16_t) value[ptbc_ninsn];
+	cursor->entry.tsc += (uint64_t) pt_bstore_unzigzag(value[ptbc_tsc]);
+	cursor->entry.isid += (int) pt_bstore_unzigzag(value[ptbc_isid]);
+
+	return 0;
+}
+
+static int pt_bstore_match_chunk(const struct pt_bstore_chunk *chunk,
+				 const struct pt_bstore_query *query)
+{
+	if ((chunk->ip_max < query->begin) || (query->end <= chunk->ip_min))
+		return 0;
+
+	if ((chunk->tsc_max < query->tsc_begin) ||
+	    (query->tsc_end < chunk->tsc_min))
+		return 0;
+
+	if (query->isid && ((query->isid < chunk->isid_min) ||
+			    (chunk->isid_max < query->isid)))
+		return 0;
+
+	return 1;
+}
+
+static int pt_bstore_match(const struct pt_bstore_entry *entry,
+			   const struct pt_bstore_query *query)
+{
+	uint64_t ip_min, ip_max;
+
+	ip_min = pt_bstore_min(entry->ip, entry->end_ip);
+	ip_max = pt_bstore_max(entry->ip, entry->end_ip);
+
+	if ((ip_max < query->begin) || (query->end <= ip_min))
+		return 0;
+
+	if ((entry->tsc < query->tsc_begin) || (query->tsc_end < entry->tsc))
+		return 0;
+
+	if (query->isid && (entry->isid != query->isid))
+		return 0;
+
+	return 1;
+}
+
+static void pt_bstore_copy(struct pt_bstore_entry *entries, size_t size,
+			   int idx, const struct pt_bstore_entry *entry)
+{
+	uint8_t *uentry;
+
+	uentry = (uint8_t *) entries + ((size_t) idx * size);
+
+	/* Zero out any unknown bytes. */
+	if (sizeof(*entry) < size) {
+		memset(uentry + sizeof(*entry), 0, size - sizeof(*entry));
+
+		size = sizeof(*entry);
+	}
+
+	memcpy(uentry, entry, size);
+}
+
+int pt_bstore_find(const struct pt_block_store *store,
+		   struct pt_bstore_entry *entries, size_t size, int nentries,
+		   const struct pt_bstore_query *query, uint64_t *pos)
+{
+	uint64_t index;
+	int nfound;
+
+	if (!store || !entries || !query || !pos)
+		return -pte_invalid;
+
+	if (size < offsetof(struct pt_bstore_entry, ninsn) + sizeof(uint16_t))
+		return -pte_invalid;
+
+	if (query->size < offsetof(struct pt_bstore_query, isid) + sizeof(int))
+		return -pte_invalid;
+
+	if (nentries < 0)
+		return -pte_invalid;
+
+	if (!nentries)
+		return 0;
+
+	nfound = 0;
+	for (index = *pos / pt_bstore_chunk_nblocks;
+	     index < store->nchunks; ++index) {
+		const struct pt_bstore_chunk *chunk;
+		struct pt_bstore_cursor cursor;
+		uint64_t first;
+		uint32_t block;
+
+		chunk = &store->chunks[index];
+		first = index * pt_bstore_chunk_nblocks;
+
+		if (*pos < first)
+			*pos = first;
+
+		/* The index tells us whether we need to look inside. */
+		if (!pt_bstore_match_chunk(chunk, query)) {
+			*pos = first + chunk->nblocks;
+			continue;
+		}
+
+		pt_bstore_cursor_init(&cursor, chunk);
+		for (block = 0; block < chunk->nblocks; ++block) {
+			int errcode;
+
+			errcode = pt_bstore_cursor_next(&cursor);
+			if (errcode < 0)
+				return errcode;
+
+			if ((first + block) < *pos)
+				continue;
+
+			*pos = first + block + 1;
+
+			if (!pt_bstore_match(&cursor.entry, query))
+				continue;
+
+			pt_bstore_copy(entries, size, nfound, &cursor.entry);
+
+			nfound += 1;
+			if (nfound == nentries)
+				return nfound;
+		}
+	}
+
+	if (!nfound)
+		return -pte_eos;
+
+	return nfound;
+}
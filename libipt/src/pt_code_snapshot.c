@@ -0,0 +1,900 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_code_snapshot.h"
+#include "pt_image_section_cache.h"
+#include "pt_section.h"
+#include "pt_section_memory.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+
+int pt_snap_init(struct pt_code_snapshot *snap,
+		 struct pt_image_section_cache *iscache)
+{
+	if (!snap)
+		return -pte_internal;
+
+	memset(snap, 0, sizeof(*snap));
+	snap->iscache = iscache;
+
+	return 0;
+}
+
+void pt_snap_fini(struct pt_code_snapshot *snap)
+{
+	struct pt_snap_section *ssec;
+	struct pt_snap_isid *sisid;
+
+	if (!snap)
+		return;
+
+	sisid = snap->isids;
+	while (sisid) {
+		struct pt_snap_isid *trash;
+
+		trash = sisid;
+		sisid = sisid->next;
+
+		free(trash);
+	}
+
+	ssec = snap->sections;
+	while (ssec) {
+		struct pt_snap_section *trash;
+
+		trash = ssec;
+		ssec = ssec->next;
+
+		(void) pt_section_put(trash->section);
+		free(trash->vaddr);
+		free(trash->pages);
+		free(trash);
+	}
+
+	snap->isids = NULL;
+	snap->sections = NULL;
+}
+
+struct pt_code_snapshot *pt_snap_alloc(struct pt_image_section_cache *iscache)
+{
+	struct pt_code_snapshot *snap;
+	int errcode;
+
+	snap = malloc(sizeof(*snap));
+	if (!snap)
+		return NULL;
+
+	errcode = pt_snap_init(snap, iscache);
+	if (errcode < 0) {
+		free(snap);
+		return NULL;
+	}
+
+	return snap;
+}
+
+void pt_snap_free(struct pt_code_snapshot *snap)
+{
+	if (!snap)
+		return;
+
+	pt_snap_fini(snap);
+	free(snap);
+}
+
+/* Return the number of pages spanned by @size bytes at file offset @offset. */
+static uint64_t pt_snap_npages(uint64_t offset, uint64_t size)
+{
+	uint64_t first, last;
+
+	if (!size)
+		return 0ull;
+
+	first = offset >> pt_snap_page_shift;
+	last = (offset + size - 1) >> pt_snap_page_shift;
+
+	return last - first + 1;
+}
+
+/* Add @vaddr to @ssec's load addresses unless it is already there.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_snap_add_vaddr(struct pt_snap_section *ssec, uint64_t vaddr)
+{
+	uint32_t idx, capacity;
+
+	if (!ssec)
+		return -pte_internal;
+
+	for (idx = 0; idx < ssec->nvaddr; ++idx) {
+		if (ssec->vaddr[idx] == vaddr)
+			return 0;
+	}
+
+	capacity = ssec->vcapacity;
+	if (capacity <= ssec->nvaddr) {
+		uint64_t *array;
+
+		capacity = capacity ? capacity * 2 : 4;
+		if (!capacity)
+			return -pte_overflow;
+
+		array = realloc(ssec->vaddr, capacity * sizeof(*array));
+		if (!array)
+			return -pte_nomem;
+
+		ssec->vaddr = array;
+		ssec->vcapacity = capacity;
+	}
+
+	ssec->vaddr[ssec->nvaddr++] = vaddr;
+
+	return 0;
+}
+
+/* Find or create the snapshot section for @section.
+ *
+ * Sections are identified by their filename, offset, and size.
+ *
+ * Takes ownership of the reference to @section.
+ *
+ * Returns the section on success, NULL otherwise.
+ */
+static struct pt_snap_section *
+pt_snap_fetch_section(struct pt_code_snapshot *snap,
+		      struct pt_section *section)
+{
+	struct pt_snap_section *ssec;
+	const char *filename;
+	uint64_t offset, size, npages;
+
+	if (!snap || !section)
+		return NULL;
+
+	filename = pt_section_filename(section);
+	offset = pt_section_offset(section);
+	size = pt_section_size(section);
+	if (!filename)
+		return NULL;
+
+	for (ssec = snap->sections; ssec; ssec = ssec->next) {
+		const struct pt_section *sec;
+
+		sec = ssec->section;
+		if (sec != section) {
+			if (pt_section_offset(sec) != offset)
+				continue;
+
+			if (pt_section_size(sec) != size)
+				continue;
+
+			if (strcmp(pt_section_filename(sec), filename) != 0)
+				continue;
+		}
+
+		(void) pt_section_put(section);
+		return ssec;
+	}
+
+	npages = pt_snap_npages(offset, size);
+	if ((SIZE_MAX / sizeof(uint64_t)) < ((npages + 63) / 64))
+		return NULL;
+
+	ssec = malloc(sizeof(*ssec));
+	if (!ssec)
+		return NULL;
+
+	memset(ssec, 0, sizeof(*ssec));
+	ssec->pages = calloc((size_t) ((npages + 63) / 64), sizeof(uint64_t));
+	if (!ssec->pages && npages) {
+		free(ssec);
+		return NULL;
+	}
+
+	ssec->section = section;
+	ssec->npages = npages;
+	ssec->next = snap->sections;
+	snap->sections = ssec;
+
+	return ssec;
+}
+
+/* Find or create the mapping for @isid.
+ *
+ * Moves the mapping to the front of @snap's isid list.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_snap_fetch_isid(struct pt_snap_isid **psisid,
+			      struct pt_code_snapshot *snap, int isid)
+{
+	struct pt_snap_isid *sisid, **pisid;
+	struct pt_snap_section *ssec;
+	struct pt_section *section;
+	uint64_t laddr;
+	int errcode;
+
+	if (!psisid || !snap)
+		return -pte_internal;
+
+	for (pisid = &snap->isids; *pisid; pisid = &(*pisid)->next) {
+		sisid = *pisid;
+
+		if (sisid->isid != isid)
+			continue;
+
+		/* Move it to the front. */
+		*pisid = sisid->next;
+		sisid->next = snap->isids;
+		snap->isids = sisid;
+
+		*psisid = sisid;
+		return 0;
+	}
+
+	errcode = pt_iscache_lookup(snap->iscache, &section, &laddr, isid);
+	if (errcode < 0)
+		return errcode;
+
+	ssec = pt_snap_fetch_section(snap, section);
+	if (!ssec) {
+		(void) pt_section_put(section);
+		return -pte_nomem;
+	}
+
+	errcode = pt_snap_add_vaddr(ssec, laddr);
+	if (errcode < 0)
+		return errcode;
+
+	sisid = malloc(sizeof(*sisid));
+	if (!sisid)
+		return -pte_nomem;
+
+	sisid->isid = isid;
+	sisid->vaddr = laddr;
+	sisid->ssec = ssec;
+	sisid->next = snap->isids;
+	snap->isids = sisid;
+
+	*psisid = sisid;
+	return 0;
+}
+
+int pt_snap_touch(struct pt_code_snapshot *snap, int isid, uint64_t ip,
+		  uint64_t size)
+{
+	struct pt_snap_section *ssec;
+	struct pt_snap_isid *sisid;
+	uint64_t offset, ssize, begin, end, base, page, last;
+	int errcode;
+
+	if (!snap)
+		return -pte_internal;
+
+	if (isid <= 0)
+		return -pte_bad_image;
+
+	errcode = pt_snap_fetch_isid(&sisid, snap, isid);
+	if (errcode < 0)
+		return errcode;
+
+	ssec = sisid->ssec;
+	if (!ssec)
+		return -pte_internal;
+
+	offset = pt_section_offset(ssec->section);
+	ssize = pt_section_size(ssec->section);
+
+	if ((ip < sisid->vaddr) || (ssize <= (ip - sisid->vaddr)))
+		return -pte_nomap;
+
+	if (!size)
+		return 0;
+
+	begin = ip - sisid->vaddr;
+	end = ssize;
+	if (size < (ssize - begin))
+		end = begin + size;
+
+	base = offset >> pt_snap_page_shift;
+	page = ((offset + begin) >> pt_snap_page_shift) - base;
+	last = ((offset + end - 1) >> pt_snap_page_shift) - base;
+
+	if (ssec->npages <= last)
+		return -pte_internal;
+
+	for (; page <= last; ++page)
+		ssec->pages[page / 64] |= 1ull << (page % 64);
+
+	return 0;
+}
+
+int pt_snap_add_block(struct pt_code_snapshot *snap,
+		      const struct pt_block *block)
+{
+	if (!snap || !block)
+		return -pte_invalid;
+
+	/* There's nothing to record in an empty block. */
+	if (!block->ninsn)
+		return 0;
+
+	if (block->end_ip < block->ip)
+		return -pte_nomap;
+
+	return pt_snap_touch(snap, block->isid, block->ip,
+			     (block->end_ip - block->ip) + pt_max_insn_size);
+}
+
+int pt_snap_add_insn(struct pt_code_snapshot *snap,
+		     const struct pt_insn *insn)
+{
+	if (!snap || !insn)
+		return -pte_invalid;
+
+	return pt_snap_touch(snap, insn->isid, insn->ip, insn->size);
+}
+
+/* Find the next run of touched pages in @ssec starting at page *@ppage.
+ *
+ * On success, provides the range of the run as offset into the section in
+ * @pbegin and @pend and updates *@ppage to point behind the run.
+ *
+ * Returns a positive integer if a run was found, zero if there are no more
+ * runs, and a negative error code otherwise.
+ */
+static int pt_snap_next_run(const struct pt_snap_section *ssec,
+			    uint64_t *ppage, uint64_t *pbegin, uint64_t *pend)
+{
+	uint64_t page, first, offset, size, base, begin, end;
+
+	if (!ssec || !ppage || !pbegin || !pend)
+		return -pte_internal;
+
+	page = *ppage;
+	while (page < ssec->npages) {
+		uint64_t bits;
+
+		bits = ssec->pages[page / 64] >> (page % 64);
+		if (bits & 1ull)
+			break;
+
+		/* Skip the remaining clear bits in this word. */
+		if (!bits)
+			page = (page | 63ull) + 1;
+		else
+			page += 1;
+	}
+
+	if (ssec->npages <= page)
+		return 0;
+
+	first = page;
+	while ((page < ssec->npages) &&
+	       (ssec->pages[page / 64] & (1ull << (page % 64))))
+		page += 1;
+
+	offset = pt_section_offset(ssec->section);
+	size = pt_section_size(ssec->section);
+	base = offset >> pt_snap_page_shift;
+
+	begin = (base + first) << pt_snap_page_shift;
+	if (begin < offset)
+		begin = offset;
+
+	end = (base + page) << pt_snap_page_shift;
+	if ((offset + size) < end)
+		end = offset + size;
+
+	*ppage = page;
+	*pbegin = begin - offset;
+	*pend = end - offset;
+
+	return 1;
+}
+
+/* Add @size to *@total.
+ *
+ * Returns zero on success, -pte_overflow otherwise.
+ */
+static int pt_snap_add_size(size_t *total, uint64_t size)
+{
+	if (!total)
+		return -pte_internal;
+
+	if ((SIZE_MAX - *total) < size)
+		return -pte_overflow;
+
+	*total += (size_t) size;
+
+	return 0;
+}
+
+/* Compute the size of @ssec in a snapshot and the number of its ranges.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_snap_section_size(const struct pt_snap_section *ssec,
+				size_t *psize, uint32_t *pnranges)
+{
+	uint64_t page, begin, end;
+	uint32_t nranges;
+	size_t size;
+	int status;
+
+	if (!ssec || !psize || !pnranges)
+		return -pte_internal;
+
+	size = 0;
+	status = pt_snap_add_size(&size, pt_snap_section_header_size +
+				  strlen(pt_section_filename(ssec->section)) +
+				  ((uint64_t) ssec->nvaddr *
+				   pt_snap_vaddr_size));
+	if (status < 0)
+		return status;
+
+	nranges = 0;
+	page = 0ull;
+	for (;;) {
+		status = pt_snap_next_run(ssec, &page, &begin, &end);
+		if (status <= 0)
+			break;
+
+		status = pt_snap_add_size(&size, pt_snap_range_header_size +
+					  (end - begin));
+		if (status < 0)
+			break;
+
+		nranges += 1;
+		if (!nranges) {
+			status = -pte_overflow;
+			break;
+		}
+	}
+
+	if (status < 0)
+		return status;
+
+	*psize = size;
+	*pnranges = nranges;
+
+	return 0;
+}
+
+int pt_snap_size(const struct pt_code_snapshot *snap, size_t *size)
+{
+	const struct pt_snap_section *ssec;
+	size_t total;
+
+	if (!snap || !size)
+		return -pte_invalid;
+
+	total = pt_snap_header_size;
+	for (ssec = snap->sections; ssec; ssec = ssec->next) {
+		uint32_t nranges;
+		size_t ssize;
+		int errcode;
+
+		errcode = pt_snap_section_size(ssec, &ssize, &nranges);
+		if (errcode < 0)
+			return errcode;
+
+		errcode = pt_snap_add_size(&total, ssize);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	*size = total;
+
+	return 0;
+}
+
+static uint8_t *pt_snap_put(uint8_t *pos, uint64_t value, int size)
+{
+	for (; size; --size, value >>= 8)
+		*pos++ = (uint8_t) value;
+
+	return pos;
+}
+
+/* Write the content of @ssec's range [@begin; @end) to @pos.
+ *
+ * The caller has mapped @ssec's section.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_snap_write_range(const struct pt_snap_section *ssec,
+			       uint8_t *pos, uint64_t begin, uint64_t end)
+{
+	while (begin < end) {
+		uint64_t chunk;
+		int status;
+
+		chunk = end - begin;
+		if ((1ull << pt_snap_page_shift) < chunk)
+			chunk = 1ull << pt_snap_page_shift;
+
+		status = pt_section_read(ssec->section, pos, (uint16_t) chunk,
+					 begin);
+		if (status <= 0)
+			return -pte_bad_image;
+
+		pos += status;
+		begin += (uint64_t) status;
+	}
+
+	return 0;
+}
+
+/* Write @ssec to @pos.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_snap_write_section(const struct pt_snap_section *ssec,
+				 uint8_t *pos, uint32_t nranges)
+{
+	const char *filename;
+	uint64_t page, begin, end;
+	uint32_t idx;
+	size_t namelen;
+	int status, errcode;
+
+	if (!ssec || !pos)
+		return -pte_internal;
+
+	filename = pt_section_filename(ssec->section);
+	if (!filename)
+		return -pte_internal;
+
+	namelen = strlen(filename);
+	if (UINT32_MAX < namelen)
+		return -pte_overflow;
+
+	pos = pt_snap_put(pos, pt_section_offset(ssec->section), 8);
+	pos = pt_snap_put(pos, pt_section_size(ssec->section), 8);
+	pos = pt_snap_put(pos, namelen, 4);
+	pos = pt_snap_put(pos, ssec->nvaddr, 4);
+	pos = pt_snap_put(pos, nranges, 4);
+
+	memcpy(pos, filename, namelen);
+	pos += namelen;
+
+	for (idx = 0; idx < ssec->nvaddr; ++idx)
+		pos = pt_snap_put(pos, ssec->vaddr[idx], 8);
+
+	if (!nranges)
+		return 0;
+
+	errcode = pt_section_map(ssec->section);
+	if (errcode < 0)
+		return errcode;
+
+	page = 0ull;
+	for (;;) {
+		status = pt_snap_next_run(ssec, &page, &begin, &end);
+		if (status <= 0)
+			break;
+
+		pos = pt_snap_put(pos, begin, 8);
+		pos = pt_snap_put(pos, end - begin, 8);
+
+		status = pt_snap_write_range(ssec, pos, begin, end);
+		if (status < 0)
+			break;
+
+		pos += end - begin;
+	}
+
+	errcode = pt_section_unmap(ssec->section);
+
+	return (status < 0) ? status : errcode;
+}
+
+int pt_snap_write(struct pt_code_snapshot *snap, uint8_t *buffer, size_t size)
+{
+	const struct pt_snap_section *ssec;
+	uint32_t nsections;
+	size_t total;
+	uint8_t *pos;
+	int errcode;
+
+	if (!snap || !buffer)
+		return -pte_invalid;
+
+	errcode = pt_snap_size(snap, &total);
+	if (errcode < 0)
+		return errcode;
+
+	if (size < total)
+		return -pte_invalid;
+
+	if (INT_MAX < total)
+		return -pte_overflow;
+
+	nsections = 0;
+	for (ssec = snap->sections; ssec; ssec = ssec->next)
+		nsections += 1;
+
+	pos = pt_snap_put(buffer, pt_snap_magic, 4);
+	pos = pt_snap_put(pos, pt_snap_version, 2);
+	pos = pt_snap_put(pos, 0, 2);
+	pos = pt_snap_put(pos, nsections, 4);
+
+	for (ssec = snap->sections; ssec; ssec = ssec->next) {
+		uint32_t nranges;
+		size_t ssize;
+
+		errcode = pt_snap_section_size(ssec, &ssize, &nranges);
+		if (errcode < 0)
+			return errcode;
+
+		errcode = pt_snap_write_section(ssec, pos, nranges);
+		if (errcode < 0)
+			return errcode;
+
+		pos += ssize;
+	}
+
+	return (int) total;
+}
+
+/* Read a @size bytes little-endian value at *@pos into @value.
+ *
+ * Returns zero on success, -pte_bad_file if @end would be exceeded.
+ */
+static int pt_snap_get(uint64_t *value, const uint8_t **pos,
+		       const uint8_t *end, int size)
+{
+	const uint8_t *begin;
+	uint64_t val;
+	int byte;
+
+	if (!value || !pos || !*pos || !end)
+		return -pte_internal;
+
+	begin = *pos;
+	if ((end - begin) < size)
+		return -pte_bad_file;
+
+	val = 0ull;
+	for (byte = size - 1; 0 <= byte; --byte)
+		val = (val << 8) | begin[byte];
+
+	*value = val;
+	*pos = begin + size;
+
+	return 0;
+}
+
+/* Read the ranges of a section from *@pos into @memory.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_snap_load_ranges(struct pt_sec_memory *memory,
+			       const uint8_t **pos, const uint8_t *end,
+			       uint64_t nranges, uint64_t size)
+{
+	for (; nranges; --nranges) {
+		uint64_t offset, rsize;
+		int errcode;
+
+		errcode = pt_snap_get(&offset, pos, end, 8);
+		if (errcode < 0)
+			return errcode;
+
+		errcode = pt_snap_get(&rsize, pos, end, 8);
+		if (errcode < 0)
+			return errcode;
+
+		if ((size < offset) || ((size - offset) < rsize) || !rsize)
+			return -pte_bad_file;
+
+		if ((uint64_t) (end - *pos) < rsize)
+			return -pte_bad_file;
+
+		errcode = pt_sec_memory_add(memory, offset, *pos,
+					    (size_t) rsize);
+		if (errcode < 0)
+			return (errcode == -pte_invalid) ? -pte_bad_file :
+				errcode;
+
+		*pos += rsize;
+	}
+
+	return 0;
+}
+
+/* Load a section from *@pos into @iscache and, optionally, into @image.
+ *
+ * Returns the number of added image section cache entries on success, a
+ * negative error code otherwise.
+ */
+static int pt_snap_load_section(struct pt_image_section_cache *iscache,
+				struct pt_image *image,
+				const struct pt_asid *asid,
+				const uint8_t **pos, const uint8_t *end)
+{
+	struct pt_sec_memory *memory;
+	struct pt_section *section;
+	const uint8_t *vaddr;
+	uint64_t offset, size, namelen, nvaddr, nranges, idx;
+	char *filename;
+	int errcode, nadded;
+
+	if (!pos || !end)
+		return -pte_internal;
+
+	errcode = pt_snap_get(&offset, pos, end, 8);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_snap_get(&size, pos, end, 8);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_snap_get(&namelen, pos, end, 4);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_snap_get(&nvaddr, pos, end, 4);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_snap_get(&nranges, pos, end, 4);
+	if (errcode < 0)
+		return errcode;
+
+	if (!size || !namelen)
+		return -pte_bad_file;
+
+	if ((uint64_t) (end - *pos) < namelen)
+		return -pte_bad_file;
+
+	filename = malloc((size_t) namelen + 1);
+	if (!filename)
+		return -pte_nomem;
+
+	memcpy(filename, *pos, (size_t) namelen);
+	filename[namelen] = 0;
+	*pos += namelen;
+
+	/* We read the load addresses once we created the section. */
+	vaddr = *pos;
+	if (((uint64_t) (end - vaddr) / pt_snap_vaddr_size) < nvaddr) {
+		free(filename);
+		return -pte_bad_file;
+	}
+
+	*pos += nvaddr * pt_snap_vaddr_size;
+
+	memory = pt_sec_memory_alloc();
+	if (!memory) {
+		free(filename);
+		return -pte_nomem;
+	}
+
+	errcode = pt_snap_load_ranges(memory, pos, end, nranges, size);
+	if (errcode < 0) {
+		pt_sec_memory_free(memory);
+		free(filename);
+		return errcode;
+	}
+
+	section = pt_mk_section_memory(filename, offset, size, memory);
+	free(filename);
+	if (!section) {
+		pt_sec_memory_free(memory);
+		return -pte_nomem;
+	}
+
+	nadded = 0;
+	for (idx = 0; idx < nvaddr; ++idx) {
+		uint64_t laddr;
+		int isid;
+
+		errcode = pt_snap_get(&laddr, &vaddr, end, 8);
+		if (errcode < 0)
+			break;
+
+		isid = pt_iscache_add(iscache, section, laddr);
+		if (isid < 0) {
+			errcode = isid;
+			break;
+		}
+
+		if (image) {
+			errcode = pt_image_add_cached(image, iscache, isid,
+						      asid);
+			if (errcode < 0)
+				break;
+		}
+
+		nadded += 1;
+	}
+
+	/* The image section cache holds its own references. */
+	(void) pt_section_put(section);
+
+	return (errcode < 0) ? errcode : nadded;
+}
+
+int pt_snap_load(struct pt_image_section_cache *iscache,
+		 struct pt_image *image, const struct pt_asid *asid,
+		 const uint8_t *buffer, size_t size)
+{
+	const uint8_t *pos, *end;
+	uint64_t magic, version, reserved, nsections;
+	int errcode, nadded;
+
+	if (!iscache || !buffer)
+		return -pte_invalid;
+
+	pos = buffer;
+	end = buffer + size;
+
+	errcode = pt_snap_get(&magic, &pos, end, 4);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_snap_get(&version, &pos, end, 2);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_snap_get(&reserved, &pos, end, 2);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_snap_get(&nsections, &pos, end, 4);
+	if (errcode < 0)
+		return errcode;
+
+	if ((magic != pt_snap_magic) || (version != pt_snap_version))
+		return -pte_bad_file;
+
+	nadded = 0;
+	for (; nsections; --nsections) {
+		int status;
+
+		status = pt_snap_load_section(iscache, image, asid, &pos, end);
+		if (status < 0)
+			return status;
+
+		if ((INT_MAX - nadded) < status)
+			return -pte_overflow;
+
+		nadded += status;
+	}
+
+	return nadded;
+}
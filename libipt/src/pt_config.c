@@ -109,6 +109,31 @@ int pt_config_from_user(struct pt_config *config,
 	begin = uconfig->begin;
 	end = uconfig->end;
 
+	/* With trace buffer fragments, @begin and @end are ignored.  We use
+	 * the first fragment, instead, until decoders move to their first
+	 * trace window.
+	 */
+	if ((offsetof(struct pt_config, nfragments) +
+	     sizeof(uconfig->nfragments)) <= size && uconfig->nfragments) {
+		const struct pt_fragment *fragments;
+		size_t fragment;
+
+		fragments = uconfig->fragments;
+		if (!fragments)
+			return -pte_bad_config;
+
+		for (fragment = 0; fragment < uconfig->nfragments; ++fragment) {
+			if (!fragments[fragment].begin ||
+			    !fragments[fragment].end ||
+			    (fragments[fragment].end <
+			     fragments[fragment].begin))
+				return -pte_bad_config;
+		}
+
+		begin = fragments[0].begin;
+		end = fragments[0].end;
+	}
+
 	if (!begin || !end || end < begin)
 		return -pte_bad_config;
 
@@ -126,6 +151,9 @@ int pt_config_from_user(struct pt_config *config,
 	/* We copied user's size - fix it. */
 	config->size = size;
 
+	config->begin = begin;
+	config->end = end;
+
 	return 0;
 }
 
@@ -0,0 +1,427 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_cost.h"
+#include "pt_config.h"
+#include "pt_packet_decoder.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+
+int pt_cost_init(struct pt_cost_profile *profile,
+		 const struct pt_config *config)
+{
+	int errcode;
+
+	if (!profile)
+		return -pte_internal;
+
+	memset(profile, 0, sizeof(*profile));
+
+	errcode = pt_config_from_user(&profile->config, config);
+	if (errcode < 0)
+		return errcode;
+
+	/* The user's block or insn flags must not be read as packet flags. */
+	memset(&profile->config.flags, 0, sizeof(profile->config.flags));
+
+	return 0;
+}
+
+void pt_cost_fini(struct pt_cost_profile *profile)
+{
+	if (!profile)
+		return;
+
+	free(profile->segments);
+}
+
+struct pt_cost_profile *pt_cost_alloc(const struct pt_config *config)
+{
+	struct pt_cost_profile *profile;
+	int errcode;
+
+	profile = malloc(sizeof(*profile));
+	if (!profile)
+		return NULL;
+
+	errcode = pt_cost_init(profile, config);
+	if (errcode < 0) {
+		free(profile);
+		return NULL;
+	}
+
+	return profile;
+}
+
+void pt_cost_free(struct pt_cost_profile *profile)
+{
+	pt_cost_fini(profile);
+	free(profile);
+}
+
+int pt_cost_add(struct pt_segment_cost *cost, const struct pt_packet *packet)
+{
+	if (!cost || !packet)
+		return -pte_internal;
+
+	switch (packet->type) {
+	case ppt_tnt_8:
+	case ppt_tnt_64:
+		cost->tnt += packet->payload.tnt.bit_size;
+		break;
+
+	case ppt_tip:
+	case ppt_tip_pge:
+	case ppt_tip_pgd:
+		cost->tip += 1;
+		break;
+
+	case ppt_fup:
+		cost->fup += 1;
+		break;
+
+	case ppt_mode:
+	case ppt_pip:
+	case ppt_vmcs:
+	case ppt_mnt:
+	case ppt_stop:
+	case ppt_exstop:
+	case ppt_mwait:
+	case ppt_pwre:
+	case ppt_pwrx:
+	case ppt_ptw:
+		cost->events += 1;
+		break;
+
+	case ppt_tsc:
+	case ppt_mtc:
+	case ppt_cyc:
+	case ppt_tma:
+	case ppt_cbr:
+		cost->timing += 1;
+		break;
+
+	case ppt_ovf:
+		cost->ovf += 1;
+		break;
+
+	case ppt_unknown:
+	case ppt_invalid:
+	case ppt_pad:
+	case ppt_psb:
+	case ppt_psbend:
+		break;
+	}
+
+	return 0;
+}
+
+void pt_cost_estimate(struct pt_segment_cost *cost)
+{
+	if (!cost)
+		return;
+
+	cost->cost = (cost->tnt * pt_cost_tnt) +
+		(cost->tip * pt_cost_tip) +
+		(cost->fup * pt_cost_fup) +
+		(cost->events * pt_cost_event) +
+		(cost->timing * pt_cost_timing) +
+		(cost->ovf * pt_cost_ovf) +
+		(cost->errors * pt_cost_error) +
+		(cost->size >> pt_cost_byte_shr);
+}
+
+/* Start a new PSB segment at @offset.
+ *
+ * Provides a pointer to the new segment in @pcost.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_cost_begin(struct pt_cost_profile *profile,
+			 struct pt_segment_cost **pcost, uint64_t offset)
+{
+	struct pt_segment_cost *segments, *cost;
+	size_t nsegments;
+
+	if (!profile || !pcost)
+		return -pte_internal;
+
+	segments = profile->segments;
+	nsegments = profile->nsegments;
+	if (profile->capacity <= nsegments) {
+		size_t capacity;
+
+		capacity = profile->capacity ? profile->capacity * 2 : 64;
+		segments = realloc(segments, capacity * sizeof(*segments));
+		if (!segments)
+			return -pte_nomem;
+
+		profile->segments = segments;
+		profile->capacity = capacity;
+	}
+
+	cost = &segments[nsegments];
+	memset(cost, 0, sizeof(*cost));
+	cost->offset = offset;
+
+	profile->nsegments = nsegments + 1;
+	*pcost = cost;
+
+	return 0;
+}
+
+static int pt_cost_scan_trace(struct pt_cost_profile *profile,
+			      struct pt_packet_decoder *decoder)
+{
+	for (;;) {
+		struct pt_segment_cost *cost;
+		int errcode;
+
+		errcode = pt_pkt_sync_forward(decoder);
+		if (errcode < 0) {
+			if (errcode == -pte_eos)
+				return 0;
+
+			return errcode;
+		}
+
+		cost = NULL;
+		for (;;) {
+			struct pt_packet packet;
+			uint64_t offset;
+
+			errcode = pt_pkt_get_offset(decoder, &offset);
+			if (errcode < 0)
+				return errcode;
+
+			errcode = pt_pkt_next(decoder, &packet, sizeof(packet));
+			if (errcode < 0) {
+				/* The segment ends at the last packet we were
+				 * able to decode.  We skip the rest up to the
+				 * next PSB.
+				 */
+				if (cost) {
+					cost->size = offset - cost->offset;
+
+					if (errcode != -pte_eos)
+						cost->errors += 1;
+				}
+
+				break;
+			}
+
+			if (!cost || (packet.type == ppt_psb)) {
+				if (cost)
+					cost->size = offset - cost->offset;
+
+				errcode = pt_cost_begin(profile, &cost, offset);
+				if (errcode < 0)
+					return errcode;
+			}
+
+			errcode = pt_cost_add(cost, &packet);
+			if (errcode < 0)
+				return errcode;
+		}
+
+		if (errcode == -pte_eos)
+			return 0;
+	}
+}
+
+int pt_cost_scan(struct pt_cost_profile *profile)
+{
+	struct pt_packet_decoder decoder;
+	size_t idx;
+	int errcode;
+
+	if (!profile)
+		return -pte_invalid;
+
+	profile->nsegments = 0;
+
+	errcode = pt_pkt_decoder_init(&decoder, &profile->config);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_cost_scan_trace(profile, &decoder);
+
+	pt_pkt_decoder_fini(&decoder);
+
+	if (errcode < 0)
+		return errcode;
+
+	for (idx = 0; idx < profile->nsegments; ++idx)
+		pt_cost_estimate(&profile->segments[idx]);
+
+	if (INT_MAX < profile->nsegments)
+		return -pte_overflow;
+
+	return (int) profile->nsegments;
+}
+
+int pt_cost_segment(const struct pt_cost_profile *profile,
+		    struct pt_segment_cost *cost, size_t size, size_t index)
+{
+	if (!profile || !cost)
+		return -pte_invalid;
+
+	if (profile->nsegments <= index)
+		return -pte_eos;
+
+	if (sizeof(*cost) < size)
+		size = sizeof(*cost);
+
+	memcpy(cost, &profile->segments[index], size);
+
+	return 0;
+}
+
+/* Greedily pack segments into parts of at most @limit cost.
+ *
+ * If @first is not NULL, provides the index of the first segment of each part
+ * in @first and starts new parts early so all @nparts parts are used if there
+ * are enough segments.
+ *
+ * Returns the number of parts or @nparts + 1 if @nparts parts do not suffice.
+ */
+static size_t pt_cost_pack(size_t *first, size_t nparts,
+			   const struct pt_segment_cost *segments,
+			   size_t nsegments, uint64_t limit)
+{
+	uint64_t sum;
+	size_t idx, parts;
+
+	sum = 0ull;
+	parts = 0;
+	for (idx = 0; idx < nsegments; ++idx) {
+		uint64_t cost;
+
+		cost = segments[idx].cost;
+
+		if (!parts || ((limit - sum) < cost) ||
+		    (first && ((nsegments - idx) <= (nparts - parts)))) {
+			if (parts == nparts)
+				return nparts + 1;
+
+			if (first)
+				first[parts] = idx;
+
+			parts += 1;
+			sum = 0ull;
+		}
+
+		sum += cost;
+	}
+
+	return parts;
+}
+
+int pt_cost_split(size_t *first, size_t nparts,
+		  const struct pt_segment_cost *segments, size_t nsegments)
+{
+	uint64_t low, high;
+	size_t idx, parts;
+
+	if (!first || (!segments && nsegments))
+		return -pte_internal;
+
+	if (INT_MAX < nparts)
+		return -pte_internal;
+
+	/* The most expensive part costs at least as much as the most expensive
+	 * segment and at most as much as all segments together.
+	 */
+	low = 0ull;
+	high = 0ull;
+	for (idx = 0; idx < nsegments; ++idx) {
+		uint64_t cost;
+
+		cost = segments[idx].cost;
+
+		if (low < cost)
+			low = cost;
+
+		if (UINT64_MAX - high < cost)
+			high = UINT64_MAX;
+		else
+			high += cost;
+	}
+
+	/* Search for the minimal cost that allows packing all segments into
+	 * @nparts parts.
+	 */
+	while (low < high) {
+		uint64_t limit;
+
+		limit = low + ((high - low) / 2);
+
+		if (pt_cost_pack(NULL, nparts, segments, nsegments, limit) <=
+		    nparts)
+			high = limit;
+		else
+			low = limit + 1;
+	}
+
+	parts = pt_cost_pack(first, nparts, segments, nsegments, low);
+	if (nparts < parts)
+		return -pte_internal;
+
+	return (int) parts;
+}
+
+int pt_cost_partition(const struct pt_cost_profile *profile, uint64_t *begin,
+		      uint32_t nparts)
+{
+	size_t *first;
+	int idx, parts;
+
+	if (!profile || !begin || !nparts)
+		return -pte_invalid;
+
+	if (INT_MAX < nparts)
+		return -pte_invalid;
+
+	first = malloc(nparts * sizeof(*first));
+	if (!first)
+		return -pte_nomem;
+
+	parts = pt_cost_split(first, nparts, profile->segments,
+			      profile->nsegments);
+	for (idx = 0; idx < parts; ++idx)
+		begin[idx] = profile->segments[first[idx]].offset;
+
+	free(first);
+
+	return parts;
+}
@@ -0,0 +1,695 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_footprint.h"
+#include "pt_insn.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+
+int pt_fp_lru_init(struct pt_fp_lru *lru, uint32_t nsets, uint32_t nways)
+{
+	uint64_t *tag;
+	size_t ntags, idx;
+
+	if (!lru)
+		return -pte_internal;
+
+	memset(lru, 0, sizeof(*lru));
+
+	if (!nsets || !nways)
+		return 0;
+
+	ntags = (size_t) nsets * (size_t) nways;
+	if ((ntags / nways) != nsets)
+		return -pte_nomem;
+
+	tag = malloc(ntags * sizeof(*tag));
+	if (!tag)
+		return -pte_nomem;
+
+	/* Line and page numbers never have all bits set. */
+	for (idx = 0; idx < ntags; ++idx)
+		tag[idx] = UINT64_MAX;
+
+	lru->tag = tag;
+	lru->nsets = nsets;
+	lru->nways = nways;
+
+	return 0;
+}
+
+void pt_fp_lru_fini(struct pt_fp_lru *lru)
+{
+	if (!lru)
+		return;
+
+	free(lru->tag);
+	lru->tag = NULL;
+}
+
+int pt_fp_lru_access(struct pt_fp_lru *lru, uint64_t tag)
+{
+	uint64_t *set;
+	uint32_t way, nways;
+	int hit;
+
+	if (!lru)
+		return -pte_internal;
+
+	if (!lru->tag)
+		return 1;
+
+	nways = lru->nways;
+	set = &lru->tag[(tag % lru->nsets) * nways];
+
+	for (way = 0; way < nways; ++way) {
+		if (set[way] == tag)
+			break;
+	}
+
+	/* On a miss, we evict the least recently used way. */
+	hit = (way < nways);
+	if (!hit)
+		way = nways - 1;
+
+	/* Make @tag the most recently used way. */
+	for (; way; --way)
+		set[way] = set[way - 1];
+
+	set[0] = tag;
+
+	return hit;
+}
+
+int pt_fp_init(struct pt_footprint *fp, const struct pt_fp_config *config,
+	       struct pt_image_section_cache *iscache)
+{
+	int errcode;
+
+	if (!fp || !config)
+		return -pte_internal;
+
+	memset(fp, 0, sizeof(*fp));
+
+	if (config->size < offsetof(struct pt_fp_config, icache_sets))
+		return -pte_invalid;
+
+	pt_fp_config_init(&fp->config);
+
+	/* Use the default for fields the user does not know about. */
+	memcpy(&fp->config, config, config->size < sizeof(fp->config) ?
+	       config->size : sizeof(fp->config));
+	fp->config.size = sizeof(fp->config);
+
+	fp->iscache = iscache;
+	fp->last_4k = UINT64_MAX;
+	fp->last_2m = UINT64_MAX;
+
+	errcode = pt_fp_lru_init(&fp->icache, fp->config.icache_sets,
+				 fp->config.icache_ways);
+	if (errcode < 0)
+		goto out_err;
+
+	errcode = pt_fp_lru_init(&fp->itlb_4k, 1, fp->config.itlb_4k_entries);
+	if (errcode < 0)
+		goto out_icache;
+
+	errcode = pt_fp_lru_init(&fp->itlb_2m, 1, fp->config.itlb_2m_entries);
+	if (errcode < 0)
+		goto out_itlb_4k;
+
+	return 0;
+
+out_itlb_4k:
+	pt_fp_lru_fini(&fp->itlb_4k);
+
+out_icache:
+	pt_fp_lru_fini(&fp->icache);
+
+out_err:
+	return errcode;
+}
+
+void pt_fp_fini(struct pt_footprint *fp)
+{
+	size_t idx;
+
+	if (!fp)
+		return;
+
+	for (idx = 0; idx < pt_fp_nbuckets; ++idx) {
+		struct pt_fp_block *fblock;
+
+		fblock = fp->block[idx];
+		while (fblock) {
+			struct pt_fp_block *trash;
+
+			trash = fblock;
+			fblock = fblock->next;
+
+			free(trash->lines);
+			free(trash);
+		}
+
+		fp->block[idx] = NULL;
+	}
+
+	for (idx = 0; idx < pt_fp_nregions; ++idx) {
+		struct pt_fp_region *region;
+
+		region = fp->region[idx];
+		while (region) {
+			struct pt_fp_region *trash;
+
+			trash = region;
+			region = region->next;
+
+			free(trash);
+		}
+
+		fp->region[idx] = NULL;
+	}
+
+	fp->last_region = NULL;
+
+	pt_fp_lru_fini(&fp->itlb_2m);
+	pt_fp_lru_fini(&fp->itlb_4k);
+	pt_fp_lru_fini(&fp->icache);
+}
+
+struct pt_footprint *pt_fp_alloc(const struct pt_fp_config *config,
+				 struct pt_image_section_cache *iscache)
+{
+	struct pt_footprint *fp;
+	int errcode;
+
+	if (!config)
+		return NULL;
+
+	fp = malloc(sizeof(*fp));
+	if (!fp)
+		return NULL;
+
+	errcode = pt_fp_init(fp, config, iscache);
+	if (errcode < 0) {
+		free(fp);
+		return NULL;
+	}
+
+	return fp;
+}
+
+void pt_fp_free(struct pt_footprint *fp)
+{
+	if (!fp)
+		return;
+
+	pt_fp_fini(fp);
+	free(fp);
+}
+
+/* Append @line to @fblock->lines unless it is already the last entry.
+ *
+ * Grows @fblock->lines as needed using @capacity to track its size.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_fp_add_line(struct pt_fp_block *fblock, uint32_t *capacity,
+			  uint64_t line)
+{
+	uint64_t *lines;
+	uint32_t nlines, cap;
+
+	if (!fblock || !capacity)
+		return -pte_internal;
+
+	lines = fblock->lines;
+	nlines = fblock->nlines;
+	if (nlines && (lines[nlines - 1] == line))
+		return 0;
+
+	cap = *capacity;
+	if (cap <= nlines) {
+		cap = cap ? cap * 2 : 8;
+
+		lines = realloc(lines, cap * sizeof(*lines));
+		if (!lines)
+			return -pte_nomem;
+
+		fblock->lines = lines;
+		*capacity = cap;
+	}
+
+	lines[nlines] = line;
+	fblock->nlines = nlines + 1;
+
+	return 0;
+}
+
+/* The context for collecting the cache lines of a block's instructions. */
+struct pt_fp_summary {
+	/* The block summary. */
+	struct pt_fp_block *fblock;
+
+	/* The number of cache lines allocated in @fblock. */
+	uint32_t capacity;
+};
+
+/* Add the cache lines covered by @insn to the struct pt_fp_summary
+ * @context.
+ */
+static int pt_fp_add_insn(const struct pt_insn *insn,
+			  const struct pt_insn_ext *iext, void *context)
+{
+	struct pt_fp_summary *summary;
+	uint64_t line, end;
+
+	(void) iext;
+
+	summary = (struct pt_fp_summary *) context;
+	if (!insn || !summary)
+		return -pte_internal;
+
+	end = (insn->ip + insn->size - 1) >> pt_fp_line_shr;
+	for (line = insn->ip >> pt_fp_line_shr; line <= end; ++line) {
+		int errcode;
+
+		errcode = pt_fp_add_line(summary->fblock, &summary->capacity,
+					 line);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	return 0;
+}
+
+int pt_fp_summarize(struct pt_fp_block *fblock, const struct pt_block *block,
+		    struct pt_image_section_cache *iscache)
+{
+	struct pt_fp_summary summary;
+	int errcode;
+
+	if (!fblock || !block)
+		return -pte_internal;
+
+	memset(fblock, 0, sizeof(*fblock));
+	fblock->ip = block->ip;
+	fblock->isid = block->isid;
+	fblock->mode = block->mode;
+	fblock->ninsn = block->ninsn;
+
+	summary.fblock = fblock;
+	summary.capacity = 0;
+
+	errcode = pt_insn_walk_block(block, iscache, pt_fp_add_insn, &summary);
+	if (errcode < 0) {
+		free(fblock->lines);
+		fblock->lines = NULL;
+		fblock->nlines = 0;
+	}
+
+	return errcode;
+}
+
+static unsigned int pt_fp_block_hash(uint64_t ip)
+{
+	return (unsigned int) ((ip ^ (ip >> 10)) & (pt_fp_nbuckets - 1));
+}
+
+/* Find or create the summary for @block.
+ *
+ * Returns the summary on success, NULL otherwise and sets @errcode.
+ */
+static const struct pt_fp_block *pt_fp_fetch_block(struct pt_footprint *fp,
+						   const struct pt_block *block,
+						   int *errcode)
+{
+	struct pt_fp_block *fblock;
+	unsigned int idx;
+	int status;
+
+	if (!fp || !block || !errcode)
+		return NULL;
+
+	idx = pt_fp_block_hash(block->ip);
+	for (fblock = fp->block[idx]; fblock; fblock = fblock->next) {
+		if ((fblock->ip == block->ip) &&
+		    (fblock->ninsn == block->ninsn) &&
+		    (fblock->isid == block->isid) &&
+		    (fblock->mode == block->mode))
+			return fblock;
+	}
+
+	fblock = malloc(sizeof(*fblock));
+	if (!fblock) {
+		*errcode = -pte_nomem;
+		return NULL;
+	}
+
+	status = pt_fp_summarize(fblock, block, fp->iscache);
+	if (status < 0) {
+		free(fblock);
+
+		*errcode = status;
+		return NULL;
+	}
+
+	fblock->next = fp->block[idx];
+	fp->block[idx] = fblock;
+
+	return fblock;
+}
+
+/* Find or create the region for 2M page @page.
+ *
+ * Returns the region on success, NULL otherwise.
+ */
+static struct pt_fp_region *pt_fp_fetch_region(struct pt_footprint *fp,
+					       uint64_t page)
+{
+	struct pt_fp_region *region;
+	unsigned int idx;
+
+	if (!fp)
+		return NULL;
+
+	region = fp->last_region;
+	if (region && (region->page == page))
+		return region;
+
+	idx = (unsigned int) (page & (pt_fp_nregions - 1));
+	for (region = fp->region[idx]; region; region = region->next) {
+		if (region->page == page)
+			break;
+	}
+
+	if (!region) {
+		region = malloc(sizeof(*region));
+		if (!region)
+			return NULL;
+
+		memset(region, 0, sizeof(*region));
+		region->page = page;
+		region->next = fp->region[idx];
+		fp->region[idx] = region;
+	}
+
+	fp->last_region = region;
+
+	return region;
+}
+
+/* Account for fetching @line.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_fp_fetch_line(struct pt_footprint *fp, uint64_t line)
+{
+	struct pt_fp_region *region;
+	uint64_t page_4k, page_2m, bit;
+	size_t idx;
+	int status;
+
+	if (!fp)
+		return -pte_internal;
+
+	page_4k = line >> (pt_fp_4k_shr - pt_fp_line_shr);
+	page_2m = line >> (pt_fp_2m_shr - pt_fp_line_shr);
+
+	region = pt_fp_fetch_region(fp, page_2m);
+	if (!region)
+		return -pte_nomem;
+
+	idx = (size_t) (page_4k & (pt_fp_region_npages - 1));
+	bit = 1ull << (line & ((1ull << (pt_fp_4k_shr - pt_fp_line_shr)) - 1));
+
+	if (!(region->window[idx] & bit)) {
+		if (!region->window[idx])
+			fp->window.pages_4k += 1;
+
+		if (!region->in_window) {
+			region->in_window = 1;
+			fp->window.pages_2m += 1;
+		}
+
+		region->window[idx] |= bit;
+		fp->window.lines += 1;
+	}
+
+	if (!(region->total[idx] & bit)) {
+		if (!region->total[idx])
+			fp->total.pages_4k += 1;
+
+		if (!region->in_total) {
+			region->in_total = 1;
+			fp->total.pages_2m += 1;
+		}
+
+		region->total[idx] |= bit;
+		fp->total.lines += 1;
+	}
+
+	fp->window.fetches += 1;
+
+	status = pt_fp_lru_access(&fp->icache, line);
+	if (status < 0)
+		return status;
+
+	if (!status)
+		fp->window.icache_misses += 1;
+
+	/* Looking up the most recently used page again is always a hit and
+	 * does not change the order.
+	 */
+	if (page_4k != fp->last_4k) {
+		fp->last_4k = page_4k;
+
+		status = pt_fp_lru_access(&fp->itlb_4k, page_4k);
+		if (status < 0)
+			return status;
+
+		if (!status)
+			fp->window.itlb_4k_misses += 1;
+	}
+
+	if (page_2m != fp->last_2m) {
+		fp->last_2m = page_2m;
+
+		status = pt_fp_lru_access(&fp->itlb_2m, page_2m);
+		if (status < 0)
+			return status;
+
+		if (!status)
+			fp->window.itlb_2m_misses += 1;
+	}
+
+	return 0;
+}
+
+/* Accumulate the additive statistics of @window in @total. */
+static void pt_fp_accumulate(struct pt_fp_stats *total,
+			     const struct pt_fp_stats *window)
+{
+	if (!total || !window || !window->nblocks)
+		return;
+
+	if (!total->nblocks)
+		total->tsc_begin = window->tsc_begin;
+
+	total->tsc_end = window->tsc_end;
+	total->nblocks += window->nblocks;
+	total->ninsn += window->ninsn;
+	total->fetches += window->fetches;
+	total->icache_misses += window->icache_misses;
+	total->itlb_4k_misses += window->itlb_4k_misses;
+	total->itlb_2m_misses += window->itlb_2m_misses;
+}
+
+int pt_fp_close_window(struct pt_footprint *fp)
+{
+	size_t idx;
+
+	if (!fp)
+		return -pte_invalid;
+
+	if (!fp->window.nblocks)
+		return 0;
+
+	for (idx = 0; idx < pt_fp_nregions; ++idx) {
+		struct pt_fp_region *region;
+
+		for (region = fp->region[idx]; region; region = region->next) {
+			if (!region->in_window)
+				continue;
+
+			memset(region->window, 0, sizeof(region->window));
+			region->in_window = 0;
+		}
+	}
+
+	pt_fp_accumulate(&fp->total, &fp->window);
+
+	fp->last = fp->window;
+	fp->have_last = 1;
+
+	memset(&fp->window, 0, sizeof(fp->window));
+
+	return 1;
+}
+
+/* Check whether @block starts a new analysis window.
+ *
+ * Returns non-zero if it does, zero otherwise.
+ */
+static int pt_fp_window_done(const struct pt_footprint *fp,
+			     const struct pt_block *block)
+{
+	const struct pt_fp_stats *window;
+	uint64_t limit;
+
+	if (!fp || !block)
+		return 0;
+
+	window = &fp->window;
+	if (!window->nblocks)
+		return 0;
+
+	limit = fp->config.window_insn;
+	if (limit && (limit <= window->ninsn))
+		return 1;
+
+	limit = fp->config.window_tsc;
+	if (limit && (window->tsc_begin <= block->tsc_begin) &&
+	    (limit <= (block->tsc_begin - window->tsc_begin)))
+		return 1;
+
+	return 0;
+}
+
+int pt_fp_add_block(struct pt_footprint *fp, const struct pt_block *block)
+{
+	const struct pt_fp_block *fblock;
+	uint32_t idx;
+	int status, errcode;
+
+	if (!fp || !block)
+		return -pte_invalid;
+
+	/* There's nothing to fetch in an empty block. */
+	if (!block->ninsn)
+		return 0;
+
+	/* We need an image section cache section for reading memory. */
+	if (block->isid <= 0)
+		return -pte_bad_image;
+
+	errcode = 0;
+	fblock = pt_fp_fetch_block(fp, block, &errcode);
+	if (!fblock)
+		return errcode ? errcode : -pte_internal;
+
+	status = 0;
+	if (pt_fp_window_done(fp, block)) {
+		status = pt_fp_close_window(fp);
+		if (status < 0)
+			return status;
+	}
+
+	for (idx = 0; idx < fblock->nlines; ++idx) {
+		errcode = pt_fp_fetch_line(fp, fblock->lines[idx]);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	if (!fp->window.nblocks)
+		fp->window.tsc_begin = block->tsc_begin;
+
+	fp->window.tsc_end = block->tsc_end;
+	fp->window.nblocks += 1;
+	fp->window.ninsn += block->ninsn;
+
+	return status;
+}
+
+/* Copy @stats to @ustats.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_fp_stats_to_user(struct pt_fp_stats *ustats, size_t size,
+			       const struct pt_fp_stats *stats)
+{
+	if (!ustats || !stats)
+		return -pte_invalid;
+
+	if (size < offsetof(struct pt_fp_stats, fetches))
+		return -pte_invalid;
+
+	/* Zero out any unknown bytes. */
+	if (sizeof(*stats) < size) {
+		memset((uint8_t *) ustats + sizeof(*stats), 0,
+		       size - sizeof(*stats));
+
+		size = sizeof(*stats);
+	}
+
+	memcpy(ustats, stats, size);
+
+	return 0;
+}
+
+int pt_fp_window(const struct pt_footprint *fp, struct pt_fp_stats *stats,
+		 size_t size)
+{
+	if (!fp)
+		return -pte_invalid;
+
+	if (!fp->have_last)
+		return -pte_nosync;
+
+	return pt_fp_stats_to_user(stats, size, &fp->last);
+}
+
+int pt_fp_total(const struct pt_footprint *fp, struct pt_fp_stats *stats,
+		size_t size)
+{
+	struct pt_fp_stats total;
+
+	if (!fp)
+		return -pte_invalid;
+
+	/* Include the current, not yet closed, analysis window. */
+	total = fp->total;
+	pt_fp_accumulate(&total, &fp->window);
+
+	return pt_fp_stats_to_user(stats, size, &total);
+}
@@ -0,0 +1,891 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_hot_profile.h"
+#include "pt_image_section_cache.h"
+#include "pt_section.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+
+static char *dupstr(const char *str)
+{
+	char *dup;
+	size_t len;
+
+	if (!str)
+		return NULL;
+
+	len = strlen(str);
+	dup = malloc(len + 1);
+	if (!dup)
+		return NULL;
+
+	return strcpy(dup, str);
+}
+
+static const char *pt_hot_basename(const char *filename)
+{
+	const char *base, *pos;
+
+	base = filename;
+	for (pos = filename; *pos; ++pos) {
+		if ((*pos == '/') || (*pos == '\\'))
+			base = pos + 1;
+	}
+
+	return base;
+}
+
+static uint32_t pt_hot_hash_str(uint32_t hash, const char *str)
+{
+	for (; *str; ++str)
+		hash = (hash ^ (uint8_t) *str) * 16777619u;
+
+	return hash;
+}
+
+static uint32_t pt_hot_hash_u64(uint32_t hash, uint64_t value)
+{
+	int byte;
+
+	for (byte = 0; byte < 8; ++byte, value >>= 8)
+		hash = (hash ^ (uint8_t) value) * 16777619u;
+
+	return hash;
+}
+
+static unsigned int pt_hot_bucket(uint32_t hash)
+{
+	return (unsigned int) ((hash ^ (hash >> 16)) & (pt_hot_nbuckets - 1));
+}
+
+int pt_hot_init(struct pt_hot_profile *profile,
+		struct pt_image_section_cache *iscache)
+{
+	if (!profile)
+		return -pte_internal;
+
+	memset(profile, 0, sizeof(*profile));
+	profile->iscache = iscache;
+
+	return 0;
+}
+
+void pt_hot_fini(struct pt_hot_profile *profile)
+{
+	struct pt_hot_section *hsec;
+	struct pt_hot_file *file;
+	size_t idx;
+
+	if (!profile)
+		return;
+
+	for (idx = 0; idx < pt_hot_nbuckets; ++idx) {
+		struct pt_hot_func *func;
+		struct pt_hot_edge *edge;
+
+		func = profile->funcs[idx];
+		while (func) {
+			struct pt_hot_func *trash;
+
+			trash = func;
+			func = func->next;
+
+			free(trash);
+		}
+
+		edge = profile->edges[idx];
+		while (edge) {
+			struct pt_hot_edge *trash;
+
+			trash = edge;
+			edge = edge->next;
+
+			free(trash);
+		}
+
+		profile->funcs[idx] = NULL;
+		profile->edges[idx] = NULL;
+	}
+
+	hsec = profile->sections;
+	while (hsec) {
+		struct pt_hot_section *trash;
+
+		trash = hsec;
+		hsec = hsec->next;
+
+		free(trash);
+	}
+
+	file = profile->files;
+	while (file) {
+		struct pt_hot_file *trash;
+		size_t sym;
+
+		trash = file;
+		file = file->next;
+
+		for (sym = 0; sym < trash->nsymbols; ++sym)
+			free(trash->symbols[sym].name);
+
+		free(trash->symbols);
+		free(trash->filename);
+		free(trash);
+	}
+
+	profile->sections = NULL;
+	profile->files = NULL;
+	profile->last = NULL;
+}
+
+struct pt_hot_profile *pt_hot_alloc(struct pt_image_section_cache *iscache)
+{
+	struct pt_hot_profile *profile;
+	int errcode;
+
+	profile = malloc(sizeof(*profile));
+	if (!profile)
+		return NULL;
+
+	errcode = pt_hot_init(profile, iscache);
+	if (errcode < 0) {
+		free(profile);
+		return NULL;
+	}
+
+	return profile;
+}
+
+void pt_hot_free(struct pt_hot_profile *profile)
+{
+	if (!profile)
+		return;
+
+	pt_hot_fini(profile);
+	free(profile);
+}
+
+/* Find or create the file for @filename.
+ *
+ * Returns the file on success, NULL otherwise.
+ */
+static struct pt_hot_file *pt_hot_fetch_file(struct pt_hot_profile *profile,
+					     const char *filename)
+{
+	struct pt_hot_file *file;
+
+	if (!profile || !filename)
+		return NULL;
+
+	for (file = profile->files; file; file = file->next) {
+		if (strcmp(file->filename, filename) == 0)
+			return file;
+	}
+
+	file = malloc(sizeof(*file));
+	if (!file)
+		return NULL;
+
+	memset(file, 0, sizeof(*file));
+	file->filename = dupstr(filename);
+	if (!file->filename) {
+		free(file);
+		return NULL;
+	}
+
+	file->basename = pt_hot_basename(file->filename);
+	file->hash = pt_hot_hash_str(2166136261u, file->basename);
+	file->next = profile->files;
+	profile->files = file;
+
+	return file;
+}
+
+int pt_hot_add_symbol(struct pt_hot_profile *profile, const char *filename,
+		      uint64_t begin, uint64_t end, const char *name)
+{
+	struct pt_hot_symbol *symbol;
+	struct pt_hot_file *file;
+	size_t idx;
+	char *dup;
+
+	if (!profile || !filename || !name)
+		return -pte_invalid;
+
+	if (end <= begin)
+		return -pte_invalid;
+
+	/* Symbols affect how blocks are attributed to functions.  Adding them
+	 * later would split a function's counts.
+	 */
+	if (profile->nblocks)
+		return -pte_bad_context;
+
+	file = pt_hot_fetch_file(profile, filename);
+	if (!file)
+		return -pte_nomem;
+
+	if (file->nsymbols == file->capacity) {
+		size_t capacity;
+
+		capacity = file->capacity ? file->capacity * 2 : 64;
+		symbol = realloc(file->symbols, capacity * sizeof(*symbol));
+		if (!symbol)
+			return -pte_nomem;
+
+		file->symbols = symbol;
+		file->capacity = capacity;
+	}
+
+	dup = dupstr(name);
+	if (!dup)
+		return -pte_nomem;
+
+	/* Keep the symbols sorted by their begin offset.  Symbols are
+	 * typically added in order so we search from the back.
+	 */
+	for (idx = file->nsymbols; idx; --idx) {
+		if (file->symbols[idx - 1].begin <= begin)
+			break;
+	}
+
+	symbol = &file->symbols[idx];
+	memmove(symbol + 1, symbol,
+		(file->nsymbols - idx) * sizeof(*symbol));
+	file->nsymbols += 1;
+
+	symbol->begin = begin;
+	symbol->end = end;
+	symbol->name = dup;
+	symbol->hash = pt_hot_hash_str(file->hash, dup);
+
+	return 0;
+}
+
+/* Find the symbol containing @offset in @file.
+ *
+ * Returns the symbol on success, NULL otherwise.
+ */
+static const struct pt_hot_symbol *
+pt_hot_find_symbol(const struct pt_hot_file *file, uint64_t offset)
+{
+	const struct pt_hot_symbol *symbol;
+	size_t lo, hi;
+
+	if (!file)
+		return NULL;
+
+	/* Find the last symbol beginning at or before @offset. */
+	lo = 0;
+	hi = file->nsymbols;
+	while (lo < hi) {
+		size_t mid;
+
+		mid = lo + ((hi - lo) / 2);
+		if (file->symbols[mid].begin <= offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (!lo)
+		return NULL;
+
+	symbol = &file->symbols[lo - 1];
+	if (symbol->end <= offset)
+		return NULL;
+
+	return symbol;
+}
+
+/* Find or create the section for @isid.
+ *
+ * Moves the section to the front of @profile's section list.
+ *
+ * Returns the section on success, a negative error code otherwise.
+ */
+static int pt_hot_fetch_section(struct pt_hot_section **phsec,
+				struct pt_hot_profile *profile, int isid)
+{
+	struct pt_hot_section *hsec, **psec;
+	struct pt_hot_file *file;
+	struct pt_section *section;
+	uint64_t laddr;
+	int errcode;
+
+	if (!phsec || !profile)
+		return -pte_internal;
+
+	for (psec = &profile->sections; *psec; psec = &(*psec)->next) {
+		hsec = *psec;
+
+		if (hsec->isid != isid)
+			continue;
+
+		/* Move it to the front. */
+		*psec = hsec->next;
+		hsec->next = profile->sections;
+		profile->sections = hsec;
+
+		*phsec = hsec;
+		return 0;
+	}
+
+	errcode = pt_iscache_lookup(profile->iscache, &section, &laddr, isid);
+	if (errcode < 0)
+		return errcode;
+
+	hsec = NULL;
+	file = pt_hot_fetch_file(profile, pt_section_filename(section));
+	if (file)
+		hsec = malloc(sizeof(*hsec));
+
+	if (!hsec) {
+		(void) pt_section_put(section);
+		return -pte_nomem;
+	}
+
+	hsec->isid = isid;
+	hsec->file = file;
+	hsec->vaddr = laddr;
+	hsec->offset = pt_section_offset(section);
+	hsec->size = pt_section_size(section);
+
+	errcode = pt_section_put(section);
+	if (errcode < 0) {
+		free(hsec);
+		return errcode;
+	}
+
+	hsec->next = profile->sections;
+	profile->sections = hsec;
+
+	*phsec = hsec;
+	return 0;
+}
+
+/* Find or create the function @name or, if @name is NULL, the function at
+ * @offset in @file.
+ *
+ * Returns the function on success, NULL otherwise.
+ */
+static struct pt_hot_func *pt_hot_fetch_func(struct pt_hot_profile *profile,
+					     const struct pt_hot_file *file,
+					     const struct pt_hot_symbol *symbol,
+					     uint64_t offset)
+{
+	struct pt_hot_func *func;
+	unsigned int idx;
+	uint32_t hash;
+
+	if (!profile || !file)
+		return NULL;
+
+	if (symbol) {
+		hash = symbol->hash;
+		offset = symbol->begin;
+	} else
+		hash = pt_hot_hash_u64(file->hash, offset);
+
+	idx = pt_hot_bucket(hash);
+	for (func = profile->funcs[idx]; func; func = func->next) {
+		if ((func->file == file) && (func->offset == offset))
+			return func;
+	}
+
+	func = malloc(sizeof(*func));
+	if (!func)
+		return NULL;
+
+	memset(func, 0, sizeof(*func));
+	func->file = file;
+	func->name = symbol ? symbol->name : NULL;
+	func->offset = offset;
+	func->hash = hash;
+	func->next = profile->funcs[idx];
+	profile->funcs[idx] = func;
+
+	return func;
+}
+
+/* Find or create the edge from @from to @to.
+ *
+ * Returns the edge on success, NULL otherwise.
+ */
+static struct pt_hot_edge *pt_hot_fetch_edge(struct pt_hot_profile *profile,
+					     const struct pt_hot_func *from,
+					     const struct pt_hot_func *to)
+{
+	struct pt_hot_edge *edge;
+	unsigned int idx;
+	uint32_t hash;
+
+	if (!profile || !from || !to)
+		return NULL;
+
+	hash = (from->hash * 31u) ^ to->hash;
+	idx = pt_hot_bucket(hash);
+	for (edge = profile->edges[idx]; edge; edge = edge->next) {
+		if ((edge->from == from) && (edge->to == to))
+			return edge;
+	}
+
+	edge = malloc(sizeof(*edge));
+	if (!edge)
+		return NULL;
+
+	memset(edge, 0, sizeof(*edge));
+	edge->from = from;
+	edge->to = to;
+	edge->hash = hash;
+	edge->next = profile->edges[idx];
+	profile->edges[idx] = edge;
+
+	return edge;
+}
+
+int pt_hot_add_block(struct pt_hot_profile *profile,
+		     const struct pt_block *block)
+{
+	const struct pt_hot_symbol *symbol;
+	struct pt_hot_section *hsec;
+	struct pt_hot_func *func;
+	uint64_t offset;
+	int errcode;
+
+	if (!profile || !block)
+		return -pte_invalid;
+
+	/* There's nothing to count in an empty block. */
+	if (!block->ninsn)
+		return 0;
+
+	/* We need an image section cache section for finding the file. */
+	if (block->isid <= 0)
+		return -pte_bad_image;
+
+	errcode = pt_hot_fetch_section(&hsec, profile, block->isid);
+	if (errcode < 0)
+		return errcode;
+
+	if ((block->ip < hsec->vaddr) ||
+	    ((hsec->vaddr + hsec->size) <= block->ip))
+		return -pte_nomap;
+
+	offset = hsec->offset + (block->ip - hsec->vaddr);
+	symbol = pt_hot_find_symbol(hsec->file, offset);
+
+	func = pt_hot_fetch_func(profile, hsec->file, symbol, offset);
+	if (!func)
+		return -pte_nomem;
+
+	if (profile->last && (profile->last != func)) {
+		struct pt_hot_edge *edge;
+
+		edge = pt_hot_fetch_edge(profile, profile->last, func);
+		if (!edge)
+			return -pte_nomem;
+
+		edge->count += 1;
+		profile->nedges += 1;
+	}
+
+	func->nblocks += 1;
+	func->ninsn += block->ninsn;
+	func->cyc += block->cyc;
+
+	profile->nblocks += 1;
+	profile->ninsn += block->ninsn;
+	profile->cyc += block->cyc;
+	profile->last = func;
+
+	return 0;
+}
+
+int pt_hot_add_gap(struct pt_hot_profile *profile)
+{
+	if (!profile)
+		return -pte_invalid;
+
+	profile->last = NULL;
+
+	return 0;
+}
+
+/* Check whether @lhs and @rhs from different profiles denote the same
+ * function.
+ */
+static int pt_hot_func_match(const struct pt_hot_func *lhs,
+			     const struct pt_hot_func *rhs)
+{
+	if (!lhs || !rhs)
+		return 0;
+
+	if (lhs->hash != rhs->hash)
+		return 0;
+
+	if (strcmp(lhs->file->basename, rhs->file->basename) != 0)
+		return 0;
+
+	if (lhs->name && rhs->name)
+		return strcmp(lhs->name, rhs->name) == 0;
+
+	if (lhs->name || rhs->name)
+		return 0;
+
+	return lhs->offset == rhs->offset;
+}
+
+/* Find the function matching @func in @profile.
+ *
+ * Returns the function if found, NULL otherwise.
+ */
+static const struct pt_hot_func *
+pt_hot_match_func(const struct pt_hot_profile *profile,
+		  const struct pt_hot_func *func)
+{
+	const struct pt_hot_func *match;
+
+	if (!profile || !func)
+		return NULL;
+
+	match = profile->funcs[pt_hot_bucket(func->hash)];
+	for (; match; match = match->next) {
+		if (pt_hot_func_match(match, func))
+			return match;
+	}
+
+	return NULL;
+}
+
+/* Find the edge matching @edge in @profile.
+ *
+ * Returns the edge if found, NULL otherwise.
+ */
+static const struct pt_hot_edge *
+pt_hot_match_edge(const struct pt_hot_profile *profile,
+		  const struct pt_hot_edge *edge)
+{
+	const struct pt_hot_edge *match;
+
+	if (!profile || !edge)
+		return NULL;
+
+	match = profile->edges[pt_hot_bucket(edge->hash)];
+	for (; match; match = match->next) {
+		if (!pt_hot_func_match(match->from, edge->from))
+			continue;
+
+		if (!pt_hot_func_match(match->to, edge->to))
+			continue;
+
+		return match;
+	}
+
+	return NULL;
+}
+
+static uint64_t pt_hot_func_value(const struct pt_hot_func *func,
+				  enum pt_hot_metric metric)
+{
+	if (!func)
+		return 0ull;
+
+	switch (metric) {
+	case pthm_insn:
+		return func->ninsn;
+
+	case pthm_cyc:
+		return func->cyc;
+
+	case pthm_blocks:
+		return func->nblocks;
+
+	case pthm_edges:
+		break;
+	}
+
+	return 0ull;
+}
+
+static uint64_t pt_hot_total(const struct pt_hot_profile *profile,
+			     enum pt_hot_metric metric)
+{
+	switch (metric) {
+	case pthm_insn:
+		return profile->ninsn;
+
+	case pthm_cyc:
+		return profile->cyc;
+
+	case pthm_blocks:
+		return profile->nblocks;
+
+	case pthm_edges:
+		return profile->nedges;
+	}
+
+	return 0ull;
+}
+
+/* Compute @value's share of @total in parts per million. */
+static uint32_t pt_hot_share(uint64_t value, uint64_t total)
+{
+	if (!total)
+		return 0u;
+
+	/* Avoid overflows in the multiplication below at the cost of some
+	 * precision.
+	 */
+	while ((UINT64_MAX / 1000000ull) < value) {
+		value >>= 1;
+		total >>= 1;
+	}
+
+	return (uint32_t) ((value * 1000000ull) / total);
+}
+
+/* A comparison in progress. */
+struct pt_hot_ranking {
+	/* The profiles' totals. */
+	uint64_t total[2];
+
+	/* The largest deltas found so far ordered by decreasing magnitude. */
+	struct pt_hot_delta *deltas;
+
+	/* The number of valid and the number of requested @deltas. */
+	int ndeltas, capacity;
+};
+
+static uint32_t pt_hot_magnitude(int32_t delta)
+{
+	return delta < 0 ? (uint32_t) -(int64_t) delta : (uint32_t) delta;
+}
+
+/* Rank the change of a function or edge.
+ *
+ * Fills in the values, shares, and delta of @delta and inserts it into
+ * @ranking if it is among the largest changes.
+ */
+static void pt_hot_rank(struct pt_hot_ranking *ranking,
+			struct pt_hot_delta *delta, uint64_t before,
+			uint64_t after)
+{
+	uint32_t magnitude;
+	int idx;
+
+	delta->value[0] = before;
+	delta->value[1] = after;
+	delta->share[0] = pt_hot_share(before, ranking->total[0]);
+	delta->share[1] = pt_hot_share(after, ranking->total[1]);
+	delta->delta = (int32_t) delta->share[1] - (int32_t) delta->share[0];
+
+	magnitude = pt_hot_magnitude(delta->delta);
+
+	idx = ranking->ndeltas;
+	if (idx == ranking->capacity) {
+		if (!idx)
+			return;
+
+		if (magnitude <=
+		    pt_hot_magnitude(ranking->deltas[idx - 1].delta))
+			return;
+
+		idx -= 1;
+	} else
+		ranking->ndeltas += 1;
+
+	for (; idx; --idx) {
+		if (magnitude <=
+		    pt_hot_magnitude(ranking->deltas[idx - 1].delta))
+			break;
+
+		ranking->deltas[idx] = ranking->deltas[idx - 1];
+	}
+
+	ranking->deltas[idx] = *delta;
+}
+
+static void pt_hot_describe(struct pt_hot_delta *delta,
+			    const struct pt_hot_func *func,
+			    const struct pt_hot_func *to)
+{
+	memset(delta, 0, sizeof(*delta));
+
+	delta->filename = func->file->basename;
+	delta->name = func->name;
+	delta->offset = func->offset;
+
+	if (to) {
+		delta->to_filename = to->file->basename;
+		delta->to_name = to->name;
+		delta->to_offset = to->offset;
+	}
+}
+
+static void pt_hot_diff_funcs(struct pt_hot_ranking *ranking,
+			      const struct pt_hot_profile *before,
+			      const struct pt_hot_profile *after,
+			      enum pt_hot_metric metric)
+{
+	size_t idx;
+
+	for (idx = 0; idx < pt_hot_nbuckets; ++idx) {
+		const struct pt_hot_func *func;
+
+		for (func = after->funcs[idx]; func; func = func->next) {
+			const struct pt_hot_func *match;
+			struct pt_hot_delta delta;
+
+			match = pt_hot_match_func(before, func);
+
+			pt_hot_describe(&delta, func, NULL);
+			pt_hot_rank(ranking, &delta,
+				    pt_hot_func_value(match, metric),
+				    pt_hot_func_value(func, metric));
+		}
+
+		/* Functions that are no longer executed. */
+		for (func = before->funcs[idx]; func; func = func->next) {
+			struct pt_hot_delta delta;
+
+			if (pt_hot_match_func(after, func))
+				continue;
+
+			pt_hot_describe(&delta, func, NULL);
+			pt_hot_rank(ranking, &delta,
+				    pt_hot_func_value(func, metric), 0ull);
+		}
+	}
+}
+
+static void pt_hot_diff_edges(struct pt_hot_ranking *ranking,
+			      const struct pt_hot_profile *before,
+			      const struct pt_hot_profile *after)
+{
+	size_t idx;
+
+	for (idx = 0; idx < pt_hot_nbuckets; ++idx) {
+		const struct pt_hot_edge *edge;
+
+		for (edge = after->edges[idx]; edge; edge = edge->next) {
+			const struct pt_hot_edge *match;
+			struct pt_hot_delta delta;
+
+			match = pt_hot_match_edge(before, edge);
+
+			pt_hot_describe(&delta, edge->from, edge->to);
+			pt_hot_rank(ranking, &delta,
+				    match ? match->count : 0ull, edge->count);
+		}
+
+		/* Edges that are no longer taken. */
+		for (edge = before->edges[idx]; edge; edge = edge->next) {
+			struct pt_hot_delta delta;
+
+			if (pt_hot_match_edge(after, edge))
+				continue;
+
+			pt_hot_describe(&delta, edge->from, edge->to);
+			pt_hot_rank(ranking, &delta, edge->count, 0ull);
+		}
+	}
+}
+
+int pt_hot_diff(const struct pt_hot_profile *before,
+		const struct pt_hot_profile *after,
+		struct pt_hot_delta *deltas, size_t size, int ndeltas,
+		enum pt_hot_metric metric)
+{
+	struct pt_hot_ranking ranking;
+	int idx;
+
+	if (!before || !after || !deltas)
+		return -pte_invalid;
+
+	if (size < offsetof(struct pt_hot_delta, delta) + sizeof(int32_t))
+		return -pte_invalid;
+
+	if (ndeltas < 0)
+		return -pte_invalid;
+
+	switch (metric) {
+	case pthm_insn:
+	case pthm_cyc:
+	case pthm_blocks:
+	case pthm_edges:
+		break;
+
+	default:
+		return -pte_invalid;
+	}
+
+	if (!ndeltas)
+		return 0;
+
+	memset(&ranking, 0, sizeof(ranking));
+	ranking.total[0] = pt_hot_total(before, metric);
+	ranking.total[1] = pt_hot_total(after, metric);
+	ranking.capacity = ndeltas;
+	ranking.deltas = malloc((size_t) ndeltas * sizeof(*ranking.deltas));
+	if (!ranking.deltas)
+		return -pte_nomem;
+
+	if (metric == pthm_edges)
+		pt_hot_diff_edges(&ranking, before, after);
+	else
+		pt_hot_diff_funcs(&ranking, before, after, metric);
+
+	for (idx = 0; idx < ranking.ndeltas; ++idx) {
+		uint8_t *udelta;
+		size_t dsize;
+
+		udelta = (uint8_t *) deltas + ((size_t) idx * size);
+		dsize = size;
+
+		/* Zero out any unknown bytes. */
+		if (sizeof(*ranking.deltas) < dsize) {
+			memset(udelta + sizeof(*ranking.deltas), 0,
+			       dsize - sizeof(*ranking.deltas));
+
+			dsize = sizeof(*ranking.deltas);
+		}
+
+		memcpy(udelta, &ranking.deltas[idx], dsize);
+	}
+
+	free(ranking.deltas);
+
+	return ranking.ndeltas;
+}
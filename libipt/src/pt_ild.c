@@ -1202,15 +1202,24 @@ static int pt_instruction_decode(struct pt_insn *insn, struct pt_insn_ext *iext,
 }
 
 int pt_ild_decode(struct pt_insn *insn, struct pt_insn_ext *iext)
+{
+	if (!insn)
+		return -pte_internal;
+
+	return pt_ild_decode_raw(insn, iext, insn->raw);
+}
+
+int pt_ild_decode_raw(struct pt_insn *insn, struct pt_insn_ext *iext,
+		      const uint8_t *raw)
 {
 	struct pt_ild ild;
 	int size;
 
-	if (!insn || !iext)
+	if (!insn || !iext || !raw)
 		return -pte_internal;
 
 	ild.mode = insn->mode;
-	ild.itext = insn->raw;
+	ild.itext = raw;
 	ild.max_bytes = insn->size;
 
 	size = pt_instruction_length_decode(&ild);
@@ -82,9 +82,20 @@ out_mem:
 
 static void pt_section_list_free(struct pt_section_list *list)
 {
+	struct pt_section_list *part;
+
 	if (!list)
 		return;
 
+	for (part = list->parts; part;) {
+		struct pt_section_list *trash;
+
+		trash = part;
+		part = part->next;
+
+		pt_section_list_free(trash);
+	}
+
 	pt_section_put(list->section.section);
 	pt_msec_fini(&list->section);
 	free(list);
@@ -102,6 +113,14 @@ static void pt_section_list_free_tail(struct pt_section_list *list)
 	}
 }
 
+/* Assign new identifiers to @list and all following elements. */
+static void pt_image_mk_ids(struct pt_image *image,
+			    struct pt_section_list *list)
+{
+	for (; list; list = list->next)
+		list->id = ++image->lastid;
+}
+
 void pt_image_init(struct pt_image *image, const char *name)
 {
 	if (!image)
@@ -118,6 +137,7 @@ void pt_image_fini(struct pt_image *image)
 		return;
 
 	pt_section_list_free_tail(image->sections);
+	free(image->index);
 	free(image->name);
 
 	memset(image, 0, sizeof(*image));
@@ -148,16 +168,315 @@ const char *pt_image_name(const struct pt_image *image)
 	return image->name;
 }
 
+/* Check whether two asids are identical.
+ *
+ * Unlike pt_asid_match(), this does not treat default values as wildcards.
+ */
+static int pt_image_same_asid(const struct pt_asid *lhs,
+			      const struct pt_asid *rhs)
+{
+	if (!lhs || !rhs)
+		return 0;
+
+	return (lhs->cr3 == rhs->cr3) && (lhs->vmcs == rhs->vmcs);
+}
+
+/* Check whether two section list entries can be coalesced.
+ *
+ * Two entries can be coalesced if @hi directly follows @lo in the same address
+ * space and in the same file, i.e. if the file is mapped contiguously.
+ *
+ * We only coalesce file sections without an image section identifier.  The
+ * coalesced section could not be reported with the identifiers of its parts
+ * and memory sections would be replaced by the file's current content.
+ *
+ * Returns a positive integer if @lo and @hi can be coalesced, zero otherwise.
+ */
+static int pt_image_can_coalesce(const struct pt_section_list *lo,
+				 const struct pt_section_list *hi)
+{
+	const struct pt_mapped_section *lmsec, *hmsec;
+	const struct pt_section *lsec, *hsec;
+	const char *lname, *hname;
+	uint64_t loff, hoff;
+
+	if (!lo || !hi)
+		return 0;
+
+	if (lo->isid || hi->isid)
+		return 0;
+
+	lmsec = &lo->section;
+	hmsec = &hi->section;
+
+	if (pt_msec_end(lmsec) != pt_msec_begin(hmsec))
+		return 0;
+
+	if (!pt_image_same_asid(pt_msec_asid(lmsec), pt_msec_asid(hmsec)))
+		return 0;
+
+	lsec = pt_msec_section(lmsec);
+	hsec = pt_msec_section(hmsec);
+
+	loff = pt_section_offset(lsec) + pt_msec_offset(lmsec) +
+		pt_msec_size(lmsec);
+	hoff = pt_section_offset(hsec) + pt_msec_offset(hmsec);
+	if (loff != hoff)
+		return 0;
+
+	if (pt_section_is_memory(lsec) || pt_section_is_memory(hsec))
+		return 0;
+
+	if (lsec == hsec)
+		return 1;
+
+	lname = pt_section_filename(lsec);
+	hname = pt_section_filename(hsec);
+	if (!lname || !hname)
+		return 0;
+
+	return (strcmp(lname, hname) == 0);
+}
+
+/* Append the parts of @elem to @parts.
+ *
+ * If @elem was coalesced, moves its parts and frees @elem.  Otherwise, @elem
+ * itself becomes a part.
+ *
+ * Returns the new tail of @parts.
+ */
+static struct pt_section_list *
+pt_image_append_parts(struct pt_section_list **parts,
+		      struct pt_section_list *elem)
+{
+	struct pt_section_list *tail;
+
+	if (elem->parts) {
+		*parts = elem->parts;
+		elem->parts = NULL;
+
+		pt_section_list_free(elem);
+	} else {
+		elem->next = NULL;
+		*parts = elem;
+	}
+
+	for (tail = *parts; tail->next; tail = tail->next)
+		;
+
+	return tail;
+}
+
+/* Create a section list entry covering two adjacent entries.
+ *
+ * The new entry maps a single file section spanning @lo and @hi so the two
+ * share a single mapping and a single block cache.
+ *
+ * Returns the new entry on success, NULL otherwise.
+ */
+static struct pt_section_list *
+pt_image_mk_coalesced(const struct pt_section_list *lo,
+		      const struct pt_section_list *hi)
+{
+	const struct pt_mapped_section *lmsec;
+	struct pt_section_list *list;
+	struct pt_section *section;
+	const struct pt_asid *asid;
+	const char *filename;
+	uint64_t offset, size, vaddr;
+	int errcode;
+
+	if (!lo || !hi)
+		return NULL;
+
+	lmsec = &lo->section;
+	asid = pt_msec_asid(lmsec);
+	vaddr = pt_msec_begin(lmsec);
+	size = pt_msec_size(lmsec) + pt_msec_size(&hi->section);
+
+	section = pt_msec_section(lmsec);
+	filename = pt_section_filename(section);
+	offset = pt_section_offset(section) + pt_msec_offset(lmsec);
+	if (!filename)
+		return NULL;
+
+	section = pt_mk_section(filename, offset, size);
+	if (!section)
+		return NULL;
+
+	/* The file may have changed since we created the original sections.
+	 *
+	 * We only coalesce if the new section covers both entries.
+	 */
+	list = NULL;
+	if ((pt_section_offset(section) == offset) &&
+	    (pt_section_size(section) == size))
+		list = pt_mk_section_list(section, asid, vaddr, 0ull, size, 0);
+
+	/* The section list got its own reference; let's drop ours. */
+	errcode = pt_section_put(section);
+	if (errcode < 0) {
+		pt_section_list_free(list);
+		return NULL;
+	}
+
+	return list;
+}
+
+/* Remove a section list entry from an image without freeing it.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_image_unlink(struct pt_image *image,
+			   const struct pt_section_list *elem)
+{
+	struct pt_section_list **list;
+
+	if (!image || !elem)
+		return -pte_internal;
+
+	for (list = &image->sections; *list; list = &((*list)->next)) {
+		if (*list == elem) {
+			*list = elem->next;
+			return 0;
+		}
+	}
+
+	return -pte_internal;
+}
+
+/* Coalesce an image section with its neighbors.
+ *
+ * Executable files are typically loaded in several adjacent segments and
+ * sideband may report a single mapping in pieces.  Decoders treat each image
+ * section separately, i.e. they end blocks at section boundaries and fill a
+ * separate block cache for each section.
+ *
+ * Replace @elem and all sections that directly precede or follow it in the
+ * same file and in the same address space with a single section.  The
+ * replaced sections are kept as parts of the new section so they can still
+ * be removed individually.
+ *
+ * This is an optimization.  We leave @image unchanged if we fail to create a
+ * coalesced section.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_image_coalesce(struct pt_image *image,
+			     struct pt_section_list *elem)
+{
+	if (!image || !elem)
+		return -pte_internal;
+
+	for (;;) {
+		struct pt_section_list *list, *lo, *hi, *new, *tail;
+		int errcode;
+
+		lo = NULL;
+		hi = NULL;
+		for (list = image->sections; list; list = list->next) {
+			if (list == elem)
+				continue;
+
+			if (pt_image_can_coalesce(list, elem)) {
+				lo = list;
+				hi = elem;
+				break;
+			}
+
+			if (pt_image_can_coalesce(elem, list)) {
+				lo = elem;
+				hi = list;
+				break;
+			}
+		}
+
+		if (!lo || !hi)
+			return 0;
+
+		new = pt_image_mk_coalesced(lo, hi);
+		if (!new)
+			return 0;
+
+		errcode = pt_image_unlink(image, lo);
+		if (errcode < 0) {
+			pt_section_list_free(new);
+			return errcode;
+		}
+
+		errcode = pt_image_unlink(image, hi);
+		if (errcode < 0) {
+			pt_section_list_free(new);
+			return errcode;
+		}
+
+		tail = pt_image_append_parts(&new->parts, lo);
+		(void) pt_image_append_parts(&tail->next, hi);
+
+		new->id = ++image->lastid;
+		new->next = image->sections;
+		image->sections = new;
+
+		image->generation += 1;
+
+		elem = new;
+	}
+}
+
+/* Replace a coalesced section list entry with its parts.
+ *
+ * The parts are inserted in place of *@list with new identifiers.
+ */
+static void pt_image_expand(struct pt_image *image,
+			    struct pt_section_list **list)
+{
+	struct pt_section_list *elem, *part;
+
+	elem = *list;
+
+	for (part = elem->parts; part->next; part = part->next)
+		part->id = ++image->lastid;
+
+	part->id = ++image->lastid;
+	part->next = elem->next;
+
+	*list = elem->parts;
+	elem->parts = NULL;
+
+	pt_section_list_free(elem);
+
+	image->generation += 1;
+}
+
+/* Count the sections that were added to an image for a list entry. */
+static int pt_image_count_parts(const struct pt_section_list *elem)
+{
+	const struct pt_section_list *part;
+	int count;
+
+	if (!elem->parts)
+		return 1;
+
+	count = 0;
+	for (part = elem->parts; part; part = part->next)
+		count += 1;
+
+	return count;
+}
+
 int pt_image_add(struct pt_image *image, struct pt_section *section,
 		 const struct pt_asid *asid, uint64_t vaddr, int isid)
 {
-	struct pt_section_list **list, *next, *removed, *new;
+	struct pt_section_list **list, *next, *removed, *new, *added;
 	uint64_t size, begin, end;
 	int errcode;
 
 	if (!image || !section)
 		return -pte_internal;
 
+	if (image->frozen)
+		return -pte_not_supported;
+
 	size = pt_section_size(section);
 	begin = vaddr;
 	end = begin + size;
@@ -166,6 +485,8 @@ int pt_image_add(struct pt_image *image, struct pt_section *section,
 	if (!next)
 		return -pte_nomem;
 
+	added = next;
+
 	removed = NULL;
 	errcode = 0;
 
@@ -199,6 +520,14 @@ int pt_image_add(struct pt_image *image, struct pt_section *section,
 			continue;
 		}
 
+		/* Shrink or split the sections that were originally added
+		 * rather than the coalesced section.
+		 */
+		if (current->parts) {
+			pt_image_expand(image, list);
+			continue;
+		}
+
 		/* The new section overlaps with @msec's section. */
 		lsec = pt_msec_section(msec);
 		loff = pt_msec_offset(msec);
@@ -254,10 +583,19 @@ int pt_image_add(struct pt_image *image, struct pt_section *section,
 		return errcode;
 	}
 
-	pt_section_list_free_tail(removed);
+	if (removed) {
+		pt_section_list_free_tail(removed);
+
+		image->generation += 1;
+	}
 
+	pt_image_mk_ids(image, next);
 	*list = next;
-	return 0;
+
+	if (!image->coalesce)
+		return 0;
+
+	return pt_image_coalesce(image, added);
 }
 
 int pt_image_remove(struct pt_image *image, struct pt_section *section,
@@ -268,6 +606,9 @@ int pt_image_remove(struct pt_image *image, struct pt_section *section,
 	if (!image || !section)
 		return -pte_internal;
 
+	if (image->frozen)
+		return -pte_not_supported;
+
 	for (list = &image->sections; *list; list = &((*list)->next)) {
 		struct pt_mapped_section *msec;
 		const struct pt_section *sec;
@@ -287,12 +628,43 @@ int pt_image_remove(struct pt_image *image, struct pt_section *section,
 		if (!errcode)
 			continue;
 
+		if (trash->parts) {
+			struct pt_section_list *part;
+
+			for (part = trash->parts; part; part = part->next) {
+				begin = pt_msec_begin(&part->section);
+				sec = pt_msec_section(&part->section);
+				if (sec == section && begin == vaddr)
+					break;
+			}
+
+			if (!part)
+				continue;
+
+			/* Split the coalesced section back into its parts and
+			 * remove the requested one.
+			 */
+			pt_image_expand(image, list);
+
+			for (; *list != part; list = &((*list)->next))
+				;
+
+			trash = *list;
+			*list = trash->next;
+			trash->next = NULL;
+			pt_section_list_free(trash);
+
+			return 0;
+		}
+
 		begin = pt_msec_begin(msec);
 		sec = pt_msec_section(msec);
 		if (sec == section && begin == vaddr) {
 			*list = trash->next;
 			pt_section_list_free(trash);
 
+			image->generation += 1;
+
 			return 0;
 		}
 	}
@@ -341,6 +713,9 @@ int pt_image_copy(struct pt_image *image, const struct pt_image *src)
 	if (!image || !src)
 		return -pte_invalid;
 
+	if (image->frozen)
+		return -pte_not_supported;
+
 	/* There is nothing to do if we copy an image to itself.
 	 *
 	 * Besides, pt_image_add() may move sections around, which would
@@ -351,14 +726,23 @@ int pt_image_copy(struct pt_image *image, const struct pt_image *src)
 
 	ignored = 0;
 	for (list = src->sections; list; list = list->next) {
-		int errcode;
+		const struct pt_section_list *part;
 
-		errcode = pt_image_add(image, list->section.section,
-				       &list->section.asid,
-				       list->section.vaddr,
-				       list->isid);
-		if (errcode < 0)
-			ignored += 1;
+		/* Copy the sections that were originally added. */
+		part = list->parts ? list->parts : list;
+		for (; part; part = part->next) {
+			int errcode;
+
+			errcode = pt_image_add(image, part->section.section,
+					       &part->section.asid,
+					       part->section.vaddr,
+					       part->isid);
+			if (errcode < 0)
+				ignored += 1;
+
+			if (part == list)
+				break;
+		}
 	}
 
 	return ignored;
@@ -374,6 +758,9 @@ int pt_image_remove_by_filename(struct pt_image *image, const char *filename,
 	if (!image || !filename)
 		return -pte_invalid;
 
+	if (image->frozen)
+		return -pte_not_supported;
+
 	errcode = pt_asid_from_user(&asid, uasid);
 	if (errcode < 0)
 		return errcode;
@@ -404,9 +791,10 @@ int pt_image_remove_by_filename(struct pt_image *image, const char *filename,
 
 		if (tname && (strcmp(tname, filename) == 0)) {
 			*list = trash->next;
+			removed += pt_image_count_parts(trash);
 			pt_section_list_free(trash);
 
-			removed += 1;
+			image->generation += 1;
 		} else
 			list = &trash->next;
 	}
@@ -424,6 +812,9 @@ int pt_image_remove_by_asid(struct pt_image *image,
 	if (!image)
 		return -pte_invalid;
 
+	if (image->frozen)
+		return -pte_not_supported;
+
 	errcode = pt_asid_from_user(&asid, uasid);
 	if (errcode < 0)
 		return errcode;
@@ -448,9 +839,10 @@ int pt_image_remove_by_asid(struct pt_image *image,
 		}
 
 		*list = trash->next;
+		removed += pt_image_count_parts(trash);
 		pt_section_list_free(trash);
 
-		removed += 1;
+		image->generation += 1;
 	}
 
 	return removed;
@@ -462,12 +854,28 @@ int pt_image_set_callback(struct pt_image *image,
 	if (!image)
 		return -pte_invalid;
 
+	if (image->frozen)
+		return -pte_not_supported;
+
 	image->readmem.callback = callback;
 	image->readmem.context = context;
 
 	return 0;
 }
 
+int pt_image_set_coalesce(struct pt_image *image, int enable)
+{
+	if (!image)
+		return -pte_invalid;
+
+	if (image->frozen)
+		return -pte_not_supported;
+
+	image->coalesce = enable ? 1 : 0;
+
+	return 0;
+}
+
 static int pt_image_read_callback(struct pt_image *image, int *isid,
 				  uint8_t *buffer, uint16_t size,
 				  const struct pt_asid *asid, uint64_t addr)
@@ -520,21 +928,84 @@ static inline int pt_image_check_msec(const struct pt_mapped_section *msec,
 	return 0;
 }
 
+/* Find the section containing a given address in a frozen image.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_image_lookup_frozen(const struct pt_image *image,
+				  const struct pt_section_list **pslist,
+				  const struct pt_asid *asid, uint64_t vaddr)
+{
+	const struct pt_image_index *index;
+	size_t lo, hi;
+
+	if (!image || !pslist)
+		return -pte_internal;
+
+	index = image->index;
+
+	/* Find the first section that begins after @vaddr. */
+	lo = 0;
+	hi = image->nindex;
+	while (lo < hi) {
+		size_t mid;
+
+		mid = lo + ((hi - lo) / 2);
+		if (pt_msec_begin(&index[mid].slist->section) <= vaddr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* Search backwards through sections that may contain @vaddr.
+	 *
+	 * Sections in the same address space do not overlap, so there are
+	 * typically only few candidates.
+	 */
+	while (lo) {
+		const struct pt_section_list *slist;
+		int errcode;
+
+		lo -= 1;
+		if (index[lo].reach <= vaddr)
+			break;
+
+		slist = index[lo].slist;
+
+		errcode = pt_image_check_msec(&slist->section, asid, vaddr);
+		if (errcode < 0) {
+			if (errcode != -pte_nomap)
+				return errcode;
+
+			continue;
+		}
+
+		*pslist = slist;
+		return 0;
+	}
+
+	return -pte_nomap;
+}
+
 /* Find the section containing a given address in a given address space.
  *
- * On success, the found section is moved to the front of the section list.
- * If caching is enabled, maps the section.
+ * On success, provides the found section in @pslist.  Unless @image is frozen,
+ * the found section is moved to the front of the section list.
  *
  * Returns zero on success, a negative error code otherwise.
  */
 static int pt_image_fetch_section(struct pt_image *image,
+				  const struct pt_section_list **pslist,
 				  const struct pt_asid *asid, uint64_t vaddr)
 {
 	struct pt_section_list **start, **list;
 
-	if (!image)
+	if (!image || !pslist)
 		return -pte_internal;
 
+	if (image->frozen)
+		return pt_image_lookup_frozen(image, pslist, asid, vaddr);
+
 	start = &image->sections;
 	for (list = start; *list;) {
 		struct pt_mapped_section *msec;
@@ -560,6 +1031,7 @@ static int pt_image_fetch_section(struct pt_image *image,
 			*start = elem;
 		}
 
+		*pslist = elem;
 		return 0;
 	}
 
@@ -569,15 +1041,15 @@ static int pt_image_fetch_section(struct pt_image *image,
 int pt_image_read(struct pt_image *image, int *isid, uint8_t *buffer,
 		  uint16_t size, const struct pt_asid *asid, uint64_t addr)
 {
-	struct pt_mapped_section *msec;
-	struct pt_section_list *slist;
+	const struct pt_mapped_section *msec;
+	const struct pt_section_list *slist;
 	struct pt_section *section;
 	int errcode, status;
 
 	if (!image || !isid)
 		return -pte_internal;
 
-	errcode = pt_image_fetch_section(image, asid, addr);
+	errcode = pt_image_fetch_section(image, &slist, asid, addr);
 	if (errcode < 0) {
 		if (errcode != -pte_nomap)
 			return errcode;
@@ -586,10 +1058,6 @@ int pt_image_read(struct pt_image *image, int *isid, uint8_t *buffer,
 					      addr);
 	}
 
-	slist = image->sections;
-	if (!slist)
-		return -pte_internal;
-
 	*isid = slist->isid;
 	msec = &slist->section;
 
@@ -649,24 +1117,21 @@ int pt_image_add_cached(struct pt_image *image,
 }
 
 int pt_image_find(struct pt_image *image, struct pt_mapped_section *usec,
-		  const struct pt_asid *asid, uint64_t vaddr)
+		  struct pt_msec_tag *tag, const struct pt_asid *asid,
+		  uint64_t vaddr)
 {
-	struct pt_mapped_section *msec;
-	struct pt_section_list *slist;
+	const struct pt_mapped_section *msec;
+	const struct pt_section_list *slist;
 	struct pt_section *section;
 	int errcode;
 
 	if (!image || !usec)
 		return -pte_internal;
 
-	errcode = pt_image_fetch_section(image, asid, vaddr);
+	errcode = pt_image_fetch_section(image, &slist, asid, vaddr);
 	if (errcode < 0)
 		return errcode;
 
-	slist = image->sections;
-	if (!slist)
-		return -pte_internal;
-
 	msec = &slist->section;
 	section = pt_msec_section(msec);
 
@@ -676,43 +1141,126 @@ int pt_image_find(struct pt_image *image, struct pt_mapped_section *usec,
 
 	*usec = *msec;
 
+	if (tag) {
+		tag->image = image;
+		tag->asid = *asid;
+		tag->generation = image->generation;
+		tag->id = slist->id;
+	}
+
 	return slist->isid;
 }
 
 int pt_image_validate(const struct pt_image *image,
-		      const struct pt_mapped_section *usec, uint64_t vaddr,
-		      int isid)
+		      const struct pt_mapped_section *usec,
+		      struct pt_msec_tag *tag, const struct pt_asid *asid,
+		      uint64_t vaddr)
 {
 	const struct pt_section_list *slist;
 	uint64_t begin, end;
-	int status;
 
-	if (!image || !usec)
+	if (!image || !usec || !tag || !asid)
 		return -pte_internal;
 
+	/* The tag is only meaningful for the image and the address space in
+	 * which @usec had been found.
+	 */
+	if (tag->image != image)
+		return -pte_nomap;
+
+	if (!pt_image_same_asid(&tag->asid, asid))
+		return -pte_nomap;
+
 	/* Check that @vaddr lies within @usec. */
 	begin = pt_msec_begin(usec);
 	end = pt_msec_end(usec);
 	if (vaddr < begin || end <= vaddr)
 		return -pte_nomap;
 
-	/* We assume that @usec is a copy of the top of our stack and accept
-	 * sporadic validation fails if it isn't, e.g. because it has moved
-	 * down.
-	 *
-	 * A failed validation requires decoders to re-fetch the section so it
-	 * only results in a (relatively small) performance loss.
+	/* Sections are never modified in place.  As long as no section has
+	 * been removed, @usec is still in @image and, since sections in the
+	 * same address space do not overlap, a lookup would still find it.
 	 */
-	slist = image->sections;
-	if (!slist)
-		return -pte_nomap;
+	if (tag->generation == image->generation)
+		return 0;
 
-	if (slist->isid != isid)
-		return -pte_nomap;
+	/* Some section has been removed.  Check that it wasn't @usec. */
+	for (slist = image->sections; slist; slist = slist->next) {
+		if (slist->id != tag->id)
+			continue;
 
-	status = memcmp(&slist->section, usec, sizeof(*usec));
-	if (status)
-		return -pte_nomap;
+		tag->generation = image->generation;
+		return 0;
+	}
+
+	return -pte_nomap;
+}
+
+static int pt_image_index_cmp(const void *lhs, const void *rhs)
+{
+	const struct pt_image_index *lindex, *rindex;
+	uint64_t lbegin, rbegin;
+
+	lindex = (const struct pt_image_index *) lhs;
+	rindex = (const struct pt_image_index *) rhs;
+
+	lbegin = pt_msec_begin(&lindex->slist->section);
+	rbegin = pt_msec_begin(&rindex->slist->section);
+
+	if (lbegin < rbegin)
+		return -1;
+
+	if (rbegin < lbegin)
+		return 1;
+
+	return 0;
+}
+
+int pt_image_freeze(struct pt_image *image)
+{
+	const struct pt_section_list *slist;
+	struct pt_image_index *index;
+	uint64_t reach;
+	size_t nindex, idx;
+
+	if (!image)
+		return -pte_invalid;
+
+	if (image->frozen)
+		return 0;
+
+	nindex = 0;
+	for (slist = image->sections; slist; slist = slist->next)
+		nindex += 1;
+
+	index = NULL;
+	if (nindex) {
+		index = malloc(nindex * sizeof(*index));
+		if (!index)
+			return -pte_nomem;
+	}
+
+	idx = 0;
+	for (slist = image->sections; slist; slist = slist->next)
+		index[idx++].slist = slist;
+
+	if (nindex)
+		qsort(index, nindex, sizeof(*index), pt_image_index_cmp);
+
+	reach = 0ull;
+	for (idx = 0; idx < nindex; ++idx) {
+		uint64_t end;
+
+		end = pt_msec_end(&index[idx].slist->section);
+		if (reach < end)
+			reach = end;
+
+		index[idx].reach = reach;
+	}
+
+	image->index = index;
+	image->nindex = nindex;
+	image->frozen = 1;
 
 	return 0;
 }
@@ -1042,6 +1042,50 @@ int pt_iscache_read(struct pt_image_section_cache *iscache, uint8_t *buffer,
 	return status;
 }
 
+int pt_iscache_warm(struct pt_image_section_cache *iscache, int isid,
+		    int bcache)
+{
+	struct pt_section *section;
+	uint64_t laddr;
+	int errcode, status;
+
+	if (!iscache)
+		return -pte_invalid;
+
+	errcode = pt_iscache_lookup(iscache, &section, &laddr, isid);
+	if (errcode < 0)
+		return errcode;
+
+	/* Mapping @section moves it to the front of our LRU list, where it
+	 * stays mapped until it gets evicted.
+	 */
+	errcode = pt_section_map(section);
+	if (errcode < 0) {
+		(void) pt_section_put(section);
+		return errcode;
+	}
+
+	/* Sections too big for a block cache are still worth mapping. */
+	status = 0;
+	if (bcache) {
+		status = pt_section_alloc_bcache(section);
+		if (status == -pte_not_supported)
+			status = 0;
+	}
+
+	errcode = pt_section_unmap(section);
+	if (errcode < 0) {
+		(void) pt_section_put(section);
+		return errcode;
+	}
+
+	errcode = pt_section_put(section);
+	if (errcode < 0)
+		return errcode;
+
+	return status;
+}
+
 int pt_iscache_notify_map(struct pt_image_section_cache *iscache,
 			  struct pt_section *section)
 {
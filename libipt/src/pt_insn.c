@@ -371,3 +371,67 @@ int pt_insn_range_is_contiguous(uint64_t begin, uint64_t end,
 
 	return 1;
 }
+
+int pt_insn_walk_block(const struct pt_block *block,
+		       struct pt_image_section_cache *iscache,
+		       int (*callback)(const struct pt_insn *insn,
+				       const struct pt_insn_ext *iext,
+				       void *context),
+		       void *context)
+{
+	uint64_t ip;
+	uint16_t ninsn;
+
+	if (!block || !callback)
+		return -pte_internal;
+
+	ip = block->ip;
+	for (ninsn = block->ninsn; ninsn; --ninsn) {
+		struct pt_insn_ext iext;
+		struct pt_insn insn;
+		int errcode;
+
+		memset(&insn, 0, sizeof(insn));
+		insn.ip = ip;
+		insn.mode = block->mode;
+		insn.isid = block->isid;
+
+		/* The last instruction may not fit entirely into the block's
+		 * section.  The block decoder provides its memory in this case.
+		 */
+		if ((ninsn == 1) && block->truncated) {
+			memcpy(insn.raw, block->raw, sizeof(insn.raw));
+			insn.size = block->size;
+		} else {
+			int size;
+
+			size = pt_iscache_read(iscache, insn.raw,
+					       sizeof(insn.raw), block->isid,
+					       ip);
+			if (size < 0)
+				return size;
+
+			insn.size = (uint8_t) size;
+		}
+
+		errcode = pt_ild_decode(&insn, &iext);
+		if (errcode < 0)
+			return errcode;
+
+		errcode = callback(&insn, &iext, context);
+		if (errcode < 0)
+			return errcode;
+
+		/* There's no need to determine the IP following the last
+		 * instruction.  It will typically require trace, anyway.
+		 */
+		if (ninsn == 1)
+			break;
+
+		errcode = pt_insn_next_ip(&ip, &insn, &iext);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	return 0;
+}
@@ -34,6 +34,7 @@
 
 #include "intel-pt.h"
 
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -399,6 +400,15 @@ int pt_insn_set_image(struct pt_insn_decoder *decoder,
 	if (!image)
 		image = &decoder->default_image;
 
+	/* The cached section belongs to the old image. */
+	if (image != decoder->image) {
+		int errcode;
+
+		errcode = pt_msec_cache_invalidate(&decoder->scache);
+		if (errcode < 0)
+			return errcode;
+	}
+
 	decoder->image = image;
 	return 0;
 }
@@ -429,6 +439,24 @@ int pt_insn_core_bus_ratio(struct pt_insn_decoder *decoder, uint32_t *cbr)
 	return pt_qry_core_bus_ratio(&decoder->query, cbr);
 }
 
+int pt_insn_get_calibration(const struct pt_insn_decoder *decoder,
+			    struct pt_time_calibration *cal, size_t size)
+{
+	if (!decoder)
+		return -pte_invalid;
+
+	return pt_qry_get_calibration(&decoder->query, cal, size);
+}
+
+int pt_insn_set_calibration(struct pt_insn_decoder *decoder,
+			    const struct pt_time_calibration *cal)
+{
+	if (!decoder)
+		return -pte_invalid;
+
+	return pt_qry_set_calibration(&decoder->query, cal);
+}
+
 int pt_insn_asid(const struct pt_insn_decoder *decoder, struct pt_asid *asid,
 		 size_t size)
 {
@@ -1206,9 +1234,77 @@ static inline int insn_to_user(struct pt_insn *uinsn, size_t size,
 
 	memcpy(uinsn, insn, size);
 
+	/* Let @uinsn->bytes point to @uinsn's own copy of the raw bytes. */
+	if ((offsetof(struct pt_insn, bytes) + sizeof(insn->bytes) <= size) &&
+	    (insn->bytes == insn->raw))
+		uinsn->bytes = uinsn->raw;
+
 	return 0;
 }
 
+static int pt_insn_decode_copy(struct pt_insn_decoder *decoder,
+			       struct pt_insn *insn, struct pt_insn_ext *iext)
+{
+	int status;
+
+	if (!decoder || !insn)
+		return -pte_internal;
+
+	status = pt_insn_decode(insn, iext, decoder->image, &decoder->asid);
+	if (status < 0)
+		return status;
+
+	insn->bytes = insn->raw;
+
+	return status;
+}
+
+/* Try to decode @insn directly from @msec's memory without copying.
+ *
+ * Returns a positive integer on success.
+ * Returns zero if @insn could not be decoded in place.
+ * Returns a negative error code otherwise.
+ */
+static int pt_insn_decode_in_place(const struct pt_mapped_section *msec,
+				   struct pt_insn *insn,
+				   struct pt_insn_ext *iext)
+{
+	const uint8_t *begin;
+	int status;
+
+	if (!insn)
+		return -pte_internal;
+
+	status = pt_msec_peek(msec, &begin, sizeof(insn->raw), insn->ip);
+	if (status < 0) {
+		switch (status) {
+		case -pte_nomap:
+		case -pte_not_supported:
+			return 0;
+
+		default:
+			return status;
+		}
+	}
+
+	insn->size = (uint8_t) status;
+
+	/* An instruction that does not fit into the remainder of the section
+	 * fails to decode here and is copied from the image instead.
+	 */
+	status = pt_ild_decode_raw(insn, iext, begin);
+	if (status < 0) {
+		if (status != -pte_bad_insn)
+			return status;
+
+		return 0;
+	}
+
+	insn->bytes = begin;
+
+	return 1;
+}
+
 static int pt_insn_decode_cached(struct pt_insn_decoder *decoder,
 				 const struct pt_mapped_section *msec,
 				 struct pt_insn *insn, struct pt_insn_ext *iext)
@@ -1227,16 +1323,20 @@ static int pt_insn_decode_cached(struct pt_insn_decoder *decoder,
 	 */
 
 	if (!msec)
-		return pt_insn_decode(insn, iext, decoder->image,
-				      &decoder->asid);
+		return pt_insn_decode_copy(decoder, insn, iext);
+
+	if (decoder->flags.variant.insn.enable_zero_copy) {
+		status = pt_insn_decode_in_place(msec, insn, iext);
+		if (status != 0)
+			return status < 0 ? status : 0;
+	}
 
 	status = pt_msec_read(msec, insn->raw, sizeof(insn->raw), insn->ip);
 	if (status < 0) {
 		if (status != -pte_nomap)
 			return status;
 
-		return pt_insn_decode(insn, iext, decoder->image,
-				      &decoder->asid);
+		return pt_insn_decode_copy(decoder, insn, iext);
 	}
 
 	/* We initialize @insn->size to the maximal possible size.  It will be
@@ -1249,10 +1349,11 @@ static int pt_insn_decode_cached(struct pt_insn_decoder *decoder,
 		if (status != -pte_bad_insn)
 			return status;
 
-		return pt_insn_decode(insn, iext, decoder->image,
-				      &decoder->asid);
+		return pt_insn_decode_copy(decoder, insn, iext);
 	}
 
+	insn->bytes = insn->raw;
+
 	return status;
 }
 
@@ -1271,7 +1372,7 @@ static int pt_insn_msec_lookup(struct pt_insn_decoder *decoder,
 	image = decoder->image;
 	ip = decoder->ip;
 
-	isid = pt_msec_cache_read(scache, pmsec, image, ip);
+	isid = pt_msec_cache_read(scache, pmsec, image, &decoder->asid, ip);
 	if (isid < 0) {
 		if (isid != -pte_nomap)
 			return isid;
@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_insn_mix.h"
+#include "pt_insn.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+
+int pt_mix_init(struct pt_insn_mix *mix,
+		struct pt_image_section_cache *iscache)
+{
+	if (!mix)
+		return -pte_internal;
+
+	memset(mix, 0, sizeof(*mix));
+	mix->iscache = iscache;
+
+	return 0;
+}
+
+static void pt_mix_free_section(struct pt_mix_section *msec)
+{
+	size_t idx;
+
+	if (!msec)
+		return;
+
+	for (idx = 0; idx < pt_mix_nbuckets; ++idx) {
+		struct pt_mix_block *mblock;
+
+		mblock = msec->bucket[idx];
+		while (mblock) {
+			struct pt_mix_block *trash;
+
+			trash = mblock;
+			mblock = mblock->next;
+
+			free(trash);
+		}
+	}
+
+	free(msec);
+}
+
+void pt_mix_fini(struct pt_insn_mix *mix)
+{
+	struct pt_mix_section *msec;
+
+	if (!mix)
+		return;
+
+	msec = mix->sections;
+	while (msec) {
+		struct pt_mix_section *trash;
+
+		trash = msec;
+		msec = msec->next;
+
+		pt_mix_free_section(trash);
+	}
+
+	mix->sections = NULL;
+}
+
+struct pt_insn_mix *pt_mix_alloc(struct pt_image_section_cache *iscache)
+{
+	struct pt_insn_mix *mix;
+	int errcode;
+
+	mix = malloc(sizeof(*mix));
+	if (!mix)
+		return NULL;
+
+	errcode = pt_mix_init(mix, iscache);
+	if (errcode < 0) {
+		free(mix);
+		return NULL;
+	}
+
+	return mix;
+}
+
+void pt_mix_free(struct pt_insn_mix *mix)
+{
+	if (!mix)
+		return;
+
+	pt_mix_fini(mix);
+	free(mix);
+}
+
+/* Count @insn's instruction class in the struct pt_mix_block @context. */
+static int pt_mix_count_insn(const struct pt_insn *insn,
+			     const struct pt_insn_ext *iext, void *context)
+{
+	struct pt_mix_block *mblock;
+
+	(void) iext;
+
+	mblock = (struct pt_mix_block *) context;
+	if (!insn || !mblock)
+		return -pte_internal;
+
+	if (pt_mix_num_iclass <= (int) insn->iclass)
+		return -pte_internal;
+
+	mblock->iclass[insn->iclass] += 1;
+
+	return 0;
+}
+
+int pt_mix_summarize(struct pt_mix_block *mblock, const struct pt_block *block,
+		     struct pt_image_section_cache *iscache)
+{
+	if (!mblock || !block)
+		return -pte_internal;
+
+	memset(mblock, 0, sizeof(*mblock));
+	mblock->ip = block->ip;
+	mblock->mode = block->mode;
+	mblock->ninsn = block->ninsn;
+
+	return pt_insn_walk_block(block, iscache, pt_mix_count_insn, mblock);
+}
+
+static unsigned int pt_mix_hash(uint64_t ip)
+{
+	return (unsigned int) ((ip ^ (ip >> 10)) & (pt_mix_nbuckets - 1));
+}
+
+/* Find or create the section for @isid.
+ *
+ * Moves the section to the front of @mix's section list.
+ *
+ * Returns the section on success, NULL otherwise.
+ */
+static struct pt_mix_section *pt_mix_fetch_section(struct pt_insn_mix *mix,
+						   int isid)
+{
+	struct pt_mix_section *msec, **pmsec;
+
+	if (!mix)
+		return NULL;
+
+	for (pmsec = &mix->sections; *pmsec; pmsec = &(*pmsec)->next) {
+		msec = *pmsec;
+
+		if (msec->isid != isid)
+			continue;
+
+		/* Move it to the front. */
+		*pmsec = msec->next;
+		msec->next = mix->sections;
+		mix->sections = msec;
+
+		return msec;
+	}
+
+	msec = malloc(sizeof(*msec));
+	if (!msec)
+		return NULL;
+
+	memset(msec, 0, sizeof(*msec));
+	msec->isid = isid;
+	msec->next = mix->sections;
+	mix->sections = msec;
+
+	return msec;
+}
+
+int pt_mix_add_block(struct pt_insn_mix *mix, const struct pt_block *block)
+{
+	struct pt_mix_section *msec;
+	struct pt_mix_block *mblock;
+	unsigned int idx;
+	int errcode;
+
+	if (!mix || !block)
+		return -pte_invalid;
+
+	/* There's nothing to count in an empty block. */
+	if (!block->ninsn)
+		return 0;
+
+	/* We need an image section cache section for reading memory. */
+	if (block->isid <= 0)
+		return -pte_bad_image;
+
+	msec = pt_mix_fetch_section(mix, block->isid);
+	if (!msec)
+		return -pte_nomem;
+
+	idx = pt_mix_hash(block->ip);
+	for (mblock = msec->bucket[idx]; mblock; mblock = mblock->next) {
+		if (mblock->ip != block->ip)
+			continue;
+
+		/* Blocks may end early, e.g. due to events. */
+		if (mblock->ninsn != block->ninsn)
+			continue;
+
+		if (mblock->mode != block->mode)
+			continue;
+
+		break;
+	}
+
+	if (!mblock) {
+		mblock = malloc(sizeof(*mblock));
+		if (!mblock)
+			return -pte_nomem;
+
+		errcode = pt_mix_summarize(mblock, block, mix->iscache);
+		if (errcode < 0) {
+			free(mblock);
+			return errcode;
+		}
+
+		mblock->next = msec->bucket[idx];
+		msec->bucket[idx] = mblock;
+	}
+
+	mblock->count += 1;
+
+	return 0;
+}
+
+int pt_mix_query(const struct pt_insn_mix *mix, struct pt_mix_counts *ucounts,
+		 size_t size, int isid, uint64_t begin, uint64_t end)
+{
+	const struct pt_mix_section *msec;
+	struct pt_mix_counts counts;
+
+	if (!mix || !ucounts)
+		return -pte_invalid;
+
+	if (size < offsetof(struct pt_mix_counts, iclass))
+		return -pte_invalid;
+
+	memset(&counts, 0, sizeof(counts));
+
+	for (msec = mix->sections; msec; msec = msec->next) {
+		size_t idx;
+
+		if (isid && (msec->isid != isid))
+			continue;
+
+		for (idx = 0; idx < pt_mix_nbuckets; ++idx) {
+			const struct pt_mix_block *mblock;
+
+			for (mblock = msec->bucket[idx]; mblock;
+			     mblock = mblock->next) {
+				uint64_t count;
+				int iclass;
+
+				if ((mblock->ip < begin) || (end <= mblock->ip))
+					continue;
+
+				count = mblock->count;
+
+				counts.nblocks += count;
+				counts.ninsn += count * mblock->ninsn;
+
+				for (iclass = 0; iclass < pt_mix_num_iclass;
+				     ++iclass)
+					counts.iclass[iclass] +=
+						count * mblock->iclass[iclass];
+			}
+		}
+	}
+
+	/* Zero out any unknown bytes. */
+	if (sizeof(counts) < size) {
+		memset((uint8_t *) ucounts + sizeof(counts), 0,
+		       size - sizeof(counts));
+
+		size = sizeof(counts);
+	}
+
+	memcpy(ucounts, &counts, size);
+
+	return 0;
+}
@@ -75,7 +75,8 @@ int pt_msec_cache_invalidate(struct pt_msec_cache *cache)
 
 int pt_msec_cache_read(struct pt_msec_cache *cache,
 		       const struct pt_mapped_section **pmsec,
-		       struct pt_image *image, uint64_t vaddr)
+		       struct pt_image *image, const struct pt_asid *asid,
+		       uint64_t vaddr)
 {
 	struct pt_mapped_section *msec;
 	int isid, errcode;
@@ -86,7 +87,7 @@ int pt_msec_cache_read(struct pt_msec_cache *cache,
 	msec = &cache->msec;
 	isid = cache->isid;
 
-	errcode = pt_image_validate(image, msec, vaddr, isid);
+	errcode = pt_image_validate(image, msec, &cache->tag, asid, vaddr);
 	if (errcode < 0)
 		return errcode;
 
@@ -114,7 +115,7 @@ int pt_msec_cache_fill(struct pt_msec_cache *cache,
 
 	msec = &cache->msec;
 
-	isid = pt_image_find(image, msec, asid, vaddr);
+	isid = pt_image_find(image, msec, &cache->tag, asid, vaddr);
 	if (isid < 0)
 		return isid;
 
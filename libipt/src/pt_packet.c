@@ -32,6 +32,8 @@
 #include "intel-pt.h"
 
 #include <limits.h>
+#include <string.h>
+#include <stddef.h>
 
 
 static uint64_t pt_pkt_read_value(const uint8_t *pos, int size)
@@ -109,6 +111,58 @@ int pt_pkt_read_psb(const uint8_t *pos, const struct pt_config *config)
 	return ptps_psb;
 }
 
+int pt_pkt_read_pad(const uint8_t *pos, const struct pt_config *config,
+		    int max)
+{
+	const uint8_t *begin, *end;
+	uint64_t pattern;
+
+	if (!pos || !config || (max < ptps_pad))
+		return -pte_internal;
+
+	end = config->end;
+	if (end < pos + ptps_pad)
+		return -pte_eos;
+
+	if ((end - pos) > max)
+		end = pos + max;
+
+	begin = pos;
+	pos += ptps_pad;
+
+	pattern = (uint64_t) pt_opc_pad * 0x0101010101010101ull;
+
+	/* Compare four words at a time and use unaligned loads via memcpy()
+	 * so this works on any architecture.
+	 */
+	while ((end - pos) >= (4 * (ptrdiff_t) sizeof(pattern))) {
+		uint64_t word[4];
+
+		memcpy(word, pos, sizeof(word));
+
+		if ((word[0] ^ pattern) | (word[1] ^ pattern) |
+		    (word[2] ^ pattern) | (word[3] ^ pattern))
+			break;
+
+		pos += sizeof(word);
+	}
+
+	while ((end - pos) >= (ptrdiff_t) sizeof(pattern)) {
+		uint64_t word;
+
+		memcpy(&word, pos, sizeof(word));
+		if (word != pattern)
+			break;
+
+		pos += sizeof(word);
+	}
+
+	while ((pos < end) && (*pos == pt_opc_pad))
+		pos += ptps_pad;
+
+	return (int) (pos - begin);
+}
+
 static int pt_pkt_ip_size(enum pt_ip_compression ipc)
 {
 	switch (ipc) {
@@ -380,6 +434,57 @@ int pt_pkt_read_mtc(struct pt_packet_mtc *packet, const uint8_t *pos,
 	return ptps_mtc;
 }
 
+/* Read a CYC packet of up to eight bytes without branching on each byte.
+ *
+ * There must be at least eight bytes of trace at @pos.
+ *
+ * Cycle-accurate tracing with a low threshold emits a lot of CYC packets.
+ * Almost all of them are short.
+ *
+ * Returns the packet size on success.
+ * Returns zero if the packet is longer than eight bytes.
+ */
+static int pt_pkt_read_cyc_fast(uint64_t *value, const uint8_t *pos)
+{
+	uint64_t word, ext, stop, mask, val;
+
+	word = pt_pkt_read_value(pos, 8);
+
+	/* Move each byte's extension bit into the byte's lowest bit.  The
+	 * first byte holds it in bit 2.
+	 */
+	ext = (word & 0x0101010101010100ull) | ((word & pt_opm_cyc_ext) >> 2);
+
+	/* The packet ends with the first byte that does not extend it. */
+	stop = ~ext & 0x0101010101010101ull;
+	if (!stop)
+		return 0;
+
+	/* Mask out bytes following the packet.
+	 *
+	 * For an eight-byte packet, the shift wraps around to zero and the
+	 * mask covers the entire word.
+	 */
+	stop &= ~stop + 1ull;
+	mask = (stop << 8) - 1ull;
+	word &= mask;
+
+	val = (word >> 3) & 0x1full;
+	val |= ((word >> 9) & 0x7full) << 5;
+	val |= ((word >> 17) & 0x7full) << 12;
+	val |= ((word >> 25) & 0x7full) << 19;
+	val |= ((word >> 33) & 0x7full) << 26;
+	val |= ((word >> 41) & 0x7full) << 33;
+	val |= ((word >> 49) & 0x7full) << 40;
+	val |= ((word >> 57) & 0x7full) << 47;
+
+	*value = val;
+
+	/* Count the bytes covered by @mask. */
+	return (int) (((mask & 0x0101010101010101ull) *
+		       0x0101010101010101ull) >> 56);
+}
+
 int pt_pkt_read_cyc(struct pt_packet_cyc *packet, const uint8_t *pos,
 		    const struct pt_config *config)
 {
@@ -393,6 +498,14 @@ int pt_pkt_read_cyc(struct pt_packet_cyc *packet, const uint8_t *pos,
 	begin = pos;
 	end = config->end;
 
+	if (8 <= (end - pos)) {
+		int size;
+
+		size = pt_pkt_read_cyc_fast(&packet->value, pos);
+		if (size)
+			return size;
+	}
+
 	/* The first byte contains the opcode and part of the payload.
 	 * We already checked that this first byte is within bounds.
 	 */
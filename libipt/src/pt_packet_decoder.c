@@ -52,7 +52,25 @@ int pt_pkt_decoder_init(struct pt_packet_decoder *decoder,
 	if (errcode < 0)
 		return errcode;
 
-	return 0;
+	return pt_win_init(&decoder->window, &decoder->config);
+}
+
+int pt_pkt_decoder_init_shared(struct pt_packet_decoder *decoder,
+			       const struct pt_config *config,
+			       const struct pt_window *window)
+{
+	int errcode;
+
+	if (!decoder || !config || !window)
+		return -pte_internal;
+
+	memset(decoder, 0, sizeof(*decoder));
+
+	errcode = pt_config_from_user(&decoder->config, config);
+	if (errcode < 0)
+		return errcode;
+
+	return pt_win_init_shared(&decoder->window, &decoder->config, window);
 }
 
 struct pt_packet_decoder *pt_pkt_alloc_decoder(const struct pt_config *config)
@@ -75,9 +93,10 @@ struct pt_packet_decoder *pt_pkt_alloc_decoder(const struct pt_config *config)
 
 void pt_pkt_decoder_fini(struct pt_packet_decoder *decoder)
 {
-	(void) decoder;
+	if (!decoder)
+		return;
 
-	/* Nothing to do. */
+	pt_win_fini(&decoder->window);
 }
 
 void pt_pkt_free_decoder(struct pt_packet_decoder *decoder)
@@ -86,6 +105,50 @@ void pt_pkt_free_decoder(struct pt_packet_decoder *decoder)
 	free(decoder);
 }
 
+/* Move to the next window.
+ *
+ * Continues decoding at the beginning of the next window.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_eos if there is no next window.
+ */
+static int pt_pkt_next_window(struct pt_packet_decoder *decoder)
+{
+	int errcode;
+
+	errcode = pt_win_next(&decoder->window);
+	if (errcode < 0)
+		return errcode;
+
+	decoder->config.begin = decoder->window.begin;
+	decoder->config.end = decoder->window.end;
+	decoder->pos = decoder->config.begin;
+
+	return 0;
+}
+
+/* Provide the position of @offset in @pos.
+ *
+ * Moves to the window containing @offset, if necessary.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_eos if @offset lies outside of the trace.
+ */
+static int pt_pkt_seek(struct pt_packet_decoder *decoder, const uint8_t **pos,
+		       uint64_t offset)
+{
+	int errcode;
+
+	errcode = pt_win_seek(&decoder->window, pos, offset);
+	if (errcode < 0)
+		return errcode;
+
+	decoder->config.begin = decoder->window.begin;
+	decoder->config.end = decoder->window.end;
+
+	return 0;
+}
+
 int pt_pkt_sync_forward(struct pt_packet_decoder *decoder)
 {
 	const uint8_t *pos, *sync, *begin;
@@ -95,15 +158,18 @@ int pt_pkt_sync_forward(struct pt_packet_decoder *decoder)
 	if (!decoder)
 		return -pte_invalid;
 
-	begin = decoder->config.begin;
-	sync = decoder->sync;
 	pos = decoder->pos;
-	if (!pos)
-		pos = begin;
+	if (!pos) {
+		errcode = pt_pkt_seek(decoder, &pos, 0ull);
+		if (errcode < 0)
+			return errcode;
+	}
 
-	if (pos == sync)
+	if (decoder->sync &&
+	    (pt_win_offset(&decoder->window, pos) == decoder->sync_offset))
 		pos += ptps_psb;
 
+	begin = decoder->config.begin;
 	if (pos < begin)
 		return -pte_internal;
 
@@ -116,11 +182,24 @@ int pt_pkt_sync_forward(struct pt_packet_decoder *decoder)
 
 	pos -= space;
 
-	errcode = pt_sync_forward(&sync, pos, &decoder->config);
+	for (;;) {
+		errcode = pt_sync_forward(&sync, pos, &decoder->config);
+		if (errcode != -pte_eos)
+			break;
+
+		/* Windows end before a PSB.  Continue in the next window. */
+		errcode = pt_pkt_next_window(decoder);
+		if (errcode < 0)
+			return errcode;
+
+		pos = decoder->config.begin;
+	}
+
 	if (errcode < 0)
 		return errcode;
 
 	decoder->sync = sync;
+	decoder->sync_offset = pt_win_offset(&decoder->window, sync);
 	decoder->pos = sync;
 
 	return 0;
@@ -129,20 +208,48 @@ int pt_pkt_sync_forward(struct pt_packet_decoder *decoder)
 int pt_pkt_sync_backward(struct pt_packet_decoder *decoder)
 {
 	const uint8_t *pos, *sync;
+	uint64_t start;
 	int errcode;
 
 	if (!decoder)
 		return -pte_invalid;
 
 	pos = decoder->pos;
-	if (!pos)
-		pos = decoder->config.end;
+	if (pos)
+		start = pt_win_offset(&decoder->window, pos);
+	else
+		start = pt_win_size(&decoder->window);
 
-	errcode = pt_sync_backward(&sync, pos, &decoder->config);
+	errcode = pt_pkt_seek(decoder, &pos, start);
 	if (errcode < 0)
 		return errcode;
 
+	for (;;) {
+		errcode = pt_sync_backward(&sync, pos, &decoder->config);
+		if (errcode != -pte_eos)
+			break;
+
+		/* Continue at the end of the previous window. */
+		errcode = pt_win_prev(&decoder->window);
+		if (errcode < 0)
+			break;
+
+		decoder->config.begin = decoder->window.begin;
+		decoder->config.end = decoder->window.end;
+
+		pos = decoder->config.end;
+	}
+
+	if (errcode < 0) {
+		/* Stay where we were. */
+		if (decoder->pos)
+			(void) pt_pkt_seek(decoder, &decoder->pos, start);
+
+		return errcode;
+	}
+
 	decoder->sync = sync;
+	decoder->sync_offset = pt_win_offset(&decoder->window, sync);
 	decoder->pos = sync;
 
 	return 0;
@@ -150,19 +257,18 @@ int pt_pkt_sync_backward(struct pt_packet_decoder *decoder)
 
 int pt_pkt_sync_set(struct pt_packet_decoder *decoder, uint64_t offset)
 {
-	const uint8_t *begin, *end, *pos;
+	const uint8_t *pos;
+	int errcode;
 
 	if (!decoder)
 		return -pte_invalid;
 
-	begin = decoder->config.begin;
-	end = decoder->config.end;
-	pos = begin + offset;
-
-	if (end < pos || pos < begin)
-		return -pte_eos;
+	errcode = pt_pkt_seek(decoder, &pos, offset);
+	if (errcode < 0)
+		return errcode;
 
 	decoder->sync = pos;
+	decoder->sync_offset = offset;
 	decoder->pos = pos;
 
 	return 0;
@@ -170,36 +276,30 @@ int pt_pkt_sync_set(struct pt_packet_decoder *decoder, uint64_t offset)
 
 int pt_pkt_get_offset(const struct pt_packet_decoder *decoder, uint64_t *offset)
 {
-	const uint8_t *begin, *pos;
+	const uint8_t *pos;
 
 	if (!decoder || !offset)
 		return -pte_invalid;
 
-	begin = decoder->config.begin;
 	pos = decoder->pos;
 
 	if (!pos)
 		return -pte_nosync;
 
-	*offset = (uint64_t) (int64_t) (pos - begin);
+	*offset = pt_win_offset(&decoder->window, pos);
 	return 0;
 }
 
 int pt_pkt_get_sync_offset(const struct pt_packet_decoder *decoder,
 			   uint64_t *offset)
 {
-	const uint8_t *begin, *sync;
-
 	if (!decoder || !offset)
 		return -pte_invalid;
 
-	begin = decoder->config.begin;
-	sync = decoder->sync;
-
-	if (!sync)
+	if (!decoder->sync)
 		return -pte_nosync;
 
-	*offset = (uint64_t) (int64_t) (sync - begin);
+	*offset = decoder->sync_offset;
 	return 0;
 }
 
@@ -245,6 +345,14 @@ int pt_pkt_next(struct pt_packet_decoder *decoder, struct pt_packet *packet,
 
 	ppkt = psize == sizeof(pkt) ? packet : &pkt;
 
+	/* Continue in the next window when we reach the end of this one. */
+	if ((decoder->pos == decoder->config.end) &&
+	    pt_win_has_next(&decoder->window)) {
+		errcode = pt_pkt_next_window(decoder);
+		if (errcode < 0)
+			return errcode;
+	}
+
 	errcode = pt_df_fetch(&dfun, decoder->pos, &decoder->config);
 	if (errcode < 0)
 		return errcode;
@@ -268,6 +376,108 @@ int pt_pkt_next(struct pt_packet_decoder *decoder, struct pt_packet *packet,
 	return size;
 }
 
+/* Check whether a packet may lie between a packet binding to a TIP and that
+ * TIP packet.
+ *
+ * Returns non-zero if it may, zero otherwise.
+ */
+static int pt_pkt_is_transparent(enum pt_packet_type type)
+{
+	switch (type) {
+	case ppt_pad:
+	case ppt_tsc:
+	case ppt_cbr:
+	case ppt_tma:
+	case ppt_mtc:
+	case ppt_cyc:
+	case ppt_mnt:
+		return 1;
+
+	default:
+		return 0;
+	}
+}
+
+int pt_pkt_find_split(struct pt_packet_decoder *decoder, uint64_t *split,
+		      uint64_t offset)
+{
+	enum pt_packet_type last;
+	uint64_t start;
+	int in_psb;
+
+	if (!decoder || !split)
+		return -pte_invalid;
+
+	if (!decoder->sync)
+		return -pte_nosync;
+
+	start = decoder->sync_offset;
+
+	last = ppt_invalid;
+	in_psb = 0;
+	for (;;) {
+		struct pt_packet packet;
+		const uint8_t *pos;
+		uint64_t here;
+		int size;
+
+		size = pt_pkt_next(decoder, &packet, sizeof(packet));
+		if (size < 0)
+			return size;
+
+		/* The packet may start a new window. */
+		pos = decoder->pos - size;
+		here = pt_win_offset(&decoder->window, pos);
+
+		switch (packet.type) {
+		case ppt_psb:
+			/* We're done when we reach the next PSB. */
+			if (here != start) {
+				decoder->sync = pos;
+				decoder->sync_offset = here;
+				decoder->pos = pos;
+				return 0;
+			}
+
+			in_psb = 1;
+			break;
+
+		case ppt_psbend:
+			in_psb = 0;
+			break;
+
+		case ppt_tip:
+			/* We need a full IP. */
+			if ((packet.payload.ip.ipc != pt_ipc_sext_48) &&
+			    (packet.payload.ip.ipc != pt_ipc_full))
+				break;
+
+			/* The TIP must not be part of an event.
+			 *
+			 * A FUP would make it an asynchronous branch, a MODE
+			 * would change the execution mode at the TIP.
+			 */
+			if ((last == ppt_fup) || (last == ppt_mode))
+				break;
+
+			if (in_psb)
+				break;
+
+			if (here < offset)
+				break;
+
+			*split = here;
+			return 1;
+
+		default:
+			break;
+		}
+
+		if (!pt_pkt_is_transparent(packet.type))
+			last = packet.type;
+	}
+}
+
 int pt_pkt_decode_unknown(struct pt_packet_decoder *decoder,
 			  struct pt_packet *packet)
 {
@@ -286,15 +496,23 @@ int pt_pkt_decode_unknown(struct pt_packet_decoder *decoder,
 int pt_pkt_decode_pad(struct pt_packet_decoder *decoder,
 		      struct pt_packet *packet)
 {
-	(void) decoder;
+	int size;
 
-	if (!packet)
+	if (!decoder || !packet)
 		return -pte_internal;
 
+	size = ptps_pad;
+	if (decoder->config.flags.variant.packet.coalesce_pad) {
+		size = pt_pkt_read_pad(decoder->pos, &decoder->config,
+				       UINT8_MAX);
+		if (size < 0)
+			return size;
+	}
+
 	packet->type = ppt_pad;
-	packet->size = ptps_pad;
+	packet->size = (uint8_t) size;
 
-	return ptps_pad;
+	return size;
 }
 
 int pt_pkt_decode_psb(struct pt_packet_decoder *decoder,
@@ -99,11 +99,16 @@ int pt_qry_decoder_init(struct pt_query_decoder *decoder,
 	if (errcode < 0)
 		return errcode;
 
+	errcode = pt_win_init(&decoder->window, &decoder->config);
+	if (errcode < 0)
+		return errcode;
+
 	pt_last_ip_init(&decoder->ip);
 	pt_tnt_cache_init(&decoder->tnt);
 	pt_time_init(&decoder->time);
 	pt_time_init(&decoder->last_time);
 	pt_tcal_init(&decoder->tcal);
+	pt_tcal_init(&decoder->tcal_seed);
 	pt_evq_init(&decoder->evq);
 
 	return 0;
@@ -129,9 +134,10 @@ struct pt_query_decoder *pt_qry_alloc_decoder(const struct pt_config *config)
 
 void pt_qry_decoder_fini(struct pt_query_decoder *decoder)
 {
-	(void) decoder;
+	if (!decoder)
+		return;
 
-	/* Nothing to do. */
+	pt_win_fini(&decoder->window);
 }
 
 void pt_qry_free_decoder(struct pt_query_decoder *decoder)
@@ -153,8 +159,9 @@ static void pt_qry_reset(struct pt_query_decoder *decoder)
 	pt_tnt_cache_init(&decoder->tnt);
 	pt_time_init(&decoder->time);
 	pt_time_init(&decoder->last_time);
-	pt_tcal_init(&decoder->tcal);
 	pt_evq_init(&decoder->evq);
+
+	decoder->tcal = decoder->tcal_seed;
 }
 
 static int pt_qry_will_event(const struct pt_query_decoder *decoder)
@@ -255,6 +262,68 @@ static int pt_qry_provoke_fetch_error(const struct pt_query_decoder *decoder)
 	return -pte_internal;
 }
 
+/* Move to the next window.
+ *
+ * Continues decoding at the beginning of the next window.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_eos if there is no next window.
+ */
+static int pt_qry_next_window(struct pt_query_decoder *decoder)
+{
+	int errcode;
+
+	errcode = pt_win_next(&decoder->window);
+	if (errcode < 0)
+		return errcode;
+
+	decoder->config.begin = decoder->window.begin;
+	decoder->config.end = decoder->window.end;
+	decoder->pos = decoder->config.begin;
+
+	return 0;
+}
+
+/* Provide the position of @offset in @pos.
+ *
+ * Moves to the window containing @offset, if necessary.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_eos if @offset lies outside of the trace.
+ */
+static int pt_qry_seek(struct pt_query_decoder *decoder, const uint8_t **pos,
+		       uint64_t offset)
+{
+	int errcode;
+
+	errcode = pt_win_seek(&decoder->window, pos, offset);
+	if (errcode < 0)
+		return errcode;
+
+	decoder->config.begin = decoder->window.begin;
+	decoder->config.end = decoder->window.end;
+
+	return 0;
+}
+
+/* Provide the offset of the current position in the current window.
+ *
+ * Packet decoders for scanning ahead are initialized with @decoder's
+ * configuration and hence operate on the current window.
+ */
+static int pt_qry_get_window_offset(const struct pt_query_decoder *decoder,
+				    uint64_t *offset)
+{
+	if (!decoder || !offset)
+		return -pte_internal;
+
+	if (!decoder->pos)
+		return -pte_nosync;
+
+	*offset = (uint64_t) (int64_t) (decoder->pos - decoder->config.begin);
+	return 0;
+}
+
 static int pt_qry_read_ahead(struct pt_query_decoder *decoder)
 {
 	if (!decoder)
@@ -264,6 +333,14 @@ static int pt_qry_read_ahead(struct pt_query_decoder *decoder)
 		const struct pt_decoder_function *dfun;
 		int errcode;
 
+		/* Windows end before a PSB.  Continue in the next window. */
+		if ((decoder->pos == decoder->config.end) &&
+		    pt_win_has_next(&decoder->window)) {
+			errcode = pt_qry_next_window(decoder);
+			if (errcode < 0)
+				return errcode;
+		}
+
 		errcode = pt_df_fetch(&decoder->next, decoder->pos,
 				      &decoder->config);
 		if (errcode)
@@ -317,6 +394,7 @@ static int pt_qry_start(struct pt_query_decoder *decoder, const uint8_t *pos,
 	pt_qry_reset(decoder);
 
 	decoder->sync = pos;
+	decoder->sync_offset = pt_win_offset(&decoder->window, pos);
 	decoder->pos = pos;
 
 	errcode = pt_df_fetch(&decoder->next, pos, &decoder->config);
@@ -567,15 +645,18 @@ int pt_qry_sync_forward(struct pt_query_decoder *decoder, uint64_t *ip)
 	if (!decoder)
 		return -pte_invalid;
 
-	begin = decoder->config.begin;
-	sync = decoder->sync;
 	pos = decoder->pos;
-	if (!pos)
-		pos = begin;
+	if (!pos) {
+		errcode = pt_qry_seek(decoder, &pos, 0ull);
+		if (errcode < 0)
+			return errcode;
+	}
 
-	if (pos == sync)
+	if (decoder->sync &&
+	    (pt_win_offset(&decoder->window, pos) == decoder->sync_offset))
 		pos += ptps_psb;
 
+	begin = decoder->config.begin;
 	if (pos < begin)
 		return -pte_internal;
 
@@ -588,7 +669,19 @@ int pt_qry_sync_forward(struct pt_query_decoder *decoder, uint64_t *ip)
 
 	pos -= space;
 
-	errcode = pt_sync_forward(&sync, pos, &decoder->config);
+	for (;;) {
+		errcode = pt_sync_forward(&sync, pos, &decoder->config);
+		if (errcode != -pte_eos)
+			break;
+
+		/* Windows end before a PSB.  Continue in the next window. */
+		errcode = pt_qry_next_window(decoder);
+		if (errcode < 0)
+			return errcode;
+
+		pos = decoder->config.begin;
+	}
+
 	if (errcode < 0)
 		return errcode;
 
@@ -597,43 +690,74 @@ int pt_qry_sync_forward(struct pt_query_decoder *decoder, uint64_t *ip)
 
 int pt_qry_sync_backward(struct pt_query_decoder *decoder, uint64_t *ip)
 {
-	const uint8_t *start, *sync;
+	const uint8_t *pos, *sync;
+	uint64_t start, offset;
 	int errcode;
 
 	if (!decoder)
 		return -pte_invalid;
 
-	start = decoder->pos;
-	if (!start)
-		start = decoder->config.end;
+	pos = decoder->pos;
+	if (pos)
+		start = pt_win_offset(&decoder->window, pos);
+	else
+		start = pt_win_size(&decoder->window);
+
+	errcode = pt_qry_seek(decoder, &pos, start);
+	if (errcode < 0)
+		return errcode;
 
-	sync = start;
 	for (;;) {
-		errcode = pt_sync_backward(&sync, sync, &decoder->config);
+		errcode = pt_sync_backward(&sync, pos, &decoder->config);
+		if (errcode == -pte_eos) {
+			/* Continue at the end of the previous window. */
+			errcode = pt_win_prev(&decoder->window);
+			if (errcode < 0)
+				break;
+
+			decoder->config.begin = decoder->window.begin;
+			decoder->config.end = decoder->window.end;
+
+			pos = decoder->config.end;
+			continue;
+		}
+
 		if (errcode < 0)
-			return errcode;
+			break;
+
+		offset = pt_win_offset(&decoder->window, sync);
 
 		errcode = pt_qry_start(decoder, sync, ip);
 		if (errcode < 0) {
 			/* Ignore incomplete trace segments at the end.  We need
 			 * a full PSB+ to start decoding.
 			 */
-			if (errcode == -pte_eos)
-				continue;
-
-			return errcode;
+			if (errcode != -pte_eos)
+				break;
+		} else {
+			/* An empty trace segment in the middle of the trace
+			 * might bring us back to where we started.
+			 *
+			 * We're done when we reached a new position.
+			 */
+			if (pt_win_offset(&decoder->window, decoder->pos) !=
+			    start)
+				return 0;
 		}
 
-		/* An empty trace segment in the middle of the trace might bring
-		 * us back to where we started.
-		 *
-		 * We're done when we reached a new position.
+		/* Continue searching before @sync.  Reading ahead may have
+		 * moved us to another window.
 		 */
-		if (decoder->pos != start)
+		errcode = pt_qry_seek(decoder, &pos, offset);
+		if (errcode < 0)
 			break;
 	}
 
-	return 0;
+	/* Make sure we stay inside the current window. */
+	if (decoder->pos)
+		(void) pt_qry_seek(decoder, &decoder->pos, start);
+
+	return errcode;
 }
 
 int pt_qry_sync_set(struct pt_query_decoder *decoder, uint64_t *ip,
@@ -645,7 +769,9 @@ int pt_qry_sync_set(struct pt_query_decoder *decoder, uint64_t *ip,
 	if (!decoder)
 		return -pte_invalid;
 
-	pos = decoder->config.begin + offset;
+	errcode = pt_qry_seek(decoder, &pos, offset);
+	if (errcode < 0)
+		return errcode;
 
 	errcode = pt_sync_set(&sync, pos, &decoder->config);
 	if (errcode < 0)
@@ -654,38 +780,119 @@ int pt_qry_sync_set(struct pt_query_decoder *decoder, uint64_t *ip,
 	return pt_qry_start(decoder, sync, ip);
 }
 
+int pt_qry_sync_split(struct pt_query_decoder *decoder, uint64_t *ip,
+		      uint64_t offset, uint64_t psb)
+{
+	const struct pt_decoder_function *dfun;
+	struct pt_packet_ip packet;
+	const uint8_t *pos, *sync;
+	int errcode, size;
+
+	if (!decoder)
+		return -pte_invalid;
+
+	/* The split point must lie inside the PSB segment starting at @psb. */
+	if (offset < psb)
+		return -pte_nosync;
+
+	errcode = pt_qry_seek(decoder, &pos, offset);
+	if (errcode < 0)
+		return errcode;
+
+	/* The PSB must be in the same window as the split point. */
+	if ((uint64_t) (pos - decoder->config.begin) < (offset - psb))
+		return -pte_eos;
+
+	errcode = pt_sync_set(&sync, pos - (offset - psb), &decoder->config);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_df_fetch(&dfun, pos, &decoder->config);
+	if (errcode < 0)
+		return errcode;
+
+	/* We can only start at a TIP packet. */
+	if (dfun != &pt_decode_tip)
+		return -pte_nosync;
+
+	size = pt_pkt_read_ip(&packet, pos, &decoder->config);
+	if (size < 0)
+		return size;
+
+	/* The TIP packet must provide the full IP. */
+	switch (packet.ipc) {
+	case pt_ipc_sext_48:
+	case pt_ipc_full:
+		break;
+
+	default:
+		return -pte_nosync;
+	}
+
+	pt_qry_reset(decoder);
+
+	decoder->sync = sync;
+	decoder->sync_offset = psb;
+	decoder->pos = pos;
+
+	/* We do not know the state at the split point.  Tracing must have been
+	 * enabled, though, for the TIP to be generated.  The time is unknown
+	 * until the next timing packet.
+	 */
+	decoder->enabled = 1;
+
+	errcode = pt_last_ip_update_ip(&decoder->ip, &packet, &decoder->config);
+	if (errcode < 0)
+		return errcode;
+
+	decoder->pos += size;
+
+	/* Fill in the start address.
+	 *
+	 * We do this before reading ahead since the latter may read an
+	 * adjacent PSB+ that might change the decoder's IP.
+	 */
+	if (ip) {
+		errcode = pt_last_ip_query(ip, &decoder->ip);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	/* Read ahead until the first query-relevant packet. */
+	errcode = pt_qry_read_ahead(decoder);
+	if (errcode < 0)
+		return errcode;
+
+	/* We return the current decoder status. */
+	return pt_qry_status_flags(decoder);
+}
+
 int pt_qry_get_offset(const struct pt_query_decoder *decoder, uint64_t *offset)
 {
-	const uint8_t *begin, *pos;
+	const uint8_t *pos;
 
 	if (!decoder || !offset)
 		return -pte_invalid;
 
-	begin = decoder->config.begin;
 	pos = decoder->pos;
 
 	if (!pos)
 		return -pte_nosync;
 
-	*offset = (uint64_t) (int64_t) (pos - begin);
+	*offset = pt_win_offset(&decoder->window, pos);
 	return 0;
 }
 
 int pt_qry_get_sync_offset(const struct pt_query_decoder *decoder,
 			   uint64_t *offset)
 {
-	const uint8_t *begin, *sync;
-
 	if (!decoder || !offset)
 		return -pte_invalid;
 
-	begin = decoder->config.begin;
-	sync = decoder->sync;
-
-	if (!sync)
+	if (!decoder->sync)
 		return -pte_nosync;
 
-	*offset = (uint64_t) (int64_t) (sync - begin);
+	*offset = decoder->sync_offset;
 	return 0;
 }
 
@@ -965,6 +1172,30 @@ int pt_qry_core_bus_ratio(struct pt_query_decoder *decoder, uint32_t *cbr)
 	return pt_time_query_cbr(cbr, &decoder->last_time);
 }
 
+int pt_qry_get_calibration(const struct pt_query_decoder *decoder,
+			   struct pt_time_calibration *cal, size_t size)
+{
+	if (!decoder || !cal)
+		return -pte_invalid;
+
+	return pt_tcal_to_user(cal, &decoder->tcal, size);
+}
+
+int pt_qry_set_calibration(struct pt_query_decoder *decoder,
+			   const struct pt_time_calibration *cal)
+{
+	int errcode;
+
+	if (!decoder || !cal)
+		return -pte_invalid;
+
+	errcode = pt_tcal_from_user(&decoder->tcal_seed, cal);
+	if (errcode < 0)
+		return errcode;
+
+	return pt_tcal_from_user(&decoder->tcal, cal);
+}
+
 static int pt_qry_event_time(struct pt_event *event,
 			     const struct pt_query_decoder *decoder)
 {
@@ -1002,10 +1233,17 @@ int pt_qry_decode_unknown(struct pt_query_decoder *decoder)
 
 int pt_qry_decode_pad(struct pt_query_decoder *decoder)
 {
+	int size;
+
 	if (!decoder)
 		return -pte_internal;
 
-	decoder->pos += ptps_pad;
+	/* Skip the entire run of padding in one go. */
+	size = pt_pkt_read_pad(decoder->pos, &decoder->config, INT_MAX);
+	if (size < 0)
+		return size;
+
+	decoder->pos += size;
 
 	return 0;
 }
@@ -2294,7 +2532,7 @@ static int pt_qry_handle_skd010(struct pt_query_decoder *decoder)
 	if (!decoder)
 		return -pte_internal;
 
-	errcode = pt_qry_get_offset(decoder, &offset);
+	errcode = pt_qry_get_window_offset(decoder, &offset);
 	if (errcode < 0)
 		return errcode;
 
@@ -2403,7 +2641,7 @@ static int apl12_resume_disabled(struct pt_query_decoder *decoder,
 	if (!decoder)
 		return -pte_internal;
 
-	errcode = pt_qry_get_offset(decoder, &begin);
+	errcode = pt_qry_get_window_offset(decoder, &begin);
 	if (errcode < 0)
 		return errcode;
 
@@ -2550,7 +2788,7 @@ static int pt_qry_handle_apl12(struct pt_query_decoder *decoder,
 	if (!decoder)
 		return -pte_internal;
 
-	status = pt_qry_get_offset(decoder, &here);
+	status = pt_qry_get_window_offset(decoder, &here);
 	if (status < 0)
 		return status;
 
@@ -2731,7 +2969,7 @@ static int pt_qry_handle_apl11(struct pt_query_decoder *decoder)
 	if (!decoder)
 		return -pte_internal;
 
-	status = pt_qry_get_offset(decoder, &offset);
+	status = pt_qry_get_window_offset(decoder, &offset);
 	if (status < 0)
 		return status;
 
@@ -2816,7 +3054,7 @@ static int pt_qry_find_ovf_fup(const struct pt_query_decoder *decoder)
 	if (!decoder)
 		return -pte_internal;
 
-	status = pt_qry_get_offset(decoder, &begin);
+	status = pt_qry_get_window_offset(decoder, &begin);
 	if (status < 0)
 		return status;
 
@@ -3262,6 +3500,81 @@ static int check_erratum_skd007(struct pt_query_decoder *decoder,
 	return 1;
 }
 
+/* The maximal number of back-to-back CYC packets we apply in one go. */
+enum {
+	pt_qry_cyc_run	= 32
+};
+
+/* Decode a run of back-to-back CYC packets.
+ *
+ * Cycle-accurate tracing with a low threshold emits a CYC packet for almost
+ * every other packet and often several in a row.  Decode them in one go and
+ * apply them in a single time update instead of going through the decoder
+ * function dispatch for each one.
+ *
+ * Errors in CYC packets following the first are left for the next decode.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_qry_decode_cyc_run(struct pt_query_decoder *decoder)
+{
+	struct pt_packet_cyc packet;
+	uint64_t cyc[pt_qry_cyc_run], fcr;
+	const struct pt_config *config;
+	const uint8_t *pos, *end;
+	size_t ncyc;
+	int errcode;
+
+	config = &decoder->config;
+	pos = decoder->pos;
+	end = config->end;
+
+	packet.value = 0ull;
+	ncyc = 0;
+	do {
+		struct pt_packet_cyc next;
+		int size;
+
+		size = pt_pkt_read_cyc(&next, pos, config);
+		if (size < 0) {
+			if (!ncyc)
+				return size;
+
+			break;
+		}
+
+		cyc[ncyc++] = next.value;
+		packet.value += next.value;
+		pos += size;
+	} while ((ncyc < pt_qry_cyc_run) && (pos < end) &&
+		 ((*pos & pt_opm_cyc) == pt_opc_cyc));
+
+	/* This is pt_qry_apply_cyc() for the entire run.
+	 *
+	 * Calibration only sums up the cycles.  It does not change the ratio
+	 * until the next MTC or TSC.
+	 */
+	errcode = pt_tcal_update_cyc(&decoder->tcal, &packet, config);
+	if (errcode < 0 && (errcode != -pte_bad_config))
+		return errcode;
+
+	errcode = pt_tcal_fcr(&fcr, &decoder->tcal);
+	if (errcode < 0) {
+		if (errcode == -pte_no_time)
+			fcr = 0ull;
+		else
+			return errcode;
+	}
+
+	errcode = pt_time_update_cyc_run(&decoder->time, cyc, ncyc, config,
+					 fcr);
+	if (errcode < 0 && (errcode != -pte_bad_config))
+		return errcode;
+
+	decoder->pos = pos;
+	return 0;
+}
+
 int pt_qry_decode_cyc(struct pt_query_decoder *decoder)
 {
 	struct pt_packet_cyc packet;
@@ -3273,6 +3586,10 @@ int pt_qry_decode_cyc(struct pt_query_decoder *decoder)
 
 	config = &decoder->config;
 
+	/* SKD007 requires us to look at each CYC individually. */
+	if (!config->errata.skd007)
+		return pt_qry_decode_cyc_run(decoder);
+
 	size = pt_pkt_read_cyc(&packet, decoder->pos, config);
 	if (size < 0)
 		return size;
@@ -0,0 +1,434 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_sample_decoder.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+int pt_smp_init(struct pt_sample_decoder *smp,
+		struct pt_insn_decoder *decoder)
+{
+	if (!smp || !decoder)
+		return -pte_internal;
+
+	memset(smp, 0, sizeof(*smp));
+	smp->decoder = decoder;
+
+	return 0;
+}
+
+void pt_smp_fini(struct pt_sample_decoder *smp)
+{
+	if (!smp)
+		return;
+
+	free(smp->sync);
+}
+
+struct pt_sample_decoder *pt_smp_alloc_decoder(struct pt_insn_decoder *decoder)
+{
+	struct pt_sample_decoder *smp;
+	int errcode;
+
+	smp = malloc(sizeof(*smp));
+	if (!smp)
+		return NULL;
+
+	errcode = pt_smp_init(smp, decoder);
+	if (errcode < 0) {
+		free(smp);
+		return NULL;
+	}
+
+	return smp;
+}
+
+void pt_smp_free_decoder(struct pt_sample_decoder *smp)
+{
+	if (!smp)
+		return;
+
+	pt_smp_fini(smp);
+	free(smp);
+}
+
+/* Index the next synchronization point.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_eos if all synchronization points have been indexed.
+ */
+static int pt_smp_index_next(struct pt_sample_decoder *smp)
+{
+	struct pt_smp_sync *sync;
+	uint64_t offset, tsc;
+	uint32_t lost_mtc, lost_cyc;
+	int status;
+
+	if (!smp)
+		return -pte_internal;
+
+	if (smp->indexed)
+		return -pte_eos;
+
+	/* Decoding samples moves the decoder.  Continue indexing from the
+	 * last indexed synchronization point.
+	 */
+	if (smp->nsync) {
+		status = pt_insn_sync_set(smp->decoder,
+					  smp->sync[smp->nsync - 1].offset);
+		if (status < 0)
+			return status;
+	}
+
+	status = pt_insn_sync_forward(smp->decoder);
+	if (status < 0) {
+		if (status == -pte_eos)
+			smp->indexed = 1;
+
+		return status;
+	}
+
+	status = pt_insn_get_sync_offset(smp->decoder, &offset);
+	if (status < 0)
+		return status;
+
+	status = pt_insn_time(smp->decoder, &tsc, &lost_mtc, &lost_cyc);
+	if (status < 0) {
+		if (status != -pte_no_time)
+			return status;
+
+		/* Keep the index ordered if there is no time. */
+		tsc = smp->nsync ? smp->sync[smp->nsync - 1].tsc : 0ull;
+	}
+
+	if (smp->nsync == smp->capacity) {
+		uint32_t capacity;
+
+		capacity = smp->capacity ? smp->capacity * 2 : 64;
+		sync = realloc(smp->sync, capacity * sizeof(*sync));
+		if (!sync)
+			return -pte_nomem;
+
+		smp->sync = sync;
+		smp->capacity = capacity;
+	}
+
+	sync = &smp->sync[smp->nsync++];
+	sync->offset = offset;
+	sync->tsc = tsc;
+
+	return 0;
+}
+
+int pt_smp_find_sync(struct pt_smp_sync *sync, struct pt_sample_decoder *smp,
+		     uint64_t tsc)
+{
+	uint32_t begin, end;
+
+	if (!sync || !smp)
+		return -pte_internal;
+
+	/* Index synchronization points until we passed @tsc. */
+	while (!smp->nsync || (smp->sync[smp->nsync - 1].tsc <= tsc)) {
+		int errcode;
+
+		errcode = pt_smp_index_next(smp);
+		if (errcode < 0) {
+			if (errcode != -pte_eos)
+				return errcode;
+
+			break;
+		}
+	}
+
+	if (!smp->nsync)
+		return -pte_eos;
+
+	/* Find the first synchronization point after @tsc. */
+	begin = 0;
+	end = smp->nsync;
+	while (begin < end) {
+		uint32_t mid;
+
+		mid = begin + ((end - begin) / 2);
+		if (smp->sync[mid].tsc <= tsc)
+			begin = mid + 1;
+		else
+			end = mid;
+	}
+
+	*sync = smp->sync[begin ? begin - 1 : 0];
+
+	return 0;
+}
+
+void pt_smp_add_branch(struct pt_smp_state *state, uint64_t from,
+		       uint64_t to)
+{
+	struct pt_branch *branch;
+
+	if (!state)
+		return;
+
+	branch = &state->branch[state->next];
+	branch->from = from;
+	branch->to = to;
+
+	state->next = (uint8_t) ((state->next + 1) % pt_smp_max_branches);
+	if (state->nbranches < pt_smp_max_branches)
+		state->nbranches += 1;
+}
+
+static void pt_smp_push(struct pt_smp_state *state, uint64_t ip)
+{
+	/* Forget the outermost call if we run out of space. */
+	if (state->ncalls == pt_smp_max_calls) {
+		memmove(&state->call[0], &state->call[1],
+			(pt_smp_max_calls - 1) * sizeof(state->call[0]));
+
+		state->ncalls -= 1;
+		state->partial = 1;
+	}
+
+	state->call[state->ncalls++] = ip;
+}
+
+static void pt_smp_pop(struct pt_smp_state *state)
+{
+	/* We are returning from a call made before we started decoding. */
+	if (!state->ncalls) {
+		state->partial = 1;
+		return;
+	}
+
+	state->ncalls -= 1;
+}
+
+void pt_smp_follow(struct pt_smp_state *state, const struct pt_insn *insn,
+		   uint64_t ip)
+{
+	if (!state || !insn)
+		return;
+
+	switch (insn->iclass) {
+	case ptic_call:
+	case ptic_far_call:
+		pt_smp_push(state, insn->ip + insn->size);
+		break;
+
+	case ptic_return:
+	case ptic_far_return:
+		pt_smp_pop(state);
+		break;
+
+	case ptic_jump:
+	case ptic_cond_jump:
+	case ptic_far_jump:
+		break;
+
+	default:
+		return;
+	}
+
+	if (ip != (insn->ip + insn->size))
+		pt_smp_add_branch(state, insn->ip, ip);
+}
+
+void pt_smp_to_context(struct pt_sample_context *context,
+		       const struct pt_smp_state *state)
+{
+	uint8_t idx;
+
+	if (!context || !state)
+		return;
+
+	for (idx = 0; idx < state->ncalls; ++idx)
+		context->call[idx] = state->call[state->ncalls - idx - 1];
+
+	for (idx = 0; idx < state->nbranches; ++idx) {
+		uint8_t pos;
+
+		pos = (uint8_t) ((state->next + pt_smp_max_branches - idx - 1) %
+				 pt_smp_max_branches);
+
+		context->branch[idx] = state->branch[pos];
+	}
+
+	context->ncalls = state->ncalls;
+	context->nbranches = state->nbranches;
+	context->partial = state->partial;
+}
+
+/* Process pending events.
+ *
+ * Returns a non-negative pt_status_flag bit-vector on success, a negative
+ * error code otherwise.
+ */
+static int pt_smp_events(struct pt_sample_decoder *smp,
+			 struct pt_smp_state *state, struct pt_insn *last,
+			 int *have_last, int status)
+{
+	if (!smp || !state || !last || !have_last)
+		return -pte_internal;
+
+	while (status & pts_event_pending) {
+		struct pt_event event;
+
+		status = pt_insn_event(smp->decoder, &event, sizeof(event));
+		if (status < 0)
+			break;
+
+		switch (event.type) {
+		default:
+			break;
+
+		case ptev_async_branch: {
+			uint64_t from, to;
+
+			from = event.variant.async_branch.from;
+			to = event.variant.async_branch.to;
+
+			if (*have_last)
+				pt_smp_follow(state, last, from);
+
+			if (!event.ip_suppressed)
+				pt_smp_add_branch(state, from, to);
+
+			*have_last = 0;
+		}
+			break;
+
+		case ptev_disabled:
+		case ptev_async_disabled:
+		case ptev_overflow:
+			/* We lose track of calls and returns. */
+			state->partial = 1;
+			*have_last = 0;
+			break;
+		}
+	}
+
+	return status;
+}
+
+int pt_smp_context(struct pt_sample_decoder *smp,
+		   struct pt_sample_context *context, size_t size,
+		   uint64_t tsc, uint64_t ip)
+{
+	struct pt_sample_context result;
+	struct pt_smp_state state;
+	struct pt_smp_sync sync;
+	struct pt_insn last;
+	int status, have_last;
+
+	if (!smp || !context)
+		return -pte_invalid;
+
+	status = pt_smp_find_sync(&sync, smp, tsc);
+	if (status < 0)
+		return status;
+
+	status = pt_insn_sync_set(smp->decoder, sync.offset);
+	if (status < 0)
+		return status;
+
+	memset(&result, 0, sizeof(result));
+	memset(&state, 0, sizeof(state));
+	memset(&last, 0, sizeof(last));
+	have_last = 0;
+
+	result.sync_offset = sync.offset;
+	result.tsc = sync.tsc;
+
+	for (;;) {
+		struct pt_insn insn;
+		uint64_t time;
+		uint32_t lost_mtc, lost_cyc;
+		int errcode;
+
+		status = pt_smp_events(smp, &state, &last, &have_last, status);
+		if (status < 0)
+			break;
+
+		if (status & pts_eos)
+			break;
+
+		status = pt_insn_next(smp->decoder, &insn, sizeof(insn));
+		if (status < 0)
+			break;
+
+		errcode = pt_insn_time(smp->decoder, &time, &lost_mtc,
+				       &lost_cyc);
+		if ((errcode < 0) && (errcode != -pte_no_time)) {
+			status = errcode;
+			break;
+		}
+
+		/* We're done when we passed the sample time. */
+		if (tsc < time)
+			break;
+
+		if (have_last)
+			pt_smp_follow(&state, &last, insn.ip);
+
+		last = insn;
+		have_last = 1;
+
+		if (insn.ip == ip) {
+			pt_smp_to_context(&result, &state);
+			result.tsc = time;
+			result.found = 1;
+		} else if (!result.found)
+			result.tsc = time;
+	}
+
+	if ((status < 0) && (status != -pte_eos))
+		return status;
+
+	/* Without a sample hit, we provide the context at @tsc. */
+	if (!result.found)
+		pt_smp_to_context(&result, &state);
+
+	/* Copy the context to the user.  Make sure we're not writing beyond
+	 * the memory provided by the user.
+	 */
+	if (sizeof(result) < size) {
+		memset((uint8_t *) context + sizeof(result), 0,
+		       size - sizeof(result));
+
+		size = sizeof(result);
+	}
+
+	memcpy(context, &result, size);
+
+	return 0;
+}
@@ -27,8 +27,10 @@
  */
 
 #include "pt_section.h"
+#include "pt_section_memory.h"
 #include "pt_block_cache.h"
 #include "pt_image_section_cache.h"
+#include "pt_compiler.h"
 
 #include "intel-pt.h"
 
@@ -53,6 +55,46 @@ static char *dupstr(const char *str)
 	return strcpy(dup, str);
 }
 
+static struct pt_section *pt_section_alloc(const char *filename,
+					    uint64_t offset, uint64_t size)
+{
+	struct pt_section *section;
+
+	section = malloc(sizeof(*section));
+	if (!section)
+		return NULL;
+
+	memset(section, 0, sizeof(*section));
+
+	section->filename = dupstr(filename);
+	section->offset = offset;
+	section->size = size;
+	section->ucount = 1;
+
+#if defined(FEATURE_THREADS)
+	{
+		int errcode;
+
+		errcode = mtx_init(&section->lock, mtx_plain);
+		if (errcode != thrd_success) {
+			free(section->filename);
+			free(section);
+			return NULL;
+		}
+
+		errcode = mtx_init(&section->alock, mtx_plain);
+		if (errcode != thrd_success) {
+			mtx_destroy(&section->lock);
+			free(section->filename);
+			free(section);
+			return NULL;
+		}
+	}
+#endif /* defined(FEATURE_THREADS) */
+
+	return section;
+}
+
 struct pt_section *pt_mk_section(const char *filename, uint64_t offset,
 				 uint64_t size)
 {
@@ -74,36 +116,11 @@ struct pt_section *pt_mk_section(const char *filename, uint64_t offset,
 	if (fsize < size)
 		size = fsize;
 
-	section = malloc(sizeof(*section));
+	section = pt_section_alloc(filename, offset, size);
 	if (!section)
 		goto out_status;
 
-	memset(section, 0, sizeof(*section));
-
-	section->filename = dupstr(filename);
 	section->status = status;
-	section->offset = offset;
-	section->size = size;
-	section->ucount = 1;
-
-#if defined(FEATURE_THREADS)
-
-	errcode = mtx_init(&section->lock, mtx_plain);
-	if (errcode != thrd_success) {
-		free(section->filename);
-		free(section);
-		goto out_status;
-	}
-
-	errcode = mtx_init(&section->alock, mtx_plain);
-	if (errcode != thrd_success) {
-		mtx_destroy(&section->lock);
-		free(section->filename);
-		free(section);
-		goto out_status;
-	}
-
-#endif /* defined(FEATURE_THREADS) */
 
 	return section;
 
@@ -112,6 +129,24 @@ out_status:
 	return NULL;
 }
 
+struct pt_section *pt_mk_section_memory(const char *filename, uint64_t offset,
+					uint64_t size,
+					struct pt_sec_memory *memory)
+{
+	struct pt_section *section;
+
+	if (!filename || !memory || !size)
+		return NULL;
+
+	section = pt_section_alloc(filename, offset, size);
+	if (!section)
+		return NULL;
+
+	section->memory = memory;
+
+	return section;
+}
+
 int pt_section_lock(struct pt_section *section)
 {
 	if (!section)
@@ -160,6 +195,7 @@ static void pt_section_free(struct pt_section *section)
 
 #endif /* defined(FEATURE_THREADS) */
 
+	pt_sec_memory_free(section->memory);
 	free(section->filename);
 	free(section->status);
 	free(section);
@@ -352,6 +388,14 @@ uint64_t pt_section_size(const struct pt_section *section)
 	return section->size;
 }
 
+int pt_section_is_memory(const struct pt_section *section)
+{
+	if (!section)
+		return 0;
+
+	return section->memory != NULL;
+}
+
 static int pt_section_bcache_memsize(const struct pt_section *section,
 				     uint64_t *psize)
 {
@@ -619,6 +663,53 @@ out_unlock:
 	return errcode;
 }
 
+void pt_section_prefetch(const struct pt_section *section, uint64_t offset)
+{
+	const struct pt_block_cache *bcache;
+
+	if (!section)
+		return;
+
+	if (section->size <= offset)
+		return;
+
+	if (section->prefetch)
+		section->prefetch(section, offset);
+
+	/* We read @section->bcache without locking.  See
+	 * pt_section_bcache().
+	 */
+	bcache = section->bcache;
+	if (bcache && (offset < bcache->nentries))
+		pt_prefetch(&bcache->entry[offset]);
+}
+
+int pt_section_peek(const struct pt_section *section, const uint8_t **pbegin,
+		    uint16_t size, uint64_t offset)
+{
+	uint64_t limit, space;
+
+	if (!section || !pbegin)
+		return -pte_internal;
+
+	if (!section->read)
+		return -pte_nomap;
+
+	limit = section->size;
+	if (limit <= offset)
+		return -pte_nomap;
+
+	if (!section->peek)
+		return -pte_not_supported;
+
+	/* Truncate if we try to access memory past the end of the section. */
+	space = limit - offset;
+	if (space < size)
+		size = (uint16_t) space;
+
+	return section->peek(section, pbegin, size, offset);
+}
+
 int pt_section_read(const struct pt_section *section, uint8_t *buffer,
 		    uint16_t size, uint64_t offset)
 {
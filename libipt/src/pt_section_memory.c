@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_section_memory.h"
+#include "pt_section.h"
+#include "pt_compiler.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+struct pt_sec_memory *pt_sec_memory_alloc(void)
+{
+	struct pt_sec_memory *memory;
+
+	memory = malloc(sizeof(*memory));
+	if (!memory)
+		return NULL;
+
+	memset(memory, 0, sizeof(*memory));
+	return memory;
+}
+
+void pt_sec_memory_free(struct pt_sec_memory *memory)
+{
+	if (!memory)
+		return;
+
+	free(memory->ranges);
+	free(memory->content);
+	free(memory);
+}
+
+static int pt_sec_memory_grow(struct pt_sec_memory *memory, size_t size)
+{
+	uint8_t *content;
+	size_t capacity;
+
+	if (!memory)
+		return -pte_internal;
+
+	capacity = memory->capacity;
+	if (size <= capacity - memory->size)
+		return 0;
+
+	if (SIZE_MAX - memory->size < size)
+		return -pte_overflow;
+
+	if (!capacity)
+		capacity = 0x1000;
+
+	while (capacity - memory->size < size) {
+		if (SIZE_MAX / 2 < capacity)
+			return -pte_overflow;
+
+		capacity *= 2;
+	}
+
+	content = realloc(memory->content, capacity);
+	if (!content)
+		return -pte_nomem;
+
+	memory->content = content;
+	memory->capacity = capacity;
+
+	return 0;
+}
+
+static struct pt_sec_memory_range *
+pt_sec_memory_new_range(struct pt_sec_memory *memory)
+{
+	struct pt_sec_memory_range *ranges;
+	size_t capacity;
+
+	if (!memory)
+		return NULL;
+
+	capacity = memory->rcapacity;
+	if (capacity <= memory->nranges) {
+		capacity = capacity ? capacity * 2 : 8;
+
+		ranges = realloc(memory->ranges, capacity * sizeof(*ranges));
+		if (!ranges)
+			return NULL;
+
+		memory->ranges = ranges;
+		memory->rcapacity = capacity;
+	}
+
+	return &memory->ranges[memory->nranges++];
+}
+
+int pt_sec_memory_add(struct pt_sec_memory *memory, uint64_t offset,
+		      const uint8_t *buffer, size_t size)
+{
+	struct pt_sec_memory_range *range;
+	uint64_t end;
+	int errcode;
+
+	if (!memory || !buffer)
+		return -pte_internal;
+
+	end = offset + size;
+	if (end < offset)
+		return -pte_overflow;
+
+	range = NULL;
+	if (memory->nranges) {
+		range = &memory->ranges[memory->nranges - 1];
+		if (offset < range->end)
+			return -pte_invalid;
+
+		/* We merge adjacent ranges so reads are not cut short. */
+		if (offset != range->end)
+			range = NULL;
+	}
+
+	errcode = pt_sec_memory_grow(memory, size);
+	if (errcode < 0)
+		return errcode;
+
+	if (!range) {
+		range = pt_sec_memory_new_range(memory);
+		if (!range)
+			return -pte_nomem;
+
+		range->begin = offset;
+		range->pos = memory->size;
+	}
+
+	memcpy(memory->content + memory->size, buffer, size);
+	memory->size += size;
+	range->end = end;
+
+	return 0;
+}
+
+/* Find the range containing @offset.
+ *
+ * Returns the range on success, NULL otherwise.
+ */
+static const struct pt_sec_memory_range *
+pt_sec_memory_find(const struct pt_sec_memory *memory, uint64_t offset)
+{
+	const struct pt_sec_memory_range *range;
+	size_t lo, hi;
+
+	if (!memory)
+		return NULL;
+
+	lo = 0;
+	hi = memory->nranges;
+	while (lo < hi) {
+		size_t mid;
+
+		mid = lo + ((hi - lo) / 2);
+		if (memory->ranges[mid].begin <= offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (!lo)
+		return NULL;
+
+	range = &memory->ranges[lo - 1];
+	if (range->end <= offset)
+		return NULL;
+
+	return range;
+}
+
+int pt_sec_memory_map(struct pt_section *section)
+{
+	if (!section || !section->memory)
+		return -pte_internal;
+
+	section->mapping = section->memory;
+	section->unmap = pt_sec_memory_unmap;
+	section->read = pt_sec_memory_read;
+	section->memsize = pt_sec_memory_memsize;
+	section->prefetch = pt_sec_memory_prefetch;
+	section->peek = pt_sec_memory_peek;
+
+	return 0;
+}
+
+int pt_sec_memory_unmap(struct pt_section *section)
+{
+	if (!section)
+		return -pte_internal;
+
+	if (!section->mapping || !section->unmap || !section->read ||
+	    !section->memsize)
+		return -pte_internal;
+
+	section->mapping = NULL;
+	section->unmap = NULL;
+	section->read = NULL;
+	section->memsize = NULL;
+	section->prefetch = NULL;
+	section->peek = NULL;
+
+	return 0;
+}
+
+int pt_sec_memory_read(const struct pt_section *section, uint8_t *buffer,
+		       uint16_t size, uint64_t offset)
+{
+	const struct pt_sec_memory_range *range;
+	const struct pt_sec_memory *memory;
+	uint64_t space;
+
+	if (!section || !buffer)
+		return -pte_internal;
+
+	memory = section->mapping;
+	if (!memory)
+		return -pte_internal;
+
+	range = pt_sec_memory_find(memory, offset);
+	if (!range)
+		return -pte_nomap;
+
+	/* Truncate if we try to read past the end of the range. */
+	space = range->end - offset;
+	if (space < size)
+		size = (uint16_t) space;
+
+	memcpy(buffer, memory->content + range->pos + (offset - range->begin),
+	       size);
+	return (int) size;
+}
+
+int pt_sec_memory_memsize(const struct pt_section *section, uint64_t *size)
+{
+	const struct pt_sec_memory *memory;
+
+	if (!section || !size)
+		return -pte_internal;
+
+	memory = section->mapping;
+	if (!memory)
+		return -pte_internal;
+
+	*size = (uint64_t) memory->size;
+
+	return 0;
+}
+
+void pt_sec_memory_prefetch(const struct pt_section *section, uint64_t offset)
+{
+	const struct pt_sec_memory_range *range;
+	const struct pt_sec_memory *memory;
+
+	if (!section)
+		return;
+
+	memory = section->mapping;
+	range = pt_sec_memory_find(memory, offset);
+	if (!range)
+		return;
+
+	pt_prefetch(memory->content + range->pos + (offset - range->begin));
+}
+
+int pt_sec_memory_peek(const struct pt_section *section, const uint8_t **pbegin,
+		       uint16_t size, uint64_t offset)
+{
+	const struct pt_sec_memory_range *range;
+	const struct pt_sec_memory *memory;
+	uint64_t space;
+
+	if (!section || !pbegin)
+		return -pte_internal;
+
+	memory = section->mapping;
+	if (!memory)
+		return -pte_internal;
+
+	range = pt_sec_memory_find(memory, offset);
+	if (!range)
+		return -pte_nomap;
+
+	/* Truncate if we try to access memory past the end of the range. */
+	space = range->end - offset;
+	if (space < size)
+		size = (uint16_t) space;
+
+	*pbegin = memory->content + range->pos + (offset - range->begin);
+	return (int) size;
+}
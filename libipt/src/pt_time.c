@@ -75,6 +75,16 @@ int pt_time_query_cbr(uint32_t *cbr, const struct pt_time *time)
 	return 0;
 }
 
+int pt_time_query_cyc(uint64_t *cyc, const struct pt_time *time)
+{
+	if (!cyc || !time)
+		return -pte_internal;
+
+	*cyc = time->cyc;
+
+	return 0;
+}
+
 /* Compute the distance between two CTC sources.
  *
  * We adjust a single wrap-around but fail if the distance is bigger than that.
@@ -408,6 +418,9 @@ int pt_time_update_cyc(struct pt_time *time,
 	if (!time || !packet || !config)
 		return -pte_internal;
 
+	/* We count cycles even if we can't translate them into time. */
+	time->cyc += packet->value;
+
 	if (!fcr) {
 		time->lost_cyc += 1;
 		return 0;
@@ -431,6 +444,60 @@ int pt_time_update_cyc(struct pt_time *time,
 	return 0;
 }
 
+int pt_time_update_cyc_run(struct pt_time *time, const uint64_t *cyc,
+			   size_t ncyc, const struct pt_config *config,
+			   uint64_t fcr)
+{
+	uint64_t fc;
+	size_t idx;
+	int status, update;
+
+	if (!time || (!cyc && ncyc) || !config)
+		return -pte_internal;
+
+	/* We count cycles even if we can't translate them into time. */
+	if (!fcr) {
+		for (idx = 0; idx < ncyc; ++idx)
+			time->cyc += cyc[idx];
+
+		time->lost_cyc += (uint32_t) ncyc;
+		return 0;
+	}
+
+	status = 0;
+	update = 0;
+	fc = time->fc;
+	for (idx = 0; idx < ncyc; ++idx) {
+		uint64_t value;
+
+		value = cyc[idx];
+		time->cyc += value;
+
+		if (!fc) {
+			int errcode;
+
+			errcode = pt_time_adjust_cyc(&value, time, config, fcr);
+			if (errcode < 0) {
+				if (errcode != -pte_bad_config)
+					return errcode;
+
+				status = errcode;
+				continue;
+			}
+		}
+
+		fc += (value * fcr) >> pt_tcal_fcr_shr;
+		update = 1;
+	}
+
+	if (update) {
+		time->fc = fc;
+		time->tsc = time->base + fc;
+	}
+
+	return status;
+}
+
 void pt_tcal_init(struct pt_time_cal *tcal)
 {
 	if (!tcal)
@@ -478,6 +545,64 @@ int pt_tcal_set_fcr(struct pt_time_cal *tcal, uint64_t fcr)
 	return 0;
 }
 
+int pt_tcal_to_user(struct pt_time_calibration *user,
+		    const struct pt_time_cal *tcal, size_t size)
+{
+	struct pt_time_calibration cal;
+
+	if (!user || !tcal)
+		return -pte_internal;
+
+	/* We need at least space for the size field. */
+	if (size < sizeof(cal.size))
+		return -pte_invalid;
+
+	if (!pt_tcal_have_fcr(tcal))
+		return -pte_no_time;
+
+	/* Only provide the fields we actually have. */
+	if (sizeof(cal) < size)
+		size = sizeof(cal);
+
+	cal.size = size;
+	cal.fcr = tcal->fcr;
+	cal.min_fcr = tcal->min_fcr;
+	cal.max_fcr = tcal->max_fcr;
+
+	memcpy(user, &cal, size);
+
+	return 0;
+}
+
+int pt_tcal_from_user(struct pt_time_cal *tcal,
+		      const struct pt_time_calibration *user)
+{
+	struct pt_time_calibration cal;
+	size_t size;
+
+	if (!tcal || !user)
+		return -pte_internal;
+
+	memset(&cal, 0, sizeof(cal));
+
+	/* Ignore fields in the user's calibration we don't know. */
+	size = user->size;
+	if (sizeof(cal) < size)
+		size = sizeof(cal);
+
+	memcpy(&cal, user, size);
+
+	/* Missing fields leave the calibration invalid. */
+	if (!cal.fcr || (cal.fcr < cal.min_fcr) || (cal.max_fcr < cal.fcr))
+		return -pte_invalid;
+
+	tcal->fcr = cal.fcr;
+	tcal->min_fcr = cal.min_fcr;
+	tcal->max_fcr = cal.max_fcr;
+
+	return 0;
+}
+
 int pt_tcal_update_tsc(struct pt_time_cal *tcal,
 		      const struct pt_packet_tsc *packet,
 		      const struct pt_config *config)
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_time.h"
+#include "pt_config.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+
+
+/* Restart calibration.
+ *
+ * Drop the partial measurements in @tcal but keep its estimation.
+ */
+static void pt_tcal_restart(struct pt_time_cal *tcal)
+{
+	struct pt_time_calibration cal;
+	int errcode;
+
+	errcode = pt_tcal_to_user(&cal, tcal, sizeof(cal));
+
+	pt_tcal_init(tcal);
+
+	if (errcode >= 0)
+		(void) pt_tcal_from_user(tcal, &cal);
+}
+
+/* Update calibration based on @packet.
+ *
+ * The @header argument says whether @packet is part of PSB+.
+ */
+static int pt_tcal_apply(struct pt_time_cal *tcal,
+			 const struct pt_packet *packet, int header,
+			 const struct pt_config *config)
+{
+	if (!packet)
+		return -pte_internal;
+
+	switch (packet->type) {
+	default:
+		return 0;
+
+	case ppt_tsc:
+		if (header)
+			return pt_tcal_header_tsc(tcal, &packet->payload.tsc,
+						  config);
+
+		return pt_tcal_update_tsc(tcal, &packet->payload.tsc, config);
+
+	case ppt_cbr:
+		if (header)
+			return pt_tcal_header_cbr(tcal, &packet->payload.cbr,
+						  config);
+
+		return pt_tcal_update_cbr(tcal, &packet->payload.cbr, config);
+
+	case ppt_tma:
+		return pt_tcal_update_tma(tcal, &packet->payload.tma, config);
+
+	case ppt_mtc:
+		return pt_tcal_update_mtc(tcal, &packet->payload.mtc, config);
+
+	case ppt_cyc:
+		return pt_tcal_update_cyc(tcal, &packet->payload.cyc, config);
+
+	case ppt_ovf:
+		/* We lost time.  The measurements we collected so far can't
+		 * be used.
+		 */
+		pt_tcal_restart(tcal);
+		return 0;
+	}
+}
+
+static int pt_tcal_trace(struct pt_time_cal *tcal,
+			 struct pt_packet_decoder *decoder,
+			 const struct pt_config *config)
+{
+	for (;;) {
+		int errcode, header;
+
+		errcode = pt_pkt_sync_forward(decoder);
+		if (errcode < 0) {
+			if (errcode == -pte_eos)
+				return 0;
+
+			return errcode;
+		}
+
+		/* We don't know how much time passed since we lost sync. */
+		pt_tcal_restart(tcal);
+
+		header = 0;
+		for (;;) {
+			struct pt_packet packet;
+
+			errcode = pt_pkt_next(decoder, &packet, sizeof(packet));
+			if (errcode < 0)
+				break;
+
+			switch (packet.type) {
+			case ppt_psb:
+				header = 1;
+				break;
+
+			case ppt_psbend:
+				header = 0;
+				break;
+
+			default:
+				/* Calibration is best-effort.  We skip packets
+				 * we can't use for calibration.
+				 */
+				(void) pt_tcal_apply(tcal, &packet, header,
+						     config);
+				break;
+			}
+		}
+
+		if (errcode == -pte_eos)
+			return 0;
+	}
+}
+
+int pt_time_calibrate(struct pt_time_calibration *cal, size_t size,
+		      const struct pt_config *uconfig)
+{
+	struct pt_packet_decoder *decoder;
+	struct pt_time_cal tcal;
+	struct pt_config config;
+	int errcode;
+
+	if (!cal || !uconfig)
+		return -pte_invalid;
+
+	errcode = pt_config_from_user(&config, uconfig);
+	if (errcode < 0)
+		return errcode;
+
+	/* The user's block or insn flags must not be read as packet flags. */
+	memset(&config.flags, 0, sizeof(config.flags));
+
+	decoder = pt_pkt_alloc_decoder(&config);
+	if (!decoder)
+		return -pte_nomem;
+
+	pt_tcal_init(&tcal);
+
+	errcode = pt_tcal_trace(&tcal, decoder, &config);
+
+	pt_pkt_free_decoder(decoder);
+
+	if (errcode < 0)
+		return errcode;
+
+	return pt_tcal_to_user(cal, &tcal, size);
+}
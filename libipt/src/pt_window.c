@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_window.h"
+#include "pt_sync.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Find the first or the last PSB in @fragment.
+ *
+ * Only PSB packets that lie completely inside a fragment are considered.
+ *
+ * Returns a positive integer and provides the PSB's trace offset in @cut if
+ * one is found, zero if none is found, a negative error code otherwise.
+ */
+static int pt_win_find_psb(struct pt_window *win, uint64_t *cut,
+			   size_t fragment, int last)
+{
+	const struct pt_fragment *frag;
+	const uint8_t *sync;
+	int errcode;
+
+	frag = &pt_win_fragments(win)[fragment];
+
+	win->config.begin = frag->begin;
+	win->config.end = frag->end;
+
+	if (last)
+		errcode = pt_sync_backward(&sync, frag->end, &win->config);
+	else
+		errcode = pt_sync_forward(&sync, frag->begin, &win->config);
+
+	if (errcode < 0)
+		return (errcode == -pte_eos) ? 0 : errcode;
+
+	*cut = pt_win_bases(win)[fragment] + (uint64_t) (sync - frag->begin);
+	return 1;
+}
+
+/* Find the PSB packets around each fragment boundary.
+ *
+ * Windows are delimited by the last PSB before and the first PSB after each
+ * fragment boundary.  We search each fragment at most twice, once from each
+ * end, so loading a window does not need to search fragments again.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_win_init_cuts(struct pt_window *win)
+{
+	struct pt_win_cut *cut;
+	uint64_t psb, size;
+	size_t fragment;
+	int status;
+
+	cut = malloc(win->nfragments * sizeof(*cut));
+	if (!cut)
+		return -pte_nomem;
+
+	win->cut = cut;
+
+	psb = 0ull;
+	for (fragment = 1; fragment < win->nfragments; ++fragment) {
+		status = pt_win_find_psb(win, &psb, fragment - 1, 1);
+		if (status < 0)
+			return status;
+
+		cut[fragment].before = psb;
+	}
+
+	size = pt_win_size(win);
+	psb = size;
+	for (fragment = win->nfragments; 1 < fragment; --fragment) {
+		status = pt_win_find_psb(win, &psb, fragment - 1, 0);
+		if (status < 0)
+			return status;
+
+		cut[fragment - 1].after = psb;
+	}
+
+	cut[0].before = 0ull;
+	cut[0].after = size;
+
+	return 0;
+}
+
+/* Load the first window and update @config's trace buffer to it. */
+static int pt_win_init_load(struct pt_window *win, struct pt_config *config)
+{
+	int errcode;
+
+	errcode = pt_win_load(win, 0ull);
+	if (errcode < 0) {
+		pt_win_fini(win);
+		return errcode;
+	}
+
+	config->begin = win->begin;
+	config->end = win->end;
+	config->fragments = NULL;
+	config->nfragments = 0;
+
+	return 0;
+}
+
+int pt_win_init(struct pt_window *win, struct pt_config *config)
+{
+	const struct pt_fragment *fragments;
+	size_t nfragments, fragment;
+	uint64_t *base;
+	int errcode;
+
+	if (!win || !config)
+		return -pte_internal;
+
+	memset(win, 0, sizeof(*win));
+
+	fragments = config->fragments;
+	nfragments = config->nfragments;
+	if (!nfragments) {
+		win->single.begin = config->begin;
+		win->single.end = config->end;
+
+		fragments = &win->single;
+		nfragments = 1;
+
+		base = win->single_base;
+	} else {
+		if (!fragments)
+			return -pte_internal;
+
+		win->fragments = fragments;
+
+		base = malloc((nfragments + 1) * sizeof(*base));
+		if (!base)
+			return -pte_nomem;
+
+		win->base = base;
+	}
+
+	win->nfragments = nfragments;
+
+	base[0] = 0ull;
+	for (fragment = 0; fragment < nfragments; ++fragment) {
+		const struct pt_fragment *frag;
+
+		frag = &fragments[fragment];
+		if (!frag->begin || !frag->end || (frag->end < frag->begin)) {
+			pt_win_fini(win);
+			return -pte_internal;
+		}
+
+		base[fragment + 1] = base[fragment] +
+			(uint64_t) (frag->end - frag->begin);
+	}
+
+	/* We search for PSBs inside a single fragment. */
+	win->config = *config;
+	win->config.fragments = NULL;
+	win->config.nfragments = 0;
+
+	if (win->fragments) {
+		errcode = pt_win_init_cuts(win);
+		if (errcode < 0) {
+			pt_win_fini(win);
+			return errcode;
+		}
+	}
+
+	return pt_win_init_load(win, config);
+}
+
+int pt_win_init_shared(struct pt_window *win, struct pt_config *config,
+		       const struct pt_window *other)
+{
+	if (!win || !config || !other)
+		return -pte_internal;
+
+	/* There is nothing to share for a different or a non-fragmented
+	 * trace.
+	 */
+	if (!other->fragments || (config->fragments != other->fragments) ||
+	    (config->nfragments != other->nfragments))
+		return pt_win_init(win, config);
+
+	memset(win, 0, sizeof(*win));
+
+	win->fragments = other->fragments;
+	win->nfragments = other->nfragments;
+	win->base = other->base;
+	win->cut = other->cut;
+	win->shared = 1;
+
+	win->config = *config;
+	win->config.fragments = NULL;
+	win->config.nfragments = 0;
+
+	return pt_win_init_load(win, config);
+}
+
+void pt_win_fini(struct pt_window *win)
+{
+	if (!win)
+		return;
+
+	if (!win->shared) {
+		free(win->base);
+		free(win->cut);
+	}
+
+	free(win->buffer);
+
+	win->base = NULL;
+	win->cut = NULL;
+	win->shared = 0;
+	win->nfragments = 0;
+	win->buffer = NULL;
+	win->capacity = 0;
+}
+
+/* Find the fragment containing @offset.
+ *
+ * Empty fragments never contain an offset.  For the trace size, this returns
+ * the last fragment.
+ */
+static size_t pt_win_fragment(const struct pt_window *win, uint64_t offset)
+{
+	const uint64_t *base;
+	size_t lo, hi;
+
+	base = pt_win_bases(win);
+
+	/* Find the last fragment beginning at or before @offset. */
+	lo = 0;
+	hi = win->nfragments;
+	while (lo < hi) {
+		size_t mid;
+
+		mid = lo + ((hi - lo) / 2);
+		if (base[mid] <= offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo ? lo - 1 : 0;
+}
+
+/* Copy the trace from @begin to @end into @win's buffer. */
+static int pt_win_copy(struct pt_window *win, uint64_t begin, uint64_t end)
+{
+	const struct pt_fragment *fragments;
+	const uint64_t *base;
+	uint64_t size, offset;
+	size_t fragment;
+
+	size = end - begin;
+	if (SIZE_MAX < size)
+		return -pte_nomem;
+
+	/* We may have copied this window already. */
+	if (win->buffer && (win->begin == win->buffer) &&
+	    (win->offset == begin) &&
+	    ((uint64_t) (win->end - win->begin) == size))
+		return 0;
+
+	if (win->capacity < size) {
+		uint8_t *buffer;
+
+		buffer = realloc(win->buffer, (size_t) size);
+		if (!buffer)
+			return -pte_nomem;
+
+		win->buffer = buffer;
+		win->capacity = (size_t) size;
+	}
+
+	fragments = pt_win_fragments(win);
+	base = pt_win_bases(win);
+
+	offset = 0ull;
+	fragment = pt_win_fragment(win, begin);
+	for (; offset < size; ++fragment) {
+		const struct pt_fragment *frag;
+		uint64_t fbegin, fsize;
+
+		if (win->nfragments <= fragment)
+			return -pte_internal;
+
+		frag = &fragments[fragment];
+		fbegin = (begin + offset) - base[fragment];
+		fsize = (base[fragment + 1] - base[fragment]) - fbegin;
+		if ((size - offset) < fsize)
+			fsize = size - offset;
+
+		memcpy(win->buffer + offset, frag->begin + fbegin,
+		       (size_t) fsize);
+
+		offset += fsize;
+	}
+
+	win->begin = win->buffer;
+	win->end = win->buffer + size;
+	win->offset = begin;
+
+	return 0;
+}
+
+int pt_win_load(struct pt_window *win, uint64_t offset)
+{
+	const struct pt_fragment *fragments;
+	const struct pt_win_cut *cut;
+	const uint64_t *base;
+	uint64_t begin, end, size;
+	size_t fragment, last;
+
+	if (!win || !win->nfragments)
+		return -pte_internal;
+
+	fragments = pt_win_fragments(win);
+	base = pt_win_bases(win);
+
+	size = base[win->nfragments];
+	if (size < offset)
+		return -pte_eos;
+
+	if (!size) {
+		win->begin = fragments[0].begin;
+		win->end = win->begin;
+		win->offset = 0ull;
+
+		return 0;
+	}
+
+	if (offset == size)
+		offset -= 1;
+
+	/* Windows are delimited by the last PSB before and the first PSB
+	 * after each fragment boundary.
+	 *
+	 * We only need to look at the boundaries of the fragment containing
+	 * @offset.  PSBs around other boundaries are further away.
+	 */
+	begin = 0ull;
+	end = size;
+
+	fragment = pt_win_fragment(win, offset);
+	if (base[fragment]) {
+		if (!win->cut)
+			return -pte_internal;
+
+		cut = &win->cut[fragment];
+		if (begin < cut->before)
+			begin = cut->before;
+
+		if (cut->after <= offset) {
+			if (begin < cut->after)
+				begin = cut->after;
+		} else if (cut->after < end)
+			end = cut->after;
+	}
+
+	if (base[fragment + 1] < size) {
+		if (!win->cut)
+			return -pte_internal;
+
+		cut = &win->cut[fragment + 1];
+		if (cut->before <= offset) {
+			if (begin < cut->before)
+				begin = cut->before;
+		} else if (cut->before < end)
+			end = cut->before;
+
+		if (cut->after < end)
+			end = cut->after;
+	}
+
+	/* Windows inside a single fragment don't need to be copied. */
+	fragment = pt_win_fragment(win, begin);
+	last = pt_win_fragment(win, end - 1);
+	if (fragment != last)
+		return pt_win_copy(win, begin, end);
+
+	win->begin = fragments[fragment].begin + (begin - base[fragment]);
+	win->end = win->begin + (end - begin);
+	win->offset = begin;
+
+	return 0;
+}
+
+int pt_win_seek(struct pt_window *win, const uint8_t **pos, uint64_t offset)
+{
+	uint64_t size;
+
+	if (!win || !pos)
+		return -pte_internal;
+
+	size = (uint64_t) (win->end - win->begin);
+	if ((offset < win->offset) || (size < (offset - win->offset)) ||
+	    ((size == (offset - win->offset)) && pt_win_has_next(win))) {
+		int errcode;
+
+		errcode = pt_win_load(win, offset);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	*pos = win->begin + (offset - win->offset);
+	return 0;
+}
+
+int pt_win_next(struct pt_window *win)
+{
+	if (!win)
+		return -pte_internal;
+
+	if (!pt_win_has_next(win))
+		return -pte_eos;
+
+	return pt_win_load(win, win->offset +
+			   (uint64_t) (win->end - win->begin));
+}
+
+int pt_win_prev(struct pt_window *win)
+{
+	if (!win)
+		return -pte_internal;
+
+	if (!win->offset)
+		return -pte_eos;
+
+	return pt_win_load(win, win->offset - 1);
+}
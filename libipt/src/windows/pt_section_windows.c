@@ -29,6 +29,8 @@
 #include "pt_section.h"
 #include "pt_section_windows.h"
 #include "pt_section_file.h"
+#include "pt_section_memory.h"
+#include "pt_compiler.h"
 
 #include "intel-pt.h"
 
@@ -181,6 +183,8 @@ int pt_sec_windows_map(struct pt_section *section, int fd)
 	section->unmap = pt_sec_windows_unmap;
 	section->read = pt_sec_windows_read;
 	section->memsize = pt_sec_windows_memsize;
+	section->prefetch = pt_sec_windows_prefetch;
+	section->peek = pt_sec_windows_peek;
 
 	return 0;
 
@@ -245,6 +249,15 @@ int pt_section_map(struct pt_section *section)
 	if (section->mcount)
 		return pt_sec_windows_map_success(section);
 
+	/* Memory sections do not need their file. */
+	if (section->memory) {
+		errcode = pt_sec_memory_map(section);
+		if (errcode < 0)
+			goto out_unlock;
+
+		return pt_sec_windows_map_success(section);
+	}
+
 	if (section->mapping) {
 		errcode = -pte_internal;
 		goto out_unlock;
@@ -338,6 +351,8 @@ int pt_sec_windows_unmap(struct pt_section *section)
 	section->unmap = NULL;
 	section->read = NULL;
 	section->memsize = NULL;
+	section->prefetch = NULL;
+	section->peek = NULL;
 
 	UnmapViewOfFile(mapping->begin);
 	CloseHandle(mapping->mh);
@@ -395,3 +410,36 @@ int pt_sec_windows_memsize(const struct pt_section *section, uint64_t *size)
 
 	return 0;
 }
+
+void pt_sec_windows_prefetch(const struct pt_section *section, uint64_t offset)
+{
+	const struct pt_sec_windows_mapping *mapping;
+
+	if (!section)
+		return;
+
+	mapping = section->mapping;
+	if (!mapping)
+		return;
+
+	pt_prefetch(mapping->begin + offset);
+}
+
+int pt_sec_windows_peek(const struct pt_section *section, const uint8_t **pbegin,
+			uint16_t size, uint64_t offset)
+{
+	const struct pt_sec_windows_mapping *mapping;
+
+	if (!section || !pbegin)
+		return -pte_internal;
+
+	mapping = section->mapping;
+	if (!mapping)
+		return -pte_internal;
+
+	/* We already checked in pt_section_peek() that the requested memory
+	 * lies within the section's boundaries.
+	 */
+	*pbegin = mapping->begin + offset;
+	return (int) size;
+}
@@ -0,0 +1,1215 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+#include "ptunit_mkfile.h"
+
+#include "intel-pt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+enum {
+	/* The load address of the test code. */
+	bfix_base	= 0x1000,
+
+	/* The maximal number of blocks we decode. */
+	bfix_nblocks	= 64
+};
+
+/* The test code.
+ *
+ * It is a loop with two indirect jumps and a conditional branch, each of which
+ * ends a block.
+ */
+static const uint8_t bfix_code[] = {
+	/* 0x1000: nop */
+	0x90,
+	/* 0x1001: nop */
+	0x90,
+	/* 0x1002: jmp *%rax */
+	0xff, 0xe0,
+	/* 0x1004: nop */
+	0x90,
+	/* 0x1005: je 0x1008 */
+	0x74, 0x01,
+	/* 0x1007: nop */
+	0x90,
+	/* 0x1008: jmp *%rax */
+	0xff, 0xe0
+};
+
+/* A test fixture providing trace for the above code. */
+struct block_fixture {
+	/* The trace buffer. */
+	uint8_t buffer[1024];
+
+	/* The configuration for decoding the trace in @buffer. */
+	struct pt_config config;
+
+	/* The encoder for writing the trace into @buffer. */
+	struct pt_encoder *encoder;
+
+	/* The image containing the test code. */
+	struct pt_image *image;
+
+	/* The file containing the test code. */
+	FILE *file;
+	char *name;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct block_fixture *);
+	struct ptunit_result (*fini)(struct block_fixture *);
+};
+
+static struct ptunit_result bfix_packet(struct block_fixture *bfix,
+					struct pt_packet *packet)
+{
+	int errcode;
+
+	errcode = pt_enc_next(bfix->encoder, packet);
+	ptu_int_gt(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result bfix_ip(struct block_fixture *bfix,
+				    enum pt_packet_type type, uint64_t ip)
+{
+	struct pt_packet packet;
+
+	memset(&packet, 0, sizeof(packet));
+	packet.type = type;
+	packet.payload.ip.ipc = pt_ipc_sext_48;
+	packet.payload.ip.ip = ip;
+
+	if (type == ppt_tip_pgd)
+		packet.payload.ip.ipc = pt_ipc_suppressed;
+
+	return bfix_packet(bfix, &packet);
+}
+
+static struct ptunit_result bfix_tnt(struct block_fixture *bfix, int taken)
+{
+	struct pt_packet packet;
+
+	memset(&packet, 0, sizeof(packet));
+	packet.type = ppt_tnt_8;
+	packet.payload.tnt.bit_size = 1;
+	packet.payload.tnt.payload = taken ? 1ull : 0ull;
+
+	return bfix_packet(bfix, &packet);
+}
+
+static struct ptunit_result bfix_tsc(struct block_fixture *bfix, uint64_t tsc)
+{
+	struct pt_packet packet;
+
+	memset(&packet, 0, sizeof(packet));
+	packet.type = ppt_tsc;
+	packet.payload.tsc.tsc = tsc;
+
+	return bfix_packet(bfix, &packet);
+}
+
+static struct ptunit_result bfix_type(struct block_fixture *bfix,
+				      enum pt_packet_type type)
+{
+	struct pt_packet packet;
+
+	memset(&packet, 0, sizeof(packet));
+	packet.type = type;
+
+	return bfix_packet(bfix, &packet);
+}
+
+/* Encode @npad PAD packets. */
+static struct ptunit_result bfix_pad(struct block_fixture *bfix, int npad)
+{
+	for (; npad > 0; --npad)
+		ptu_test(bfix_type, bfix, ppt_pad);
+
+	return ptu_passed();
+}
+
+/* Encode a PSB+ header starting at the beginning of the test code. */
+static struct ptunit_result bfix_psb(struct block_fixture *bfix, uint64_t tsc)
+{
+	struct pt_packet packet;
+
+	ptu_test(bfix_type, bfix, ppt_psb);
+
+	if (tsc)
+		ptu_test(bfix_tsc, bfix, tsc);
+
+	memset(&packet, 0, sizeof(packet));
+	packet.type = ppt_mode;
+	packet.payload.mode.leaf = pt_mol_exec;
+	packet.payload.mode.bits.exec = pt_set_exec_mode(ptem_64bit);
+
+	ptu_test(bfix_packet, bfix, &packet);
+	ptu_test(bfix_ip, bfix, ppt_fup, bfix_base);
+	ptu_test(bfix_type, bfix, ppt_psbend);
+
+	return ptu_passed();
+}
+
+/* Encode @niter iterations of the test code loop.
+ *
+ * The conditional branch is taken in odd iterations.
+ */
+static struct ptunit_result bfix_loop(struct block_fixture *bfix, int niter)
+{
+	int iter;
+
+	for (iter = 0; iter < niter; ++iter) {
+		ptu_test(bfix_ip, bfix, ppt_tip, bfix_base + 0x4);
+		ptu_test(bfix_tnt, bfix, iter & 1);
+		ptu_test(bfix_ip, bfix, ppt_tip, bfix_base);
+	}
+
+	return ptu_passed();
+}
+
+/* Disable tracing at the first indirect jump of the test code. */
+static struct ptunit_result bfix_end(struct block_fixture *bfix)
+{
+	return bfix_ip(bfix, ppt_tip_pgd, 0ull);
+}
+
+/* Allocate a block decoder using @flags for the trace encoded so far.
+ *
+ * The decoder is not synchronized.
+ */
+static struct pt_block_decoder *
+bfix_alloc_decoder(struct block_fixture *bfix,
+		   const struct pt_conf_flags *flags)
+{
+	struct pt_block_decoder *decoder;
+	struct pt_config config;
+	uint64_t size;
+	int errcode;
+
+	errcode = pt_enc_get_offset(bfix->encoder, &size);
+	if (errcode < 0)
+		return NULL;
+
+	config = bfix->config;
+	config.end = config.begin + size;
+	if (flags)
+		config.flags = *flags;
+
+	decoder = pt_blk_alloc_decoder(&config);
+	if (!decoder)
+		return NULL;
+
+	errcode = pt_blk_set_image(decoder, bfix->image);
+	if (errcode < 0) {
+		pt_blk_free_decoder(decoder);
+		return NULL;
+	}
+
+	return decoder;
+}
+
+/* Find the first split point at or after @offset.
+ *
+ * Provides the split point's offset in @split and the offset of its PSB
+ * segment in @psb.
+ */
+static struct ptunit_result bfix_find_split(struct block_fixture *bfix,
+					    uint64_t *split, uint64_t *psb,
+					    uint64_t offset)
+{
+	struct pt_packet_decoder *decoder;
+	struct pt_config config;
+	uint64_t size;
+	int status;
+
+	status = pt_enc_get_offset(bfix->encoder, &size);
+	ptu_int_eq(status, 0);
+
+	config = bfix->config;
+	config.end = config.begin + size;
+
+	decoder = pt_pkt_alloc_decoder(&config);
+	ptu_ptr(decoder);
+
+	status = pt_pkt_sync_forward(decoder);
+	ptu_int_eq(status, 0);
+
+	status = pt_pkt_find_split(decoder, split, offset);
+	ptu_int_gt(status, 0);
+
+	status = pt_pkt_get_sync_offset(decoder, psb);
+	ptu_int_eq(status, 0);
+
+	pt_pkt_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+/* Drain pending events. */
+static int bfix_drain_events(struct pt_block_decoder *decoder, int status)
+{
+	while (status & pts_event_pending) {
+		struct pt_event event;
+
+		status = pt_blk_event(decoder, &event, sizeof(event));
+		if (status < 0)
+			return status;
+	}
+
+	return status;
+}
+
+/* Decode non-empty blocks into @blocks until we reach the end of the trace or
+ * the decode budget is exhausted.
+ *
+ * Provides the number of blocks in @nblocks.
+ *
+ * Returns -pte_eos at the end of the trace, a pt_status_flag bit-vector
+ * containing pts_budget if the budget is exhausted, and a negative error code
+ * otherwise.
+ */
+static int bfix_decode(struct pt_block_decoder *decoder,
+		       struct pt_block *blocks, int *nblocks)
+{
+	int status;
+
+	for (;;) {
+		struct pt_block block;
+
+		status = pt_blk_next(decoder, &block, sizeof(block));
+		if (status < 0)
+			break;
+
+		if (block.ninsn) {
+			if (bfix_nblocks <= *nblocks)
+				return -pte_nomem;
+
+			blocks[(*nblocks)++] = block;
+		}
+
+		status = bfix_drain_events(decoder, status);
+		if (status < 0)
+			break;
+
+		if (status & pts_budget)
+			break;
+	}
+
+	return status;
+}
+
+/* Provide the IP of the instruction following the one at @ip in the test code.
+ *
+ * Returns zero if @ip does not point to an instruction in the test code.
+ */
+static uint64_t bfix_next_ip(uint64_t ip)
+{
+	switch (ip - bfix_base) {
+	case 0x0:
+	case 0x1:
+	case 0x4:
+	case 0x7:
+		return ip + 1;
+
+	case 0x2:
+	case 0x5:
+	case 0x8:
+		return ip + 2;
+	}
+
+	return 0ull;
+}
+
+/* Provide the instruction trace of @niter iterations of bfix_loop() followed
+ * by the instructions disabled by bfix_end() in @ips.
+ *
+ * Returns the number of instructions.
+ */
+static int bfix_expect(uint64_t *ips, int niter)
+{
+	int iter, ninsn;
+
+	ninsn = 0;
+	for (iter = 0; iter < niter; ++iter) {
+		ips[ninsn++] = bfix_base;
+		ips[ninsn++] = bfix_base + 0x1;
+		ips[ninsn++] = bfix_base + 0x2;
+		ips[ninsn++] = bfix_base + 0x4;
+		ips[ninsn++] = bfix_base + 0x5;
+		if (!(iter & 1))
+			ips[ninsn++] = bfix_base + 0x7;
+		ips[ninsn++] = bfix_base + 0x8;
+	}
+
+	ips[ninsn++] = bfix_base;
+	ips[ninsn++] = bfix_base + 0x1;
+	ips[ninsn++] = bfix_base + 0x2;
+
+	return ninsn;
+}
+
+/* Check that @blocks contain the instruction trace of @niter iterations of
+ * bfix_loop() followed by the instructions disabled by bfix_end().
+ *
+ * The block decoder may end blocks early, e.g. while filling its block cache,
+ * so we compare instructions rather than blocks.
+ */
+static struct ptunit_result bfix_check(const struct pt_block *blocks,
+				       int nblocks, int niter)
+{
+	uint64_t ips[bfix_nblocks * 3];
+	int idx, ninsn, insn;
+
+	ninsn = bfix_expect(ips, niter);
+
+	insn = 0;
+	for (idx = 0; idx < nblocks; ++idx) {
+		const struct pt_block *block;
+		uint64_t ip;
+		uint16_t bninsn;
+
+		block = &blocks[idx];
+
+		ptu_int_eq(block->mode, ptem_64bit);
+		ptu_uint_ne(block->ninsn, 0);
+
+		ip = block->ip;
+		for (bninsn = 0; bninsn < block->ninsn; ++bninsn) {
+			ptu_int_lt(insn, ninsn);
+			ptu_uint_eq(ip, ips[insn]);
+
+			if (bninsn + 1 < block->ninsn) {
+				ip = bfix_next_ip(ip);
+				ptu_uint_ne(ip, 0ull);
+			}
+
+			insn += 1;
+		}
+
+		ptu_uint_eq(block->end_ip, ip);
+	}
+
+	ptu_int_eq(insn, ninsn);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result timing(struct block_fixture *bfix)
+{
+	struct pt_block_decoder *decoder;
+	struct pt_block blocks[bfix_nblocks];
+	struct pt_conf_flags flags;
+	int status, nblocks;
+
+	ptu_test(bfix_psb, bfix, 0x1000ull);
+	ptu_test(bfix_tsc, bfix, 0x2000ull);
+	ptu_test(bfix_ip, bfix, ppt_tip, bfix_base + 0x4);
+	ptu_test(bfix_tsc, bfix, 0x3000ull);
+	ptu_test(bfix_tnt, bfix, 0);
+	ptu_test(bfix_ip, bfix, ppt_tip, bfix_base);
+	ptu_test(bfix_end, bfix);
+
+	memset(&flags, 0, sizeof(flags));
+	flags.variant.block.enable_block_timing = 1;
+
+	decoder = bfix_alloc_decoder(bfix, &flags);
+	ptu_ptr(decoder);
+
+	status = pt_blk_sync_forward(decoder);
+	ptu_int_ge(status, 0);
+
+	nblocks = 0;
+	status = bfix_decode(decoder, blocks, &nblocks);
+	ptu_int_eq(status, -pte_eos);
+	ptu_test(bfix_check, blocks, nblocks, 1);
+
+	/* Each block spans the time between the queries at its ends. */
+	ptu_uint_eq(blocks[0].has_tsc, 1);
+	ptu_uint_eq(blocks[0].tsc_begin, 0x1000ull);
+	ptu_uint_eq(blocks[0].tsc_end, 0x2000ull);
+
+	ptu_uint_eq(blocks[1].has_tsc, 1);
+	ptu_uint_eq(blocks[1].tsc_begin, 0x2000ull);
+	ptu_uint_eq(blocks[1].tsc_end, 0x3000ull);
+
+	ptu_uint_eq(blocks[2].has_tsc, 1);
+	ptu_uint_eq(blocks[2].tsc_begin, 0x3000ull);
+	ptu_uint_eq(blocks[2].tsc_end, 0x3000ull);
+
+	ptu_uint_eq(blocks[3].has_tsc, 1);
+	ptu_uint_eq(blocks[3].tsc_begin, 0x3000ull);
+	ptu_uint_eq(blocks[3].tsc_end, 0x3000ull);
+
+	pt_blk_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result timing_disabled(struct block_fixture *bfix)
+{
+	struct pt_block_decoder *decoder;
+	struct pt_block blocks[bfix_nblocks];
+	int status, nblocks, idx;
+
+	ptu_test(bfix_psb, bfix, 0x1000ull);
+	ptu_test(bfix_tsc, bfix, 0x2000ull);
+	ptu_test(bfix_loop, bfix, 1);
+	ptu_test(bfix_end, bfix);
+
+	decoder = bfix_alloc_decoder(bfix, NULL);
+	ptu_ptr(decoder);
+
+	status = pt_blk_sync_forward(decoder);
+	ptu_int_ge(status, 0);
+
+	nblocks = 0;
+	status = bfix_decode(decoder, blocks, &nblocks);
+	ptu_int_eq(status, -pte_eos);
+	ptu_test(bfix_check, blocks, nblocks, 1);
+
+	for (idx = 0; idx < nblocks; ++idx) {
+		ptu_uint_eq(blocks[idx].has_tsc, 0);
+		ptu_uint_eq(blocks[idx].tsc_begin, 0ull);
+		ptu_uint_eq(blocks[idx].tsc_end, 0ull);
+	}
+
+	pt_blk_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result budget_insn(struct block_fixture *bfix)
+{
+	struct pt_block_decoder *decoder;
+	struct pt_block blocks[bfix_nblocks], block;
+	int status, nblocks;
+
+	ptu_test(bfix_psb, bfix, 0ull);
+	ptu_test(bfix_loop, bfix, 2);
+	ptu_test(bfix_end, bfix);
+
+	decoder = bfix_alloc_decoder(bfix, NULL);
+	ptu_ptr(decoder);
+
+	status = pt_blk_sync_forward(decoder);
+	ptu_int_ge(status, 0);
+
+	status = pt_blk_set_budget(decoder, 2ull, 0ull);
+	ptu_int_eq(status, 0);
+
+	/* The first block is ended early to not exceed the budget. */
+	nblocks = 0;
+	status = bfix_decode(decoder, blocks, &nblocks);
+	ptu_int_ge(status, 0);
+	ptu_int_eq(status & pts_budget, pts_budget);
+	ptu_int_eq(nblocks, 1);
+	ptu_uint_eq(blocks[0].ip, bfix_base);
+	ptu_uint_eq(blocks[0].end_ip, bfix_base + 0x1);
+	ptu_uint_eq(blocks[0].ninsn, 2);
+
+	/* We don't proceed until we get a new budget. */
+	status = pt_blk_next(decoder, &block, sizeof(block));
+	ptu_int_ge(status, 0);
+	ptu_int_eq(status & pts_budget, pts_budget);
+	ptu_uint_eq(block.ip, bfix_base + 0x2);
+	ptu_uint_eq(block.ninsn, 0);
+
+	status = pt_blk_set_budget(decoder, 0ull, 0ull);
+	ptu_int_eq(status, 0);
+
+	/* We continue where we stopped. */
+	status = bfix_decode(decoder, blocks, &nblocks);
+	ptu_int_eq(status, -pte_eos);
+	ptu_int_ge(nblocks, 2);
+	ptu_uint_eq(blocks[1].ip, bfix_base + 0x2);
+	ptu_uint_eq(blocks[1].end_ip, bfix_base + 0x2);
+	ptu_uint_eq(blocks[1].ninsn, 1);
+
+	ptu_test(bfix_check, blocks, nblocks, 2);
+
+	pt_blk_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result budget_insn_exact(struct block_fixture *bfix)
+{
+	struct pt_block_decoder *decoder;
+	struct pt_block blocks[bfix_nblocks];
+	int status, nblocks, nstops, idx;
+
+	ptu_test(bfix_psb, bfix, 0ull);
+	ptu_test(bfix_loop, bfix, 2);
+	ptu_test(bfix_end, bfix);
+
+	decoder = bfix_alloc_decoder(bfix, NULL);
+	ptu_ptr(decoder);
+
+	status = pt_blk_sync_forward(decoder);
+	ptu_int_ge(status, 0);
+
+	/* Each budget yields exactly one instruction. */
+	nblocks = 0;
+	for (nstops = 0; nstops < bfix_nblocks; ++nstops) {
+		int ndecoded;
+
+		status = pt_blk_set_budget(decoder, 1ull, 0ull);
+		ptu_int_eq(status, 0);
+
+		ndecoded = nblocks;
+		status = bfix_decode(decoder, blocks, &nblocks);
+		if (status < 0)
+			break;
+
+		ptu_int_eq(status & pts_budget, pts_budget);
+		ptu_int_eq(nblocks, ndecoded + 1);
+	}
+
+	ptu_int_eq(status, -pte_eos);
+
+	/* Two iterations take 7 and 6 instructions, respectively, plus 3 for
+	 * the final block.
+	 */
+	ptu_int_eq(nblocks, 16);
+
+	for (idx = 0; idx < nblocks; ++idx) {
+		ptu_uint_eq(blocks[idx].ninsn, 1);
+		ptu_uint_eq(blocks[idx].ip, blocks[idx].end_ip);
+	}
+
+	pt_blk_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result budget_bytes(struct block_fixture *bfix)
+{
+	struct pt_block_decoder *decoder;
+	struct pt_block blocks[bfix_nblocks];
+	int status, nblocks, nstops;
+
+	ptu_test(bfix_psb, bfix, 0ull);
+	ptu_test(bfix_loop, bfix, 2);
+	ptu_test(bfix_end, bfix);
+
+	decoder = bfix_alloc_decoder(bfix, NULL);
+	ptu_ptr(decoder);
+
+	status = pt_blk_sync_forward(decoder);
+	ptu_int_ge(status, 0);
+
+	/* The byte budget is checked after each block so blocks aren't split.
+	 *
+	 * We need to stop more than once to make this test meaningful.
+	 */
+	nblocks = 0;
+	for (nstops = 0; nstops < bfix_nblocks; ++nstops) {
+		status = pt_blk_set_budget(decoder, 0ull, 1ull);
+		ptu_int_eq(status, 0);
+
+		status = bfix_decode(decoder, blocks, &nblocks);
+		if (status < 0)
+			break;
+
+		ptu_int_eq(status & pts_budget, pts_budget);
+	}
+
+	ptu_int_eq(status, -pte_eos);
+	ptu_int_gt(nstops, 1);
+	ptu_test(bfix_check, blocks, nblocks, 2);
+
+	pt_blk_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result budget_nosync(struct block_fixture *bfix)
+{
+	struct pt_block_decoder *decoder;
+	int status;
+
+	ptu_test(bfix_psb, bfix, 0ull);
+	ptu_test(bfix_end, bfix);
+
+	decoder = bfix_alloc_decoder(bfix, NULL);
+	ptu_ptr(decoder);
+
+	status = pt_blk_set_budget(decoder, 0ull, 1ull);
+	ptu_int_eq(status, -pte_nosync);
+
+	status = pt_blk_set_budget(decoder, 1ull, 0ull);
+	ptu_int_eq(status, 0);
+
+	pt_blk_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result budget_null(void)
+{
+	int status;
+
+	status = pt_blk_set_budget(NULL, 0ull, 0ull);
+	ptu_int_eq(status, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result split(struct block_fixture *bfix)
+{
+	struct pt_block_decoder *decoder, *spec;
+	struct pt_block blocks[bfix_nblocks];
+	uint64_t offset, split, psb;
+	int status, nblocks;
+
+	ptu_test(bfix_psb, bfix, 0ull);
+	ptu_test(bfix_loop, bfix, 2);
+
+	status = pt_enc_get_offset(bfix->encoder, &offset);
+	ptu_int_eq(status, 0);
+
+	ptu_test(bfix_loop, bfix, 2);
+	ptu_test(bfix_end, bfix);
+
+	/* The split point is the TIP to 0x1004 in the third iteration. */
+	ptu_test(bfix_find_split, bfix, &split, &psb, offset);
+	ptu_uint_eq(split, offset);
+	ptu_uint_eq(psb, 0ull);
+
+	decoder = bfix_alloc_decoder(bfix, NULL);
+	ptu_ptr(decoder);
+
+	spec = bfix_alloc_decoder(bfix, NULL);
+	ptu_ptr(spec);
+
+	status = pt_blk_set_split(decoder, split);
+	ptu_int_eq(status, 0);
+
+	status = pt_blk_sync_forward(decoder);
+	ptu_int_ge(status, 0);
+
+	/* The decoder stops at the branch whose destination is given by the
+	 * split point.
+	 */
+	nblocks = 0;
+	status = bfix_decode(decoder, blocks, &nblocks);
+	ptu_int_ge(status, 0);
+	ptu_int_eq(status & pts_budget, pts_budget);
+	ptu_int_ge(nblocks, 1);
+	ptu_uint_eq(blocks[nblocks - 1].end_ip, bfix_base + 0x2);
+
+	/* The speculative decoder continues from there. */
+	status = pt_blk_sync_split(spec, split, psb, ptem_64bit);
+	ptu_int_ge(status, 0);
+
+	status = pt_blk_patch_split(spec, decoder);
+	ptu_int_eq(status, 0);
+
+	status = bfix_decode(spec, blocks, &nblocks);
+	ptu_int_eq(status, -pte_eos);
+
+	ptu_test(bfix_check, blocks, nblocks, 4);
+
+	pt_blk_free_decoder(spec);
+	pt_blk_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result split_bad_mode(struct block_fixture *bfix)
+{
+	struct pt_block_decoder *decoder, *spec;
+	struct pt_block blocks[bfix_nblocks];
+	uint64_t offset, split, psb;
+	int status, nblocks;
+
+	ptu_test(bfix_psb, bfix, 0ull);
+	ptu_test(bfix_loop, bfix, 1);
+
+	status = pt_enc_get_offset(bfix->encoder, &offset);
+	ptu_int_eq(status, 0);
+
+	ptu_test(bfix_loop, bfix, 1);
+	ptu_test(bfix_end, bfix);
+
+	ptu_test(bfix_find_split, bfix, &split, &psb, offset);
+
+	decoder = bfix_alloc_decoder(bfix, NULL);
+	ptu_ptr(decoder);
+
+	spec = bfix_alloc_decoder(bfix, NULL);
+	ptu_ptr(spec);
+
+	status = pt_blk_set_split(decoder, split);
+	ptu_int_eq(status, 0);
+
+	status = pt_blk_sync_forward(decoder);
+	ptu_int_ge(status, 0);
+
+	status = pt_blk_sync_split(spec, split, psb, ptem_32bit);
+	ptu_int_ge(status, 0);
+
+	/* We can't validate the speculation before reaching the split point. */
+	status = pt_blk_patch_split(spec, decoder);
+	ptu_int_eq(status, -pte_nosync);
+
+	nblocks = 0;
+	status = bfix_decode(decoder, blocks, &nblocks);
+	ptu_int_ge(status, 0);
+	ptu_int_eq(status & pts_budget, pts_budget);
+
+	/* The speculative decoder guessed the wrong execution mode. */
+	status = pt_blk_patch_split(spec, decoder);
+	ptu_int_eq(status, -pte_bad_context);
+
+	pt_blk_free_decoder(spec);
+	pt_blk_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result prefetch(struct block_fixture *bfix)
+{
+	struct pt_block_decoder *decoder;
+	struct pt_block blocks[bfix_nblocks];
+	struct pt_conf_flags flags;
+	int status, nblocks;
+
+	/* Make the trace exceed the prefetch window. */
+	ptu_test(bfix_psb, bfix, 0ull);
+	ptu_test(bfix_loop, bfix, 8);
+	ptu_test(bfix_end, bfix);
+
+	memset(&flags, 0, sizeof(flags));
+	flags.variant.block.enable_prefetch = 1;
+
+	decoder = bfix_alloc_decoder(bfix, &flags);
+	ptu_ptr(decoder);
+
+	status = pt_blk_sync_forward(decoder);
+	ptu_int_ge(status, 0);
+
+	/* Prefetching must not change the decode. */
+	nblocks = 0;
+	status = bfix_decode(decoder, blocks, &nblocks);
+	ptu_int_eq(status, -pte_eos);
+	ptu_test(bfix_check, blocks, nblocks, 8);
+
+	pt_blk_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result prefetch_split(struct block_fixture *bfix)
+{
+	struct pt_block_decoder *decoder, *spec;
+	struct pt_block blocks[bfix_nblocks];
+	struct pt_conf_flags flags;
+	uint64_t offset, split, psb;
+	int status, nblocks;
+
+	ptu_test(bfix_psb, bfix, 0ull);
+	ptu_test(bfix_loop, bfix, 4);
+
+	status = pt_enc_get_offset(bfix->encoder, &offset);
+	ptu_int_eq(status, 0);
+
+	ptu_test(bfix_loop, bfix, 4);
+	ptu_test(bfix_end, bfix);
+
+	ptu_test(bfix_find_split, bfix, &split, &psb, offset);
+
+	memset(&flags, 0, sizeof(flags));
+	flags.variant.block.enable_prefetch = 1;
+
+	decoder = bfix_alloc_decoder(bfix, &flags);
+	ptu_ptr(decoder);
+
+	spec = bfix_alloc_decoder(bfix, &flags);
+	ptu_ptr(spec);
+
+	status = pt_blk_set_split(decoder, split);
+	ptu_int_eq(status, 0);
+
+	status = pt_blk_sync_forward(decoder);
+	ptu_int_ge(status, 0);
+
+	nblocks = 0;
+	status = bfix_decode(decoder, blocks, &nblocks);
+	ptu_int_ge(status, 0);
+	ptu_int_eq(status & pts_budget, pts_budget);
+
+	/* The lookahead follows the speculative decoder to the split point. */
+	status = pt_blk_sync_split(spec, split, psb, ptem_64bit);
+	ptu_int_ge(status, 0);
+
+	status = pt_blk_patch_split(spec, decoder);
+	ptu_int_eq(status, 0);
+
+	status = bfix_decode(spec, blocks, &nblocks);
+	ptu_int_eq(status, -pte_eos);
+
+	ptu_test(bfix_check, blocks, nblocks, 8);
+
+	pt_blk_free_decoder(spec);
+	pt_blk_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+/* Encode two iterations of bfix_loop() with runs of PAD packets of various
+ * lengths in between.
+ */
+static struct ptunit_result bfix_pad_loop(struct block_fixture *bfix)
+{
+	ptu_test(bfix_psb, bfix, 0ull);
+	ptu_test(bfix_pad, bfix, 200);
+	ptu_test(bfix_ip, bfix, ppt_tip, bfix_base + 0x4);
+	ptu_test(bfix_pad, bfix, 1);
+	ptu_test(bfix_tnt, bfix, 0);
+	ptu_test(bfix_pad, bfix, 7);
+	ptu_test(bfix_ip, bfix, ppt_tip, bfix_base);
+	ptu_test(bfix_pad, bfix, 33);
+	ptu_test(bfix_ip, bfix, ppt_tip, bfix_base + 0x4);
+	ptu_test(bfix_tnt, bfix, 1);
+	ptu_test(bfix_pad, bfix, 64);
+	ptu_test(bfix_ip, bfix, ppt_tip, bfix_base);
+	ptu_test(bfix_end, bfix);
+	ptu_test(bfix_pad, bfix, 100);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pad(struct block_fixture *bfix)
+{
+	struct pt_block_decoder *decoder;
+	struct pt_block blocks[bfix_nblocks];
+	int status, nblocks;
+
+	ptu_test(bfix_pad_loop, bfix);
+
+	decoder = bfix_alloc_decoder(bfix, NULL);
+	ptu_ptr(decoder);
+
+	status = pt_blk_sync_forward(decoder);
+	ptu_int_ge(status, 0);
+
+	/* PAD packets must not change the decode. */
+	nblocks = 0;
+	status = bfix_decode(decoder, blocks, &nblocks);
+	ptu_int_eq(status, -pte_eos);
+	ptu_test(bfix_check, blocks, nblocks, 2);
+
+	pt_blk_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pad_prefetch(struct block_fixture *bfix)
+{
+	struct pt_block_decoder *decoder;
+	struct pt_block blocks[bfix_nblocks];
+	struct pt_conf_flags flags;
+	int status, nblocks;
+
+	ptu_test(bfix_pad_loop, bfix);
+
+	memset(&flags, 0, sizeof(flags));
+	flags.variant.block.enable_prefetch = 1;
+
+	decoder = bfix_alloc_decoder(bfix, &flags);
+	ptu_ptr(decoder);
+
+	status = pt_blk_sync_forward(decoder);
+	ptu_int_ge(status, 0);
+
+	nblocks = 0;
+	status = bfix_decode(decoder, blocks, &nblocks);
+	ptu_int_eq(status, -pte_eos);
+	ptu_test(bfix_check, blocks, nblocks, 2);
+
+	pt_blk_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result profile_null(struct block_fixture *bfix)
+{
+	struct pt_block_decoder *decoder;
+	struct pt_blk_profile profile;
+	int status;
+
+	ptu_test(bfix_psb, bfix, 0ull);
+	ptu_test(bfix_end, bfix);
+
+	decoder = bfix_alloc_decoder(bfix, NULL);
+	ptu_ptr(decoder);
+
+	status = pt_blk_get_profile(NULL, &profile, sizeof(profile));
+	ptu_int_eq(status, -pte_invalid);
+
+	status = pt_blk_get_profile(decoder, NULL, sizeof(profile));
+	ptu_int_eq(status, -pte_invalid);
+
+	pt_blk_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result profile(struct block_fixture *bfix)
+{
+	struct pt_block_decoder *decoder;
+	struct pt_blk_profile profile;
+	uint64_t nblocks, ninsn, nevents, noverflows;
+	int status;
+
+	ptu_test(bfix_psb, bfix, 0ull);
+	ptu_test(bfix_loop, bfix, 4);
+	ptu_test(bfix_type, bfix, ppt_ovf);
+	ptu_test(bfix_ip, bfix, ppt_fup, bfix_base);
+	ptu_test(bfix_loop, bfix, 2);
+	ptu_test(bfix_end, bfix);
+
+	decoder = bfix_alloc_decoder(bfix, NULL);
+	ptu_ptr(decoder);
+
+	status = pt_blk_get_profile(decoder, &profile, sizeof(profile));
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(profile.nblocks, 0ull);
+	ptu_uint_eq(profile.ninsn, 0ull);
+	ptu_uint_eq(profile.nevents, 0ull);
+	ptu_uint_eq(profile.noverflows, 0ull);
+	ptu_uint_eq(profile.bcache_misses, 0ull);
+	ptu_uint_eq(profile.msec_refills, 0ull);
+
+	nblocks = 0ull;
+	ninsn = 0ull;
+	nevents = 0ull;
+	noverflows = 0ull;
+
+	status = pt_blk_sync_forward(decoder);
+	ptu_int_ge(status, 0);
+
+	for (;;) {
+		struct pt_block block;
+
+		while (status & pts_event_pending) {
+			struct pt_event event;
+
+			status = pt_blk_event(decoder, &event, sizeof(event));
+			ptu_int_ge(status, 0);
+
+			nevents += 1;
+			if (event.type == ptev_overflow)
+				noverflows += 1;
+		}
+
+		if (status & pts_eos)
+			break;
+
+		status = pt_blk_next(decoder, &block, sizeof(block));
+		if (status < 0)
+			break;
+
+		if (block.ninsn) {
+			nblocks += 1;
+			ninsn += block.ninsn;
+		}
+	}
+
+	if (status < 0)
+		ptu_int_eq(status, -pte_eos);
+
+	status = pt_blk_get_profile(decoder, &profile, sizeof(profile));
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(profile.nblocks, nblocks);
+	ptu_uint_eq(profile.ninsn, ninsn);
+	ptu_uint_eq(profile.nevents, nevents);
+	ptu_uint_eq(profile.noverflows, 1ull);
+	ptu_uint_eq(noverflows, 1ull);
+
+	/* The block cache is filled in the first iteration.  The code is in a
+	 * single section, so we look it up once.
+	 */
+	ptu_uint_ne(profile.bcache_misses, 0ull);
+	ptu_uint_lt(profile.bcache_misses, profile.nblocks);
+	ptu_uint_eq(profile.msec_refills, 1ull);
+
+	pt_blk_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result profile_size(struct block_fixture *bfix)
+{
+	struct pt_block_decoder *decoder;
+	struct pt_block blocks[bfix_nblocks];
+	struct pt_blk_profile profile;
+	uint64_t buffer[(sizeof(profile) / sizeof(uint64_t)) + 2];
+	int status, nblocks;
+	size_t idx;
+
+	ptu_test(bfix_psb, bfix, 0ull);
+	ptu_test(bfix_loop, bfix, 2);
+	ptu_test(bfix_end, bfix);
+
+	decoder = bfix_alloc_decoder(bfix, NULL);
+	ptu_ptr(decoder);
+
+	status = pt_blk_sync_forward(decoder);
+	ptu_int_ge(status, 0);
+
+	nblocks = 0;
+	status = bfix_decode(decoder, blocks, &nblocks);
+	ptu_int_eq(status, -pte_eos);
+
+	status = pt_blk_get_profile(decoder, &profile, sizeof(profile));
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(profile.nblocks, (uint64_t) nblocks);
+
+	/* A smaller profile is truncated. */
+	memset(buffer, 0xcd, sizeof(buffer));
+
+	status = pt_blk_get_profile(decoder, (struct pt_blk_profile *) buffer,
+				    sizeof(uint64_t));
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(buffer[0], profile.nblocks);
+	ptu_uint_eq(buffer[1], 0xcdcdcdcdcdcdcdcdull);
+
+	/* A bigger profile is zero-extended. */
+	memset(buffer, 0xcd, sizeof(buffer));
+
+	status = pt_blk_get_profile(decoder, (struct pt_blk_profile *) buffer,
+				    sizeof(buffer));
+	ptu_int_eq(status, 0);
+	ptu_int_eq(memcmp(buffer, &profile, sizeof(profile)), 0);
+
+	for (idx = sizeof(profile) / sizeof(uint64_t);
+	     idx < sizeof(buffer) / sizeof(uint64_t); ++idx)
+		ptu_uint_eq(buffer[idx], 0ull);
+
+	pt_blk_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result bfix_init(struct block_fixture *bfix)
+{
+	size_t written;
+	int errcode;
+
+	memset(bfix->buffer, 0, sizeof(bfix->buffer));
+
+	pt_config_init(&bfix->config);
+	bfix->config.begin = bfix->buffer;
+	bfix->config.end = bfix->buffer + sizeof(bfix->buffer);
+
+	bfix->encoder = pt_alloc_encoder(&bfix->config);
+	ptu_ptr(bfix->encoder);
+
+	errcode = ptunit_mkfile(&bfix->file, &bfix->name, "wb");
+	ptu_int_eq(errcode, 0);
+
+	written = fwrite(bfix_code, sizeof(bfix_code), 1, bfix->file);
+	ptu_uint_eq(written, 1);
+
+	errcode = fflush(bfix->file);
+	ptu_int_eq(errcode, 0);
+
+	bfix->image = pt_image_alloc(NULL);
+	ptu_ptr(bfix->image);
+
+	errcode = pt_image_add_file(bfix->image, bfix->name, 0ull,
+				    sizeof(bfix_code), NULL, bfix_base);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result bfix_fini(struct block_fixture *bfix)
+{
+	pt_image_free(bfix->image);
+	bfix->image = NULL;
+
+	pt_free_encoder(bfix->encoder);
+	bfix->encoder = NULL;
+
+	if (bfix->file) {
+		fclose(bfix->file);
+		bfix->file = NULL;
+
+		if (bfix->name)
+			remove(bfix->name);
+	}
+
+	free(bfix->name);
+	bfix->name = NULL;
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct block_fixture bfix;
+	struct ptunit_suite suite;
+
+	bfix.init = bfix_init;
+	bfix.fini = bfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run_f(suite, timing, bfix);
+	ptu_run_f(suite, timing_disabled, bfix);
+
+	ptu_run(suite, budget_null);
+	ptu_run_f(suite, budget_nosync, bfix);
+	ptu_run_f(suite, budget_insn, bfix);
+	ptu_run_f(suite, budget_insn_exact, bfix);
+	ptu_run_f(suite, budget_bytes, bfix);
+
+	ptu_run_f(suite, split, bfix);
+	ptu_run_f(suite, split_bad_mode, bfix);
+
+	ptu_run_f(suite, prefetch, bfix);
+	ptu_run_f(suite, prefetch_split, bfix);
+
+	ptu_run_f(suite, pad, bfix);
+	ptu_run_f(suite, pad_prefetch, bfix);
+
+	ptu_run_f(suite, profile_null, bfix);
+	ptu_run_f(suite, profile, bfix);
+	ptu_run_f(suite, profile_size, bfix);
+
+	return ptunit_report(&suite);
+}
@@ -0,0 +1,592 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_block_store.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+
+
+enum {
+	/* The number of blocks in the test store.
+	 *
+	 * This spans several chunks with a partial last chunk.
+	 */
+	bfix_nblocks	= 1000
+};
+
+/* A test fixture providing an execution trace store. */
+struct bstore_fixture {
+	/* The store. */
+	struct pt_block_store store;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct bstore_fixture *);
+	struct ptunit_result (*fini)(struct bstore_fixture *);
+};
+
+/* Provide the @idx-th test block. */
+static void bfix_block(struct pt_bstore_entry *entry, uint64_t idx)
+{
+	memset(entry, 0, sizeof(*entry));
+
+	entry->ip = 0x400000ull + ((idx * 0x1234ull) % 0x10000ull);
+	entry->end_ip = entry->ip + (idx % 7);
+	entry->tsc = 0x10000ull + (idx * 0x20ull);
+	entry->isid = 1 + (int) (idx / 300);
+	entry->ninsn = (uint16_t) (1 + (idx % 5));
+}
+
+static struct ptunit_result bfix_init(struct bstore_fixture *bfix)
+{
+	uint64_t idx;
+
+	pt_bstore_init(&bfix->store);
+
+	for (idx = 0; idx < bfix_nblocks; ++idx) {
+		struct pt_bstore_entry entry;
+		struct pt_block block;
+		int errcode;
+
+		bfix_block(&entry, idx);
+
+		memset(&block, 0, sizeof(block));
+		block.ip = entry.ip;
+		block.end_ip = entry.end_ip;
+		block.isid = entry.isid;
+		block.ninsn = entry.ninsn;
+
+		errcode = pt_bstore_add_block(&bfix->store, &block, entry.tsc);
+		ptu_int_eq(errcode, 0);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result bfix_fini(struct bstore_fixture *bfix)
+{
+	pt_bstore_fini(&bfix->store);
+
+	return ptu_passed();
+}
+
+/* Check that @query finds exactly the test blocks accepted by @match when
+ * asking for @batch blocks at a time.
+ */
+static struct ptunit_result
+bfix_check(struct bstore_fixture *bfix, const struct pt_bstore_query *query,
+	   int (*match)(const struct pt_bstore_entry *,
+			const struct pt_bstore_query *), int batch)
+{
+	struct pt_bstore_entry entries[16];
+	uint64_t pos, idx;
+	int status;
+
+	ptu_int_le(batch, 16);
+
+	pos = 0ull;
+	idx = 0ull;
+	for (;;) {
+		int entry;
+
+		status = pt_bstore_find(&bfix->store, entries, sizeof(*entries),
+					batch, query, &pos);
+		if (status < 0)
+			break;
+
+		ptu_int_gt(status, 0);
+		ptu_int_le(status, batch);
+
+		for (entry = 0; entry < status; ++entry) {
+			struct pt_bstore_entry expected;
+
+			for (;; ++idx) {
+				ptu_uint_lt(idx, bfix_nblocks);
+
+				bfix_block(&expected, idx);
+				if (match(&expected, query))
+					break;
+			}
+
+			ptu_uint_eq(entries[entry].ip, expected.ip);
+			ptu_uint_eq(entries[entry].end_ip, expected.end_ip);
+			ptu_uint_eq(entries[entry].tsc, expected.tsc);
+			ptu_int_eq(entries[entry].isid, expected.isid);
+			ptu_uint_eq(entries[entry].ninsn, expected.ninsn);
+
+			idx += 1;
+		}
+	}
+
+	ptu_int_eq(status, -pte_eos);
+
+	/* There must not be any more matching blocks. */
+	for (; idx < bfix_nblocks; ++idx) {
+		struct pt_bstore_entry expected;
+
+		bfix_block(&expected, idx);
+		ptu_int_eq(match(&expected, query), 0);
+	}
+
+	return ptu_passed();
+}
+
+static int match_all(const struct pt_bstore_entry *entry,
+		     const struct pt_bstore_query *query)
+{
+	(void) entry;
+	(void) query;
+
+	return 1;
+}
+
+static int match_query(const struct pt_bstore_entry *entry,
+		       const struct pt_bstore_query *query)
+{
+	if ((entry->end_ip < query->begin) || (query->end <= entry->ip))
+		return 0;
+
+	if ((entry->tsc < query->tsc_begin) || (query->tsc_end < entry->tsc))
+		return 0;
+
+	if (query->isid && (entry->isid != query->isid))
+		return 0;
+
+	return 1;
+}
+
+static struct ptunit_result fini_null(void)
+{
+	pt_bstore_fini(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result free_null(void)
+{
+	pt_bstore_free(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_null(struct bstore_fixture *bfix)
+{
+	struct pt_block block;
+	int errcode;
+
+	memset(&block, 0, sizeof(block));
+
+	errcode = pt_bstore_add_block(NULL, &block, 0ull);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_bstore_add_block(&bfix->store, NULL, 0ull);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result find_null(struct bstore_fixture *bfix)
+{
+	struct pt_bstore_query query;
+	struct pt_bstore_entry entry;
+	uint64_t pos;
+	int errcode;
+
+	pt_bstore_query_init(&query);
+	pos = 0ull;
+
+	errcode = pt_bstore_find(NULL, &entry, sizeof(entry), 1, &query, &pos);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_bstore_find(&bfix->store, NULL, sizeof(entry), 1, &query,
+				 &pos);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_bstore_find(&bfix->store, &entry, sizeof(entry), 1, NULL,
+				 &pos);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_bstore_find(&bfix->store, &entry, sizeof(entry), 1,
+				 &query, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result find_bad_size(struct bstore_fixture *bfix)
+{
+	struct pt_bstore_query query;
+	struct pt_bstore_entry entry;
+	uint64_t pos;
+	int errcode;
+
+	pt_bstore_query_init(&query);
+	pos = 0ull;
+
+	errcode = pt_bstore_find(&bfix->store, &entry, sizeof(entry) / 2, 1,
+				 &query, &pos);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_bstore_find(&bfix->store, &entry, sizeof(entry), -1,
+				 &query, &pos);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	query.size = sizeof(query) / 2;
+	errcode = pt_bstore_find(&bfix->store, &entry, sizeof(entry), 1,
+				 &query, &pos);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result encode(uint64_t value, int size)
+{
+	uint8_t buffer[pt_bstore_max_varint + 1];
+	uint64_t decoded;
+	int status;
+
+	memset(buffer, 0xcc, sizeof(buffer));
+
+	status = pt_bstore_encode(buffer, value);
+	ptu_int_eq(status, size);
+	ptu_uint_eq(buffer[size], 0xcc);
+
+	status = pt_bstore_decode(&decoded, buffer, buffer + size);
+	ptu_int_eq(status, size);
+	ptu_uint_eq(decoded, value);
+
+	status = pt_bstore_decode(&decoded, buffer, buffer + size - 1);
+	ptu_int_eq(status, -pte_bad_context);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result decode_overlong(void)
+{
+	uint8_t buffer[pt_bstore_max_varint + 1];
+	uint64_t decoded;
+	int status;
+
+	memset(buffer, 0xff, sizeof(buffer));
+
+	status = pt_bstore_decode(&decoded, buffer, buffer + sizeof(buffer));
+	ptu_int_eq(status, -pte_bad_context);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result empty(void)
+{
+	struct pt_block_store *store;
+	struct pt_bstore_query query;
+	struct pt_bstore_entry entry;
+	struct pt_block block;
+	uint64_t pos;
+	int errcode;
+
+	store = pt_bstore_alloc();
+	ptu_ptr(store);
+
+	memset(&block, 0, sizeof(block));
+	block.ip = 0x1000ull;
+	block.end_ip = 0x1000ull;
+
+	errcode = pt_bstore_add_block(store, &block, 0ull);
+	ptu_int_eq(errcode, 0);
+
+	pt_bstore_query_init(&query);
+	pos = 0ull;
+
+	errcode = pt_bstore_find(store, &entry, sizeof(entry), 1, &query, &pos);
+	ptu_int_eq(errcode, -pte_eos);
+	ptu_uint_eq(pos, 0ull);
+
+	pt_bstore_free(store);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result backward(void)
+{
+	struct pt_block_store *store;
+	struct pt_bstore_query query;
+	struct pt_bstore_entry entry;
+	struct pt_block block;
+	uint64_t pos;
+	int status;
+
+	store = pt_bstore_alloc();
+	ptu_ptr(store);
+
+	/* A block ending in a backward jump. */
+	memset(&block, 0, sizeof(block));
+	block.ip = 0x2000ull;
+	block.end_ip = 0x1000ull;
+	block.ninsn = 2;
+
+	status = pt_bstore_add_block(store, &block, 0ull);
+	ptu_int_eq(status, 0);
+
+	/* It is found from addresses between its end_ip and its ip. */
+	pt_bstore_query_init(&query);
+	query.begin = 0x1800ull;
+	query.end = 0x1900ull;
+	pos = 0ull;
+
+	status = pt_bstore_find(store, &entry, sizeof(entry), 1, &query, &pos);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(entry.ip, 0x2000ull);
+	ptu_uint_eq(entry.end_ip, 0x1000ull);
+	ptu_uint_eq(entry.ninsn, 2);
+
+	/* It is found from its end_ip. */
+	query.begin = 0x1000ull;
+	query.end = 0x1001ull;
+	pos = 0ull;
+
+	status = pt_bstore_find(store, &entry, sizeof(entry), 1, &query, &pos);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(entry.ip, 0x2000ull);
+
+	/* It is not found from below its end_ip. */
+	query.begin = 0x800ull;
+	query.end = 0x1000ull;
+	pos = 0ull;
+
+	status = pt_bstore_find(store, &entry, sizeof(entry), 1, &query, &pos);
+	ptu_int_eq(status, -pte_eos);
+
+	pt_bstore_free(store);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result chunks(struct bstore_fixture *bfix)
+{
+	uint32_t chunk, nblocks;
+
+	ptu_uint_eq(bfix->store.nchunks, (bfix_nblocks +
+					  pt_bstore_chunk_nblocks - 1) /
+		    pt_bstore_chunk_nblocks);
+
+	nblocks = 0;
+	for (chunk = 0; chunk < bfix->store.nchunks; ++chunk)
+		nblocks += bfix->store.chunks[chunk].nblocks;
+
+	ptu_uint_eq(nblocks, bfix_nblocks);
+
+	ptu_int_eq(bfix->store.chunks[0].isid_min, 1);
+	ptu_int_eq(bfix->store.chunks[0].isid_max, 1);
+	ptu_int_eq(bfix->store.chunks[1].isid_min, 1);
+	ptu_int_eq(bfix->store.chunks[1].isid_max, 2);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result find_all(struct bstore_fixture *bfix, int batch)
+{
+	struct pt_bstore_query query;
+
+	pt_bstore_query_init(&query);
+
+	ptu_check(bfix_check, bfix, &query, match_all, batch);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result find_none(struct bstore_fixture *bfix)
+{
+	struct pt_bstore_query query;
+	struct pt_bstore_entry entry;
+	uint64_t pos;
+	int errcode;
+
+	pt_bstore_query_init(&query);
+	query.begin = 0x1000ull;
+	query.end = 0x2000ull;
+	pos = 0ull;
+
+	errcode = pt_bstore_find(&bfix->store, &entry, sizeof(entry), 1,
+				 &query, &pos);
+	ptu_int_eq(errcode, -pte_eos);
+	ptu_uint_eq(pos, bfix_nblocks);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result find_time(struct bstore_fixture *bfix)
+{
+	struct pt_bstore_query query;
+
+	pt_bstore_query_init(&query);
+	query.tsc_begin = 0x10000ull + (300 * 0x20ull);
+	query.tsc_end = 0x10000ull + (340 * 0x20ull);
+
+	ptu_check(bfix_check, bfix, &query, match_query, 16);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result find_addr(struct bstore_fixture *bfix)
+{
+	struct pt_bstore_query query;
+
+	pt_bstore_query_init(&query);
+	query.begin = 0x404000ull;
+	query.end = 0x405000ull;
+
+	ptu_check(bfix_check, bfix, &query, match_query, 3);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result find_isid(struct bstore_fixture *bfix)
+{
+	struct pt_bstore_query query;
+
+	pt_bstore_query_init(&query);
+	query.begin = 0x404000ull;
+	query.end = 0x408000ull;
+	query.isid = 2;
+
+	ptu_check(bfix_check, bfix, &query, match_query, 5);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result find_isid_skip(struct bstore_fixture *bfix)
+{
+	struct pt_bstore_query query;
+
+	/* Blocks in the first chunk cannot be decoded anymore.  We must not
+	 * look at them when searching for another section.
+	 */
+	bfix->store.chunks[0].column[ptbc_ip].size = 0;
+
+	pt_bstore_query_init(&query);
+	query.isid = 3;
+
+	ptu_check(bfix_check, bfix, &query, match_query, 16);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result find_pos(struct bstore_fixture *bfix)
+{
+	struct pt_bstore_query query;
+	struct pt_bstore_entry entry, expected;
+	uint64_t pos;
+	int status;
+
+	pt_bstore_query_init(&query);
+	pos = 517ull;
+
+	status = pt_bstore_find(&bfix->store, &entry, sizeof(entry), 1,
+				&query, &pos);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(pos, 518ull);
+
+	bfix_block(&expected, 517ull);
+	ptu_uint_eq(entry.ip, expected.ip);
+	ptu_uint_eq(entry.tsc, expected.tsc);
+
+	pos = bfix_nblocks;
+	status = pt_bstore_find(&bfix->store, &entry, sizeof(entry), 1,
+				&query, &pos);
+	ptu_int_eq(status, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result find_size(struct bstore_fixture *bfix)
+{
+	struct pt_bstore_query query;
+	uint8_t buffer[2 * (sizeof(struct pt_bstore_entry) + 8)];
+	uint64_t pos;
+	size_t size;
+	int status;
+
+	pt_bstore_query_init(&query);
+	size = sizeof(struct pt_bstore_entry) + 8;
+	pos = 0ull;
+
+	memset(buffer, 0xcc, sizeof(buffer));
+
+	status = pt_bstore_find(&bfix->store,
+				(struct pt_bstore_entry *) buffer, size, 2,
+				&query, &pos);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[size - 1], 0);
+	ptu_uint_eq(buffer[(2 * size) - 1], 0);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct ptunit_suite suite;
+	struct bstore_fixture bfix;
+
+	bfix.init = bfix_init;
+	bfix.fini = bfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, fini_null);
+	ptu_run(suite, free_null);
+	ptu_run_f(suite, add_null, bfix);
+	ptu_run_f(suite, find_null, bfix);
+	ptu_run_f(suite, find_bad_size, bfix);
+
+	ptu_run_p(suite, encode, 0ull, 1);
+	ptu_run_p(suite, encode, 0x7full, 1);
+	ptu_run_p(suite, encode, 0x80ull, 2);
+	ptu_run_p(suite, encode, 0x3fffull, 2);
+	ptu_run_p(suite, encode, 0x4000ull, 3);
+	ptu_run_p(suite, encode, UINT64_MAX, pt_bstore_max_varint);
+	ptu_run(suite, decode_overlong);
+
+	ptu_run(suite, empty);
+	ptu_run(suite, backward);
+	ptu_run_f(suite, chunks, bfix);
+	ptu_run_fp(suite, find_all, bfix, 1);
+	ptu_run_fp(suite, find_all, bfix, 7);
+	ptu_run_fp(suite, find_all, bfix, 16);
+	ptu_run_f(suite, find_none, bfix);
+	ptu_run_f(suite, find_time, bfix);
+	ptu_run_f(suite, find_addr, bfix);
+	ptu_run_f(suite, find_isid, bfix);
+	ptu_run_f(suite, find_isid_skip, bfix);
+	ptu_run_f(suite, find_pos, bfix);
+	ptu_run_f(suite, find_size, bfix);
+
+	return ptunit_report(&suite);
+}
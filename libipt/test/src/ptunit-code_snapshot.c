@@ -0,0 +1,730 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_code_snapshot.h"
+#include "pt_section.h"
+#include "pt_section_memory.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/* A mock image section cache.
+ *
+ * It provides three entries for two sections initially.  The first two
+ * entries share a section.  Sections added via pt_iscache_add() are appended.
+ */
+struct pt_image_section_cache {
+	/* The sections indexed by isid - 1. */
+	struct pt_section *section[8];
+
+	/* The load addresses indexed by isid - 1. */
+	uint64_t laddr[8];
+
+	/* The number of entries. */
+	int nentries;
+
+	/* The number of pt_image_add_cached() calls. */
+	int nimage;
+};
+
+int pt_iscache_lookup(struct pt_image_section_cache *iscache,
+		      struct pt_section **section, uint64_t *laddr, int isid)
+{
+	if (!iscache || !section || !laddr)
+		return -pte_internal;
+
+	if ((isid <= 0) || (iscache->nentries < isid))
+		return -pte_bad_image;
+
+	*section = iscache->section[isid - 1];
+	*laddr = iscache->laddr[isid - 1];
+	(*section)->ucount += 1;
+
+	return 0;
+}
+
+int pt_iscache_add(struct pt_image_section_cache *iscache,
+		   struct pt_section *section, uint64_t laddr)
+{
+	int idx;
+
+	if (!iscache || !section)
+		return -pte_internal;
+
+	idx = iscache->nentries;
+	if (8 <= idx)
+		return -pte_nomem;
+
+	section->ucount += 1;
+
+	iscache->section[idx] = section;
+	iscache->laddr[idx] = laddr;
+	iscache->nentries += 1;
+
+	return idx + 1;
+}
+
+int pt_image_add_cached(struct pt_image *image,
+			struct pt_image_section_cache *iscache, int isid,
+			const struct pt_asid *asid)
+{
+	(void) image;
+	(void) asid;
+
+	if (!iscache)
+		return -pte_internal;
+
+	if ((isid <= 0) || (iscache->nentries < isid))
+		return -pte_bad_image;
+
+	iscache->nimage += 1;
+
+	return 0;
+}
+
+struct pt_section *pt_mk_section_memory(const char *filename, uint64_t offset,
+					uint64_t size,
+					struct pt_sec_memory *memory)
+{
+	struct pt_section *section;
+
+	section = malloc(sizeof(*section));
+	if (!section)
+		return NULL;
+
+	memset(section, 0, sizeof(*section));
+	section->filename = malloc(strlen(filename) + 1);
+	if (!section->filename) {
+		free(section);
+		return NULL;
+	}
+
+	strcpy(section->filename, filename);
+	section->offset = offset;
+	section->size = size;
+	section->memory = memory;
+	section->ucount = 1;
+
+	return section;
+}
+
+const char *pt_section_filename(const struct pt_section *section)
+{
+	if (!section)
+		return NULL;
+
+	return section->filename;
+}
+
+uint64_t pt_section_offset(const struct pt_section *section)
+{
+	if (!section)
+		return 0ull;
+
+	return section->offset;
+}
+
+uint64_t pt_section_size(const struct pt_section *section)
+{
+	if (!section)
+		return 0ull;
+
+	return section->size;
+}
+
+int pt_section_put(struct pt_section *section)
+{
+	if (!section || !section->ucount)
+		return -pte_internal;
+
+	section->ucount -= 1;
+	if (!section->ucount && section->memory) {
+		pt_sec_memory_free(section->memory);
+		free(section->filename);
+		free(section);
+	}
+
+	return 0;
+}
+
+int pt_section_map(struct pt_section *section)
+{
+	if (!section)
+		return -pte_internal;
+
+	section->mcount += 1;
+
+	return 0;
+}
+
+int pt_section_unmap(struct pt_section *section)
+{
+	if (!section || !section->mcount)
+		return -pte_internal;
+
+	section->mcount -= 1;
+
+	return 0;
+}
+
+/* The content of a file section is its file offset's low byte. */
+int pt_section_read(const struct pt_section *section, uint8_t *buffer,
+		    uint16_t size, uint64_t offset)
+{
+	uint16_t idx;
+
+	if (!section || !buffer)
+		return -pte_internal;
+
+	if (!section->mcount || (section->size < (offset + size)))
+		return -pte_nomap;
+
+	for (idx = 0; idx < size; ++idx)
+		buffer[idx] = (uint8_t) (section->offset + offset + idx);
+
+	return (int) size;
+}
+
+/* A test fixture providing a code snapshot. */
+struct snap_fixture {
+	/* The code snapshot. */
+	struct pt_code_snapshot snap;
+
+	/* The image section cache. */
+	struct pt_image_section_cache iscache;
+
+	/* The sections. */
+	struct pt_section section[2];
+
+	/* A block. */
+	struct pt_block block;
+
+	/* An instruction. */
+	struct pt_insn insn;
+
+	/* The written snapshot. */
+	uint8_t *buffer;
+	size_t size;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct snap_fixture *);
+	struct ptunit_result (*fini)(struct snap_fixture *);
+};
+
+static char sfix_file_a[] = "/bin/a";
+static char sfix_file_b[] = "/lib/b";
+
+static struct ptunit_result sfix_init(struct snap_fixture *sfix)
+{
+	int errcode;
+
+	memset(sfix->section, 0, sizeof(sfix->section));
+	sfix->section[0].filename = sfix_file_a;
+	sfix->section[0].offset = 0x1000ull;
+	sfix->section[0].size = 0x3000ull;
+	sfix->section[0].ucount = 1;
+	sfix->section[1].filename = sfix_file_b;
+	sfix->section[1].offset = 0x800ull;
+	sfix->section[1].size = 0x1800ull;
+	sfix->section[1].ucount = 1;
+
+	memset(&sfix->iscache, 0, sizeof(sfix->iscache));
+	sfix->iscache.section[0] = &sfix->section[0];
+	sfix->iscache.laddr[0] = 0x400000ull;
+	sfix->iscache.section[1] = &sfix->section[0];
+	sfix->iscache.laddr[1] = 0x800000ull;
+	sfix->iscache.section[2] = &sfix->section[1];
+	sfix->iscache.laddr[2] = 0x600000ull;
+	sfix->iscache.nentries = 3;
+
+	memset(&sfix->block, 0, sizeof(sfix->block));
+	sfix->block.ip = 0x400000ull;
+	sfix->block.end_ip = 0x400010ull;
+	sfix->block.isid = 1;
+	sfix->block.mode = ptem_64bit;
+	sfix->block.ninsn = 4;
+
+	memset(&sfix->insn, 0, sizeof(sfix->insn));
+	sfix->insn.ip = 0x600000ull;
+	sfix->insn.isid = 3;
+	sfix->insn.mode = ptem_64bit;
+	sfix->insn.size = 2;
+
+	sfix->buffer = NULL;
+	sfix->size = 0;
+
+	errcode = pt_snap_init(&sfix->snap, &sfix->iscache);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sfix_fini(struct snap_fixture *sfix)
+{
+	int idx;
+
+	pt_snap_fini(&sfix->snap);
+
+	/* All references to our sections have been dropped. */
+	ptu_uint_eq(sfix->section[0].ucount, 1);
+	ptu_uint_eq(sfix->section[1].ucount, 1);
+	ptu_uint_eq(sfix->section[0].mcount, 0);
+	ptu_uint_eq(sfix->section[1].mcount, 0);
+
+	for (idx = 3; idx < sfix->iscache.nentries; ++idx) {
+		int errcode;
+
+		errcode = pt_section_put(sfix->iscache.section[idx]);
+		ptu_int_eq(errcode, 0);
+	}
+
+	free(sfix->buffer);
+
+	return ptu_passed();
+}
+
+/* Write @sfix->snap into @sfix->buffer. */
+static struct ptunit_result sfix_write(struct snap_fixture *sfix)
+{
+	int status;
+
+	status = pt_snap_size(&sfix->snap, &sfix->size);
+	ptu_int_eq(status, 0);
+
+	sfix->buffer = malloc(sfix->size);
+	ptu_ptr(sfix->buffer);
+
+	status = pt_snap_write(&sfix->snap, sfix->buffer, sfix->size);
+	ptu_int_eq(status, (int) sfix->size);
+
+	return ptu_passed();
+}
+
+/* Check that @section provides [@begin; @end) and nothing around it. */
+static struct ptunit_result sfix_check_range(struct pt_section *section,
+					     uint64_t begin, uint64_t end)
+{
+	uint8_t buffer[0x10];
+	int status;
+
+	status = pt_sec_memory_read(section, buffer, sizeof(buffer), begin);
+	ptu_int_eq(status, (int) (end - begin < sizeof(buffer) ?
+				  end - begin : sizeof(buffer)));
+	ptu_uint_eq(buffer[0], (uint8_t) (section->offset + begin));
+
+	status = pt_sec_memory_read(section, buffer, sizeof(buffer), end - 1);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], (uint8_t) (section->offset + end - 1));
+
+	status = pt_sec_memory_read(section, buffer, 1, end);
+	ptu_int_eq(status, -pte_nomap);
+
+	if (begin) {
+		status = pt_sec_memory_read(section, buffer, 1, begin - 1);
+		ptu_int_eq(status, -pte_nomap);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_null(void)
+{
+	struct pt_image_section_cache iscache;
+	int errcode;
+
+	errcode = pt_snap_init(NULL, &iscache);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fini_null(void)
+{
+	pt_snap_fini(NULL);
+	pt_snap_free(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_null(struct snap_fixture *sfix)
+{
+	size_t size;
+	int errcode;
+
+	errcode = pt_snap_add_block(NULL, &sfix->block);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_snap_add_block(&sfix->snap, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_snap_add_insn(NULL, &sfix->insn);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_snap_add_insn(&sfix->snap, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_snap_size(NULL, &size);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_snap_size(&sfix->snap, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result write_null(struct snap_fixture *sfix)
+{
+	uint8_t buffer[pt_snap_header_size];
+	int errcode;
+
+	errcode = pt_snap_write(NULL, buffer, sizeof(buffer));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_snap_write(&sfix->snap, NULL, sizeof(buffer));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_snap_load(NULL, NULL, NULL, buffer, sizeof(buffer));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_snap_load(&sfix->iscache, NULL, NULL, NULL,
+			       sizeof(buffer));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_empty(struct snap_fixture *sfix)
+{
+	size_t size;
+	int errcode;
+
+	sfix->block.ninsn = 0;
+
+	errcode = pt_snap_add_block(&sfix->snap, &sfix->block);
+	ptu_int_eq(errcode, 0);
+	ptu_null(sfix->snap.sections);
+
+	errcode = pt_snap_size(&sfix->snap, &size);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(size, pt_snap_header_size);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_no_isid(struct snap_fixture *sfix)
+{
+	int errcode;
+
+	sfix->block.isid = 0;
+
+	errcode = pt_snap_add_block(&sfix->snap, &sfix->block);
+	ptu_int_eq(errcode, -pte_bad_image);
+
+	sfix->insn.isid = 4;
+
+	errcode = pt_snap_add_insn(&sfix->snap, &sfix->insn);
+	ptu_int_eq(errcode, -pte_bad_image);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_nomap(struct snap_fixture *sfix)
+{
+	int errcode;
+
+	sfix->block.ip = 0x3ff000ull;
+
+	errcode = pt_snap_add_block(&sfix->snap, &sfix->block);
+	ptu_int_eq(errcode, -pte_nomap);
+
+	sfix->insn.ip = 0x601800ull;
+
+	errcode = pt_snap_add_insn(&sfix->snap, &sfix->insn);
+	ptu_int_eq(errcode, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_block_pages(struct snap_fixture *sfix)
+{
+	struct pt_snap_section *ssec;
+	int errcode;
+
+	/* The block's last instruction may cross into the next page. */
+	sfix->block.ip = 0x400ff0ull;
+	sfix->block.end_ip = 0x400ff8ull;
+
+	errcode = pt_snap_add_block(&sfix->snap, &sfix->block);
+	ptu_int_eq(errcode, 0);
+
+	ssec = sfix->snap.sections;
+	ptu_ptr(ssec);
+	ptu_null(ssec->next);
+	ptu_ptr_eq(ssec->section, &sfix->section[0]);
+	ptu_uint_eq(ssec->npages, 3);
+	ptu_uint_eq(ssec->pages[0], 0x3ull);
+	ptu_uint_eq(ssec->nvaddr, 1);
+	ptu_uint_eq(ssec->vaddr[0], 0x400000ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_block_end(struct snap_fixture *sfix)
+{
+	struct pt_snap_section *ssec;
+	int errcode;
+
+	/* The range is truncated at the end of the section. */
+	sfix->block.ip = 0x402ff0ull;
+	sfix->block.end_ip = 0x402ffeull;
+
+	errcode = pt_snap_add_block(&sfix->snap, &sfix->block);
+	ptu_int_eq(errcode, 0);
+
+	ssec = sfix->snap.sections;
+	ptu_ptr(ssec);
+	ptu_uint_eq(ssec->pages[0], 0x4ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_shared(struct snap_fixture *sfix)
+{
+	struct pt_snap_section *ssec;
+	int errcode;
+
+	errcode = pt_snap_add_block(&sfix->snap, &sfix->block);
+	ptu_int_eq(errcode, 0);
+
+	/* The same section loaded at a different address. */
+	sfix->block.isid = 2;
+	sfix->block.ip = 0x802000ull;
+	sfix->block.end_ip = 0x802000ull;
+
+	errcode = pt_snap_add_block(&sfix->snap, &sfix->block);
+	ptu_int_eq(errcode, 0);
+
+	ssec = sfix->snap.sections;
+	ptu_ptr(ssec);
+	ptu_null(ssec->next);
+	ptu_uint_eq(ssec->pages[0], 0x5ull);
+	ptu_uint_eq(ssec->nvaddr, 2);
+	ptu_uint_eq(ssec->vaddr[0], 0x400000ull);
+	ptu_uint_eq(ssec->vaddr[1], 0x800000ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_insn_unaligned(struct snap_fixture *sfix)
+{
+	struct pt_snap_section *ssec;
+	size_t size;
+	int errcode;
+
+	/* The section starts in the middle of a page. */
+	sfix->insn.ip = 0x600900ull;
+
+	errcode = pt_snap_add_insn(&sfix->snap, &sfix->insn);
+	ptu_int_eq(errcode, 0);
+
+	ssec = sfix->snap.sections;
+	ptu_ptr(ssec);
+	ptu_ptr_eq(ssec->section, &sfix->section[1]);
+	ptu_uint_eq(ssec->npages, 2);
+	ptu_uint_eq(ssec->pages[0], 0x2ull);
+
+	/* The page begins at section offset 0x800. */
+	errcode = pt_snap_size(&sfix->snap, &size);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(size, pt_snap_header_size + pt_snap_section_header_size +
+		    sizeof(sfix_file_b) - 1 + pt_snap_vaddr_size +
+		    pt_snap_range_header_size + 0x1000);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result write_small(struct snap_fixture *sfix)
+{
+	uint8_t buffer[pt_snap_header_size];
+	int errcode;
+
+	errcode = pt_snap_add_insn(&sfix->snap, &sfix->insn);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_snap_write(&sfix->snap, buffer, sizeof(buffer));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result write_load(struct snap_fixture *sfix)
+{
+	struct pt_section *seca, *secb;
+	struct pt_image *image;
+	int status;
+
+	/* Touch pages one and two of section a via both load addresses. */
+	sfix->block.ip = 0x401000ull;
+	sfix->block.end_ip = 0x401000ull;
+
+	status = pt_snap_add_block(&sfix->snap, &sfix->block);
+	ptu_int_eq(status, 0);
+
+	sfix->block.isid = 2;
+	sfix->block.ip = 0x802000ull;
+	sfix->block.end_ip = 0x802000ull;
+
+	status = pt_snap_add_block(&sfix->snap, &sfix->block);
+	ptu_int_eq(status, 0);
+
+	/* Touch the last page of section b. */
+	sfix->insn.ip = 0x601400ull;
+
+	status = pt_snap_add_insn(&sfix->snap, &sfix->insn);
+	ptu_int_eq(status, 0);
+
+	ptu_test(sfix_write, sfix);
+
+	/* We don't look at the image. */
+	image = (struct pt_image *) sfix;
+
+	status = pt_snap_load(&sfix->iscache, image, NULL, sfix->buffer,
+			      sfix->size);
+	ptu_int_eq(status, 3);
+	ptu_int_eq(sfix->iscache.nentries, 6);
+	ptu_int_eq(sfix->iscache.nimage, 3);
+
+	/* Sections are written in reverse order. */
+	secb = sfix->iscache.section[3];
+	ptu_ptr(secb);
+	ptu_ptr(secb->memory);
+	ptu_str_eq(secb->filename, sfix_file_b);
+	ptu_uint_eq(secb->offset, 0x800ull);
+	ptu_uint_eq(secb->size, 0x1800ull);
+	ptu_uint_eq(sfix->iscache.laddr[3], 0x600000ull);
+
+	seca = sfix->iscache.section[4];
+	ptu_ptr(seca);
+	ptu_ptr(seca->memory);
+	ptu_ptr_eq(sfix->iscache.section[5], seca);
+	ptu_str_eq(seca->filename, sfix_file_a);
+	ptu_uint_eq(seca->offset, 0x1000ull);
+	ptu_uint_eq(seca->size, 0x3000ull);
+	ptu_uint_eq(sfix->iscache.laddr[4], 0x400000ull);
+	ptu_uint_eq(sfix->iscache.laddr[5], 0x800000ull);
+
+	status = pt_sec_memory_map(seca);
+	ptu_int_eq(status, 0);
+
+	ptu_test(sfix_check_range, seca, 0x1000ull, 0x3000ull);
+
+	status = pt_sec_memory_unmap(seca);
+	ptu_int_eq(status, 0);
+
+	status = pt_sec_memory_map(secb);
+	ptu_int_eq(status, 0);
+
+	ptu_test(sfix_check_range, secb, 0x800ull, 0x1800ull);
+
+	status = pt_sec_memory_unmap(secb);
+	ptu_int_eq(status, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result load_bad_magic(struct snap_fixture *sfix)
+{
+	int status;
+
+	ptu_test(sfix_write, sfix);
+
+	sfix->buffer[0] ^= 0xff;
+
+	status = pt_snap_load(&sfix->iscache, NULL, NULL, sfix->buffer,
+			      sfix->size);
+	ptu_int_eq(status, -pte_bad_file);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result load_truncated(struct snap_fixture *sfix)
+{
+	int status;
+
+	status = pt_snap_add_insn(&sfix->snap, &sfix->insn);
+	ptu_int_eq(status, 0);
+
+	ptu_test(sfix_write, sfix);
+
+	status = pt_snap_load(&sfix->iscache, NULL, NULL, sfix->buffer,
+			      sfix->size - 1);
+	ptu_int_eq(status, -pte_bad_file);
+	ptu_int_eq(sfix->iscache.nentries, 3);
+
+	status = pt_snap_load(&sfix->iscache, NULL, NULL, sfix->buffer,
+			      pt_snap_header_size + 1);
+	ptu_int_eq(status, -pte_bad_file);
+	ptu_int_eq(sfix->iscache.nentries, 3);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct snap_fixture sfix;
+	struct ptunit_suite suite;
+
+	sfix.init = sfix_init;
+	sfix.fini = sfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, init_null);
+	ptu_run(suite, fini_null);
+	ptu_run_f(suite, add_null, sfix);
+	ptu_run_f(suite, write_null, sfix);
+
+	ptu_run_f(suite, add_empty, sfix);
+	ptu_run_f(suite, add_no_isid, sfix);
+	ptu_run_f(suite, add_nomap, sfix);
+	ptu_run_f(suite, add_block_pages, sfix);
+	ptu_run_f(suite, add_block_end, sfix);
+	ptu_run_f(suite, add_shared, sfix);
+	ptu_run_f(suite, add_insn_unaligned, sfix);
+	ptu_run_f(suite, write_small, sfix);
+	ptu_run_f(suite, write_load, sfix);
+	ptu_run_f(suite, load_bad_magic, sfix);
+	ptu_run_f(suite, load_truncated, sfix);
+
+	return ptunit_report(&suite);
+}
@@ -0,0 +1,734 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_cost.h"
+#include "pt_encoder.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+
+
+/* A test fixture providing a trace to scan. */
+struct cost_fixture {
+	/* The trace buffer. */
+	uint8_t buffer[256];
+
+	/* The configuration. */
+	struct pt_config config;
+
+	/* The encoder. */
+	struct pt_encoder encoder;
+
+	/* The decode cost profile. */
+	struct pt_cost_profile profile;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct cost_fixture *);
+	struct ptunit_result (*fini)(struct cost_fixture *);
+};
+
+static struct ptunit_result cfix_init(struct cost_fixture *cfix)
+{
+	int errcode;
+
+	memset(cfix->buffer, 0, sizeof(cfix->buffer));
+
+	pt_config_init(&cfix->config);
+	cfix->config.begin = cfix->buffer;
+	cfix->config.end = cfix->buffer + sizeof(cfix->buffer);
+
+	errcode = pt_encoder_init(&cfix->encoder, &cfix->config);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_cost_init(&cfix->profile, &cfix->config);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result cfix_fini(struct cost_fixture *cfix)
+{
+	pt_cost_fini(&cfix->profile);
+	pt_encoder_fini(&cfix->encoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result cfix_encode(struct cost_fixture *cfix,
+					enum pt_packet_type type)
+{
+	struct pt_packet packet;
+	int errcode;
+
+	memset(&packet, 0, sizeof(packet));
+	packet.type = type;
+
+	switch (type) {
+	default:
+		break;
+
+	case ppt_tnt_8:
+		packet.payload.tnt.bit_size = 6;
+		break;
+
+	case ppt_tip:
+	case ppt_fup:
+		packet.payload.ip.ipc = pt_ipc_sext_48;
+		packet.payload.ip.ip = 0x1000ull;
+		break;
+	}
+
+	errcode = pt_enc_next(&cfix->encoder, &packet);
+	ptu_int_gt(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result cfix_offset(struct cost_fixture *cfix,
+					uint64_t *offset)
+{
+	int errcode;
+
+	errcode = pt_enc_get_offset(&cfix->encoder, offset);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result cfix_segments(struct pt_segment_cost *segments,
+					  const uint64_t *cost, size_t n)
+{
+	size_t idx;
+
+	memset(segments, 0, n * sizeof(*segments));
+
+	for (idx = 0; idx < n; ++idx)
+		segments[idx].cost = cost[idx];
+
+	return ptu_passed();
+}
+
+/* Dummy decode functions to satisfy link dependencies. */
+struct pt_query_decoder;
+
+int pt_qry_decode_unknown(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_pad(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_psb(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_tip(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_tnt_8(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_tnt_64(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_tip_pge(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_tip_pgd(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_fup(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_header_fup(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_pip(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_header_pip(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_ovf(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_mode(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_header_mode(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_psbend(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_tsc(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_header_tsc(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_cbr(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_header_cbr(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_tma(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_mtc(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_cyc(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_stop(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_vmcs(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_header_vmcs(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_mnt(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_header_mnt(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_exstop(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_mwait(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_pwre(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_pwrx(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_ptw(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+
+static struct ptunit_result alloc_null(void)
+{
+	struct pt_cost_profile *profile;
+
+	profile = pt_cost_alloc(NULL);
+	ptu_null(profile);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result free_null(void)
+{
+	pt_cost_free(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result null(struct cost_fixture *cfix)
+{
+	struct pt_segment_cost cost;
+	uint64_t begin;
+	int errcode;
+
+	errcode = pt_cost_scan(NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_cost_segment(NULL, &cost, sizeof(cost), 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_cost_segment(&cfix->profile, NULL, sizeof(cost), 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_cost_partition(NULL, &begin, 1);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_cost_partition(&cfix->profile, NULL, 1);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_cost_partition(&cfix->profile, &begin, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_cost_add(NULL, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_cost_split(NULL, 1, &cost, 1);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add(void)
+{
+	struct pt_segment_cost cost;
+	struct pt_packet packet;
+	int errcode;
+
+	memset(&cost, 0, sizeof(cost));
+	memset(&packet, 0, sizeof(packet));
+
+	packet.type = ppt_tnt_64;
+	packet.payload.tnt.bit_size = 40;
+	errcode = pt_cost_add(&cost, &packet);
+	ptu_int_eq(errcode, 0);
+
+	packet.type = ppt_tip_pgd;
+	errcode = pt_cost_add(&cost, &packet);
+	ptu_int_eq(errcode, 0);
+
+	packet.type = ppt_fup;
+	errcode = pt_cost_add(&cost, &packet);
+	ptu_int_eq(errcode, 0);
+
+	packet.type = ppt_ptw;
+	errcode = pt_cost_add(&cost, &packet);
+	ptu_int_eq(errcode, 0);
+
+	packet.type = ppt_cyc;
+	errcode = pt_cost_add(&cost, &packet);
+	ptu_int_eq(errcode, 0);
+
+	packet.type = ppt_ovf;
+	errcode = pt_cost_add(&cost, &packet);
+	ptu_int_eq(errcode, 0);
+
+	packet.type = ppt_pad;
+	errcode = pt_cost_add(&cost, &packet);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(cost.tnt, 40);
+	ptu_uint_eq(cost.tip, 1);
+	ptu_uint_eq(cost.fup, 1);
+	ptu_uint_eq(cost.events, 1);
+	ptu_uint_eq(cost.timing, 1);
+	ptu_uint_eq(cost.ovf, 1);
+	ptu_uint_eq(cost.errors, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result estimate(void)
+{
+	struct pt_segment_cost cost;
+
+	memset(&cost, 0, sizeof(cost));
+	cost.size = 0x40;
+	cost.tnt = 2;
+	cost.tip = 1;
+
+	pt_cost_estimate(&cost);
+	ptu_uint_eq(cost.cost, (2 * pt_cost_tnt) + pt_cost_tip +
+		    (0x40 >> pt_cost_byte_shr));
+
+	/* An overflow costs more than a few branches. */
+	memset(&cost, 0, sizeof(cost));
+	cost.ovf = 1;
+
+	pt_cost_estimate(&cost);
+	ptu_uint_gt(cost.cost, (2 * pt_cost_tnt) + pt_cost_tip);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result split_empty(void)
+{
+	struct pt_segment_cost segments[1];
+	size_t first[2];
+	int parts;
+
+	memset(segments, 0, sizeof(segments));
+
+	parts = pt_cost_split(first, 2, segments, 0);
+	ptu_int_eq(parts, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result split_one(void)
+{
+	static const uint64_t cost[] = { 3, 1, 4, 1, 5 };
+	struct pt_segment_cost segments[5];
+	size_t first[1];
+	int parts;
+
+	ptu_test(cfix_segments, segments, cost, 5);
+
+	parts = pt_cost_split(first, 1, segments, 5);
+	ptu_int_eq(parts, 1);
+	ptu_uint_eq(first[0], 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result split_balanced(void)
+{
+	static const uint64_t cost[] = { 5, 1, 1, 1, 5 };
+	struct pt_segment_cost segments[5];
+	size_t first[3];
+	int parts;
+
+	ptu_test(cfix_segments, segments, cost, 5);
+
+	parts = pt_cost_split(first, 3, segments, 5);
+	ptu_int_eq(parts, 3);
+	ptu_uint_eq(first[0], 0);
+	ptu_uint_eq(first[1], 1);
+	ptu_uint_eq(first[2], 4);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result split_skewed(void)
+{
+	static const uint64_t cost[] = { 1, 1, 1, 1, 1, 1, 12 };
+	struct pt_segment_cost segments[7];
+	size_t first[2];
+	int parts;
+
+	ptu_test(cfix_segments, segments, cost, 7);
+
+	/* Splitting by the number of segments would leave one worker with
+	 * most of the work.
+	 */
+	parts = pt_cost_split(first, 2, segments, 7);
+	ptu_int_eq(parts, 2);
+	ptu_uint_eq(first[0], 0);
+	ptu_uint_eq(first[1], 6);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result split_all_parts(void)
+{
+	static const uint64_t cost[] = { 1, 1, 8, 1 };
+	struct pt_segment_cost segments[4];
+	size_t first[4];
+	int parts;
+
+	ptu_test(cfix_segments, segments, cost, 4);
+
+	/* We use all parts even if fewer parts would suffice. */
+	parts = pt_cost_split(first, 4, segments, 4);
+	ptu_int_eq(parts, 4);
+	ptu_uint_eq(first[0], 0);
+	ptu_uint_eq(first[1], 1);
+	ptu_uint_eq(first[2], 2);
+	ptu_uint_eq(first[3], 3);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result split_few(void)
+{
+	static const uint64_t cost[] = { 2, 3 };
+	struct pt_segment_cost segments[2];
+	size_t first[4];
+	int parts;
+
+	ptu_test(cfix_segments, segments, cost, 2);
+
+	parts = pt_cost_split(first, 4, segments, 2);
+	ptu_int_eq(parts, 2);
+	ptu_uint_eq(first[0], 0);
+	ptu_uint_eq(first[1], 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result scan_empty(struct cost_fixture *cfix)
+{
+	struct pt_segment_cost cost;
+	uint64_t begin;
+	int errcode;
+
+	errcode = pt_cost_scan(&cfix->profile);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_cost_segment(&cfix->profile, &cost, sizeof(cost), 0);
+	ptu_int_eq(errcode, -pte_eos);
+
+	errcode = pt_cost_partition(&cfix->profile, &begin, 1);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_flags(struct cost_fixture *cfix)
+{
+	int errcode;
+
+	cfix->config.flags.variant.block.end_on_call = 1;
+	pt_cost_fini(&cfix->profile);
+
+	errcode = pt_cost_init(&cfix->profile, &cfix->config);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cfix->profile.config.flags.variant.packet.coalesce_pad, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result scan(struct cost_fixture *cfix)
+{
+	struct pt_segment_cost cost;
+	uint64_t sync[2], end, begin[2];
+	int errcode;
+
+	ptu_test(cfix_offset, cfix, &sync[0]);
+	ptu_test(cfix_encode, cfix, ppt_psb);
+	ptu_test(cfix_encode, cfix, ppt_fup);
+	ptu_test(cfix_encode, cfix, ppt_psbend);
+	ptu_test(cfix_encode, cfix, ppt_tnt_8);
+	ptu_test(cfix_encode, cfix, ppt_cyc);
+
+	ptu_test(cfix_offset, cfix, &sync[1]);
+	ptu_test(cfix_encode, cfix, ppt_psb);
+	ptu_test(cfix_encode, cfix, ppt_psbend);
+	ptu_test(cfix_encode, cfix, ppt_tip);
+	ptu_test(cfix_encode, cfix, ppt_tnt_8);
+	ptu_test(cfix_encode, cfix, ppt_tnt_8);
+	ptu_test(cfix_encode, cfix, ppt_ovf);
+	ptu_test(cfix_offset, cfix, &end);
+
+	cfix->config.end = cfix->buffer + end;
+	pt_cost_fini(&cfix->profile);
+
+	errcode = pt_cost_init(&cfix->profile, &cfix->config);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_cost_scan(&cfix->profile);
+	ptu_int_eq(errcode, 2);
+
+	errcode = pt_cost_segment(&cfix->profile, &cost, sizeof(cost), 0);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cost.offset, sync[0]);
+	ptu_uint_eq(cost.size, sync[1] - sync[0]);
+	ptu_uint_eq(cost.tnt, 6);
+	ptu_uint_eq(cost.tip, 0);
+	ptu_uint_eq(cost.fup, 1);
+	ptu_uint_eq(cost.timing, 1);
+	ptu_uint_eq(cost.ovf, 0);
+
+	errcode = pt_cost_segment(&cfix->profile, &cost, sizeof(cost), 1);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cost.offset, sync[1]);
+	ptu_uint_eq(cost.size, end - sync[1]);
+	ptu_uint_eq(cost.tnt, 12);
+	ptu_uint_eq(cost.tip, 1);
+	ptu_uint_eq(cost.fup, 0);
+	ptu_uint_eq(cost.timing, 0);
+	ptu_uint_eq(cost.ovf, 1);
+	ptu_uint_eq(cost.errors, 0);
+
+	errcode = pt_cost_segment(&cfix->profile, &cost, sizeof(cost), 2);
+	ptu_int_eq(errcode, -pte_eos);
+
+	errcode = pt_cost_partition(&cfix->profile, begin, 2);
+	ptu_int_eq(errcode, 2);
+	ptu_uint_eq(begin[0], sync[0]);
+	ptu_uint_eq(begin[1], sync[1]);
+
+	errcode = pt_cost_partition(&cfix->profile, begin, 1);
+	ptu_int_eq(errcode, 1);
+	ptu_uint_eq(begin[0], sync[0]);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result scan_error(struct cost_fixture *cfix)
+{
+	struct pt_segment_cost cost;
+	uint64_t sync[2], bad;
+	int errcode;
+
+	ptu_test(cfix_offset, cfix, &sync[0]);
+	ptu_test(cfix_encode, cfix, ppt_psb);
+	ptu_test(cfix_encode, cfix, ppt_psbend);
+	ptu_test(cfix_encode, cfix, ppt_tnt_8);
+	ptu_test(cfix_offset, cfix, &bad);
+
+	/* An unknown opcode stops the segment. */
+	cfix->buffer[bad] = 0x02;
+	cfix->buffer[bad + 1] = 0xff;
+	cfix->encoder.pos += 2;
+
+	ptu_test(cfix_offset, cfix, &sync[1]);
+	ptu_test(cfix_encode, cfix, ppt_psb);
+	ptu_test(cfix_encode, cfix, ppt_psbend);
+
+	errcode = pt_cost_scan(&cfix->profile);
+	ptu_int_eq(errcode, 2);
+
+	errcode = pt_cost_segment(&cfix->profile, &cost, sizeof(cost), 0);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cost.offset, sync[0]);
+	ptu_uint_eq(cost.size, bad - sync[0]);
+	ptu_uint_eq(cost.errors, 1);
+
+	errcode = pt_cost_segment(&cfix->profile, &cost, sizeof(cost), 1);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cost.offset, sync[1]);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct cost_fixture cfix;
+	struct ptunit_suite suite;
+
+	cfix.init = cfix_init;
+	cfix.fini = cfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, alloc_null);
+	ptu_run(suite, free_null);
+	ptu_run_f(suite, null, cfix);
+
+	ptu_run(suite, add);
+	ptu_run(suite, estimate);
+
+	ptu_run(suite, split_empty);
+	ptu_run(suite, split_one);
+	ptu_run(suite, split_balanced);
+	ptu_run(suite, split_skewed);
+	ptu_run(suite, split_all_parts);
+	ptu_run(suite, split_few);
+
+	ptu_run_f(suite, init_flags, cfix);
+	ptu_run_f(suite, scan_empty, cfix);
+	ptu_run_f(suite, scan, cfix);
+	ptu_run_f(suite, scan_error, cfix);
+
+	return ptunit_report(&suite);
+}
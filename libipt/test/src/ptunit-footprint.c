@@ -0,0 +1,446 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_footprint.h"
+#include "pt_ild.h"
+#include "pt_image.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/* A mock image section cache providing a single section. */
+struct pt_image_section_cache {
+	/* The section identifier. */
+	int isid;
+
+	/* The virtual address at which the section is loaded. */
+	uint64_t vaddr;
+
+	/* The section's memory. */
+	uint8_t code[0x100];
+};
+
+int pt_iscache_read(struct pt_image_section_cache *iscache, uint8_t *buffer,
+		    uint64_t size, int isid, uint64_t vaddr)
+{
+	uint64_t offset;
+
+	if (!iscache || !buffer || !size)
+		return -pte_invalid;
+
+	if (isid != iscache->isid)
+		return -pte_bad_image;
+
+	offset = vaddr - iscache->vaddr;
+	if ((vaddr < iscache->vaddr) || (sizeof(iscache->code) <= offset))
+		return -pte_nomap;
+
+	if ((sizeof(iscache->code) - offset) < size)
+		size = sizeof(iscache->code) - offset;
+
+	memcpy(buffer, &iscache->code[offset], (size_t) size);
+
+	return (int) size;
+}
+
+int pt_image_read(struct pt_image *image, int *isid, uint8_t *buffer,
+		  uint16_t size, const struct pt_asid *asid, uint64_t addr)
+{
+	(void) image;
+	(void) isid;
+	(void) buffer;
+	(void) size;
+	(void) asid;
+	(void) addr;
+
+	return -pte_internal;
+}
+
+/* A test fixture providing a code footprint analysis. */
+struct fp_fixture {
+	/* The analysis. */
+	struct pt_footprint fp;
+
+	/* The configuration. */
+	struct pt_fp_config config;
+
+	/* The image section cache. */
+	struct pt_image_section_cache iscache;
+
+	/* A block of instructions crossing a line boundary. */
+	struct pt_block block;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct fp_fixture *);
+	struct ptunit_result (*fini)(struct fp_fixture *);
+};
+
+static struct ptunit_result ffix_init(struct fp_fixture *ffix)
+{
+	int errcode;
+
+	memset(&ffix->iscache, 0, sizeof(ffix->iscache));
+	ffix->iscache.isid = 1;
+	ffix->iscache.vaddr = 0x1000ull;
+	memset(ffix->iscache.code, 0x90, sizeof(ffix->iscache.code));
+
+	/* 0x1000: jmp 0x10c0 */
+	ffix->iscache.code[0x00] = 0xe9;
+	ffix->iscache.code[0x01] = 0xbb;
+	ffix->iscache.code[0x02] = 0x00;
+	ffix->iscache.code[0x03] = 0x00;
+	ffix->iscache.code[0x04] = 0x00;
+
+	/* 0x1041: ret */
+	ffix->iscache.code[0x41] = 0xc3;
+
+	/* 0x10c1: ret */
+	ffix->iscache.code[0xc1] = 0xc3;
+
+	/* 0x103e: nop; nop; nop; ret */
+	memset(&ffix->block, 0, sizeof(ffix->block));
+	ffix->block.ip = 0x103eull;
+	ffix->block.end_ip = 0x1041ull;
+	ffix->block.isid = 1;
+	ffix->block.mode = ptem_64bit;
+	ffix->block.ninsn = 4;
+
+	pt_fp_config_init(&ffix->config);
+	ffix->config.window_insn = 4;
+
+	errcode = pt_fp_init(&ffix->fp, &ffix->config, &ffix->iscache);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result ffix_fini(struct fp_fixture *ffix)
+{
+	pt_fp_fini(&ffix->fp);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result lru_init_null(void)
+{
+	int errcode;
+
+	errcode = pt_fp_lru_init(NULL, 1, 1);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result lru_access_null(void)
+{
+	int status;
+
+	status = pt_fp_lru_access(NULL, 0ull);
+	ptu_int_eq(status, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result lru_disabled(void)
+{
+	struct pt_fp_lru lru;
+	int status;
+
+	status = pt_fp_lru_init(&lru, 0, 4);
+	ptu_int_eq(status, 0);
+
+	status = pt_fp_lru_access(&lru, 0x42ull);
+	ptu_int_gt(status, 0);
+
+	pt_fp_lru_fini(&lru);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result lru(void)
+{
+	struct pt_fp_lru lru;
+	int status;
+
+	/* Two sets with two ways each. */
+	status = pt_fp_lru_init(&lru, 2, 2);
+	ptu_int_eq(status, 0);
+
+	status = pt_fp_lru_access(&lru, 0x0ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_fp_lru_access(&lru, 0x2ull);
+	ptu_int_eq(status, 0);
+
+	/* A different set does not interfere. */
+	status = pt_fp_lru_access(&lru, 0x1ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_fp_lru_access(&lru, 0x0ull);
+	ptu_int_gt(status, 0);
+
+	/* This evicts 0x2, which is now the least recently used. */
+	status = pt_fp_lru_access(&lru, 0x4ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_fp_lru_access(&lru, 0x0ull);
+	ptu_int_gt(status, 0);
+
+	status = pt_fp_lru_access(&lru, 0x2ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_fp_lru_access(&lru, 0x1ull);
+	ptu_int_gt(status, 0);
+
+	pt_fp_lru_fini(&lru);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_null(void)
+{
+	struct pt_fp_config config;
+	struct pt_footprint fp;
+	int errcode;
+
+	pt_fp_config_init(&config);
+
+	errcode = pt_fp_init(NULL, &config, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_fp_init(&fp, NULL, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_bad_config(void)
+{
+	struct pt_fp_config config;
+	struct pt_footprint fp;
+	int errcode;
+
+	pt_fp_config_init(&config);
+	config.size = 0;
+
+	errcode = pt_fp_init(&fp, &config, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fini_null(void)
+{
+	pt_fp_fini(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result summarize(struct fp_fixture *ffix)
+{
+	struct pt_fp_block fblock;
+	int errcode;
+
+	errcode = pt_fp_summarize(&fblock, &ffix->block, &ffix->iscache);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(fblock.nlines, 2);
+	ptu_uint_eq(fblock.lines[0], 0x40ull);
+	ptu_uint_eq(fblock.lines[1], 0x41ull);
+
+	free(fblock.lines);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result summarize_jump(struct fp_fixture *ffix)
+{
+	struct pt_fp_block fblock;
+	int errcode;
+
+	/* 0x1000: jmp 0x10c0; 0x10c0: nop; 0x10c1: ret */
+	ffix->block.ip = 0x1000ull;
+	ffix->block.end_ip = 0x10c1ull;
+	ffix->block.ninsn = 3;
+
+	errcode = pt_fp_summarize(&fblock, &ffix->block, &ffix->iscache);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(fblock.nlines, 2);
+	ptu_uint_eq(fblock.lines[0], 0x40ull);
+	ptu_uint_eq(fblock.lines[1], 0x43ull);
+
+	free(fblock.lines);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_null(struct fp_fixture *ffix)
+{
+	int status;
+
+	status = pt_fp_add_block(NULL, &ffix->block);
+	ptu_int_eq(status, -pte_invalid);
+
+	status = pt_fp_add_block(&ffix->fp, NULL);
+	ptu_int_eq(status, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_no_isid(struct fp_fixture *ffix)
+{
+	int status;
+
+	ffix->block.isid = 0;
+
+	status = pt_fp_add_block(&ffix->fp, &ffix->block);
+	ptu_int_eq(status, -pte_bad_image);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result window_none(struct fp_fixture *ffix)
+{
+	struct pt_fp_stats stats;
+	int status;
+
+	status = pt_fp_window(&ffix->fp, &stats, sizeof(stats));
+	ptu_int_eq(status, -pte_nosync);
+
+	status = pt_fp_close_window(&ffix->fp);
+	ptu_int_eq(status, 0);
+
+	status = pt_fp_window(&ffix->fp, &stats, sizeof(stats));
+	ptu_int_eq(status, -pte_nosync);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add(struct fp_fixture *ffix)
+{
+	struct pt_fp_stats stats;
+	int status;
+
+	status = pt_fp_add_block(&ffix->fp, &ffix->block);
+	ptu_int_eq(status, 0);
+
+	/* The second block starts a new window. */
+	status = pt_fp_add_block(&ffix->fp, &ffix->block);
+	ptu_int_gt(status, 0);
+
+	status = pt_fp_window(&ffix->fp, &stats, sizeof(stats));
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(stats.nblocks, 1ull);
+	ptu_uint_eq(stats.ninsn, 4ull);
+	ptu_uint_eq(stats.lines, 2ull);
+	ptu_uint_eq(stats.pages_4k, 1ull);
+	ptu_uint_eq(stats.pages_2m, 1ull);
+	ptu_uint_eq(stats.fetches, 2ull);
+	ptu_uint_eq(stats.icache_misses, 2ull);
+	ptu_uint_eq(stats.itlb_4k_misses, 1ull);
+	ptu_uint_eq(stats.itlb_2m_misses, 1ull);
+
+	status = pt_fp_close_window(&ffix->fp);
+	ptu_int_gt(status, 0);
+
+	/* The lines are unique per window but remain cached. */
+	status = pt_fp_window(&ffix->fp, &stats, sizeof(stats));
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(stats.nblocks, 1ull);
+	ptu_uint_eq(stats.lines, 2ull);
+	ptu_uint_eq(stats.fetches, 2ull);
+	ptu_uint_eq(stats.icache_misses, 0ull);
+	ptu_uint_eq(stats.itlb_4k_misses, 0ull);
+	ptu_uint_eq(stats.itlb_2m_misses, 0ull);
+
+	status = pt_fp_total(&ffix->fp, &stats, sizeof(stats));
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(stats.nblocks, 2ull);
+	ptu_uint_eq(stats.ninsn, 8ull);
+	ptu_uint_eq(stats.lines, 2ull);
+	ptu_uint_eq(stats.pages_4k, 1ull);
+	ptu_uint_eq(stats.fetches, 4ull);
+	ptu_uint_eq(stats.icache_misses, 2ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result total_open_window(struct fp_fixture *ffix)
+{
+	struct pt_fp_stats stats;
+	int status;
+
+	status = pt_fp_add_block(&ffix->fp, &ffix->block);
+	ptu_int_eq(status, 0);
+
+	status = pt_fp_total(&ffix->fp, &stats, sizeof(stats));
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(stats.nblocks, 1ull);
+	ptu_uint_eq(stats.lines, 2ull);
+	ptu_uint_eq(stats.fetches, 2ull);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct ptunit_suite suite;
+	struct fp_fixture ffix;
+
+	pt_ild_init();
+
+	ffix.init = ffix_init;
+	ffix.fini = ffix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, lru_init_null);
+	ptu_run(suite, lru_access_null);
+	ptu_run(suite, lru_disabled);
+	ptu_run(suite, lru);
+
+	ptu_run(suite, init_null);
+	ptu_run(suite, init_bad_config);
+	ptu_run(suite, fini_null);
+
+	ptu_run_f(suite, summarize, ffix);
+	ptu_run_f(suite, summarize_jump, ffix);
+	ptu_run_f(suite, add_null, ffix);
+	ptu_run_f(suite, add_no_isid, ffix);
+	ptu_run_f(suite, window_none, ffix);
+	ptu_run_f(suite, add, ffix);
+	ptu_run_f(suite, total_open_window, ffix);
+
+	return ptunit_report(&suite);
+}
@@ -0,0 +1,570 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_hot_profile.h"
+#include "pt_section.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+
+
+/* A mock image section cache providing two sections.
+ *
+ * They correspond to the same program built in two different directories and
+ * loaded at different addresses.
+ */
+struct pt_image_section_cache {
+	/* The sections indexed by isid - 1. */
+	struct pt_section section[2];
+
+	/* The load addresses indexed by isid - 1. */
+	uint64_t laddr[2];
+
+	/* The number of lookups. */
+	uint32_t nlookups;
+};
+
+int pt_iscache_lookup(struct pt_image_section_cache *iscache,
+		      struct pt_section **section, uint64_t *laddr, int isid)
+{
+	if (!iscache || !section || !laddr)
+		return -pte_internal;
+
+	if ((isid <= 0) || (2 < isid))
+		return -pte_bad_image;
+
+	*section = &iscache->section[isid - 1];
+	*laddr = iscache->laddr[isid - 1];
+	iscache->nlookups += 1;
+
+	return 0;
+}
+
+const char *pt_section_filename(const struct pt_section *section)
+{
+	if (!section)
+		return NULL;
+
+	return section->filename;
+}
+
+uint64_t pt_section_offset(const struct pt_section *section)
+{
+	if (!section)
+		return 0ull;
+
+	return section->offset;
+}
+
+uint64_t pt_section_size(const struct pt_section *section)
+{
+	if (!section)
+		return 0ull;
+
+	return section->size;
+}
+
+int pt_section_put(struct pt_section *section)
+{
+	if (!section)
+		return -pte_internal;
+
+	return 0;
+}
+
+/* A test fixture providing two hot path profiles. */
+struct hot_fixture {
+	/* The profiles before and after the change. */
+	struct pt_hot_profile before, after;
+
+	/* The image section cache. */
+	struct pt_image_section_cache iscache;
+
+	/* A block. */
+	struct pt_block block;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct hot_fixture *);
+	struct ptunit_result (*fini)(struct hot_fixture *);
+};
+
+static char hfix_file_a[] = "/a/prog";
+static char hfix_file_b[] = "/b/prog";
+
+static struct ptunit_result hfix_init(struct hot_fixture *hfix)
+{
+	int errcode;
+
+	memset(&hfix->iscache, 0, sizeof(hfix->iscache));
+	hfix->iscache.section[0].filename = hfix_file_a;
+	hfix->iscache.section[0].offset = 0x400ull;
+	hfix->iscache.section[0].size = 0x1000ull;
+	hfix->iscache.laddr[0] = 0x1000ull;
+	hfix->iscache.section[1].filename = hfix_file_b;
+	hfix->iscache.section[1].offset = 0x400ull;
+	hfix->iscache.section[1].size = 0x1000ull;
+	hfix->iscache.laddr[1] = 0x8000ull;
+
+	memset(&hfix->block, 0, sizeof(hfix->block));
+	hfix->block.ip = 0x1000ull;
+	hfix->block.isid = 1;
+	hfix->block.mode = ptem_64bit;
+	hfix->block.ninsn = 4;
+
+	errcode = pt_hot_init(&hfix->before, &hfix->iscache);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_hot_init(&hfix->after, &hfix->iscache);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result hfix_fini(struct hot_fixture *hfix)
+{
+	pt_hot_fini(&hfix->before);
+	pt_hot_fini(&hfix->after);
+
+	return ptu_passed();
+}
+
+/* Add a block at file offset @offset with @ninsn instructions to @profile.
+ *
+ * The block is taken from section @isid.
+ */
+static struct ptunit_result hfix_add(struct hot_fixture *hfix,
+				     struct pt_hot_profile *profile, int isid,
+				     uint64_t offset, uint16_t ninsn)
+{
+	int errcode;
+
+	hfix->block.isid = isid;
+	hfix->block.ip = hfix->iscache.laddr[isid - 1] + offset - 0x400ull;
+	hfix->block.ninsn = ninsn;
+
+	errcode = pt_hot_add_block(profile, &hfix->block);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+/* Add symbols for two functions, main and foo, to @profile. */
+static struct ptunit_result hfix_symbols(struct pt_hot_profile *profile,
+					 const char *filename, uint64_t foo)
+{
+	int errcode;
+
+	/* Add them out of order. */
+	errcode = pt_hot_add_symbol(profile, filename, foo, foo + 0x100ull,
+				    "foo");
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_hot_add_symbol(profile, filename, 0x400ull, 0x500ull,
+				    "main");
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_null(void)
+{
+	int errcode;
+
+	errcode = pt_hot_init(NULL, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fini_null(void)
+{
+	pt_hot_fini(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_null(struct hot_fixture *hfix)
+{
+	int errcode;
+
+	errcode = pt_hot_add_block(NULL, &hfix->block);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_hot_add_block(&hfix->before, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_hot_add_symbol(NULL, hfix_file_a, 0ull, 1ull, "f");
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_hot_add_symbol(&hfix->before, NULL, 0ull, 1ull, "f");
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_hot_add_symbol(&hfix->before, hfix_file_a, 0ull, 1ull,
+				    NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_hot_add_gap(NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result diff_null(struct hot_fixture *hfix)
+{
+	struct pt_hot_delta delta;
+	int errcode;
+
+	errcode = pt_hot_diff(NULL, &hfix->after, &delta, sizeof(delta), 1,
+			      pthm_insn);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_hot_diff(&hfix->before, NULL, &delta, sizeof(delta), 1,
+			      pthm_insn);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_hot_diff(&hfix->before, &hfix->after, NULL, sizeof(delta),
+			      1, pthm_insn);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_hot_diff(&hfix->before, &hfix->after, &delta, 0, 1,
+			      pthm_insn);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result diff_bad_metric(struct hot_fixture *hfix)
+{
+	struct pt_hot_delta delta;
+	int errcode;
+
+	errcode = pt_hot_diff(&hfix->before, &hfix->after, &delta,
+			      sizeof(delta), 1, (enum pt_hot_metric) 42);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_empty(struct hot_fixture *hfix)
+{
+	int errcode;
+
+	hfix->block.ninsn = 0;
+
+	errcode = pt_hot_add_block(&hfix->before, &hfix->block);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(hfix->before.nblocks, 0ull);
+	ptu_uint_eq(hfix->iscache.nlookups, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_no_isid(struct hot_fixture *hfix)
+{
+	int errcode;
+
+	hfix->block.isid = 0;
+
+	errcode = pt_hot_add_block(&hfix->before, &hfix->block);
+	ptu_int_eq(errcode, -pte_bad_image);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_nomap(struct hot_fixture *hfix)
+{
+	int errcode;
+
+	hfix->block.ip = 0x2000ull;
+
+	errcode = pt_hot_add_block(&hfix->before, &hfix->block);
+	ptu_int_eq(errcode, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_symbol_bad_range(struct hot_fixture *hfix)
+{
+	int errcode;
+
+	errcode = pt_hot_add_symbol(&hfix->before, hfix_file_a, 0x10ull,
+				    0x10ull, "f");
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_symbol_late(struct hot_fixture *hfix)
+{
+	int errcode;
+
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x400ull, 4);
+
+	errcode = pt_hot_add_symbol(&hfix->before, hfix_file_a, 0x400ull,
+				    0x500ull, "main");
+	ptu_int_eq(errcode, -pte_bad_context);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add(struct hot_fixture *hfix)
+{
+	const struct pt_hot_profile *profile;
+
+	profile = &hfix->before;
+
+	ptu_test(hfix_symbols, &hfix->before, hfix_file_a, 0x800ull);
+
+	hfix->block.cyc = 10ull;
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x400ull, 4);
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x420ull, 2);
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x800ull, 3);
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x440ull, 1);
+
+	/* The section is looked up only once. */
+	ptu_uint_eq(hfix->iscache.nlookups, 1);
+
+	ptu_uint_eq(profile->nblocks, 4ull);
+	ptu_uint_eq(profile->ninsn, 10ull);
+	ptu_uint_eq(profile->cyc, 40ull);
+
+	/* We transferred control from main to foo and back. */
+	ptu_uint_eq(profile->nedges, 2ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_gap(struct hot_fixture *hfix)
+{
+	int errcode;
+
+	ptu_test(hfix_symbols, &hfix->before, hfix_file_a, 0x800ull);
+
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x400ull, 4);
+
+	errcode = pt_hot_add_gap(&hfix->before);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x800ull, 3);
+	ptu_uint_eq(hfix->before.nedges, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result diff_none(struct hot_fixture *hfix)
+{
+	struct pt_hot_delta delta;
+	int errcode;
+
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x400ull, 4);
+	ptu_test(hfix_add, hfix, &hfix->after, 2, 0x400ull, 4);
+
+	errcode = pt_hot_diff(&hfix->before, &hfix->after, &delta,
+			      sizeof(delta), 0, pthm_insn);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result diff_symbols(struct hot_fixture *hfix)
+{
+	struct pt_hot_delta deltas[4];
+	int errcode;
+
+	/* The function foo moved in the new build. */
+	ptu_test(hfix_symbols, &hfix->before, hfix_file_a, 0x800ull);
+	ptu_test(hfix_symbols, &hfix->after, hfix_file_b, 0x900ull);
+
+	/* Before, main and foo executed the same number of instructions. */
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x400ull, 4);
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x800ull, 4);
+
+	/* After, foo executes three times as many instructions as main. */
+	ptu_test(hfix_add, hfix, &hfix->after, 2, 0x400ull, 2);
+	ptu_test(hfix_add, hfix, &hfix->after, 2, 0x900ull, 6);
+
+	memset(deltas, 0xcd, sizeof(deltas));
+	errcode = pt_hot_diff(&hfix->before, &hfix->after, deltas,
+			      sizeof(deltas[0]), 4, pthm_insn);
+	ptu_int_eq(errcode, 2);
+
+	ptu_str_eq(deltas[0].filename, "prog");
+	ptu_uint_eq(deltas[0].value[0], 4ull);
+	ptu_uint_eq(deltas[0].share[0], 500000);
+	ptu_int_eq(deltas[1].delta, -deltas[0].delta);
+
+	if (deltas[0].delta < 0) {
+		ptu_str_eq(deltas[0].name, "main");
+		ptu_uint_eq(deltas[0].value[1], 2ull);
+		ptu_uint_eq(deltas[0].share[1], 250000);
+		ptu_int_eq(deltas[0].delta, -250000);
+		ptu_str_eq(deltas[1].name, "foo");
+		ptu_uint_eq(deltas[1].offset, 0x900ull);
+	} else {
+		ptu_str_eq(deltas[0].name, "foo");
+		ptu_uint_eq(deltas[0].offset, 0x900ull);
+		ptu_uint_eq(deltas[0].value[1], 6ull);
+		ptu_uint_eq(deltas[0].share[1], 750000);
+		ptu_int_eq(deltas[0].delta, 250000);
+		ptu_str_eq(deltas[1].name, "main");
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result diff_offsets(struct hot_fixture *hfix)
+{
+	struct pt_hot_delta deltas[2];
+	int errcode;
+
+	/* Without symbols, blocks are identified by their file offset. */
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x400ull, 4);
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x800ull, 4);
+	ptu_test(hfix_add, hfix, &hfix->after, 2, 0x400ull, 4);
+	ptu_test(hfix_add, hfix, &hfix->after, 2, 0x400ull, 4);
+	ptu_test(hfix_add, hfix, &hfix->after, 2, 0x900ull, 8);
+
+	errcode = pt_hot_diff(&hfix->before, &hfix->after, deltas,
+			      sizeof(deltas[0]), 2, pthm_blocks);
+	ptu_int_eq(errcode, 2);
+
+	/* The block at 0x800 is no longer executed. */
+	ptu_null(deltas[0].name);
+	ptu_uint_eq(deltas[0].offset, 0x800ull);
+	ptu_uint_eq(deltas[0].value[0], 1ull);
+	ptu_uint_eq(deltas[0].value[1], 0ull);
+	ptu_int_eq(deltas[0].delta, -500000);
+
+	/* It is followed by the new block at 0x900. */
+	ptu_null(deltas[1].name);
+	ptu_uint_eq(deltas[1].share[0], 0);
+	ptu_uint_eq(deltas[1].share[1], 333333);
+	ptu_uint_eq(deltas[1].offset, 0x900ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result diff_edges(struct hot_fixture *hfix)
+{
+	struct pt_hot_delta deltas[2];
+	int errcode, ret, call;
+
+	ptu_test(hfix_symbols, &hfix->before, hfix_file_a, 0x800ull);
+	ptu_test(hfix_symbols, &hfix->after, hfix_file_b, 0x900ull);
+
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x400ull, 4);
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x800ull, 4);
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x400ull, 4);
+
+	ptu_test(hfix_add, hfix, &hfix->after, 2, 0x400ull, 4);
+	ptu_test(hfix_add, hfix, &hfix->after, 2, 0x900ull, 4);
+
+	errcode = pt_hot_diff(&hfix->before, &hfix->after, deltas,
+			      sizeof(deltas[0]), 2, pthm_edges);
+	ptu_int_eq(errcode, 2);
+
+	/* Both changes are equal in magnitude. */
+	ret = deltas[0].delta < 0 ? 0 : 1;
+	call = 1 - ret;
+
+	/* The return from foo to main disappeared. */
+	ptu_str_eq(deltas[ret].name, "foo");
+	ptu_str_eq(deltas[ret].to_name, "main");
+	ptu_uint_eq(deltas[ret].value[0], 1ull);
+	ptu_uint_eq(deltas[ret].value[1], 0ull);
+	ptu_int_eq(deltas[ret].delta, -500000);
+
+	/* The call from main to foo became more important. */
+	ptu_str_eq(deltas[call].name, "main");
+	ptu_str_eq(deltas[call].to_filename, "prog");
+	ptu_str_eq(deltas[call].to_name, "foo");
+	ptu_uint_eq(deltas[call].to_offset, 0x900ull);
+	ptu_int_eq(deltas[call].delta, 500000);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result diff_size(struct hot_fixture *hfix)
+{
+	struct {
+		struct pt_hot_delta delta;
+		uint8_t extra[8];
+	} deltas[2];
+	int errcode;
+
+	ptu_test(hfix_add, hfix, &hfix->before, 1, 0x400ull, 4);
+	ptu_test(hfix_add, hfix, &hfix->after, 2, 0x800ull, 4);
+
+	memset(deltas, 0xcd, sizeof(deltas));
+	errcode = pt_hot_diff(&hfix->before, &hfix->after, &deltas[0].delta,
+			      sizeof(deltas[0]), 2, pthm_insn);
+	ptu_int_eq(errcode, 2);
+
+	ptu_uint_eq(deltas[0].extra[0], 0);
+	ptu_uint_eq(deltas[0].extra[7], 0);
+	ptu_uint_eq(deltas[1].extra[0], 0);
+	ptu_uint_eq(deltas[1].delta.value[0] + deltas[0].delta.value[0], 4ull);
+	ptu_uint_eq(deltas[1].delta.value[1] + deltas[0].delta.value[1], 4ull);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct ptunit_suite suite;
+	struct hot_fixture hfix;
+
+	hfix.init = hfix_init;
+	hfix.fini = hfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, init_null);
+	ptu_run(suite, fini_null);
+	ptu_run_f(suite, add_null, hfix);
+	ptu_run_f(suite, diff_null, hfix);
+	ptu_run_f(suite, diff_bad_metric, hfix);
+
+	ptu_run_f(suite, add_empty, hfix);
+	ptu_run_f(suite, add_no_isid, hfix);
+	ptu_run_f(suite, add_nomap, hfix);
+	ptu_run_f(suite, add_symbol_bad_range, hfix);
+	ptu_run_f(suite, add_symbol_late, hfix);
+	ptu_run_f(suite, add, hfix);
+	ptu_run_f(suite, add_gap, hfix);
+	ptu_run_f(suite, diff_none, hfix);
+	ptu_run_f(suite, diff_symbols, hfix);
+	ptu_run_f(suite, diff_offsets, hfix);
+	ptu_run_f(suite, diff_edges, hfix);
+	ptu_run_f(suite, diff_size, hfix);
+
+	return ptunit_report(&suite);
+}
@@ -66,6 +66,9 @@ struct ifix_status {
 	/* The test mapping to be used. */
 	struct ifix_mapping *mapping;
 
+	/* Memory section indication. */
+	int memory;
+
 	/* A link back to the test fixture providing this section. */
 	struct image_fixture *ifix;
 };
@@ -208,15 +211,40 @@ uint64_t pt_section_size(const struct pt_section *section)
 	return section->size;
 }
 
+/* The section to be returned by the next pt_mk_section() call, if any. */
+static struct pt_section *ifix_mk_section;
+
 struct pt_section *pt_mk_section(const char *file, uint64_t offset,
 				 uint64_t size)
 {
+	struct pt_section *section;
+
 	(void) file;
 	(void) offset;
 	(void) size;
 
-	/* This function is not used by our tests. */
-	return NULL;
+	section = ifix_mk_section;
+	if (!section)
+		return NULL;
+
+	ifix_mk_section = NULL;
+	section->ucount += 1;
+
+	return section;
+}
+
+int pt_section_is_memory(const struct pt_section *section)
+{
+	const struct ifix_status *status;
+
+	if (!section)
+		return 0;
+
+	status = section->status;
+	if (!status)
+		return 0;
+
+	return status->memory;
 }
 
 int pt_section_get(struct pt_section *section)
@@ -1898,20 +1926,303 @@ static struct ptunit_result add_cached_bad_isid(struct image_fixture *ifix)
 	return ptu_passed();
 }
 
+/* Prepare sections 0 and 1 as adjacent pieces of one file and section 2 as the
+ * coalesced section covering both.
+ */
+static struct ptunit_result ifix_prepare_coalesce(struct image_fixture *ifix,
+						  uint64_t offset)
+{
+	int status;
+
+	ifix->section[1].filename = ifix->section[0].filename;
+	ifix->section[1].offset = offset;
+
+	ifix->section[2].filename = ifix->section[0].filename;
+	ifix->section[2].offset = ifix->section[0].offset;
+	ifix->section[2].size = ifix->section[0].size + ifix->section[1].size;
+
+	ifix_mk_section = &ifix->section[2];
+
+	status = pt_image_set_coalesce(&ifix->image, 1);
+	ptu_int_eq(status, 0);
+
+	return ptu_passed();
+}
+
+/* Add sections 0 and 1 at adjacent addresses. */
+static struct ptunit_result ifix_add_adjacent(struct image_fixture *ifix,
+					     int isid)
+{
+	int status;
+
+	status = pt_image_add(&ifix->image, &ifix->section[1], &ifix->asid[0],
+			      0x1010ull, isid);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_add(&ifix->image, &ifix->section[0], &ifix->asid[0],
+			      0x1000ull, isid);
+	ptu_int_eq(status, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result ifix_find(struct image_fixture *ifix,
+				      uint64_t vaddr, int isid,
+				      const struct pt_section *section)
+{
+	struct pt_mapped_section msec;
+	int status;
+
+	status = pt_image_find(&ifix->image, &msec, NULL, &ifix->asid[0],
+			       vaddr);
+	ptu_int_eq(status, isid);
+	ptu_ptr_eq(msec.section, section);
+
+	status = pt_section_put(msec.section);
+	ptu_int_eq(status, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result set_coalesce_null(void)
+{
+	int status;
+
+	status = pt_image_set_coalesce(NULL, 1);
+	ptu_int_eq(status, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coalesce(struct image_fixture *ifix)
+{
+	struct pt_mapped_section msec;
+	int status;
+
+	ptu_check(ifix_prepare_coalesce, ifix, 0x20ull);
+	ptu_check(ifix_add_adjacent, ifix, 0);
+
+	ptu_ptr(ifix->image.sections);
+	ptu_null(ifix->image.sections->next);
+
+	status = pt_image_find(&ifix->image, &msec, NULL,
+			       &ifix->asid[0], 0x1018ull);
+	ptu_int_eq(status, 0);
+	ptu_ptr_eq(msec.section, &ifix->section[2]);
+	ptu_uint_eq(msec.vaddr, 0x1000ull);
+	ptu_uint_eq(msec.offset, 0x0ull);
+	ptu_uint_eq(msec.size, 0x20ull);
+
+	status = pt_section_put(msec.section);
+	ptu_int_eq(status, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coalesce_disabled(struct image_fixture *ifix)
+{
+	int status;
+
+	ptu_check(ifix_prepare_coalesce, ifix, 0x20ull);
+
+	status = pt_image_set_coalesce(&ifix->image, 0);
+	ptu_int_eq(status, 0);
+
+	ptu_check(ifix_add_adjacent, ifix, 0);
+	ptu_check(ifix_find, ifix, 0x1018ull, 0, &ifix->section[1]);
+	ptu_check(ifix_find, ifix, 0x1008ull, 0, &ifix->section[0]);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coalesce_gap(struct image_fixture *ifix)
+{
+	ptu_check(ifix_prepare_coalesce, ifix, 0x28ull);
+	ptu_check(ifix_add_adjacent, ifix, 0);
+	ptu_check(ifix_find, ifix, 0x1018ull, 0, &ifix->section[1]);
+	ptu_check(ifix_find, ifix, 0x1008ull, 0, &ifix->section[0]);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coalesce_asid(struct image_fixture *ifix)
+{
+	int status;
+
+	ptu_check(ifix_prepare_coalesce, ifix, 0x20ull);
+
+	status = pt_image_add(&ifix->image, &ifix->section[0], &ifix->asid[0],
+			      0x1000ull, 0);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_add(&ifix->image, &ifix->section[1], &ifix->asid[1],
+			      0x1010ull, 0);
+	ptu_int_eq(status, 0);
+
+	ptu_check(ifix_find, ifix, 0x1008ull, 0, &ifix->section[0]);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coalesce_isid(struct image_fixture *ifix)
+{
+	ptu_check(ifix_prepare_coalesce, ifix, 0x20ull);
+	ptu_check(ifix_add_adjacent, ifix, 1);
+	ptu_check(ifix_find, ifix, 0x1018ull, 1, &ifix->section[1]);
+	ptu_check(ifix_find, ifix, 0x1008ull, 1, &ifix->section[0]);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coalesce_memory(struct image_fixture *ifix)
+{
+	ptu_check(ifix_prepare_coalesce, ifix, 0x20ull);
+
+	ifix->status[1].memory = 1;
+
+	ptu_check(ifix_add_adjacent, ifix, 0);
+	ptu_check(ifix_find, ifix, 0x1018ull, 0, &ifix->section[1]);
+	ptu_check(ifix_find, ifix, 0x1008ull, 0, &ifix->section[0]);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coalesce_fail(struct image_fixture *ifix)
+{
+	ptu_check(ifix_prepare_coalesce, ifix, 0x20ull);
+
+	/* The file shrank since we added the original sections. */
+	ifix->section[2].size -= 1;
+
+	ptu_check(ifix_add_adjacent, ifix, 0);
+	ptu_check(ifix_find, ifix, 0x1018ull, 0, &ifix->section[1]);
+	ptu_check(ifix_find, ifix, 0x1008ull, 0, &ifix->section[0]);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coalesce_remove(struct image_fixture *ifix)
+{
+	struct pt_mapped_section msec;
+	int status;
+
+	ptu_check(ifix_prepare_coalesce, ifix, 0x20ull);
+	ptu_check(ifix_add_adjacent, ifix, 0);
+	ptu_check(ifix_find, ifix, 0x1008ull, 0, &ifix->section[2]);
+
+	status = pt_image_remove(&ifix->image, &ifix->section[0],
+				 &ifix->asid[0], 0x1000ull);
+	ptu_int_eq(status, 0);
+
+	ptu_check(ifix_find, ifix, 0x1018ull, 0, &ifix->section[1]);
+
+	status = pt_image_find(&ifix->image, &msec, NULL, &ifix->asid[0],
+			       0x1008ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	ptu_int_eq(ifix->section[0].ucount, 0);
+	ptu_int_eq(ifix->section[2].ucount, 0);
+
+	status = pt_image_remove(&ifix->image, &ifix->section[1],
+				 &ifix->asid[0], 0x1010ull);
+	ptu_int_eq(status, 0);
+
+	ptu_null(ifix->image.sections);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result
+coalesce_remove_by_filename(struct image_fixture *ifix)
+{
+	int status;
+
+	ptu_check(ifix_prepare_coalesce, ifix, 0x20ull);
+	ptu_check(ifix_add_adjacent, ifix, 0);
+
+	status = pt_image_remove_by_filename(&ifix->image,
+					     ifix->section[0].filename,
+					     &ifix->asid[0]);
+	ptu_int_eq(status, 2);
+
+	ptu_null(ifix->image.sections);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coalesce_remove_by_asid(struct image_fixture *ifix)
+{
+	int status;
+
+	ptu_check(ifix_prepare_coalesce, ifix, 0x20ull);
+	ptu_check(ifix_add_adjacent, ifix, 0);
+
+	status = pt_image_remove_by_asid(&ifix->image, &ifix->asid[0]);
+	ptu_int_eq(status, 2);
+
+	ptu_null(ifix->image.sections);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coalesce_overlap(struct image_fixture *ifix)
+{
+	int status;
+
+	ptu_check(ifix_prepare_coalesce, ifix, 0x20ull);
+	ptu_check(ifix_add_adjacent, ifix, 0);
+
+	status = ifix_add_section(ifix, "file-3");
+	ptu_int_eq(status, 3);
+
+	status = pt_image_add(&ifix->image, &ifix->section[3], &ifix->asid[0],
+			      0x1008ull, 0);
+	ptu_int_eq(status, 0);
+
+	ptu_check(ifix_find, ifix, 0x1004ull, 0, &ifix->section[0]);
+	ptu_check(ifix_find, ifix, 0x1010ull, 0, &ifix->section[3]);
+	ptu_check(ifix_find, ifix, 0x101cull, 0, &ifix->section[1]);
+
+	ptu_int_eq(ifix->section[2].ucount, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coalesce_copy(struct image_fixture *ifix)
+{
+	int status;
+
+	ptu_check(ifix_prepare_coalesce, ifix, 0x20ull);
+	ptu_check(ifix_add_adjacent, ifix, 0);
+
+	status = pt_image_copy(&ifix->copy, &ifix->image);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_remove(&ifix->copy, &ifix->section[0],
+				 &ifix->asid[0], 0x1000ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_remove(&ifix->copy, &ifix->section[1],
+				 &ifix->asid[0], 0x1010ull);
+	ptu_int_eq(status, 0);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result find_null(struct image_fixture *ifix)
 {
 	struct pt_mapped_section msec;
 	int status;
 
-	status = pt_image_find(NULL, &msec, &ifix->asid[0],
+	status = pt_image_find(NULL, &msec, NULL, &ifix->asid[0],
 			       0x1000ull);
 	ptu_int_eq(status, -pte_internal);
 
-	status = pt_image_find(&ifix->image, NULL, &ifix->asid[0],
+	status = pt_image_find(&ifix->image, NULL, NULL, &ifix->asid[0],
 			       0x1000ull);
 	ptu_int_eq(status, -pte_internal);
 
-	status = pt_image_find(&ifix->image, &msec, NULL, 0x1000ull);
+	status = pt_image_find(&ifix->image, &msec, NULL, NULL, 0x1000ull);
 	ptu_int_eq(status, -pte_internal);
 
 	return ptu_passed();
@@ -1922,7 +2233,8 @@ static struct ptunit_result find(struct image_fixture *ifix)
 	struct pt_mapped_section msec;
 	int status;
 
-	status = pt_image_find(&ifix->image, &msec, &ifix->asid[1], 0x2003ull);
+	status = pt_image_find(&ifix->image, &msec, NULL,
+			       &ifix->asid[1], 0x2003ull);
 	ptu_int_eq(status, 11);
 	ptu_ptr_eq(msec.section, &ifix->section[1]);
 	ptu_uint_eq(msec.vaddr, 0x2000ull);
@@ -1946,7 +2258,8 @@ static struct ptunit_result find_asid(struct image_fixture *ifix)
 			      0x1008ull, 2);
 	ptu_int_eq(status, 0);
 
-	status = pt_image_find(&ifix->image, &msec, &ifix->asid[0], 0x1009ull);
+	status = pt_image_find(&ifix->image, &msec, NULL,
+			       &ifix->asid[0], 0x1009ull);
 	ptu_int_eq(status, 1);
 	ptu_ptr_eq(msec.section, &ifix->section[0]);
 	ptu_uint_eq(msec.vaddr, 0x1000ull);
@@ -1954,7 +2267,8 @@ static struct ptunit_result find_asid(struct image_fixture *ifix)
 	status = pt_section_put(msec.section);
 	ptu_int_eq(status, 0);
 
-	status = pt_image_find(&ifix->image, &msec, &ifix->asid[1], 0x1009ull);
+	status = pt_image_find(&ifix->image, &msec, NULL,
+			       &ifix->asid[1], 0x1009ull);
 	ptu_int_eq(status, 2);
 	ptu_ptr_eq(msec.section, &ifix->section[0]);
 	ptu_uint_eq(msec.vaddr, 0x1008ull);
@@ -1970,7 +2284,8 @@ static struct ptunit_result find_bad_asid(struct image_fixture *ifix)
 	struct pt_mapped_section msec;
 	int status;
 
-	status = pt_image_find(&ifix->image, &msec, &ifix->asid[0], 0x2003ull);
+	status = pt_image_find(&ifix->image, &msec, NULL,
+			       &ifix->asid[0], 0x2003ull);
 	ptu_int_eq(status, -pte_nomap);
 
 	return ptu_passed();
@@ -1981,7 +2296,8 @@ static struct ptunit_result find_nomem(struct image_fixture *ifix)
 	struct pt_mapped_section msec;
 	int status;
 
-	status = pt_image_find(&ifix->image, &msec, &ifix->asid[1], 0x1010ull);
+	status = pt_image_find(&ifix->image, &msec, NULL,
+			       &ifix->asid[1], 0x1010ull);
 	ptu_int_eq(status, -pte_nomap);
 
 	return ptu_passed();
@@ -1990,123 +2306,383 @@ static struct ptunit_result find_nomem(struct image_fixture *ifix)
 static struct ptunit_result validate_null(struct image_fixture *ifix)
 {
 	struct pt_mapped_section msec;
+	struct pt_msec_tag tag;
 	int status;
 
-	status = pt_image_validate(NULL, &msec, 0x1004ull, 10);
+	status = pt_image_validate(NULL, &msec, &tag, &ifix->asid[0],
+				   0x1004ull);
+	ptu_int_eq(status, -pte_internal);
+
+	status = pt_image_validate(&ifix->image, NULL, &tag, &ifix->asid[0],
+				   0x1004ull);
 	ptu_int_eq(status, -pte_internal);
 
-	status = pt_image_validate(&ifix->image, NULL, 0x1004ull, 10);
+	status = pt_image_validate(&ifix->image, &msec, NULL, &ifix->asid[0],
+				   0x1004ull);
+	ptu_int_eq(status, -pte_internal);
+
+	status = pt_image_validate(&ifix->image, &msec, &tag, NULL, 0x1004ull);
 	ptu_int_eq(status, -pte_internal);
 
 	return ptu_passed();
 }
 
+/* Find the section at 0x1003 in asid[0] and provide it in @msec and @tag. */
+static struct ptunit_result vfix_find(struct image_fixture *ifix,
+				      struct pt_mapped_section *msec,
+				      struct pt_msec_tag *tag)
+{
+	int isid, status;
+
+	isid = pt_image_find(&ifix->image, msec, tag, &ifix->asid[0],
+			     0x1003ull);
+	ptu_int_eq(isid, 10);
+
+	status = pt_section_put(msec->section);
+	ptu_int_eq(status, 0);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result validate(struct image_fixture *ifix)
 {
 	struct pt_mapped_section msec;
-	int isid, status;
+	struct pt_msec_tag tag;
+	int status;
 
-	isid = pt_image_find(&ifix->image, &msec, &ifix->asid[0], 0x1003ull);
-	ptu_int_ge(isid, 0);
+	ptu_test(vfix_find, ifix, &msec, &tag);
 
-	status = pt_section_put(msec.section);
+	status = pt_image_validate(&ifix->image, &msec, &tag, &ifix->asid[0],
+				   0x1004ull);
+	ptu_int_eq(status, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result validate_bad_vaddr(struct image_fixture *ifix)
+{
+	struct pt_mapped_section msec;
+	struct pt_msec_tag tag;
+	int status;
+
+	ptu_test(vfix_find, ifix, &msec, &tag);
+
+	msec.vaddr = 0x2000ull;
+
+	status = pt_image_validate(&ifix->image, &msec, &tag, &ifix->asid[0],
+				   0x1004ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result validate_reordered(struct image_fixture *ifix)
+{
+	struct pt_mapped_section msec, other;
+	struct pt_msec_tag tag;
+	int status;
+
+	ptu_test(vfix_find, ifix, &msec, &tag);
+
+	/* Move the other section to the front. */
+	status = pt_image_find(&ifix->image, &other, NULL, &ifix->asid[1],
+			       0x2003ull);
+	ptu_int_eq(status, 11);
+
+	status = pt_section_put(other.section);
 	ptu_int_eq(status, 0);
 
-	status = pt_image_validate(&ifix->image, &msec, 0x1004ull, isid);
+	status = pt_image_validate(&ifix->image, &msec, &tag, &ifix->asid[0],
+				   0x1004ull);
 	ptu_int_eq(status, 0);
 
 	return ptu_passed();
 }
 
-static struct ptunit_result validate_bad_asid(struct image_fixture *ifix)
+static struct ptunit_result validate_added(struct image_fixture *ifix)
 {
 	struct pt_mapped_section msec;
-	int isid, status;
+	struct pt_msec_tag tag;
+	int status;
 
-	isid = pt_image_find(&ifix->image, &msec, &ifix->asid[0], 0x1003ull);
-	ptu_int_ge(isid, 0);
+	ptu_test(vfix_find, ifix, &msec, &tag);
 
-	status = pt_section_put(msec.section);
+	status = pt_image_add(&ifix->image, &ifix->section[2], &ifix->asid[0],
+			      0x3000ull, 12);
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(tag.generation, ifix->image.generation);
+
+	status = pt_image_validate(&ifix->image, &msec, &tag, &ifix->asid[0],
+				   0x1004ull);
 	ptu_int_eq(status, 0);
 
-	msec.asid = ifix->asid[1];
+	return ptu_passed();
+}
+
+static struct ptunit_result validate_removed(struct image_fixture *ifix)
+{
+	struct pt_mapped_section msec;
+	struct pt_msec_tag tag;
+	int status;
 
-	status = pt_image_validate(&ifix->image, &msec, 0x1004ull, isid);
+	ptu_test(vfix_find, ifix, &msec, &tag);
+
+	status = pt_image_remove(&ifix->image, &ifix->section[0],
+				 &ifix->asid[0], 0x1000ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_validate(&ifix->image, &msec, &tag, &ifix->asid[0],
+				   0x1004ull);
 	ptu_int_eq(status, -pte_nomap);
 
 	return ptu_passed();
 }
 
-static struct ptunit_result validate_bad_vaddr(struct image_fixture *ifix)
+static struct ptunit_result validate_removed_other(struct image_fixture *ifix)
 {
 	struct pt_mapped_section msec;
-	int isid, status;
+	struct pt_msec_tag tag;
+	int status;
 
-	isid = pt_image_find(&ifix->image, &msec, &ifix->asid[0], 0x1003ull);
-	ptu_int_ge(isid, 0);
+	ptu_test(vfix_find, ifix, &msec, &tag);
 
-	status = pt_section_put(msec.section);
+	status = pt_image_remove(&ifix->image, &ifix->section[1],
+				 &ifix->asid[1], 0x2000ull);
 	ptu_int_eq(status, 0);
+	ptu_uint_ne(tag.generation, ifix->image.generation);
 
-	msec.vaddr = 0x2000ull;
+	status = pt_image_validate(&ifix->image, &msec, &tag, &ifix->asid[0],
+				   0x1004ull);
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(tag.generation, ifix->image.generation);
+
+	return ptu_passed();
+}
 
-	status = pt_image_validate(&ifix->image, &msec, 0x1004ull, isid);
+static struct ptunit_result validate_replaced(struct image_fixture *ifix)
+{
+	struct pt_mapped_section msec;
+	struct pt_msec_tag tag;
+	int status;
+
+	ptu_test(vfix_find, ifix, &msec, &tag);
+
+	/* Shrink the section by adding an overlapping section. */
+	status = pt_image_add(&ifix->image, &ifix->section[2], &ifix->asid[0],
+			      0x1008ull, 12);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_validate(&ifix->image, &msec, &tag, &ifix->asid[0],
+				   0x1004ull);
 	ptu_int_eq(status, -pte_nomap);
 
 	return ptu_passed();
 }
 
-static struct ptunit_result validate_bad_offset(struct image_fixture *ifix)
+static struct ptunit_result validate_other_asid(struct image_fixture *ifix)
 {
 	struct pt_mapped_section msec;
-	int isid, status;
+	struct pt_msec_tag tag;
+	int status;
 
-	isid = pt_image_find(&ifix->image, &msec, &ifix->asid[0], 0x1003ull);
-	ptu_int_ge(isid, 0);
+	ptu_test(vfix_find, ifix, &msec, &tag);
 
-	status = pt_section_put(msec.section);
+	status = pt_image_validate(&ifix->image, &msec, &tag, &ifix->asid[1],
+				   0x1004ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result validate_other_image(struct image_fixture *ifix)
+{
+	struct pt_mapped_section msec;
+	struct pt_msec_tag tag;
+	struct pt_image other;
+	int status;
+
+	ptu_test(vfix_find, ifix, &msec, &tag);
+
+	/* Map a different section at the same address in another image with
+	 * the same generation.
+	 */
+	pt_image_init(&other, NULL);
+
+	status = pt_image_add(&other, &ifix->section[1], &ifix->asid[0],
+			      0x1000ull, 11);
 	ptu_int_eq(status, 0);
 
-	msec.offset = 0x8ull;
+	other.generation = ifix->image.generation;
 
-	status = pt_image_validate(&ifix->image, &msec, 0x1004ull, isid);
+	status = pt_image_validate(&other, &msec, &tag, &ifix->asid[0],
+				   0x1004ull);
+	pt_image_fini(&other);
 	ptu_int_eq(status, -pte_nomap);
 
 	return ptu_passed();
 }
 
-static struct ptunit_result validate_bad_size(struct image_fixture *ifix)
+static struct ptunit_result freeze_null(void)
 {
-	struct pt_mapped_section msec;
-	int isid, status;
+	int status;
 
-	isid = pt_image_find(&ifix->image, &msec, &ifix->asid[0], 0x1003ull);
-	ptu_int_ge(isid, 0);
+	status = pt_image_freeze(NULL);
+	ptu_int_eq(status, -pte_invalid);
 
-	status = pt_section_put(msec.section);
+	return ptu_passed();
+}
+
+static struct ptunit_result freeze_empty(struct image_fixture *ifix)
+{
+	uint8_t buffer[] = { 0xcc };
+	int status, isid;
+
+	status = pt_image_freeze(&ifix->image);
 	ptu_int_eq(status, 0);
 
-	msec.size = 0x8ull;
+	isid = -1;
+	status = pt_image_read(&ifix->image, &isid, buffer, 1, &ifix->asid[0],
+			       0x1000ull);
+	ptu_int_eq(status, -pte_nomap);
+	ptu_int_eq(isid, -1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result freeze_read(struct image_fixture *ifix)
+{
+	const struct pt_section_list *head;
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status, isid;
+
+	status = pt_image_freeze(&ifix->image);
+	ptu_int_eq(status, 0);
+
+	head = ifix->image.sections;
 
-	status = pt_image_validate(&ifix->image, &msec, 0x1004ull, isid);
+	isid = -1;
+	status = pt_image_read(&ifix->image, &isid, buffer, 1, &ifix->asid[1],
+			       0x2003ull);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(isid, 11);
+	ptu_uint_eq(buffer[0], 0x03);
+
+	isid = -1;
+	status = pt_image_read(&ifix->image, &isid, buffer, 1, &ifix->asid[0],
+			       0x1005ull);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(isid, 10);
+	ptu_uint_eq(buffer[0], 0x05);
+
+	isid = -1;
+	status = pt_image_read(&ifix->image, &isid, buffer, 1, &ifix->asid[0],
+			       0x2003ull);
 	ptu_int_eq(status, -pte_nomap);
+	ptu_int_eq(isid, -1);
+
+	/* Lookups do not modify a frozen image. */
+	ptu_ptr_eq(ifix->image.sections, head);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result freeze_overlap(struct image_fixture *ifix)
+{
+	uint8_t buffer[] = { 0xcc };
+	int status, isid;
+
+	status = pt_image_add(&ifix->image, &ifix->section[0], &ifix->asid[0],
+			      0x1000ull, 1);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_add(&ifix->image, &ifix->section[1], &ifix->asid[1],
+			      0x1008ull, 2);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_add(&ifix->image, &ifix->section[2], &ifix->asid[0],
+			      0x1010ull, 3);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_freeze(&ifix->image);
+	ptu_int_eq(status, 0);
+
+	isid = -1;
+	status = pt_image_read(&ifix->image, &isid, buffer, 1, &ifix->asid[0],
+			       0x1009ull);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(isid, 1);
+	ptu_uint_eq(buffer[0], 0x09);
+
+	isid = -1;
+	status = pt_image_read(&ifix->image, &isid, buffer, 1, &ifix->asid[1],
+			       0x1009ull);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(isid, 2);
+	ptu_uint_eq(buffer[0], 0x01);
+
+	isid = -1;
+	status = pt_image_read(&ifix->image, &isid, buffer, 1, &ifix->asid[0],
+			       0x1011ull);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(isid, 3);
+	ptu_uint_eq(buffer[0], 0x01);
 
 	return ptu_passed();
 }
 
-static struct ptunit_result validate_bad_isid(struct image_fixture *ifix)
+static struct ptunit_result freeze_find(struct image_fixture *ifix)
 {
 	struct pt_mapped_section msec;
-	int isid, status;
+	struct pt_msec_tag tag;
+	int status;
 
-	isid = pt_image_find(&ifix->image, &msec, &ifix->asid[0], 0x1003ull);
-	ptu_int_ge(isid, 0);
+	status = pt_image_freeze(&ifix->image);
+	ptu_int_eq(status, 0);
 
-	status = pt_section_put(msec.section);
+	ptu_test(vfix_find, ifix, &msec, &tag);
+	ptu_ptr_eq(msec.section, &ifix->section[0]);
+
+	status = pt_image_validate(&ifix->image, &msec, &tag, &ifix->asid[0],
+				   0x1004ull);
 	ptu_int_eq(status, 0);
 
-	status = pt_image_validate(&ifix->image, &msec, 0x1004ull, isid + 1);
-	ptu_int_eq(status, -pte_nomap);
+	return ptu_passed();
+}
+
+static struct ptunit_result freeze_modify(struct image_fixture *ifix)
+{
+	int status;
+
+	status = pt_image_freeze(&ifix->image);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_freeze(&ifix->image);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_add(&ifix->image, &ifix->section[2], &ifix->asid[2],
+			      0x3000ull, 12);
+	ptu_int_eq(status, -pte_not_supported);
+
+	status = pt_image_remove(&ifix->image, &ifix->section[0],
+				 &ifix->asid[0], 0x1000ull);
+	ptu_int_eq(status, -pte_not_supported);
+
+	status = pt_image_remove_by_filename(&ifix->image, "file-0",
+					     &ifix->asid[0]);
+	ptu_int_eq(status, -pte_not_supported);
+
+	status = pt_image_remove_by_asid(&ifix->image, &ifix->asid[0]);
+	ptu_int_eq(status, -pte_not_supported);
+
+	status = pt_image_copy(&ifix->image, &ifix->copy);
+	ptu_int_eq(status, -pte_not_supported);
+
+	status = pt_image_set_callback(&ifix->image, NULL, NULL);
+	ptu_int_eq(status, -pte_not_supported);
+
+	/* A frozen image can still be copied into a normal image. */
+	status = pt_image_copy(&ifix->copy, &ifix->image);
+	ptu_int_eq(status, 0);
 
 	return ptu_passed();
 }
@@ -2124,6 +2700,7 @@ static struct ptunit_result ifix_init(struct image_fixture *ifix)
 	memset(&ifix->iscache, 0, sizeof(ifix->iscache));
 
 	ifix->nsecs = 0;
+	ifix_mk_section = NULL;
 
 	index = ifix_add_section(ifix, "file-0");
 	ptu_int_eq(index, 0);
@@ -2268,6 +2845,20 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, add_cached_twice, ifix);
 	ptu_run_f(suite, add_cached_bad_isid, ifix);
 
+	ptu_run(suite, set_coalesce_null);
+	ptu_run_f(suite, coalesce, ifix);
+	ptu_run_f(suite, coalesce_disabled, ifix);
+	ptu_run_f(suite, coalesce_gap, ifix);
+	ptu_run_f(suite, coalesce_asid, ifix);
+	ptu_run_f(suite, coalesce_isid, ifix);
+	ptu_run_f(suite, coalesce_memory, ifix);
+	ptu_run_f(suite, coalesce_fail, ifix);
+	ptu_run_f(suite, coalesce_remove, ifix);
+	ptu_run_f(suite, coalesce_remove_by_filename, ifix);
+	ptu_run_f(suite, coalesce_remove_by_asid, ifix);
+	ptu_run_f(suite, coalesce_overlap, ifix);
+	ptu_run_f(suite, coalesce_copy, ifix);
+
 	ptu_run_f(suite, find_null, rfix);
 	ptu_run_f(suite, find, rfix);
 	ptu_run_f(suite, find_asid, ifix);
@@ -2276,11 +2867,21 @@ int main(int argc, char **argv)
 
 	ptu_run_f(suite, validate_null, rfix);
 	ptu_run_f(suite, validate, rfix);
-	ptu_run_f(suite, validate_bad_asid, rfix);
 	ptu_run_f(suite, validate_bad_vaddr, rfix);
-	ptu_run_f(suite, validate_bad_offset, rfix);
-	ptu_run_f(suite, validate_bad_size, rfix);
-	ptu_run_f(suite, validate_bad_isid, rfix);
+	ptu_run_f(suite, validate_reordered, rfix);
+	ptu_run_f(suite, validate_added, rfix);
+	ptu_run_f(suite, validate_removed, rfix);
+	ptu_run_f(suite, validate_removed_other, rfix);
+	ptu_run_f(suite, validate_replaced, rfix);
+	ptu_run_f(suite, validate_other_asid, rfix);
+	ptu_run_f(suite, validate_other_image, rfix);
+
+	ptu_run(suite, freeze_null);
+	ptu_run_f(suite, freeze_empty, ifix);
+	ptu_run_f(suite, freeze_read, rfix);
+	ptu_run_f(suite, freeze_overlap, ifix);
+	ptu_run_f(suite, freeze_find, rfix);
+	ptu_run_f(suite, freeze_modify, rfix);
 
 	return ptunit_report(&suite);
 }
@@ -83,6 +83,7 @@ extern int pt_section_map(struct pt_section *section);
 extern int pt_section_map_share(struct pt_section *section);
 extern int pt_section_unmap(struct pt_section *section);
 extern int pt_section_request_bcache(struct pt_section *section);
+extern int pt_section_alloc_bcache(struct pt_section *section);
 
 extern const char *pt_section_filename(const struct pt_section *section);
 extern uint64_t pt_section_offset(const struct pt_section *section);
@@ -455,6 +456,11 @@ out_alock:
 	return errcode;
 }
 
+int pt_section_alloc_bcache(struct pt_section *section)
+{
+	return pt_section_request_bcache(section);
+}
+
 const char *pt_section_filename(const struct pt_section *section)
 {
 	if (!section)
@@ -738,6 +744,16 @@ static struct ptunit_result read_null(void)
 	return ptu_passed();
 }
 
+static struct ptunit_result warm_null(void)
+{
+	int errcode;
+
+	errcode = pt_iscache_warm(NULL, 1, 1);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result init_fini(struct iscache_fixture *cfix)
 {
 	(void) cfix;
@@ -1270,6 +1286,65 @@ static struct ptunit_result lru_read(struct iscache_fixture *cfix)
 	return ptu_passed();
 }
 
+static struct ptunit_result lru_warm(struct iscache_fixture *cfix)
+{
+	int status, isid;
+
+	cfix->iscache.limit = cfix->section[0]->size;
+	ptu_uint_eq(cfix->iscache.used, 0ull);
+	ptu_null(cfix->iscache.lru);
+
+	isid = pt_iscache_add(&cfix->iscache, cfix->section[0], 0xa000ull);
+	ptu_int_gt(isid, 0);
+
+	status = pt_iscache_warm(&cfix->iscache, isid, 0);
+	ptu_int_eq(status, 0);
+
+	ptu_ptr(cfix->iscache.lru);
+	ptu_ptr_eq(cfix->iscache.lru->section, cfix->section[0]);
+	ptu_null(cfix->iscache.lru->next);
+	ptu_uint_eq(cfix->iscache.used, cfix->section[0]->size);
+	ptu_uint_eq(cfix->section[0]->bcsize, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result lru_warm_bcache(struct iscache_fixture *cfix)
+{
+	int status, isid;
+
+	cfix->iscache.limit = 4 * cfix->section[0]->size;
+	ptu_uint_eq(cfix->iscache.used, 0ull);
+	ptu_null(cfix->iscache.lru);
+
+	isid = pt_iscache_add(&cfix->iscache, cfix->section[0], 0xa000ull);
+	ptu_int_gt(isid, 0);
+
+	status = pt_iscache_warm(&cfix->iscache, isid, 1);
+	ptu_int_eq(status, 0);
+
+	ptu_ptr(cfix->iscache.lru);
+	ptu_ptr_eq(cfix->iscache.lru->section, cfix->section[0]);
+	ptu_null(cfix->iscache.lru->next);
+	ptu_uint_eq(cfix->iscache.used, 4 * cfix->section[0]->size);
+	ptu_int_eq(cfix->section[0]->mcount, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result warm_bad_isid(struct iscache_fixture *cfix)
+{
+	int status, isid;
+
+	isid = pt_iscache_add(&cfix->iscache, cfix->section[0], 0xa000ull);
+	ptu_int_gt(isid, 0);
+
+	status = pt_iscache_warm(&cfix->iscache, isid + 1, 1);
+	ptu_int_eq(status, -pte_bad_image);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result lru_map_nodup(struct iscache_fixture *cfix)
 {
 	int status, isid;
@@ -1962,6 +2037,7 @@ int main(int argc, char **argv)
 	ptu_run(suite, free_null);
 	ptu_run(suite, add_file_null);
 	ptu_run(suite, read_null);
+	ptu_run(suite, warm_null);
 
 	ptu_run_f(suite, name, dfix);
 	ptu_run_f(suite, name_none, dfix);
@@ -2000,9 +2076,12 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, read_truncate, cfix);
 	ptu_run_f(suite, read_bad_vaddr, cfix);
 	ptu_run_f(suite, read_bad_isid, cfix);
+	ptu_run_f(suite, warm_bad_isid, cfix);
 
 	ptu_run_f(suite, lru_map, cfix);
 	ptu_run_f(suite, lru_read, cfix);
+	ptu_run_f(suite, lru_warm, cfix);
+	ptu_run_f(suite, lru_warm_bcache, cfix);
 	ptu_run_f(suite, lru_map_nodup, cfix);
 	ptu_run_f(suite, lru_map_too_big, cfix);
 	ptu_run_f(suite, lru_map_add_front, cfix);
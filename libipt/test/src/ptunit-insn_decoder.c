@@ -0,0 +1,463 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+#include "ptunit_mkfile.h"
+
+#include "intel-pt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+enum {
+	/* The load address of the test code. */
+	ifix_base	= 0x1000,
+
+	/* The number of instructions in the test code. */
+	ifix_ninsn	= 3,
+
+	/* The number of instructions in the trace. */
+	ifix_ntrace	= 2 * ifix_ninsn
+};
+
+/* The test code.
+ *
+ * The trace runs through it twice.  The indirect jump branches back to the
+ * beginning the first time and disables tracing the second time.
+ */
+static const uint8_t ifix_code[] = {
+	/* 0x1000: mov $0x12345678, %eax */
+	0xb8, 0x78, 0x56, 0x34, 0x12,
+	/* 0x1005: nop */
+	0x90,
+	/* 0x1006: jmp *%rax */
+	0xff, 0xe0
+};
+
+/* The offsets of the instructions in the test code. */
+static const uint8_t ifix_offset[ifix_ninsn] = { 0x0, 0x5, 0x6 };
+
+/* The sizes of the instructions in the test code. */
+static const uint8_t ifix_size[ifix_ninsn] = { 5, 1, 2 };
+
+/* A test fixture providing trace for the above code. */
+struct insn_fixture {
+	/* The trace buffer. */
+	uint8_t buffer[64];
+
+	/* The configuration for decoding the trace in @buffer. */
+	struct pt_config config;
+
+	/* The image containing the test code. */
+	struct pt_image *image;
+
+	/* The file containing the test code. */
+	FILE *file;
+	char *name;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct insn_fixture *);
+	struct ptunit_result (*fini)(struct insn_fixture *);
+};
+
+/* Add the test code in @ifix's file to @ifix's image.
+ *
+ * If @split is not zero, the code is added as two sections, the second of
+ * which starts at @split bytes into the code.
+ */
+static struct ptunit_result ifix_add_code(struct insn_fixture *ifix,
+					  uint64_t split)
+{
+	int errcode;
+
+	if (!split)
+		split = sizeof(ifix_code);
+
+	errcode = pt_image_add_file(ifix->image, ifix->name, 0ull, split, NULL,
+				    ifix_base);
+	ptu_int_eq(errcode, 0);
+
+	if (split < sizeof(ifix_code)) {
+		errcode = pt_image_add_file(ifix->image, ifix->name, split,
+					    sizeof(ifix_code) - split, NULL,
+					    ifix_base + split);
+		ptu_int_eq(errcode, 0);
+	}
+
+	return ptu_passed();
+}
+
+/* Drain pending events. */
+static int ifix_drain_events(struct pt_insn_decoder *decoder, int status)
+{
+	while (status & pts_event_pending) {
+		struct pt_event event;
+
+		status = pt_insn_event(decoder, &event, sizeof(event));
+		if (status < 0)
+			return status;
+	}
+
+	return status;
+}
+
+/* Allocate an instruction flow decoder using @flags and synchronize it onto
+ * the trace.
+ */
+static struct pt_insn_decoder *
+ifix_alloc_decoder(struct insn_fixture *ifix,
+		   const struct pt_conf_flags *flags)
+{
+	struct pt_insn_decoder *decoder;
+	struct pt_config config;
+	int errcode;
+
+	config = ifix->config;
+	if (flags)
+		config.flags = *flags;
+
+	decoder = pt_insn_alloc_decoder(&config);
+	if (!decoder)
+		return NULL;
+
+	errcode = pt_insn_set_image(decoder, ifix->image);
+	if (errcode < 0) {
+		pt_insn_free_decoder(decoder);
+		return NULL;
+	}
+
+	errcode = pt_insn_sync_forward(decoder);
+	if (errcode >= 0)
+		errcode = ifix_drain_events(decoder, errcode);
+
+	if (errcode < 0) {
+		pt_insn_free_decoder(decoder);
+		return NULL;
+	}
+
+	return decoder;
+}
+
+/* Decode the next instruction into @insn and check it against the test code
+ * instruction at @idx modulo ifix_ninsn.
+ *
+ * If @in_place is not zero, the instruction's bytes must point into the
+ * section memory; otherwise, they must point to @insn->raw.
+ */
+static struct ptunit_result ifix_next(struct pt_insn_decoder *decoder,
+				      struct pt_insn *insn, int idx,
+				      int in_place)
+{
+	int status;
+
+	idx %= ifix_ninsn;
+
+	status = pt_insn_next(decoder, insn, sizeof(*insn));
+	ptu_int_ge(status, 0);
+
+	status = ifix_drain_events(decoder, status);
+	ptu_int_ge(status, 0);
+
+	ptu_uint_eq(insn->ip, ifix_base + ifix_offset[idx]);
+	ptu_uint_eq(insn->size, ifix_size[idx]);
+	ptu_ptr(insn->bytes);
+	ptu_int_eq(memcmp(insn->bytes, &ifix_code[ifix_offset[idx]],
+			  insn->size), 0);
+
+	if (in_place)
+		ptu_ptr_ne(insn->bytes, insn->raw);
+	else {
+		ptu_ptr_eq(insn->bytes, insn->raw);
+		ptu_int_eq(memcmp(insn->raw, &ifix_code[ifix_offset[idx]],
+				  insn->size), 0);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result zero_copy(struct insn_fixture *ifix)
+{
+	struct pt_insn_decoder *decoder;
+	struct pt_conf_flags flags;
+	struct pt_insn insn;
+	int idx, status;
+
+	ptu_test(ifix_add_code, ifix, 0ull);
+
+	memset(&flags, 0, sizeof(flags));
+	flags.variant.insn.enable_zero_copy = 1;
+
+	decoder = ifix_alloc_decoder(ifix, &flags);
+	ptu_ptr(decoder);
+
+	for (idx = 0; idx < ifix_ntrace; ++idx)
+		ptu_test(ifix_next, decoder, &insn, idx, 1);
+
+	status = pt_insn_next(decoder, &insn, sizeof(insn));
+	ptu_int_eq(status, -pte_eos);
+
+	pt_insn_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result zero_copy_disabled(struct insn_fixture *ifix)
+{
+	struct pt_insn_decoder *decoder;
+	struct pt_insn insn;
+	int idx, status;
+
+	ptu_test(ifix_add_code, ifix, 0ull);
+
+	decoder = ifix_alloc_decoder(ifix, NULL);
+	ptu_ptr(decoder);
+
+	for (idx = 0; idx < ifix_ntrace; ++idx)
+		ptu_test(ifix_next, decoder, &insn, idx, 0);
+
+	status = pt_insn_next(decoder, &insn, sizeof(insn));
+	ptu_int_eq(status, -pte_eos);
+
+	pt_insn_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result zero_copy_truncated(struct insn_fixture *ifix)
+{
+	struct pt_insn_decoder *decoder;
+	struct pt_conf_flags flags;
+	struct pt_insn insn;
+	int idx, status;
+
+	/* Split the first instruction across two sections. */
+	ptu_test(ifix_add_code, ifix, 3ull);
+
+	memset(&flags, 0, sizeof(flags));
+	flags.variant.insn.enable_zero_copy = 1;
+
+	decoder = ifix_alloc_decoder(ifix, &flags);
+	ptu_ptr(decoder);
+
+	/* The truncated instruction must be copied. */
+	for (idx = 0; idx < ifix_ntrace; ++idx) {
+		if (!(idx % ifix_ninsn)) {
+			ptu_test(ifix_next, decoder, &insn, idx, 0);
+			ptu_uint_eq(insn.truncated, 1);
+		} else {
+			ptu_test(ifix_next, decoder, &insn, idx, 1);
+			ptu_uint_eq(insn.truncated, 0);
+		}
+	}
+
+	status = pt_insn_next(decoder, &insn, sizeof(insn));
+	ptu_int_eq(status, -pte_eos);
+
+	pt_insn_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result set_image(struct insn_fixture *ifix)
+{
+	struct pt_insn_decoder *decoder;
+	struct pt_image *image;
+	struct pt_insn insn;
+	uint8_t code[sizeof(ifix_code)];
+	size_t written;
+	char *name;
+	FILE *file;
+	int idx, errcode;
+
+	ptu_test(ifix_add_code, ifix, 0ull);
+
+	/* The same code with a different immediate in a different image.
+	 *
+	 * Both images are built the same way so their sections match in
+	 * everything but their content.
+	 */
+	memcpy(code, ifix_code, sizeof(code));
+	memset(&code[1], 0xbb, 4);
+
+	errcode = ptunit_mkfile(&file, &name, "wb");
+	ptu_int_eq(errcode, 0);
+
+	written = fwrite(code, sizeof(code), 1, file);
+	ptu_uint_eq(written, 1);
+
+	errcode = fflush(file);
+	ptu_int_eq(errcode, 0);
+
+	image = pt_image_alloc(NULL);
+	ptu_ptr(image);
+
+	errcode = pt_image_add_file(image, name, 0ull, sizeof(code), NULL,
+				    ifix_base);
+	ptu_int_eq(errcode, 0);
+
+	decoder = ifix_alloc_decoder(ifix, NULL);
+	ptu_ptr(decoder);
+
+	for (idx = 0; idx < ifix_ninsn; ++idx)
+		ptu_test(ifix_next, decoder, &insn, idx, 0);
+
+	/* The section cached from the old image must not be used. */
+	errcode = pt_insn_set_image(decoder, image);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_next(decoder, &insn, sizeof(insn));
+	ptu_int_ge(errcode, 0);
+	ptu_uint_eq(insn.ip, ifix_base);
+	ptu_uint_eq(insn.size, sizeof(code[0]) + 4);
+	ptu_int_eq(memcmp(insn.raw, code, insn.size), 0);
+
+	pt_insn_free_decoder(decoder);
+	pt_image_free(image);
+
+	fclose(file);
+	remove(name);
+	free(name);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result ifix_init(struct insn_fixture *ifix)
+{
+	struct pt_encoder *encoder;
+	struct pt_packet packet;
+	uint64_t size;
+	size_t written;
+	int errcode;
+
+	memset(ifix->buffer, 0, sizeof(ifix->buffer));
+
+	pt_config_init(&ifix->config);
+	ifix->config.begin = ifix->buffer;
+	ifix->config.end = ifix->buffer + sizeof(ifix->buffer);
+
+	encoder = pt_alloc_encoder(&ifix->config);
+	ptu_ptr(encoder);
+
+	memset(&packet, 0, sizeof(packet));
+	packet.type = ppt_psb;
+	errcode = pt_enc_next(encoder, &packet);
+	ptu_int_gt(errcode, 0);
+
+	memset(&packet, 0, sizeof(packet));
+	packet.type = ppt_mode;
+	packet.payload.mode.leaf = pt_mol_exec;
+	packet.payload.mode.bits.exec = pt_set_exec_mode(ptem_64bit);
+	errcode = pt_enc_next(encoder, &packet);
+	ptu_int_gt(errcode, 0);
+
+	memset(&packet, 0, sizeof(packet));
+	packet.type = ppt_fup;
+	packet.payload.ip.ipc = pt_ipc_sext_48;
+	packet.payload.ip.ip = ifix_base;
+	errcode = pt_enc_next(encoder, &packet);
+	ptu_int_gt(errcode, 0);
+
+	memset(&packet, 0, sizeof(packet));
+	packet.type = ppt_psbend;
+	errcode = pt_enc_next(encoder, &packet);
+	ptu_int_gt(errcode, 0);
+
+	memset(&packet, 0, sizeof(packet));
+	packet.type = ppt_tip;
+	packet.payload.ip.ipc = pt_ipc_sext_48;
+	packet.payload.ip.ip = ifix_base;
+	errcode = pt_enc_next(encoder, &packet);
+	ptu_int_gt(errcode, 0);
+
+	memset(&packet, 0, sizeof(packet));
+	packet.type = ppt_tip_pgd;
+	packet.payload.ip.ipc = pt_ipc_sext_48;
+	packet.payload.ip.ip = ifix_base;
+	errcode = pt_enc_next(encoder, &packet);
+	ptu_int_gt(errcode, 0);
+
+	errcode = pt_enc_get_offset(encoder, &size);
+	ptu_int_eq(errcode, 0);
+
+	pt_free_encoder(encoder);
+
+	ifix->config.end = ifix->buffer + size;
+
+	errcode = ptunit_mkfile(&ifix->file, &ifix->name, "wb");
+	ptu_int_eq(errcode, 0);
+
+	written = fwrite(ifix_code, sizeof(ifix_code), 1, ifix->file);
+	ptu_uint_eq(written, 1);
+
+	errcode = fflush(ifix->file);
+	ptu_int_eq(errcode, 0);
+
+	ifix->image = pt_image_alloc(NULL);
+	ptu_ptr(ifix->image);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result ifix_fini(struct insn_fixture *ifix)
+{
+	pt_image_free(ifix->image);
+	ifix->image = NULL;
+
+	if (ifix->file) {
+		fclose(ifix->file);
+		ifix->file = NULL;
+
+		if (ifix->name)
+			remove(ifix->name);
+	}
+
+	free(ifix->name);
+	ifix->name = NULL;
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct insn_fixture ifix;
+	struct ptunit_suite suite;
+
+	ifix.init = ifix_init;
+	ifix.fini = ifix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run_f(suite, zero_copy, ifix);
+	ptu_run_f(suite, zero_copy_disabled, ifix);
+	ptu_run_f(suite, zero_copy_truncated, ifix);
+	ptu_run_f(suite, set_image, ifix);
+
+	return ptunit_report(&suite);
+}
@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_insn_mix.h"
+#include "pt_ild.h"
+#include "pt_image.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+#include <stddef.h>
+
+
+/* A mock image section cache providing a single section. */
+struct pt_image_section_cache {
+	/* The section identifier. */
+	int isid;
+
+	/* The virtual address at which the section is loaded. */
+	uint64_t vaddr;
+
+	/* The section's memory. */
+	uint8_t code[0x20];
+
+	/* The number of read requests. */
+	uint32_t nreads;
+};
+
+int pt_iscache_read(struct pt_image_section_cache *iscache, uint8_t *buffer,
+		    uint64_t size, int isid, uint64_t vaddr)
+{
+	uint64_t offset;
+
+	if (!iscache || !buffer || !size)
+		return -pte_invalid;
+
+	if (isid != iscache->isid)
+		return -pte_bad_image;
+
+	offset = vaddr - iscache->vaddr;
+	if ((vaddr < iscache->vaddr) || (sizeof(iscache->code) <= offset))
+		return -pte_nomap;
+
+	if ((sizeof(iscache->code) - offset) < size)
+		size = sizeof(iscache->code) - offset;
+
+	memcpy(buffer, &iscache->code[offset], (size_t) size);
+	iscache->nreads += 1;
+
+	return (int) size;
+}
+
+int pt_image_read(struct pt_image *image, int *isid, uint8_t *buffer,
+		  uint16_t size, const struct pt_asid *asid, uint64_t addr)
+{
+	(void) image;
+	(void) isid;
+	(void) buffer;
+	(void) size;
+	(void) asid;
+	(void) addr;
+
+	return -pte_internal;
+}
+
+/* A test fixture providing an instruction mix profile. */
+struct mix_fixture {
+	/* The profile. */
+	struct pt_insn_mix mix;
+
+	/* The image section cache. */
+	struct pt_image_section_cache iscache;
+
+	/* A block of instructions in @iscache. */
+	struct pt_block block;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct mix_fixture *);
+	struct ptunit_result (*fini)(struct mix_fixture *);
+};
+
+static struct ptunit_result mfix_init(struct mix_fixture *mfix)
+{
+	static const uint8_t code[] = {
+		/* 0x1000: nop */
+		0x90,
+		/* 0x1001: call 0x1006 */
+		0xe8, 0x00, 0x00, 0x00, 0x00,
+		/* 0x1006: jmp 0x1009 */
+		0xeb, 0x01,
+		/* 0x1008: nop */
+		0x90,
+		/* 0x1009: nop */
+		0x90,
+		/* 0x100a: ret */
+		0xc3
+	};
+	int errcode;
+
+	memset(&mfix->iscache, 0, sizeof(mfix->iscache));
+	mfix->iscache.isid = 1;
+	mfix->iscache.vaddr = 0x1000ull;
+	memcpy(mfix->iscache.code, code, sizeof(code));
+
+	memset(&mfix->block, 0, sizeof(mfix->block));
+	mfix->block.ip = 0x1000ull;
+	mfix->block.end_ip = 0x100aull;
+	mfix->block.isid = 1;
+	mfix->block.mode = ptem_64bit;
+	mfix->block.ninsn = 5;
+
+	errcode = pt_mix_init(&mfix->mix, &mfix->iscache);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result mfix_fini(struct mix_fixture *mfix)
+{
+	pt_mix_fini(&mfix->mix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_null(void)
+{
+	int errcode;
+
+	errcode = pt_mix_init(NULL, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fini_null(void)
+{
+	pt_mix_fini(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result summarize_null(void)
+{
+	struct pt_mix_block mblock;
+	struct pt_block block;
+	int errcode;
+
+	memset(&block, 0, sizeof(block));
+
+	errcode = pt_mix_summarize(NULL, &block, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_mix_summarize(&mblock, NULL, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_null(struct mix_fixture *mfix)
+{
+	int errcode;
+
+	errcode = pt_mix_add_block(NULL, &mfix->block);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_mix_add_block(&mfix->mix, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result query_null(struct mix_fixture *mfix)
+{
+	struct pt_mix_counts counts;
+	int errcode;
+
+	errcode = pt_mix_query(NULL, &counts, sizeof(counts), 0, 0ull,
+			       UINT64_MAX);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_mix_query(&mfix->mix, NULL, sizeof(counts), 0, 0ull,
+			       UINT64_MAX);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_mix_query(&mfix->mix, &counts, 0, 0, 0ull, UINT64_MAX);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result summarize(struct mix_fixture *mfix)
+{
+	struct pt_mix_block mblock;
+	int errcode;
+
+	errcode = pt_mix_summarize(&mblock, &mfix->block, &mfix->iscache);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(mblock.ip, 0x1000ull);
+	ptu_uint_eq(mblock.ninsn, 5);
+	ptu_uint_eq(mblock.count, 0ull);
+	ptu_uint_eq(mblock.iclass[ptic_other], 2);
+	ptu_uint_eq(mblock.iclass[ptic_call], 1);
+	ptu_uint_eq(mblock.iclass[ptic_jump], 1);
+	ptu_uint_eq(mblock.iclass[ptic_return], 1);
+	ptu_uint_eq(mblock.iclass[ptic_cond_jump], 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result summarize_truncated(struct mix_fixture *mfix)
+{
+	struct pt_mix_block mblock;
+	int errcode;
+
+	/* Replace the ret in memory; the block provides the real bytes. */
+	mfix->iscache.code[0xa] = 0x90;
+
+	mfix->block.truncated = 1;
+	mfix->block.raw[0] = 0xc3;
+	mfix->block.size = 1;
+
+	errcode = pt_mix_summarize(&mblock, &mfix->block, &mfix->iscache);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(mblock.iclass[ptic_other], 2);
+	ptu_uint_eq(mblock.iclass[ptic_return], 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_empty(struct mix_fixture *mfix)
+{
+	struct pt_mix_counts counts;
+	int errcode;
+
+	mfix->block.ninsn = 0;
+
+	errcode = pt_mix_add_block(&mfix->mix, &mfix->block);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_mix_query(&mfix->mix, &counts, sizeof(counts), 0, 0ull,
+			       UINT64_MAX);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(counts.nblocks, 0ull);
+	ptu_uint_eq(counts.ninsn, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_no_isid(struct mix_fixture *mfix)
+{
+	int errcode;
+
+	mfix->block.isid = 0;
+
+	errcode = pt_mix_add_block(&mfix->mix, &mfix->block);
+	ptu_int_eq(errcode, -pte_bad_image);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_nomap(struct mix_fixture *mfix)
+{
+	int errcode;
+
+	mfix->block.ip = 0x2000ull;
+
+	errcode = pt_mix_add_block(&mfix->mix, &mfix->block);
+	ptu_int_eq(errcode, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add(struct mix_fixture *mfix)
+{
+	struct pt_mix_counts counts;
+	uint32_t nreads;
+	int errcode;
+
+	errcode = pt_mix_add_block(&mfix->mix, &mfix->block);
+	ptu_int_eq(errcode, 0);
+
+	nreads = mfix->iscache.nreads;
+	ptu_uint_eq(nreads, 5);
+
+	/* The second execution uses the cached summary. */
+	errcode = pt_mix_add_block(&mfix->mix, &mfix->block);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(mfix->iscache.nreads, nreads);
+
+	/* A block ending early gets its own summary. */
+	mfix->block.ninsn = 2;
+
+	errcode = pt_mix_add_block(&mfix->mix, &mfix->block);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(mfix->iscache.nreads, nreads + 2);
+
+	errcode = pt_mix_query(&mfix->mix, &counts, sizeof(counts), 0, 0ull,
+			       UINT64_MAX);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(counts.nblocks, 3ull);
+	ptu_uint_eq(counts.ninsn, 12ull);
+	ptu_uint_eq(counts.iclass[ptic_other], 5ull);
+	ptu_uint_eq(counts.iclass[ptic_call], 3ull);
+	ptu_uint_eq(counts.iclass[ptic_jump], 2ull);
+	ptu_uint_eq(counts.iclass[ptic_return], 2ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result query_range(struct mix_fixture *mfix)
+{
+	struct pt_mix_counts counts;
+	int errcode;
+
+	errcode = pt_mix_add_block(&mfix->mix, &mfix->block);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_mix_query(&mfix->mix, &counts, sizeof(counts), 0, 0x1001ull,
+			       UINT64_MAX);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(counts.nblocks, 0ull);
+
+	errcode = pt_mix_query(&mfix->mix, &counts, sizeof(counts), 2, 0ull,
+			       UINT64_MAX);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(counts.nblocks, 0ull);
+
+	errcode = pt_mix_query(&mfix->mix, &counts, sizeof(counts), 1, 0x1000ull,
+			       0x1001ull);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(counts.nblocks, 1ull);
+	ptu_uint_eq(counts.ninsn, 5ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result query_size(struct mix_fixture *mfix)
+{
+	uint8_t buffer[sizeof(struct pt_mix_counts) + 8];
+	struct pt_mix_counts *counts;
+	size_t size;
+	int errcode;
+
+	errcode = pt_mix_add_block(&mfix->mix, &mfix->block);
+	ptu_int_eq(errcode, 0);
+
+	counts = (struct pt_mix_counts *) buffer;
+
+	/* The counts must at least cover @nblocks and @ninsn. */
+	size = offsetof(struct pt_mix_counts, iclass);
+
+	errcode = pt_mix_query(&mfix->mix, counts, size - 1, 0, 0ull,
+			       UINT64_MAX);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	/* Instruction classes beyond @size are not provided. */
+	memset(buffer, 0xcc, sizeof(buffer));
+
+	errcode = pt_mix_query(&mfix->mix, counts, size, 0, 0ull, UINT64_MAX);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(counts->nblocks, 1ull);
+	ptu_uint_eq(counts->ninsn, 5ull);
+	ptu_uint_eq(buffer[size], 0xcc);
+
+	/* Bytes beyond struct pt_mix_counts are zeroed. */
+	memset(buffer, 0xcc, sizeof(buffer));
+
+	errcode = pt_mix_query(&mfix->mix, counts, sizeof(buffer), 0, 0ull,
+			       UINT64_MAX);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(counts->nblocks, 1ull);
+	ptu_uint_eq(counts->iclass[ptic_return], 1ull);
+	ptu_uint_eq(buffer[sizeof(buffer) - 1], 0);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct ptunit_suite suite;
+	struct mix_fixture mfix;
+
+	pt_ild_init();
+
+	mfix.init = mfix_init;
+	mfix.fini = mfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, init_null);
+	ptu_run(suite, fini_null);
+	ptu_run(suite, summarize_null);
+	ptu_run_f(suite, add_null, mfix);
+	ptu_run_f(suite, query_null, mfix);
+
+	ptu_run_f(suite, summarize, mfix);
+	ptu_run_f(suite, summarize_truncated, mfix);
+	ptu_run_f(suite, add_empty, mfix);
+	ptu_run_f(suite, add_no_isid, mfix);
+	ptu_run_f(suite, add_nomap, mfix);
+	ptu_run_f(suite, add, mfix);
+	ptu_run_f(suite, query_range, mfix);
+	ptu_run_f(suite, query_size, mfix);
+
+	return ptunit_report(&suite);
+}
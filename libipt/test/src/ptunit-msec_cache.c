@@ -111,19 +111,21 @@ struct pt_image {
 };
 
 extern int pt_image_validate(struct pt_image *, struct pt_mapped_section *,
-			     uint64_t, int);
+			     struct pt_msec_tag *, const struct pt_asid *,
+			     uint64_t);
 extern int pt_image_find(struct pt_image *, struct pt_mapped_section *,
-			 const struct pt_asid *, uint64_t);
+			 struct pt_msec_tag *, const struct pt_asid *,
+			 uint64_t);
 
 int pt_image_validate(struct pt_image *image, struct pt_mapped_section *msec,
-		      uint64_t vaddr, int isid)
+		      struct pt_msec_tag *tag, const struct pt_asid *asid,
+		      uint64_t vaddr)
 {
 	struct pt_section *section;
 
 	(void) vaddr;
-	(void) isid;
 
-	if (!image || !msec)
+	if (!image || !msec || !tag || !asid)
 		return -pte_internal;
 
 	section = image->section;
@@ -137,10 +139,12 @@ int pt_image_validate(struct pt_image *image, struct pt_mapped_section *msec,
 }
 
 int pt_image_find(struct pt_image *image, struct pt_mapped_section *msec,
-		  const struct pt_asid *asid, uint64_t vaddr)
+		  struct pt_msec_tag *tag, const struct pt_asid *asid,
+		  uint64_t vaddr)
 {
 	struct pt_section *section;
 
+	(void) tag;
 	(void) vaddr;
 
 	if (!image || !msec || !asid)
@@ -206,15 +210,19 @@ static struct ptunit_result read_null(void)
 	const struct pt_mapped_section *msec;
 	struct pt_msec_cache mcache;
 	struct pt_image image;
+	struct pt_asid asid;
 	int status;
 
-	status = pt_msec_cache_read(NULL, &msec, &image, 0ull);
+	status = pt_msec_cache_read(NULL, &msec, &image, &asid, 0ull);
+	ptu_int_eq(status, -pte_internal);
+
+	status = pt_msec_cache_read(&mcache, NULL, &image, &asid, 0ull);
 	ptu_int_eq(status, -pte_internal);
 
-	status = pt_msec_cache_read(&mcache, NULL, &image, 0ull);
+	status = pt_msec_cache_read(&mcache, &msec, NULL, &asid, 0ull);
 	ptu_int_eq(status, -pte_internal);
 
-	status = pt_msec_cache_read(&mcache, &msec, NULL, 0ull);
+	status = pt_msec_cache_read(&mcache, &msec, &image, NULL, 0ull);
 	ptu_int_eq(status, -pte_internal);
 
 	return ptu_passed();
@@ -265,11 +273,14 @@ static struct ptunit_result invalidate(struct test_fixture *tfix)
 static struct ptunit_result read_nomap(struct test_fixture *tfix)
 {
 	const struct pt_mapped_section *msec;
+	struct pt_asid asid;
 	int status;
 
+	pt_asid_init(&asid);
 	msec = NULL;
 
-	status = pt_msec_cache_read(&tfix->mcache, &msec, &tfix->image, 0ull);
+	status = pt_msec_cache_read(&tfix->mcache, &msec, &tfix->image, &asid,
+				    0ull);
 	ptu_int_eq(status, -pte_nomap);
 	ptu_null(msec);
 
@@ -280,9 +291,13 @@ static struct ptunit_result read(struct test_fixture *tfix)
 {
 	const struct pt_mapped_section *msec;
 	struct pt_section *section;
+	struct pt_asid asid;
 	int status;
 
-	status = pt_msec_cache_read(&tfix->mcache, &msec, &tfix->image, 0ull);
+	pt_asid_init(&asid);
+
+	status = pt_msec_cache_read(&tfix->mcache, &msec, &tfix->image, &asid,
+				    0ull);
 	ptu_int_eq(status, 0);
 
 	ptu_ptr_eq(msec, &tfix->mcache.msec);
@@ -28,6 +28,7 @@
 
 #include "ptunit.h"
 
+#include "pt_packet.h"
 #include "pt_packet_decoder.h"
 #include "pt_query_decoder.h"
 #include "pt_encoder.h"
@@ -36,6 +37,7 @@
 #include "intel-pt.h"
 
 #include <string.h>
+#include <limits.h>
 
 
 /* A test fixture providing everything needed for packet en- and de-coding. */
@@ -375,6 +377,29 @@ static struct ptunit_result cyc(struct packet_fixture *pfix)
 	return ptu_passed();
 }
 
+static struct ptunit_result cyc_value(struct packet_fixture *pfix,
+				      uint64_t value)
+{
+	int size;
+
+	pfix->packet[0].type = ppt_cyc;
+	pfix->packet[0].payload.cyc.value = value;
+
+	ptu_test(pfix_test, pfix);
+
+	/* Check that we get the same without trace following the packet. */
+	size = pt_pkt_sync_set(&pfix->decoder, 0ull);
+	ptu_int_eq(size, 0);
+
+	pfix->decoder.config.end = pfix->encoder.pos;
+
+	size = pt_pkt_next(&pfix->decoder, &pfix->packet[1],
+			   sizeof(pfix->packet[1]));
+	ptu_int_gt(size, 0);
+
+	return ptu_pkt_eq(&pfix->packet[0], &pfix->packet[1]);
+}
+
 static struct ptunit_result vmcs(struct packet_fixture *pfix)
 {
 	pfix->packet[0].type = ppt_vmcs;
@@ -464,6 +489,98 @@ static struct ptunit_result ptw(struct packet_fixture *pfix, uint8_t plc,
 	return ptu_passed();
 }
 
+static struct ptunit_result fragments(struct packet_fixture *pfix)
+{
+	struct pt_packet_decoder decoder, fdecoder;
+	struct pt_fragment fragment[2];
+	struct pt_config config;
+	uint8_t head[64], tail[64];
+	size_t size, split;
+	uint64_t offset;
+	int errcode;
+
+	pt_encode_psb(&pfix->encoder);
+	pt_encode_psbend(&pfix->encoder);
+	pt_encode_tsc(&pfix->encoder, 0x1000ull);
+	pt_encode_tip(&pfix->encoder, 0xffffff00ull, pt_ipc_sext_48);
+	pt_encode_psb(&pfix->encoder);
+	pt_encode_psbend(&pfix->encoder);
+	pt_encode_tnt_8(&pfix->encoder, 0x1, 2);
+
+	size = (size_t) (pfix->encoder.pos - pfix->buffer);
+
+	config = pfix->config;
+	config.end = pfix->buffer + size;
+
+	/* Decoding fragments gives the same packets at the same offsets no
+	 * matter where we split the trace.
+	 */
+	for (split = 1; split < size; ++split) {
+		memcpy(head, pfix->buffer, split);
+		memcpy(tail, pfix->buffer + split, size - split);
+
+		fragment[0].begin = head;
+		fragment[0].end = head + split;
+		fragment[1].begin = tail;
+		fragment[1].end = tail + (size - split);
+
+		config.fragments = fragment;
+		config.nfragments = 2;
+
+		errcode = pt_pkt_decoder_init(&fdecoder, &config);
+		ptu_int_eq(errcode, 0);
+
+		config.fragments = NULL;
+		config.nfragments = 0;
+
+		errcode = pt_pkt_decoder_init(&decoder, &config);
+		ptu_int_eq(errcode, 0);
+
+		errcode = pt_pkt_sync_forward(&fdecoder);
+		ptu_int_eq(errcode, 0);
+
+		errcode = pt_pkt_sync_forward(&decoder);
+		ptu_int_eq(errcode, 0);
+
+		for (;;) {
+			uint64_t foffset;
+			int fsize;
+
+			errcode = pt_pkt_get_offset(&decoder, &offset);
+			ptu_int_eq(errcode, 0);
+
+			errcode = pt_pkt_get_offset(&fdecoder, &foffset);
+			ptu_int_eq(errcode, 0);
+			ptu_uint_eq(foffset, offset);
+
+			errcode = pt_pkt_next(&decoder, &pfix->packet[0],
+					      sizeof(pfix->packet[0]));
+			fsize = pt_pkt_next(&fdecoder, &pfix->packet[1],
+					    sizeof(pfix->packet[1]));
+			ptu_int_eq(fsize, errcode);
+			if (errcode < 0)
+				break;
+
+			ptu_test(ptu_pkt_eq, &pfix->packet[0],
+				 &pfix->packet[1]);
+		}
+
+		ptu_int_eq(errcode, -pte_eos);
+
+		errcode = pt_pkt_sync_backward(&fdecoder);
+		ptu_int_eq(errcode, 0);
+
+		errcode = pt_pkt_get_sync_offset(&fdecoder, &offset);
+		ptu_int_eq(errcode, 0);
+		ptu_uint_eq(offset, 33ull);
+
+		pt_pkt_decoder_fini(&decoder);
+		pt_pkt_decoder_fini(&fdecoder);
+	}
+
+	return ptu_passed();
+}
+
 static struct ptunit_result cutoff(struct packet_fixture *pfix,
 				   enum pt_packet_type type)
 {
@@ -542,6 +659,72 @@ static struct ptunit_result cutoff_mode(struct packet_fixture *pfix,
 	return ptu_passed();
 }
 
+static struct ptunit_result pad_run(struct packet_fixture *pfix)
+{
+	int size;
+
+	pfix->buffer[37] = pt_opc_ext;
+	pfix->buffer[38] = pt_ext_ovf;
+
+	size = pt_pkt_read_pad(pfix->buffer, &pfix->config, INT_MAX);
+	ptu_int_eq(size, 37);
+
+	size = pt_pkt_read_pad(&pfix->buffer[36], &pfix->config, INT_MAX);
+	ptu_int_eq(size, 1);
+
+	/* The run ends at the end of the trace buffer. */
+	size = pt_pkt_read_pad(&pfix->buffer[39], &pfix->config, INT_MAX);
+	ptu_int_eq(size, (int) sizeof(pfix->buffer) - 39);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pad_run_max(struct packet_fixture *pfix)
+{
+	int size;
+
+	size = pt_pkt_read_pad(pfix->buffer, &pfix->config, 5);
+	ptu_int_eq(size, 5);
+
+	size = pt_pkt_read_pad(pfix->buffer, &pfix->config, 0);
+	ptu_int_eq(size, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pad_run_eos(struct packet_fixture *pfix)
+{
+	int size;
+
+	size = pt_pkt_read_pad(pfix->config.end, &pfix->config, INT_MAX);
+	ptu_int_eq(size, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pad_coalesce(struct packet_fixture *pfix)
+{
+	int size;
+
+	pfix->buffer[37] = pt_opc_ext;
+	pfix->buffer[38] = pt_ext_ovf;
+
+	pfix->decoder.config.flags.variant.packet.coalesce_pad = 1;
+
+	size = pt_pkt_next(&pfix->decoder, &pfix->packet[1],
+			   sizeof(pfix->packet[1]));
+	ptu_int_eq(size, 37);
+	ptu_int_eq(pfix->packet[1].type, ppt_pad);
+	ptu_uint_eq(pfix->packet[1].size, 37);
+
+	size = pt_pkt_next(&pfix->decoder, &pfix->packet[1],
+			   sizeof(pfix->packet[1]));
+	ptu_int_eq(size, ptps_ovf);
+	ptu_int_eq(pfix->packet[1].type, ppt_ovf);
+
+	return ptu_passed();
+}
+
 int main(int argc, char **argv)
 {
 	struct packet_fixture pfix;
@@ -615,6 +798,13 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, tma_bad, pfix);
 	ptu_run_f(suite, mtc, pfix);
 	ptu_run_f(suite, cyc, pfix);
+	ptu_run_fp(suite, cyc_value, pfix, 0x0ull);
+	ptu_run_fp(suite, cyc_value, pfix, 0x1full);
+	ptu_run_fp(suite, cyc_value, pfix, 0x20ull);
+	ptu_run_fp(suite, cyc_value, pfix, 0xfffull);
+	ptu_run_fp(suite, cyc_value, pfix, 0x7fffffffffffull);
+	ptu_run_fp(suite, cyc_value, pfix, 0x800000000000ull);
+	ptu_run_fp(suite, cyc_value, pfix, 0x1000000000000000ull);
 	ptu_run_f(suite, vmcs, pfix);
 	ptu_run_f(suite, mnt, pfix);
 	ptu_run_fp(suite, exstop, pfix, 0);
@@ -625,6 +815,8 @@ int main(int argc, char **argv)
 	ptu_run_fp(suite, ptw, pfix, 0, 1);
 	ptu_run_fp(suite, ptw, pfix, 1, 0);
 
+	ptu_run_f(suite, fragments, pfix);
+
 	ptu_run_fp(suite, cutoff, pfix, ppt_psb);
 	ptu_run_fp(suite, cutoff_ip, pfix, ppt_tip);
 	ptu_run_fp(suite, cutoff_ip, pfix, ppt_tip_pge);
@@ -648,6 +840,11 @@ int main(int argc, char **argv)
 	ptu_run_fp(suite, cutoff, pfix, ppt_pwrx);
 	ptu_run_fp(suite, cutoff, pfix, ppt_ptw);
 
+	ptu_run_f(suite, pad_run, pfix);
+	ptu_run_f(suite, pad_run_max, pfix);
+	ptu_run_f(suite, pad_run_eos, pfix);
+	ptu_run_f(suite, pad_coalesce, pfix);
+
 	return ptunit_report(&suite);
 }
 
@@ -31,6 +31,7 @@
 #include "pt_last_ip.h"
 #include "pt_decoder_function.h"
 #include "pt_query_decoder.h"
+#include "pt_packet_decoder.h"
 #include "pt_encoder.h"
 #include "pt_opcodes.h"
 
@@ -439,6 +440,357 @@ decode_sync_backward(struct ptu_decoder_fixture *dfix)
 	return ptu_passed();
 }
 
+/* Encode a PSB segment with two split points followed by another PSB.
+ *
+ * Provides the split points' offsets in @split and the next PSB's offset in
+ * @next.
+ */
+static struct ptunit_result ptu_encode_split(struct pt_encoder *encoder,
+					     uint64_t *split, uint64_t *next)
+{
+	int errcode;
+
+	pt_encode_psb(encoder);
+	pt_encode_mode_exec(encoder, ptem_64bit);
+	pt_encode_fup(encoder, 0x1000ull, pt_ipc_sext_48);
+	pt_encode_psbend(encoder);
+
+	/* A compressed IP is not a split point. */
+	pt_encode_tip(encoder, 0x1010ull, pt_ipc_update_16);
+
+	/* Neither are IPs binding to an event. */
+	pt_encode_fup(encoder, 0x1020ull, pt_ipc_sext_48);
+	pt_encode_mtc(encoder, 1);
+	pt_encode_tip(encoder, 0x2000ull, pt_ipc_sext_48);
+	pt_encode_mode_exec(encoder, ptem_32bit);
+	pt_encode_tip(encoder, 0x3000ull, pt_ipc_sext_48);
+
+	errcode = pt_enc_get_offset(encoder, &split[0]);
+	ptu_int_ge(errcode, 0);
+
+	pt_encode_tip(encoder, 0x4000ull, pt_ipc_sext_48);
+	pt_encode_tnt_8(encoder, 0x2, 2);
+
+	errcode = pt_enc_get_offset(encoder, &split[1]);
+	ptu_int_ge(errcode, 0);
+
+	pt_encode_tip(encoder, 0x5000ull, pt_ipc_full);
+
+	errcode = pt_enc_get_offset(encoder, next);
+	ptu_int_ge(errcode, 0);
+
+	pt_encode_psb(encoder);
+	pt_encode_mode_exec(encoder, ptem_64bit);
+	pt_encode_psbend(encoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result find_split(struct ptu_decoder_fixture *dfix)
+{
+	struct pt_packet_decoder *decoder;
+	uint64_t split[2], next, offset;
+	int status;
+
+	ptu_test(ptu_encode_split, &dfix->encoder, split, &next);
+
+	decoder = pt_pkt_alloc_decoder(&dfix->config);
+	ptu_ptr(decoder);
+
+	status = pt_pkt_sync_set(decoder, 0ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_pkt_find_split(decoder, &offset, 0ull);
+	ptu_int_gt(status, 0);
+	ptu_uint_eq(offset, split[0]);
+
+	status = pt_pkt_get_sync_offset(decoder, &offset);
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(offset, 0ull);
+
+	status = pt_pkt_find_split(decoder, &offset, 0ull);
+	ptu_int_gt(status, 0);
+	ptu_uint_eq(offset, split[1]);
+
+	status = pt_pkt_find_split(decoder, &offset, 0ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_pkt_get_offset(decoder, &offset);
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(offset, next);
+
+	pt_pkt_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result find_split_offset(struct ptu_decoder_fixture *dfix)
+{
+	struct pt_packet_decoder *decoder;
+	uint64_t split[2], next, offset;
+	int status;
+
+	ptu_test(ptu_encode_split, &dfix->encoder, split, &next);
+
+	decoder = pt_pkt_alloc_decoder(&dfix->config);
+	ptu_ptr(decoder);
+
+	status = pt_pkt_sync_set(decoder, 0ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_pkt_find_split(decoder, &offset, split[0] + 1ull);
+	ptu_int_gt(status, 0);
+	ptu_uint_eq(offset, split[1]);
+
+	pt_pkt_free_decoder(decoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result find_split_null(void)
+{
+	struct pt_packet_decoder decoder;
+	uint64_t offset;
+	int status;
+
+	status = pt_pkt_find_split(NULL, &offset, 0ull);
+	ptu_int_eq(status, -pte_invalid);
+
+	status = pt_pkt_find_split(&decoder, NULL, 0ull);
+	ptu_int_eq(status, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sync_split(struct ptu_decoder_fixture *dfix)
+{
+	struct pt_query_decoder *decoder = &dfix->decoder;
+	uint64_t split[2], next, offset, ip;
+	int status, taken;
+
+	ptu_test(ptu_encode_split, &dfix->encoder, split, &next);
+
+	status = pt_qry_sync_split(decoder, &ip, split[0], 0ull);
+	ptu_int_ge(status, 0);
+	ptu_uint_eq(ip, 0x4000ull);
+
+	status = pt_qry_get_sync_offset(decoder, &offset);
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(offset, 0ull);
+
+	status = pt_qry_cond_branch(decoder, &taken);
+	ptu_int_ge(status, 0);
+	ptu_int_eq(taken, 1);
+
+	status = pt_qry_cond_branch(decoder, &taken);
+	ptu_int_ge(status, 0);
+	ptu_int_eq(taken, 0);
+
+	status = pt_qry_indirect_branch(decoder, &ip);
+	ptu_int_ge(status, 0);
+	ptu_uint_eq(ip, 0x5000ull);
+
+	status = pt_qry_sync_split(decoder, &ip, split[1], 0ull);
+	ptu_int_ge(status, 0);
+	ptu_uint_eq(ip, 0x5000ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sync_split_bad(struct ptu_decoder_fixture *dfix)
+{
+	struct pt_query_decoder *decoder = &dfix->decoder;
+	struct pt_encoder *encoder = &dfix->encoder;
+	uint64_t offset, psb, ip;
+	int status;
+
+	status = pt_enc_get_offset(encoder, &offset);
+	ptu_int_ge(status, 0);
+
+	/* There must be a PSB at @psb. */
+	pt_encode_tip(encoder, 0x1000ull, pt_ipc_sext_48);
+
+	status = pt_qry_sync_split(decoder, &ip, offset, offset);
+	ptu_int_eq(status, -pte_nosync);
+
+	status = pt_enc_get_offset(encoder, &psb);
+	ptu_int_ge(status, 0);
+
+	pt_encode_psb(encoder);
+	pt_encode_mode_exec(encoder, ptem_64bit);
+	pt_encode_psbend(encoder);
+
+	/* The PSB must precede the split point. */
+	status = pt_qry_sync_split(decoder, &ip, offset, psb);
+	ptu_int_eq(status, -pte_nosync);
+
+	/* There must be a TIP at the split point. */
+	status = pt_enc_get_offset(encoder, &offset);
+	ptu_int_ge(status, 0);
+
+	pt_encode_tnt_8(encoder, 0x1, 1);
+
+	status = pt_qry_sync_split(decoder, &ip, offset, psb);
+	ptu_int_eq(status, -pte_nosync);
+
+	/* The TIP must provide the full IP. */
+	status = pt_enc_get_offset(encoder, &offset);
+	ptu_int_ge(status, 0);
+
+	pt_encode_tip(encoder, 0x1010ull, pt_ipc_update_16);
+
+	status = pt_qry_sync_split(decoder, &ip, offset, psb);
+	ptu_int_eq(status, -pte_nosync);
+
+	status = pt_qry_sync_split(NULL, &ip, offset, psb);
+	ptu_int_eq(status, -pte_invalid);
+
+	return ptu_passed();
+}
+
+/* Decode @decoder and @fdecoder in lock-step and compare the results. */
+static struct ptunit_result ptu_qry_same(struct pt_query_decoder *decoder,
+					 struct pt_query_decoder *fdecoder)
+{
+	uint64_t ip, fip, offset, foffset;
+	int status, fstatus;
+
+	status = pt_qry_sync_forward(decoder, &ip);
+	fstatus = pt_qry_sync_forward(fdecoder, &fip);
+	ptu_int_ge(status, 0);
+	ptu_int_eq(fstatus, status);
+	ptu_uint_eq(fip, ip);
+
+	while (!(status & pts_eos)) {
+		status = pt_qry_get_offset(decoder, &offset);
+		ptu_int_eq(status, 0);
+
+		status = pt_qry_get_offset(fdecoder, &foffset);
+		ptu_int_eq(status, 0);
+		ptu_uint_eq(foffset, offset);
+
+		status = pt_qry_get_sync_offset(decoder, &offset);
+		ptu_int_eq(status, 0);
+
+		status = pt_qry_get_sync_offset(fdecoder, &foffset);
+		ptu_int_eq(status, 0);
+		ptu_uint_eq(foffset, offset);
+
+		if (fstatus & pts_event_pending) {
+			struct pt_event event, fevent;
+
+			status = pt_qry_event(decoder, &event, sizeof(event));
+			fstatus = pt_qry_event(fdecoder, &fevent,
+					       sizeof(fevent));
+			ptu_int_ge(status, 0);
+			ptu_int_eq(fstatus, status);
+			ptu_int_eq(fevent.type, event.type);
+			ptu_uint_eq(fevent.ip_suppressed, event.ip_suppressed);
+			continue;
+		}
+
+		status = pt_qry_cond_branch(decoder, &fstatus);
+		if (status != -pte_bad_query) {
+			int taken;
+
+			ptu_int_ge(status, 0);
+
+			fstatus = pt_qry_cond_branch(fdecoder, &taken);
+			ptu_int_eq(fstatus, status);
+			continue;
+		}
+
+		status = pt_qry_indirect_branch(decoder, &ip);
+		fstatus = pt_qry_indirect_branch(fdecoder, &fip);
+		ptu_int_ge(status, 0);
+		ptu_int_eq(fstatus, status);
+		ptu_uint_eq(fip, ip);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fragments(struct ptu_decoder_fixture *dfix)
+{
+	struct pt_query_decoder decoder, fdecoder;
+	struct pt_encoder *encoder = &dfix->encoder;
+	struct pt_fragment fragment[2];
+	struct pt_config config;
+	uint8_t head[64], tail[64];
+	uint64_t offset, ip;
+	size_t size, split;
+	int errcode;
+
+	pt_encode_psb(encoder);
+	pt_encode_mode_exec(encoder, ptem_64bit);
+	pt_encode_psbend(encoder);
+	pt_encode_tip_pge(encoder, 0x1000ull, pt_ipc_sext_48);
+	pt_encode_tnt_8(encoder, 0x2, 2);
+	pt_encode_tip(encoder, 0x2000ull, pt_ipc_sext_48);
+	pt_encode_psb(encoder);
+	pt_encode_fup(encoder, 0x2000ull, pt_ipc_sext_48);
+	pt_encode_mode_exec(encoder, ptem_64bit);
+	pt_encode_psbend(encoder);
+	pt_encode_tnt_8(encoder, 0x1, 1);
+	pt_encode_tip_pgd(encoder, 0ull, pt_ipc_suppressed);
+
+	size = (size_t) (encoder->pos - dfix->buffer);
+	ptu_uint_le(size, sizeof(head));
+
+	config = dfix->config;
+	config.end = dfix->buffer + size;
+
+	/* Decoding fragments gives the same results at the same offsets no
+	 * matter where we split the trace.
+	 */
+	for (split = 1; split < size; ++split) {
+		memcpy(head, dfix->buffer, split);
+		memcpy(tail, dfix->buffer + split, size - split);
+
+		fragment[0].begin = head;
+		fragment[0].end = head + split;
+		fragment[1].begin = tail;
+		fragment[1].end = tail + (size - split);
+
+		config.fragments = fragment;
+		config.nfragments = 2;
+
+		errcode = pt_qry_decoder_init(&fdecoder, &config);
+		ptu_int_eq(errcode, 0);
+
+		config.fragments = NULL;
+		config.nfragments = 0;
+
+		errcode = pt_qry_decoder_init(&decoder, &config);
+		ptu_int_eq(errcode, 0);
+
+		ptu_test(ptu_qry_same, &decoder, &fdecoder);
+
+		errcode = pt_qry_sync_backward(&fdecoder, &ip);
+		ptu_int_ge(errcode, 0);
+
+		errcode = pt_qry_get_sync_offset(&fdecoder, &offset);
+		ptu_int_eq(errcode, 0);
+		ptu_uint_eq(offset, 35ull);
+
+		errcode = pt_qry_sync_backward(&fdecoder, &ip);
+		ptu_int_ge(errcode, 0);
+
+		errcode = pt_qry_get_sync_offset(&fdecoder, &offset);
+		ptu_int_eq(errcode, 0);
+		ptu_uint_eq(offset, 0ull);
+
+		errcode = pt_qry_sync_set(&fdecoder, &ip, 35ull);
+		ptu_int_ge(errcode, 0);
+		ptu_uint_eq(ip, 0x2000ull);
+
+		pt_qry_decoder_fini(&decoder);
+		pt_qry_decoder_fini(&fdecoder);
+	}
+
+	return ptu_passed();
+}
+
 static struct ptunit_result indir_null(struct ptu_decoder_fixture *dfix)
 {
 	struct pt_query_decoder *decoder = &dfix->decoder;
@@ -2149,6 +2501,96 @@ static struct ptunit_result cbr(struct ptu_decoder_fixture *dfix)
 	return ptu_passed();
 }
 
+static struct ptunit_result calibration_null(struct ptu_decoder_fixture *dfix)
+{
+	struct pt_query_decoder *decoder = &dfix->decoder;
+	struct pt_time_calibration cal;
+	int errcode;
+
+	errcode = pt_qry_get_calibration(NULL, &cal, sizeof(cal));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_qry_get_calibration(decoder, NULL, sizeof(cal));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_qry_set_calibration(NULL, &cal);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_qry_set_calibration(decoder, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result
+calibration_initial(struct ptu_decoder_fixture *dfix)
+{
+	struct pt_query_decoder *decoder = &dfix->decoder;
+	struct pt_time_calibration cal;
+	int errcode;
+
+	errcode = pt_qry_get_calibration(decoder, &cal, sizeof(cal));
+	ptu_int_eq(errcode, -pte_no_time);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result calibration(struct ptu_decoder_fixture *dfix)
+{
+	struct pt_query_decoder *decoder = &dfix->decoder;
+	struct pt_encoder *encoder = &dfix->encoder;
+	struct pt_time_calibration cal;
+	uint64_t ip;
+	int errcode;
+
+	pt_encode_psb(encoder);
+	pt_encode_mode_exec(encoder, ptem_64bit);
+	pt_encode_psbend(encoder);
+
+	cal.size = sizeof(cal);
+	cal.fcr = 0x300;
+	cal.min_fcr = 0x200;
+	cal.max_fcr = 0x400;
+
+	errcode = pt_qry_set_calibration(decoder, &cal);
+	ptu_int_eq(errcode, 0);
+
+	/* The calibration survives synchronizing. */
+	errcode = pt_qry_sync_forward(decoder, &ip);
+	ptu_int_ge(errcode, 0);
+
+	memset(&cal, 0, sizeof(cal));
+
+	errcode = pt_qry_get_calibration(decoder, &cal, sizeof(cal));
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cal.size, sizeof(cal));
+	ptu_uint_eq(cal.fcr, 0x300);
+	ptu_uint_eq(cal.min_fcr, 0x200);
+	ptu_uint_eq(cal.max_fcr, 0x400);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result calibration_bad(struct ptu_decoder_fixture *dfix)
+{
+	struct pt_query_decoder *decoder = &dfix->decoder;
+	struct pt_time_calibration cal;
+	int errcode;
+
+	cal.size = sizeof(cal);
+	cal.fcr = 0x100;
+	cal.min_fcr = 0x200;
+	cal.max_fcr = 0x400;
+
+	errcode = pt_qry_set_calibration(decoder, &cal);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_qry_get_calibration(decoder, &cal, sizeof(cal));
+	ptu_int_eq(errcode, -pte_no_time);
+
+	return ptu_passed();
+}
+
 /* Test that end-of-stream is indicated correctly when the stream ends with a
  * partial non-query-relevant packet.
  */
@@ -2443,6 +2885,12 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, sync_backward_empty_mid, dfix_raw);
 	ptu_run_f(suite, sync_backward_empty_begin, dfix_raw);
 	ptu_run_f(suite, decode_sync_backward, dfix_raw);
+	ptu_run_f(suite, find_split, dfix_raw);
+	ptu_run_f(suite, find_split_offset, dfix_raw);
+	ptu_run(suite, find_split_null);
+	ptu_run_f(suite, sync_split, dfix_raw);
+	ptu_run_f(suite, sync_split_bad, dfix_raw);
+	ptu_run_f(suite, fragments, dfix_raw);
 
 	ptu_run_f(suite, indir_null, dfix_empty);
 	ptu_run_f(suite, indir_empty, dfix_empty);
@@ -2865,6 +3313,11 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, cbr_initial, dfix_empty);
 	ptu_run_f(suite, cbr, dfix_empty);
 
+	ptu_run_f(suite, calibration_null, dfix_empty);
+	ptu_run_f(suite, calibration_initial, dfix_empty);
+	ptu_run_f(suite, calibration, dfix_raw);
+	ptu_run_f(suite, calibration_bad, dfix_empty);
+
 	ptu_run_f(suite, indir_cyc_cutoff, dfix_empty);
 	ptu_run_f(suite, cond_cyc_cutoff, dfix_empty);
 	ptu_run_f(suite, event_cyc_cutoff, dfix_empty);
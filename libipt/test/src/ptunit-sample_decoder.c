@@ -0,0 +1,642 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_sample_decoder.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+
+
+/* An instruction in a mock trace. */
+struct mock_insn {
+	/* The instruction. */
+	uint64_t ip;
+	enum pt_insn_class iclass;
+	uint8_t size;
+
+	/* The time at which the instruction executed. */
+	uint64_t tsc;
+
+	/* A flag saying whether a PSB precedes the instruction. */
+	int psb;
+};
+
+enum {
+	/* The trace offset of a PSB in front of instruction index i is
+	 * i * mock_psb_size.
+	 */
+	mock_psb_size	= 0x100
+};
+
+/* A mock instruction flow decoder replaying a list of instructions. */
+struct pt_insn_decoder {
+	/* The instructions. */
+	const struct mock_insn *insn;
+	size_t ninsn;
+
+	/* The index of the next instruction. */
+	size_t pos;
+
+	/* The index of the instruction following the current PSB. */
+	size_t sync;
+
+	/* A flag saying whether we are synchronized. */
+	int synced;
+
+	/* The current time. */
+	uint64_t tsc;
+
+	/* An event to report in front of instruction index @event_pos. */
+	struct pt_event event;
+	size_t event_pos;
+	int have_event;
+
+	/* A flag saying whether @event is pending. */
+	int event_pending;
+
+	/* The number of pt_insn_sync_forward() calls. */
+	int nsync_forward;
+};
+
+static int mock_status(struct pt_insn_decoder *decoder)
+{
+	if (decoder->have_event && (decoder->pos == decoder->event_pos)) {
+		decoder->event_pending = 1;
+		return pts_event_pending;
+	}
+
+	return 0;
+}
+
+int pt_insn_sync_forward(struct pt_insn_decoder *decoder)
+{
+	size_t pos;
+
+	if (!decoder)
+		return -pte_internal;
+
+	decoder->nsync_forward += 1;
+
+	pos = decoder->synced ? decoder->sync + 1 : 0;
+	for (; pos < decoder->ninsn; ++pos) {
+		if (decoder->insn[pos].psb)
+			return pt_insn_sync_set(decoder, pos * mock_psb_size);
+	}
+
+	return -pte_eos;
+}
+
+int pt_insn_sync_set(struct pt_insn_decoder *decoder, uint64_t offset)
+{
+	size_t pos;
+
+	if (!decoder)
+		return -pte_internal;
+
+	pos = (size_t) (offset / mock_psb_size);
+	if ((offset % mock_psb_size) || (decoder->ninsn <= pos) ||
+	    !decoder->insn[pos].psb)
+		return -pte_nosync;
+
+	decoder->pos = pos;
+	decoder->sync = pos;
+	decoder->synced = 1;
+	decoder->tsc = decoder->insn[pos].tsc;
+	decoder->event_pending = 0;
+
+	return mock_status(decoder);
+}
+
+int pt_insn_get_sync_offset(const struct pt_insn_decoder *decoder,
+			    uint64_t *offset)
+{
+	if (!decoder || !offset || !decoder->synced)
+		return -pte_internal;
+
+	*offset = decoder->sync * mock_psb_size;
+
+	return 0;
+}
+
+int pt_insn_time(struct pt_insn_decoder *decoder, uint64_t *time,
+		 uint32_t *lost_mtc, uint32_t *lost_cyc)
+{
+	if (!decoder || !time)
+		return -pte_internal;
+
+	(void) lost_mtc;
+	(void) lost_cyc;
+
+	*time = decoder->tsc;
+
+	return 0;
+}
+
+int pt_insn_next(struct pt_insn_decoder *decoder, struct pt_insn *insn,
+		 size_t size)
+{
+	const struct mock_insn *minsn;
+
+	if (!decoder || !insn || (size != sizeof(*insn)))
+		return -pte_internal;
+
+	if (decoder->event_pending)
+		return -pte_event_ignored;
+
+	if (decoder->ninsn <= decoder->pos)
+		return -pte_eos;
+
+	minsn = &decoder->insn[decoder->pos++];
+
+	memset(insn, 0, sizeof(*insn));
+	insn->ip = minsn->ip;
+	insn->iclass = minsn->iclass;
+	insn->size = minsn->size;
+
+	decoder->tsc = minsn->tsc;
+
+	return mock_status(decoder);
+}
+
+int pt_insn_event(struct pt_insn_decoder *decoder, struct pt_event *event,
+		  size_t size)
+{
+	if (!decoder || !event || (size != sizeof(*event)))
+		return -pte_internal;
+
+	if (!decoder->event_pending)
+		return -pte_bad_query;
+
+	decoder->event_pending = 0;
+	decoder->have_event = 0;
+	*event = decoder->event;
+
+	return 0;
+}
+
+/* The mock trace.
+ *
+ * Function main at 0x1000 calls foo at 0x2000, which calls bar at 0x3000.
+ */
+static const struct mock_insn trace[] = {
+	{ 0x1000ull, ptic_other, 2, 100ull, 1 },
+	{ 0x1002ull, ptic_call, 5, 100ull, 0 },
+	{ 0x2000ull, ptic_other, 1, 110ull, 0 },
+	{ 0x2001ull, ptic_cond_jump, 2, 110ull, 0 },
+	{ 0x2003ull, ptic_jump, 2, 120ull, 0 },
+	{ 0x2010ull, ptic_call, 5, 200ull, 1 },
+	{ 0x3000ull, ptic_other, 3, 210ull, 0 },
+	{ 0x3003ull, ptic_return, 1, 220ull, 0 },
+	{ 0x2015ull, ptic_return, 1, 230ull, 0 },
+	{ 0x1007ull, ptic_return, 1, 240ull, 0 },
+	{ 0x0500ull, ptic_other, 1, 250ull, 0 },
+	{ 0x3000ull, ptic_other, 3, 300ull, 1 },
+	{ 0x3003ull, ptic_other, 1, 310ull, 0 }
+};
+
+/* A test fixture providing a sample context decoder. */
+struct smp_fixture {
+	/* The mock instruction flow decoder. */
+	struct pt_insn_decoder decoder;
+
+	/* The sample context decoder. */
+	struct pt_sample_decoder smp;
+
+	/* The sample context. */
+	struct pt_sample_context context;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct smp_fixture *);
+	struct ptunit_result (*fini)(struct smp_fixture *);
+};
+
+static struct ptunit_result sfix_init(struct smp_fixture *sfix)
+{
+	int errcode;
+
+	memset(&sfix->decoder, 0, sizeof(sfix->decoder));
+	sfix->decoder.insn = trace;
+	sfix->decoder.ninsn = sizeof(trace) / sizeof(trace[0]);
+
+	memset(&sfix->context, 0xcd, sizeof(sfix->context));
+
+	errcode = pt_smp_init(&sfix->smp, &sfix->decoder);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sfix_fini(struct smp_fixture *sfix)
+{
+	pt_smp_fini(&sfix->smp);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_null(void)
+{
+	struct pt_sample_decoder smp;
+	struct pt_insn_decoder decoder;
+	int errcode;
+
+	errcode = pt_smp_init(NULL, &decoder);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_smp_init(&smp, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fini_null(void)
+{
+	pt_smp_fini(NULL);
+	pt_smp_free_decoder(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result alloc_null(void)
+{
+	struct pt_sample_decoder *smp;
+
+	smp = pt_smp_alloc_decoder(NULL);
+	ptu_null(smp);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result context_null(struct smp_fixture *sfix)
+{
+	int errcode;
+
+	errcode = pt_smp_context(NULL, &sfix->context, sizeof(sfix->context),
+				 0ull, 0ull);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_smp_context(&sfix->smp, NULL, sizeof(sfix->context), 0ull,
+				 0ull);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result context_size(struct smp_fixture *sfix)
+{
+	struct pt_sample_context context;
+	uint64_t storage[(sizeof(context) / sizeof(uint64_t)) + 1];
+	uint8_t *buffer;
+	size_t idx;
+	int errcode;
+
+	buffer = (uint8_t *) storage;
+
+	errcode = pt_smp_context(&sfix->smp, &context, sizeof(context), 215ull,
+				 0x3000ull);
+	ptu_int_eq(errcode, 0);
+
+	/* A smaller context is truncated. */
+	memset(buffer, 0xcd, sizeof(storage));
+
+	errcode = pt_smp_context(&sfix->smp,
+				 (struct pt_sample_context *) buffer,
+				 sizeof(context.call[0]), 215ull, 0x3000ull);
+	ptu_int_eq(errcode, 0);
+	ptu_int_eq(memcmp(buffer, &context, sizeof(context.call[0])), 0);
+
+	for (idx = sizeof(context.call[0]); idx < sizeof(storage); ++idx)
+		ptu_uint_eq(buffer[idx], 0xcd);
+
+	/* A bigger context is zero-extended. */
+	errcode = pt_smp_context(&sfix->smp,
+				 (struct pt_sample_context *) buffer,
+				 sizeof(storage), 215ull, 0x3000ull);
+	ptu_int_eq(errcode, 0);
+	ptu_int_eq(memcmp(buffer, &context, sizeof(context)), 0);
+
+	for (idx = sizeof(context); idx < sizeof(storage); ++idx)
+		ptu_uint_eq(buffer[idx], 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result context_empty(struct smp_fixture *sfix)
+{
+	int errcode;
+
+	sfix->decoder.ninsn = 0;
+
+	errcode = pt_smp_context(&sfix->smp, &sfix->context,
+				 sizeof(sfix->context), 0ull, 0ull);
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result find_sync(struct smp_fixture *sfix)
+{
+	struct pt_smp_sync sync;
+	int errcode;
+
+	errcode = pt_smp_find_sync(&sync, &sfix->smp, 150ull);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(sync.offset, 0ull);
+	ptu_uint_eq(sync.tsc, 100ull);
+
+	/* We only index as far as needed. */
+	ptu_uint_eq(sfix->smp.nsync, 2);
+	ptu_int_eq(sfix->smp.indexed, 0);
+
+	errcode = pt_smp_find_sync(&sync, &sfix->smp, 200ull);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(sync.offset, 5 * mock_psb_size);
+	ptu_uint_eq(sync.tsc, 200ull);
+
+	errcode = pt_smp_find_sync(&sync, &sfix->smp, 50ull);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(sync.offset, 0ull);
+
+	errcode = pt_smp_find_sync(&sync, &sfix->smp, 1000ull);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(sync.offset, 11 * mock_psb_size);
+	ptu_uint_eq(sfix->smp.nsync, 3);
+	ptu_int_eq(sfix->smp.indexed, 1);
+
+	/* Once indexed, we do not search again. */
+	sfix->decoder.nsync_forward = 0;
+
+	errcode = pt_smp_find_sync(&sync, &sfix->smp, 2000ull);
+	ptu_int_eq(errcode, 0);
+	ptu_int_eq(sfix->decoder.nsync_forward, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result context_found(struct smp_fixture *sfix)
+{
+	struct pt_sample_context *context;
+	int errcode;
+
+	context = &sfix->context;
+
+	errcode = pt_smp_context(&sfix->smp, context, sizeof(*context), 215ull,
+				 0x3000ull);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(context->sync_offset, 5 * mock_psb_size);
+	ptu_uint_eq(context->tsc, 210ull);
+	ptu_uint_eq(context->found, 1);
+	ptu_uint_eq(context->partial, 0);
+	ptu_uint_eq(context->ncalls, 1);
+	ptu_uint_eq(context->call[0], 0x2015ull);
+	ptu_uint_eq(context->nbranches, 1);
+	ptu_uint_eq(context->branch[0].from, 0x2010ull);
+	ptu_uint_eq(context->branch[0].to, 0x3000ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result context_last(struct smp_fixture *sfix)
+{
+	struct pt_sample_context *context;
+	int errcode;
+
+	context = &sfix->context;
+
+	errcode = pt_smp_context(&sfix->smp, context, sizeof(*context), 120ull,
+				 0x2000ull);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(context->sync_offset, 0ull);
+	ptu_uint_eq(context->tsc, 110ull);
+	ptu_uint_eq(context->found, 1);
+	ptu_uint_eq(context->ncalls, 1);
+	ptu_uint_eq(context->call[0], 0x1007ull);
+	ptu_uint_eq(context->nbranches, 1);
+	ptu_uint_eq(context->branch[0].from, 0x1002ull);
+	ptu_uint_eq(context->branch[0].to, 0x2000ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result context_not_found(struct smp_fixture *sfix)
+{
+	struct pt_sample_context *context;
+	int errcode;
+
+	context = &sfix->context;
+
+	errcode = pt_smp_context(&sfix->smp, context, sizeof(*context), 245ull,
+				 0x4000ull);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(context->sync_offset, 5 * mock_psb_size);
+	ptu_uint_eq(context->tsc, 240ull);
+	ptu_uint_eq(context->found, 0);
+	ptu_uint_eq(context->partial, 1);
+	ptu_uint_eq(context->ncalls, 0);
+	ptu_uint_eq(context->nbranches, 3);
+	ptu_uint_eq(context->branch[0].from, 0x2015ull);
+	ptu_uint_eq(context->branch[0].to, 0x1007ull);
+	ptu_uint_eq(context->branch[1].from, 0x3003ull);
+	ptu_uint_eq(context->branch[1].to, 0x2015ull);
+	ptu_uint_eq(context->branch[2].from, 0x2010ull);
+	ptu_uint_eq(context->branch[2].to, 0x3000ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result context_early(struct smp_fixture *sfix)
+{
+	struct pt_sample_context *context;
+	int errcode;
+
+	context = &sfix->context;
+
+	errcode = pt_smp_context(&sfix->smp, context, sizeof(*context), 50ull,
+				 0x1000ull);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(context->sync_offset, 0ull);
+	ptu_uint_eq(context->tsc, 100ull);
+	ptu_uint_eq(context->found, 0);
+	ptu_uint_eq(context->ncalls, 0);
+	ptu_uint_eq(context->nbranches, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result context_overflow(struct smp_fixture *sfix)
+{
+	struct pt_sample_context *context;
+	int errcode;
+
+	context = &sfix->context;
+
+	sfix->decoder.event.type = ptev_overflow;
+	sfix->decoder.event_pos = 3;
+	sfix->decoder.have_event = 1;
+
+	errcode = pt_smp_context(&sfix->smp, context, sizeof(*context), 115ull,
+				 0x2001ull);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(context->found, 1);
+	ptu_uint_eq(context->partial, 1);
+	ptu_uint_eq(context->ncalls, 1);
+	ptu_uint_eq(context->nbranches, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result context_async(struct smp_fixture *sfix)
+{
+	struct pt_sample_context *context;
+	int errcode;
+
+	context = &sfix->context;
+
+	sfix->decoder.event.type = ptev_async_branch;
+	sfix->decoder.event.variant.async_branch.from = 0x2001ull;
+	sfix->decoder.event.variant.async_branch.to = 0x2001ull;
+	sfix->decoder.event_pos = 3;
+	sfix->decoder.have_event = 1;
+
+	errcode = pt_smp_context(&sfix->smp, context, sizeof(*context), 115ull,
+				 0x2001ull);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(context->found, 1);
+	ptu_uint_eq(context->partial, 0);
+	ptu_uint_eq(context->ncalls, 1);
+	ptu_uint_eq(context->nbranches, 2);
+	ptu_uint_eq(context->branch[0].from, 0x2001ull);
+	ptu_uint_eq(context->branch[0].to, 0x2001ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result branch_ring(void)
+{
+	struct pt_sample_context context;
+	struct pt_smp_state state;
+	uint64_t idx;
+
+	memset(&state, 0, sizeof(state));
+
+	for (idx = 0; idx < pt_smp_max_branches + 8; ++idx)
+		pt_smp_add_branch(&state, idx, idx + 1);
+
+	memset(&context, 0, sizeof(context));
+	pt_smp_to_context(&context, &state);
+
+	ptu_uint_eq(context.nbranches, pt_smp_max_branches);
+	ptu_uint_eq(context.branch[0].from, pt_smp_max_branches + 7);
+	ptu_uint_eq(context.branch[pt_smp_max_branches - 1].from, 8ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result call_overflow(void)
+{
+	struct pt_sample_context context;
+	struct pt_smp_state state;
+	struct pt_insn insn;
+	uint64_t idx;
+
+	memset(&state, 0, sizeof(state));
+	memset(&insn, 0, sizeof(insn));
+	insn.iclass = ptic_call;
+	insn.size = 5;
+
+	for (idx = 0; idx < pt_smp_max_calls + 2; ++idx) {
+		insn.ip = idx * 0x10ull;
+		pt_smp_follow(&state, &insn, 0x1000ull);
+	}
+
+	memset(&context, 0, sizeof(context));
+	pt_smp_to_context(&context, &state);
+
+	ptu_uint_eq(context.ncalls, pt_smp_max_calls);
+	ptu_uint_eq(context.partial, 1);
+	ptu_uint_eq(context.call[0], ((pt_smp_max_calls + 1) * 0x10ull) + 5);
+	ptu_uint_eq(context.call[pt_smp_max_calls - 1], (2 * 0x10ull) + 5);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result follow_not_taken(void)
+{
+	struct pt_smp_state state;
+	struct pt_insn insn;
+
+	memset(&state, 0, sizeof(state));
+	memset(&insn, 0, sizeof(insn));
+	insn.ip = 0x1000ull;
+	insn.iclass = ptic_cond_jump;
+	insn.size = 2;
+
+	pt_smp_follow(&state, &insn, 0x1002ull);
+	ptu_uint_eq(state.nbranches, 0);
+
+	insn.iclass = ptic_other;
+
+	pt_smp_follow(&state, &insn, 0x2000ull);
+	ptu_uint_eq(state.nbranches, 0);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct ptunit_suite suite;
+	struct smp_fixture sfix;
+
+	sfix.init = sfix_init;
+	sfix.fini = sfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, init_null);
+	ptu_run(suite, fini_null);
+	ptu_run(suite, alloc_null);
+	ptu_run_f(suite, context_null, sfix);
+	ptu_run_f(suite, context_empty, sfix);
+
+	ptu_run_f(suite, find_sync, sfix);
+	ptu_run_f(suite, context_found, sfix);
+	ptu_run_f(suite, context_size, sfix);
+	ptu_run_f(suite, context_last, sfix);
+	ptu_run_f(suite, context_not_found, sfix);
+	ptu_run_f(suite, context_early, sfix);
+	ptu_run_f(suite, context_overflow, sfix);
+	ptu_run_f(suite, context_async, sfix);
+
+	ptu_run(suite, branch_ring);
+	ptu_run(suite, call_overflow);
+	ptu_run(suite, follow_not_taken);
+
+	return ptunit_report(&suite);
+}
@@ -28,6 +28,7 @@
 
 #include "pt_section.h"
 #include "pt_section_file.h"
+#include "pt_section_memory.h"
 
 #include "intel-pt.h"
 
@@ -146,6 +147,14 @@ int pt_section_map(struct pt_section *section)
 	if (mcount)
 		return pt_section_map_success(section);
 
+	if (section->memory) {
+		errcode = pt_sec_memory_map(section);
+		if (errcode < 0)
+			goto out_unlock;
+
+		return pt_section_map_success(section);
+	}
+
 	if (section->mapping)
 		goto out_unlock;
 
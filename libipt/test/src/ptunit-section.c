@@ -30,6 +30,7 @@
 #include "ptunit_mkfile.h"
 
 #include "pt_section.h"
+#include "pt_section_memory.h"
 #include "pt_block_cache.h"
 
 #include "intel-pt.h"
@@ -924,6 +925,95 @@ static struct ptunit_result read_nomap(struct section_fixture *sfix)
 	return ptu_passed();
 }
 
+static struct ptunit_result peek(struct section_fixture *sfix)
+{
+	uint8_t bytes[] = { 0xcc, 0x2, 0x4, 0x6 };
+	const uint8_t *begin;
+	int status;
+
+	sfix_write(sfix, bytes);
+
+	sfix->section = pt_mk_section(sfix->name, 0x1ull, 0x3ull);
+	ptu_ptr(sfix->section);
+
+	status = pt_section_map(sfix->section);
+	ptu_int_eq(status, 0);
+
+	/* Not all section implementations provide direct memory access. */
+	begin = NULL;
+	status = pt_section_peek(sfix->section, &begin, 2, 0x1ull);
+	if (status == -pte_not_supported) {
+		status = pt_section_unmap(sfix->section);
+		ptu_int_eq(status, 0);
+
+		return ptu_skipped();
+	}
+
+	ptu_int_eq(status, 2);
+	ptu_ptr(begin);
+	ptu_uint_eq(begin[0], bytes[2]);
+	ptu_uint_eq(begin[1], bytes[3]);
+
+	/* We truncate at the end of the section. */
+	status = pt_section_peek(sfix->section, &begin, 4, 0x2ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(begin[0], bytes[3]);
+
+	status = pt_section_peek(sfix->section, &begin, 1, 0x3ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	status = pt_section_unmap(sfix->section);
+	ptu_int_eq(status, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result peek_null(struct section_fixture *sfix)
+{
+	uint8_t bytes[] = { 0xcc, 0x2, 0x4, 0x6 };
+	const uint8_t *begin;
+	int status;
+
+	sfix_write(sfix, bytes);
+
+	sfix->section = pt_mk_section(sfix->name, 0x1ull, 0x3ull);
+	ptu_ptr(sfix->section);
+
+	status = pt_section_peek(NULL, &begin, 1, 0x0ull);
+	ptu_int_eq(status, -pte_internal);
+
+	status = pt_section_peek(sfix->section, NULL, 1, 0x0ull);
+	ptu_int_eq(status, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result peek_nomap(struct section_fixture *sfix)
+{
+	uint8_t bytes[] = { 0xcc, 0x2, 0x4, 0x6 };
+	const uint8_t *begin;
+	int status;
+
+	sfix_write(sfix, bytes);
+
+	sfix->section = pt_mk_section(sfix->name, 0x1ull, 0x3ull);
+	ptu_ptr(sfix->section);
+
+	status = pt_section_peek(sfix->section, &begin, 1, 0x0ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	status = pt_section_map(sfix->section);
+	ptu_int_eq(status, 0);
+
+	status = pt_section_unmap(sfix->section);
+	ptu_int_eq(status, 0);
+
+	status = pt_section_peek(sfix->section, &begin, 1, 0x0ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result read_unmap_map(struct section_fixture *sfix)
 {
 	uint8_t bytes[] = { 0xcc, 0x2, 0x4, 0x6 };
@@ -1280,6 +1370,189 @@ static struct ptunit_result memsize_map_bcache(struct section_fixture *sfix)
 	return ptu_passed();
 }
 
+static struct ptunit_result memory_create_null(void)
+{
+	struct pt_sec_memory *memory;
+	struct pt_section *section;
+
+	memory = pt_sec_memory_alloc();
+	ptu_ptr(memory);
+
+	section = pt_mk_section_memory(NULL, 0x0ull, 0x10ull, memory);
+	ptu_null(section);
+
+	section = pt_mk_section_memory("file", 0x0ull, 0x10ull, NULL);
+	ptu_null(section);
+
+	section = pt_mk_section_memory("file", 0x0ull, 0x0ull, memory);
+	ptu_null(section);
+
+	pt_sec_memory_free(memory);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result memory_add_bad_order(void)
+{
+	struct pt_sec_memory *memory;
+	uint8_t bytes[] = { 0x2, 0x4 };
+	int errcode;
+
+	memory = pt_sec_memory_alloc();
+	ptu_ptr(memory);
+
+	errcode = pt_sec_memory_add(memory, 0x10ull, bytes, sizeof(bytes));
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_sec_memory_add(memory, 0x11ull, bytes, sizeof(bytes));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sec_memory_add(memory, 0x0ull, bytes, sizeof(bytes));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sec_memory_add(NULL, 0x20ull, bytes, sizeof(bytes));
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_sec_memory_add(memory, 0x20ull, NULL, sizeof(bytes));
+	ptu_int_eq(errcode, -pte_internal);
+
+	pt_sec_memory_free(memory);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result memory_create(struct section_fixture *sfix)
+{
+	struct pt_sec_memory *memory;
+	const char *name;
+	uint64_t offset, size;
+
+	memory = pt_sec_memory_alloc();
+	ptu_ptr(memory);
+
+	/* The file does not need to exist. */
+	sfix->section = pt_mk_section_memory("/no/such/file", 0x1000ull,
+					     0x3000ull, memory);
+	ptu_ptr(sfix->section);
+
+	name = pt_section_filename(sfix->section);
+	ptu_str_eq(name, "/no/such/file");
+
+	offset = pt_section_offset(sfix->section);
+	ptu_uint_eq(offset, 0x1000ull);
+
+	size = pt_section_size(sfix->section);
+	ptu_uint_eq(size, 0x3000ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result memory_read(struct section_fixture *sfix)
+{
+	struct pt_sec_memory *memory;
+	uint8_t bytes[] = { 0x2, 0x4, 0x6, 0x8 };
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc };
+	uint64_t memsize;
+	int status;
+
+	memory = pt_sec_memory_alloc();
+	ptu_ptr(memory);
+
+	status = pt_sec_memory_add(memory, 0x10ull, bytes, 2);
+	ptu_int_eq(status, 0);
+
+	/* This range is merged with the previous one. */
+	status = pt_sec_memory_add(memory, 0x12ull, &bytes[2], 2);
+	ptu_int_eq(status, 0);
+
+	status = pt_sec_memory_add(memory, 0x20ull, bytes, sizeof(bytes));
+	ptu_int_eq(status, 0);
+
+	sfix->section = pt_mk_section_memory("/no/such/file", 0x0ull, 0x30ull,
+					     memory);
+	ptu_ptr(sfix->section);
+
+	status = pt_section_map(sfix->section);
+	ptu_int_eq(status, 0);
+
+	status = pt_section_read(sfix->section, buffer, 3, 0x11ull);
+	ptu_int_eq(status, 3);
+	ptu_uint_eq(buffer[0], bytes[1]);
+	ptu_uint_eq(buffer[1], bytes[2]);
+	ptu_uint_eq(buffer[2], bytes[3]);
+	ptu_uint_eq(buffer[3], 0xcc);
+
+	/* We stop at the end of a range. */
+	status = pt_section_read(sfix->section, buffer, sizeof(buffer),
+				 0x22ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], bytes[2]);
+	ptu_uint_eq(buffer[1], bytes[3]);
+
+	status = pt_section_read(sfix->section, buffer, 1, 0x14ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	status = pt_section_read(sfix->section, buffer, 1, 0x0ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	status = pt_section_memsize(sfix->section, &memsize);
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(memsize, 0x8ull);
+
+	status = pt_section_unmap(sfix->section);
+	ptu_int_eq(status, 0);
+
+	status = pt_section_read(sfix->section, buffer, 1, 0x10ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result memory_peek(struct section_fixture *sfix)
+{
+	struct pt_sec_memory *memory;
+	uint8_t bytes[] = { 0x2, 0x4, 0x6, 0x8 };
+	const uint8_t *begin;
+	int status;
+
+	memory = pt_sec_memory_alloc();
+	ptu_ptr(memory);
+
+	status = pt_sec_memory_add(memory, 0x10ull, bytes, sizeof(bytes));
+	ptu_int_eq(status, 0);
+
+	sfix->section = pt_mk_section_memory("/no/such/file", 0x0ull, 0x30ull,
+					     memory);
+	ptu_ptr(sfix->section);
+
+	status = pt_section_map(sfix->section);
+	ptu_int_eq(status, 0);
+
+	begin = NULL;
+	status = pt_section_peek(sfix->section, &begin, 2, 0x11ull);
+	ptu_int_eq(status, 2);
+	ptu_ptr(begin);
+	ptu_uint_eq(begin[0], bytes[1]);
+	ptu_uint_eq(begin[1], bytes[2]);
+
+	/* We stop at the end of a range. */
+	status = pt_section_peek(sfix->section, &begin, 0x10, 0x12ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(begin[0], bytes[2]);
+	ptu_uint_eq(begin[1], bytes[3]);
+
+	status = pt_section_peek(sfix->section, &begin, 1, 0x14ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	status = pt_section_unmap(sfix->section);
+	ptu_int_eq(status, 0);
+
+	status = pt_section_peek(sfix->section, &begin, 1, 0x10ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result sfix_init(struct section_fixture *sfix)
 {
 	int errcode;
@@ -1377,6 +1650,9 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, read_overflow_32bit, sfix);
 	ptu_run_f(suite, read_nomap, sfix);
 	ptu_run_f(suite, read_unmap_map, sfix);
+	ptu_run_f(suite, peek, sfix);
+	ptu_run_f(suite, peek_null, sfix);
+	ptu_run_f(suite, peek_nomap, sfix);
 
 	ptu_run_f(suite, init_no_bcache, sfix);
 	ptu_run_f(suite, bcache_alloc_free, sfix);
@@ -1389,6 +1665,12 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, memsize_map_nobcache, sfix);
 	ptu_run_f(suite, memsize_map_bcache, sfix);
 
+	ptu_run(suite, memory_create_null);
+	ptu_run(suite, memory_add_bad_order);
+	ptu_run_f(suite, memory_create, sfix);
+	ptu_run_f(suite, memory_read, sfix);
+	ptu_run_f(suite, memory_peek, sfix);
+
 	ptu_run_fp(suite, stress, sfix, worker_bcache);
 	ptu_run_fp(suite, stress, sfix, worker_read);
 
@@ -32,6 +32,8 @@
 
 #include "ptunit.h"
 
+#include <string.h>
+
 
 /* A time unit test fixture. */
 
@@ -196,6 +198,32 @@ static struct ptunit_result query_cbr_none(struct time_fixture *tfix)
 	return ptu_passed();
 }
 
+static struct ptunit_result query_cyc_null(struct time_fixture *tfix)
+{
+	uint64_t cyc;
+	int errcode;
+
+	errcode = pt_time_query_cyc(NULL, &tfix->time);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_time_query_cyc(&cyc, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result query_cyc_none(struct time_fixture *tfix)
+{
+	uint64_t cyc;
+	int errcode;
+
+	errcode = pt_time_query_cyc(&cyc, &tfix->time);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cyc, 0ull);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result tcal_cbr_null(struct time_fixture *tfix)
 {
 	struct pt_packet_cbr packet;
@@ -238,6 +266,144 @@ static struct ptunit_result tcal_cyc_null(struct time_fixture *tfix)
 	return ptu_passed();
 }
 
+static struct ptunit_result tcal_to_user_null(struct time_fixture *tfix)
+{
+	struct pt_time_calibration cal;
+	int errcode;
+
+	errcode = pt_tcal_to_user(NULL, &tfix->tcal, sizeof(cal));
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_tcal_to_user(&cal, NULL, sizeof(cal));
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_tcal_to_user(&cal, &tfix->tcal, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result tcal_to_user_none(struct time_fixture *tfix)
+{
+	struct pt_time_calibration cal;
+	int errcode;
+
+	pt_tcal_init(&tfix->tcal);
+
+	errcode = pt_tcal_to_user(&cal, &tfix->tcal, sizeof(cal));
+	ptu_int_eq(errcode, -pte_no_time);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result tcal_to_user(struct time_fixture *tfix)
+{
+	struct pt_time_calibration cal;
+	int errcode;
+
+	errcode = pt_tcal_set_fcr(&tfix->tcal, 0x3ull << pt_tcal_fcr_shr);
+	ptu_int_eq(errcode, 0);
+
+	memset(&cal, 0xcd, sizeof(cal));
+
+	errcode = pt_tcal_to_user(&cal, &tfix->tcal, sizeof(cal));
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cal.size, sizeof(cal));
+	ptu_uint_eq(cal.fcr, 0x3ull << pt_tcal_fcr_shr);
+	ptu_uint_eq(cal.min_fcr, 0x2ull << pt_tcal_fcr_shr);
+	ptu_uint_eq(cal.max_fcr, 0x3ull << pt_tcal_fcr_shr);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result tcal_to_user_small(struct time_fixture *tfix)
+{
+	struct pt_time_calibration cal;
+	int errcode;
+
+	memset(&cal, 0xcd, sizeof(cal));
+
+	errcode = pt_tcal_to_user(&cal, &tfix->tcal,
+				  offsetof(struct pt_time_calibration,
+					   min_fcr));
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cal.size, offsetof(struct pt_time_calibration, min_fcr));
+	ptu_uint_eq(cal.fcr, 0x2ull << pt_tcal_fcr_shr);
+	ptu_uint_eq(cal.min_fcr, 0xcdcdcdcdcdcdcdcdull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result tcal_from_user_null(struct time_fixture *tfix)
+{
+	struct pt_time_calibration cal;
+	int errcode;
+
+	memset(&cal, 0, sizeof(cal));
+
+	errcode = pt_tcal_from_user(NULL, &cal);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_tcal_from_user(&tfix->tcal, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result tcal_from_user(struct time_fixture *tfix)
+{
+	struct pt_time_calibration cal;
+	uint64_t fcr;
+	int errcode;
+
+	pt_tcal_init(&tfix->tcal);
+
+	cal.size = sizeof(cal);
+	cal.fcr = 0x3ull << pt_tcal_fcr_shr;
+	cal.min_fcr = 0x1ull << pt_tcal_fcr_shr;
+	cal.max_fcr = 0x4ull << pt_tcal_fcr_shr;
+
+	errcode = pt_tcal_from_user(&tfix->tcal, &cal);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_tcal_fcr(&fcr, &tfix->tcal);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(fcr, 0x3ull << pt_tcal_fcr_shr);
+	ptu_uint_eq(tfix->tcal.min_fcr, 0x1ull << pt_tcal_fcr_shr);
+	ptu_uint_eq(tfix->tcal.max_fcr, 0x4ull << pt_tcal_fcr_shr);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result tcal_from_user_bad(struct time_fixture *tfix)
+{
+	struct pt_time_calibration cal;
+	uint64_t fcr;
+	int errcode;
+
+	cal.size = sizeof(cal);
+	cal.fcr = 0x3ull << pt_tcal_fcr_shr;
+	cal.min_fcr = 0x4ull << pt_tcal_fcr_shr;
+	cal.max_fcr = 0x5ull << pt_tcal_fcr_shr;
+
+	errcode = pt_tcal_from_user(&tfix->tcal, &cal);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	/* A calibration without bounds is not valid, either. */
+	cal.size = offsetof(struct pt_time_calibration, min_fcr);
+	cal.min_fcr = 0x3ull << pt_tcal_fcr_shr;
+
+	errcode = pt_tcal_from_user(&tfix->tcal, &cal);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	/* The calibration remains unchanged. */
+	errcode = pt_tcal_fcr(&fcr, &tfix->tcal);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(fcr, 0x2ull << pt_tcal_fcr_shr);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result tsc(struct time_fixture *tfix)
 {
 	struct pt_packet_tsc packet;
@@ -330,6 +496,113 @@ static struct ptunit_result cyc(struct time_fixture *tfix)
 	return ptu_passed();
 }
 
+static struct ptunit_result cyc_count(struct time_fixture *tfix)
+{
+	struct pt_packet_cyc packet;
+	uint64_t cyc;
+	int errcode;
+
+	packet.value = 0xdc;
+
+	errcode = pt_time_update_cyc(&tfix->time, &packet, &tfix->config, 0ull);
+	ptu_int_eq(errcode, 0);
+
+	packet.value = 0x23;
+
+	errcode = pt_time_update_cyc(&tfix->time, &packet, &tfix->config, 0ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_time_query_cyc(&cyc, &tfix->time);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cyc, 0xffull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result cyc_run_null(struct time_fixture *tfix)
+{
+	uint64_t cyc[1];
+	int errcode;
+
+	memset(cyc, 0, sizeof(cyc));
+
+	errcode = pt_time_update_cyc_run(NULL, cyc, 1, &tfix->config, 0ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_time_update_cyc_run(&tfix->time, NULL, 1, &tfix->config,
+					 0ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_time_update_cyc_run(&tfix->time, cyc, 1, NULL, 0ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result cyc_run(struct time_fixture *tfix, uint64_t fcr)
+{
+	struct pt_packet_tsc tsc;
+	struct pt_packet_tma tma;
+	struct pt_packet_mtc mtc;
+	struct pt_time time;
+	uint64_t cyc[] = { 0x3ull, 0x1ull, 0xdcull, 0x0ull, 0x7ull };
+	uint64_t ttsc, rtsc, tcyc, rcyc;
+	uint32_t tlost, rlost;
+	size_t idx;
+	int errcode;
+
+	tsc.tsc = 0x1000ull;
+	tma.ctc = 0x2;
+	tma.fc = 0x1;
+	mtc.ctc = 0x1;
+
+	errcode = pt_time_update_tsc(&tfix->time, &tsc, &tfix->config);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_time_update_tma(&tfix->time, &tma, &tfix->config);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_time_update_mtc(&tfix->time, &mtc, &tfix->config);
+	ptu_int_eq(errcode, 0);
+
+	/* Applying the run gives the same time as applying each packet. */
+	time = tfix->time;
+	for (idx = 0; idx < sizeof(cyc) / sizeof(cyc[0]); ++idx) {
+		struct pt_packet_cyc packet;
+
+		packet.value = cyc[idx];
+
+		errcode = pt_time_update_cyc(&time, &packet, &tfix->config,
+					     fcr);
+		ptu_int_eq(errcode, 0);
+	}
+
+	errcode = pt_time_update_cyc_run(&tfix->time, cyc,
+					 sizeof(cyc) / sizeof(cyc[0]),
+					 &tfix->config, fcr);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_time_query_tsc(&ttsc, &tlost, NULL, &tfix->time);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_time_query_tsc(&rtsc, &rlost, NULL, &time);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(ttsc, rtsc);
+	ptu_uint_eq(tlost, rlost);
+
+	errcode = pt_time_query_cyc(&tcyc, &tfix->time);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_time_query_cyc(&rcyc, &time);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(tcyc, rcyc);
+	ptu_uint_eq(tcyc, 0xe7ull);
+
+	return ptu_passed();
+}
+
 
 int main(int argc, char **argv)
 {
@@ -351,16 +624,30 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, query_tsc_none, tfix);
 	ptu_run_f(suite, query_cbr_null, tfix);
 	ptu_run_f(suite, query_cbr_none, tfix);
+	ptu_run_f(suite, query_cyc_null, tfix);
+	ptu_run_f(suite, query_cyc_none, tfix);
 
 	ptu_run_f(suite, tcal_cbr_null, tfix);
 	ptu_run_f(suite, tcal_mtc_null, tfix);
 	ptu_run_f(suite, tcal_cyc_null, tfix);
+	ptu_run_f(suite, tcal_to_user_null, tfix);
+	ptu_run_f(suite, tcal_to_user_none, tfix);
+	ptu_run_f(suite, tcal_to_user, tfix);
+	ptu_run_f(suite, tcal_to_user_small, tfix);
+	ptu_run_f(suite, tcal_from_user_null, tfix);
+	ptu_run_f(suite, tcal_from_user, tfix);
+	ptu_run_f(suite, tcal_from_user_bad, tfix);
 
 	ptu_run_f(suite, tsc, tfix);
 	ptu_run_f(suite, cbr, tfix);
 	ptu_run_f(suite, tma, tfix);
 	ptu_run_f(suite, mtc, tfix);
 	ptu_run_f(suite, cyc, tfix);
+	ptu_run_f(suite, cyc_count, tfix);
+	ptu_run_f(suite, cyc_run_null, tfix);
+	ptu_run_fp(suite, cyc_run, tfix, 0ull);
+	ptu_run_fp(suite, cyc_run, tfix, 0x2ull << pt_tcal_fcr_shr);
+	ptu_run_fp(suite, cyc_run, tfix, 0x3ull);
 
 	/* The bulk is covered in ptt tests. */
 
@@ -0,0 +1,481 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_encoder.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+#include <stddef.h>
+
+
+/* A test fixture providing a trace to calibrate over. */
+struct calibrate_fixture {
+	/* The trace buffer. */
+	uint8_t buffer[256];
+
+	/* The configuration. */
+	struct pt_config config;
+
+	/* The encoder. */
+	struct pt_encoder encoder;
+
+	/* The calibration. */
+	struct pt_time_calibration cal;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct calibrate_fixture *);
+	struct ptunit_result (*fini)(struct calibrate_fixture *);
+};
+
+static struct ptunit_result cfix_init(struct calibrate_fixture *cfix)
+{
+	int errcode;
+
+	memset(cfix->buffer, 0, sizeof(cfix->buffer));
+	memset(&cfix->cal, 0xcd, sizeof(cfix->cal));
+
+	pt_config_init(&cfix->config);
+	cfix->config.begin = cfix->buffer;
+	cfix->config.end = cfix->buffer + sizeof(cfix->buffer);
+
+	errcode = pt_encoder_init(&cfix->encoder, &cfix->config);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result cfix_fini(struct calibrate_fixture *cfix)
+{
+	pt_encoder_fini(&cfix->encoder);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result cfix_encode(struct calibrate_fixture *cfix,
+					const struct pt_packet *packet)
+{
+	int errcode;
+
+	errcode = pt_enc_next(&cfix->encoder, packet);
+	ptu_int_gt(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result cfix_psb(struct calibrate_fixture *cfix,
+				     uint64_t tsc)
+{
+	struct pt_packet packet;
+
+	memset(&packet, 0, sizeof(packet));
+
+	packet.type = ppt_psb;
+	ptu_test(cfix_encode, cfix, &packet);
+
+	packet.type = ppt_tsc;
+	packet.payload.tsc.tsc = tsc;
+	ptu_test(cfix_encode, cfix, &packet);
+
+	packet.type = ppt_psbend;
+	ptu_test(cfix_encode, cfix, &packet);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result cfix_cyc(struct calibrate_fixture *cfix,
+				     uint64_t cyc)
+{
+	struct pt_packet packet;
+
+	memset(&packet, 0, sizeof(packet));
+
+	packet.type = ppt_cyc;
+	packet.payload.cyc.value = cyc;
+	ptu_test(cfix_encode, cfix, &packet);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result cfix_ovf(struct calibrate_fixture *cfix)
+{
+	struct pt_packet packet;
+
+	memset(&packet, 0, sizeof(packet));
+
+	packet.type = ppt_ovf;
+	ptu_test(cfix_encode, cfix, &packet);
+
+	return ptu_passed();
+}
+
+/* Dummy decode functions to satisfy link dependencies. */
+struct pt_query_decoder;
+
+int pt_qry_decode_unknown(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_pad(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_psb(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_tip(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_tnt_8(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_tnt_64(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_tip_pge(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_tip_pgd(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_fup(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_header_fup(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_pip(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_header_pip(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_ovf(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_mode(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_header_mode(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_psbend(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_tsc(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_header_tsc(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_cbr(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_header_cbr(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_tma(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_mtc(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_cyc(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_stop(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_vmcs(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_header_vmcs(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_mnt(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_header_mnt(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_exstop(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_mwait(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_pwre(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_pwrx(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+int pt_qry_decode_ptw(struct pt_query_decoder *d)
+{
+	(void) d;
+
+	return -pte_internal;
+}
+
+static struct ptunit_result null(struct calibrate_fixture *cfix)
+{
+	int errcode;
+
+	errcode = pt_time_calibrate(NULL, sizeof(cfix->cal), &cfix->config);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_time_calibrate(&cfix->cal, sizeof(cfix->cal), NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result empty(struct calibrate_fixture *cfix)
+{
+	int errcode;
+
+	errcode = pt_time_calibrate(&cfix->cal, sizeof(cfix->cal),
+				    &cfix->config);
+	ptu_int_eq(errcode, -pte_no_time);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result no_cyc(struct calibrate_fixture *cfix)
+{
+	int errcode;
+
+	ptu_test(cfix_psb, cfix, 0x1000ull);
+	ptu_test(cfix_psb, cfix, 0x1800ull);
+
+	errcode = pt_time_calibrate(&cfix->cal, sizeof(cfix->cal),
+				    &cfix->config);
+	ptu_int_eq(errcode, -pte_no_time);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result tsc(struct calibrate_fixture *cfix)
+{
+	int errcode;
+
+	ptu_test(cfix_psb, cfix, 0x1000ull);
+	ptu_test(cfix_cyc, cfix, 0x80ull);
+	ptu_test(cfix_cyc, cfix, 0x80ull);
+	ptu_test(cfix_psb, cfix, 0x1800ull);
+
+	errcode = pt_time_calibrate(&cfix->cal, sizeof(cfix->cal),
+				    &cfix->config);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cfix->cal.size, sizeof(cfix->cal));
+	ptu_uint_eq(cfix->cal.fcr, 0x8ull << 8);
+	ptu_uint_eq(cfix->cal.min_fcr, 0x8ull << 8);
+	ptu_uint_eq(cfix->cal.max_fcr, 0x8ull << 8);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result tsc_bounds(struct calibrate_fixture *cfix)
+{
+	int errcode;
+
+	ptu_test(cfix_psb, cfix, 0x1000ull);
+	ptu_test(cfix_cyc, cfix, 0x100ull);
+	ptu_test(cfix_psb, cfix, 0x1800ull);
+	ptu_test(cfix_cyc, cfix, 0x200ull);
+	ptu_test(cfix_psb, cfix, 0x2000ull);
+
+	errcode = pt_time_calibrate(&cfix->cal, sizeof(cfix->cal),
+				    &cfix->config);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cfix->cal.fcr, 0x4ull << 8);
+	ptu_uint_eq(cfix->cal.min_fcr, 0x4ull << 8);
+	ptu_uint_eq(cfix->cal.max_fcr, 0x8ull << 8);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result ovf(struct calibrate_fixture *cfix)
+{
+	int errcode;
+
+	ptu_test(cfix_psb, cfix, 0x1000ull);
+	ptu_test(cfix_cyc, cfix, 0x100ull);
+	ptu_test(cfix_psb, cfix, 0x1800ull);
+	ptu_test(cfix_cyc, cfix, 0x100ull);
+	ptu_test(cfix_ovf, cfix);
+	ptu_test(cfix_cyc, cfix, 0x1ull);
+	ptu_test(cfix_psb, cfix, 0x4000ull);
+
+	/* We keep the estimation but do not calibrate across the overflow. */
+	errcode = pt_time_calibrate(&cfix->cal, sizeof(cfix->cal),
+				    &cfix->config);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cfix->cal.fcr, 0x8ull << 8);
+	ptu_uint_eq(cfix->cal.min_fcr, 0x8ull << 8);
+	ptu_uint_eq(cfix->cal.max_fcr, 0x8ull << 8);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result small(struct calibrate_fixture *cfix)
+{
+	size_t size;
+	int errcode;
+
+	ptu_test(cfix_psb, cfix, 0x1000ull);
+	ptu_test(cfix_cyc, cfix, 0x100ull);
+	ptu_test(cfix_psb, cfix, 0x1800ull);
+
+	size = offsetof(struct pt_time_calibration, min_fcr);
+
+	errcode = pt_time_calibrate(&cfix->cal, size, &cfix->config);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cfix->cal.size, size);
+	ptu_uint_eq(cfix->cal.fcr, 0x8ull << 8);
+	ptu_uint_eq(cfix->cal.min_fcr, 0xcdcdcdcdcdcdcdcdull);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct calibrate_fixture cfix;
+	struct ptunit_suite suite;
+
+	cfix.init = cfix_init;
+	cfix.fini = cfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run_f(suite, null, cfix);
+	ptu_run_f(suite, empty, cfix);
+	ptu_run_f(suite, no_cyc, cfix);
+	ptu_run_f(suite, tsc, cfix);
+	ptu_run_f(suite, tsc_bounds, cfix);
+	ptu_run_f(suite, ovf, cfix);
+	ptu_run_f(suite, small, cfix);
+
+	return ptunit_report(&suite);
+}
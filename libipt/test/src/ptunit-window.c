@@ -0,0 +1,457 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_window.h"
+#include "pt_opcodes.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+
+
+/* A test fixture for window tests. */
+struct window_fixture {
+	/* The trace buffer. */
+	uint8_t buffer[256];
+
+	/* The trace fragments. */
+	struct pt_fragment fragments[3];
+
+	/* A trace configuration. */
+	struct pt_config config;
+
+	/* The window. */
+	struct pt_window win;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct window_fixture *);
+	struct ptunit_result (*fini)(struct window_fixture *);
+};
+
+static struct ptunit_result wfix_init(struct window_fixture *wfix)
+{
+	memset(wfix->buffer, 0xcd, sizeof(wfix->buffer));
+	memset(wfix->fragments, 0, sizeof(wfix->fragments));
+	memset(&wfix->win, 0, sizeof(wfix->win));
+
+	memset(&wfix->config, 0, sizeof(wfix->config));
+	wfix->config.size = sizeof(wfix->config);
+	wfix->config.begin = wfix->buffer;
+	wfix->config.end = wfix->buffer + sizeof(wfix->buffer);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result wfix_fini(struct window_fixture *wfix)
+{
+	pt_win_fini(&wfix->win);
+
+	return ptu_passed();
+}
+
+static void wfix_encode_psb(struct window_fixture *wfix, size_t offset)
+{
+	uint8_t *pos;
+	int i;
+
+	pos = &wfix->buffer[offset];
+
+	*pos++ = pt_opc_psb;
+	*pos++ = pt_ext_psb;
+
+	for (i = 0; i < pt_psb_repeat_count; ++i) {
+		*pos++ = pt_psb_hi;
+		*pos++ = pt_psb_lo;
+	}
+}
+
+/* Split the first 128 bytes of the trace buffer into two fragments at 64. */
+static void wfix_split(struct window_fixture *wfix)
+{
+	wfix->fragments[0].begin = wfix->buffer;
+	wfix->fragments[0].end = wfix->buffer + 64;
+	wfix->fragments[1].begin = wfix->buffer + 64;
+	wfix->fragments[1].end = wfix->buffer + 128;
+
+	wfix->config.fragments = wfix->fragments;
+	wfix->config.nfragments = 2;
+}
+
+static struct ptunit_result check_window(const struct pt_window *win,
+					 const uint8_t *trace,
+					 uint64_t begin, uint64_t end)
+{
+	ptu_uint_eq(win->offset, begin);
+	ptu_uint_eq((uint64_t) (win->end - win->begin), end - begin);
+	ptu_int_eq(memcmp(win->begin, trace + begin, (size_t) (end - begin)),
+		   0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_null(struct window_fixture *wfix)
+{
+	int errcode;
+
+	errcode = pt_win_init(NULL, &wfix->config);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_win_init(&wfix->win, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result single(struct window_fixture *wfix)
+{
+	int errcode;
+
+	wfix_encode_psb(wfix, 32);
+
+	errcode = pt_win_init(&wfix->win, &wfix->config);
+	ptu_int_eq(errcode, 0);
+	ptu_ptr_eq(wfix->win.begin, wfix->buffer);
+	ptu_ptr_eq(wfix->win.end, wfix->buffer + sizeof(wfix->buffer));
+	ptu_ptr_eq(wfix->config.begin, wfix->win.begin);
+	ptu_ptr_eq(wfix->config.end, wfix->win.end);
+	ptu_uint_eq(wfix->win.offset, 0ull);
+	ptu_int_eq(pt_win_has_next(&wfix->win), 0);
+
+	errcode = pt_win_next(&wfix->win);
+	ptu_int_eq(errcode, -pte_eos);
+
+	errcode = pt_win_prev(&wfix->win);
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fragments(struct window_fixture *wfix)
+{
+	int errcode;
+
+	wfix_encode_psb(wfix, 32);
+	wfix_encode_psb(wfix, 80);
+	wfix_split(wfix);
+
+	errcode = pt_win_init(&wfix->win, &wfix->config);
+	ptu_int_eq(errcode, 0);
+	ptu_null(wfix->config.fragments);
+	ptu_uint_eq(wfix->config.nfragments, 0);
+	ptu_ptr_eq(wfix->config.begin, wfix->buffer);
+	ptu_ptr_eq(wfix->config.end, wfix->buffer + 32);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 0ull, 32ull);
+	ptu_int_eq(pt_win_has_next(&wfix->win), 1);
+
+	errcode = pt_win_next(&wfix->win);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 32ull, 80ull);
+	ptu_ptr_eq(wfix->win.begin, wfix->win.buffer);
+
+	errcode = pt_win_next(&wfix->win);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 80ull, 128ull);
+	ptu_ptr_eq(wfix->win.begin, wfix->buffer + 80);
+	ptu_int_eq(pt_win_has_next(&wfix->win), 0);
+
+	errcode = pt_win_next(&wfix->win);
+	ptu_int_eq(errcode, -pte_eos);
+
+	errcode = pt_win_prev(&wfix->win);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 32ull, 80ull);
+
+	errcode = pt_win_prev(&wfix->win);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 0ull, 32ull);
+
+	errcode = pt_win_prev(&wfix->win);
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fragments_psbs(struct window_fixture *wfix)
+{
+	int errcode;
+
+	wfix_encode_psb(wfix, 0);
+	wfix_encode_psb(wfix, 32);
+	wfix_encode_psb(wfix, 80);
+	wfix_encode_psb(wfix, 112);
+	wfix_split(wfix);
+
+	errcode = pt_win_init(&wfix->win, &wfix->config);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 0ull, 32ull);
+
+	errcode = pt_win_next(&wfix->win);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 32ull, 80ull);
+
+	errcode = pt_win_next(&wfix->win);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 80ull, 128ull);
+	ptu_int_eq(pt_win_has_next(&wfix->win), 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fragments_empty(struct window_fixture *wfix)
+{
+	int errcode;
+
+	wfix_encode_psb(wfix, 32);
+	wfix_encode_psb(wfix, 80);
+
+	wfix->fragments[0].begin = wfix->buffer;
+	wfix->fragments[0].end = wfix->buffer + 64;
+	wfix->fragments[1].begin = wfix->buffer + 200;
+	wfix->fragments[1].end = wfix->buffer + 200;
+	wfix->fragments[2].begin = wfix->buffer + 64;
+	wfix->fragments[2].end = wfix->buffer + 128;
+
+	wfix->config.fragments = wfix->fragments;
+	wfix->config.nfragments = 3;
+
+	errcode = pt_win_init(&wfix->win, &wfix->config);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 0ull, 32ull);
+
+	errcode = pt_win_next(&wfix->win);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 32ull, 80ull);
+
+	errcode = pt_win_next(&wfix->win);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 80ull, 128ull);
+	ptu_int_eq(pt_win_has_next(&wfix->win), 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fragments_straddle(struct window_fixture *wfix)
+{
+	int errcode;
+
+	/* A PSB crossing the fragment boundary does not delimit windows. */
+	wfix_encode_psb(wfix, 56);
+	wfix_split(wfix);
+
+	errcode = pt_win_init(&wfix->win, &wfix->config);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 0ull, 128ull);
+	ptu_ptr_eq(wfix->win.begin, wfix->win.buffer);
+	ptu_int_eq(pt_win_has_next(&wfix->win), 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fragments_none(struct window_fixture *wfix)
+{
+	int errcode;
+
+	wfix_split(wfix);
+
+	errcode = pt_win_init(&wfix->win, &wfix->config);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 0ull, 128ull);
+	ptu_int_eq(pt_win_has_next(&wfix->win), 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fragments_gap(struct window_fixture *wfix)
+{
+	const uint8_t *buffer;
+	int errcode;
+
+	/* The middle fragment does not contain a PSB. */
+	wfix_encode_psb(wfix, 16);
+	wfix_encode_psb(wfix, 160);
+
+	wfix->fragments[0].begin = wfix->buffer;
+	wfix->fragments[0].end = wfix->buffer + 64;
+	wfix->fragments[1].begin = wfix->buffer + 64;
+	wfix->fragments[1].end = wfix->buffer + 128;
+	wfix->fragments[2].begin = wfix->buffer + 128;
+	wfix->fragments[2].end = wfix->buffer + 192;
+
+	wfix->config.fragments = wfix->fragments;
+	wfix->config.nfragments = 3;
+
+	errcode = pt_win_init(&wfix->win, &wfix->config);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 0ull, 16ull);
+
+	errcode = pt_win_next(&wfix->win);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 16ull, 160ull);
+	ptu_ptr_eq(wfix->win.begin, wfix->win.buffer);
+
+	/* Loading the same window again does not copy it again. */
+	buffer = wfix->win.buffer;
+	wfix->win.buffer[0] = 0;
+
+	errcode = pt_win_load(&wfix->win, 100ull);
+	ptu_int_eq(errcode, 0);
+	ptu_ptr_eq(wfix->win.begin, buffer);
+	ptu_uint_eq(wfix->win.begin[0], 0);
+
+	wfix->win.buffer[0] = wfix->buffer[16];
+
+	errcode = pt_win_next(&wfix->win);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 160ull, 192ull);
+	ptu_int_eq(pt_win_has_next(&wfix->win), 0);
+
+	errcode = pt_win_load(&wfix->win, 130ull);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 16ull, 160ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_shared_null(struct window_fixture *wfix)
+{
+	int errcode;
+
+	errcode = pt_win_init_shared(NULL, &wfix->config, &wfix->win);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_win_init_shared(&wfix->win, NULL, &wfix->win);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_win_init_shared(&wfix->win, &wfix->config, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_shared(struct window_fixture *wfix)
+{
+	struct pt_config config;
+	struct pt_window win;
+	int errcode;
+
+	wfix_encode_psb(wfix, 32);
+	wfix_encode_psb(wfix, 80);
+	wfix_split(wfix);
+
+	config = wfix->config;
+
+	errcode = pt_win_init(&wfix->win, &wfix->config);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_win_init_shared(&win, &config, &wfix->win);
+	ptu_int_eq(errcode, 0);
+	ptu_ptr_eq(win.base, wfix->win.base);
+	ptu_ptr_eq(win.cut, wfix->win.cut);
+	ptu_uint_eq(win.shared, 1);
+	ptu_ptr_eq(config.begin, wfix->buffer);
+	ptu_ptr_eq(config.end, wfix->buffer + 32);
+
+	/* Each window has its own position and buffer. */
+	errcode = pt_win_load(&win, 64ull);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &win, wfix->buffer, 32ull, 80ull);
+	ptu_ptr_eq(win.begin, win.buffer);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 0ull, 32ull);
+
+	errcode = pt_win_load(&wfix->win, 100ull);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 80ull, 128ull);
+	ptu_test(check_window, &win, wfix->buffer, 32ull, 80ull);
+
+	pt_win_fini(&win);
+	ptu_ptr(wfix->win.base);
+	ptu_ptr(wfix->win.cut);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result load(struct window_fixture *wfix)
+{
+	int errcode;
+
+	wfix_encode_psb(wfix, 32);
+	wfix_encode_psb(wfix, 80);
+	wfix_split(wfix);
+
+	errcode = pt_win_init(&wfix->win, &wfix->config);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_win_load(&wfix->win, 100ull);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 80ull, 128ull);
+
+	errcode = pt_win_load(&wfix->win, 64ull);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 32ull, 80ull);
+
+	errcode = pt_win_load(&wfix->win, 31ull);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 0ull, 32ull);
+
+	errcode = pt_win_load(&wfix->win, 128ull);
+	ptu_int_eq(errcode, 0);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 80ull, 128ull);
+
+	errcode = pt_win_load(&wfix->win, 129ull);
+	ptu_int_eq(errcode, -pte_eos);
+	ptu_test(check_window, &wfix->win, wfix->buffer, 80ull, 128ull);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct window_fixture wfix;
+	struct ptunit_suite suite;
+
+	wfix.init = wfix_init;
+	wfix.fini = wfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run_f(suite, init_null, wfix);
+	ptu_run_f(suite, single, wfix);
+	ptu_run_f(suite, fragments, wfix);
+	ptu_run_f(suite, fragments_psbs, wfix);
+	ptu_run_f(suite, fragments_empty, wfix);
+	ptu_run_f(suite, fragments_straddle, wfix);
+	ptu_run_f(suite, fragments_none, wfix);
+	ptu_run_f(suite, fragments_gap, wfix);
+	ptu_run_f(suite, load, wfix);
+	ptu_run_f(suite, init_shared_null, wfix);
+	ptu_run_f(suite, init_shared, wfix);
+
+	return ptunit_report(&suite);
+}
@@ -207,6 +207,14 @@ struct pev_event {
 
 		/* The sample identifier. */
 		const uint64_t *identifier;
+
+		/* The sampled instruction pointer, data address, and period.
+		 *
+		 * Those are only provided for @type = PERF_RECORD_SAMPLE.
+		 */
+		const uint64_t *ip;
+		const uint64_t *addr;
+		const uint64_t *period;
 	} sample;
 };
 
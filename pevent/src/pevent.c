@@ -180,6 +180,100 @@ static int pev_read_samples(struct pev_event *event, const uint8_t *begin,
 	return (int) (pos - begin);
 }
 
+/* The samples we read from PERF_RECORD_SAMPLE records. */
+static const uint64_t pev_record_sample_type = PERF_SAMPLE_IDENTIFIER |
+	PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_ADDR |
+	PERF_SAMPLE_ID | PERF_SAMPLE_STREAM_ID | PERF_SAMPLE_CPU |
+	PERF_SAMPLE_PERIOD;
+
+/* Read the samples of a PERF_RECORD_SAMPLE record.
+ *
+ * Sample records are not followed by sample_id.  They contain the samples
+ * themselves, in a different order.
+ *
+ * Returns the number of bytes read on success, a negative error code otherwise.
+ */
+static int pev_read_record_samples(struct pev_event *event,
+				   const uint8_t *begin, const uint8_t *end,
+				   const struct pev_config *config)
+{
+	const uint8_t *pos;
+	uint64_t sample_type;
+
+	if (!event || !begin || !config)
+		return -pte_internal;
+
+	if (!pev_config_has(config, sample_type))
+		return -pte_bad_config;
+
+	sample_type = config->sample_type;
+	pos = begin;
+
+	if (sample_type & PERF_SAMPLE_IDENTIFIER) {
+		event->sample.identifier = (const uint64_t *) pos;
+		pos += 8;
+	}
+
+	if (sample_type & PERF_SAMPLE_IP) {
+		event->sample.ip = (const uint64_t *) pos;
+		pos += 8;
+	}
+
+	if (sample_type & PERF_SAMPLE_TID) {
+		event->sample.pid = (const uint32_t *) &pos[0];
+		event->sample.tid = (const uint32_t *) &pos[4];
+		pos += 8;
+	}
+
+	if (sample_type & PERF_SAMPLE_TIME) {
+		int errcode;
+
+		event->sample.time = (const uint64_t *) pos;
+		pos += 8;
+
+		/* We're reading the time.  Let's make sure the pointer lies
+		 * inside the buffer.
+		 */
+		if (end < pos)
+			return -pte_nosync;
+
+		errcode = pev_time_to_tsc(&event->sample.tsc,
+					  *event->sample.time, config);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	if (sample_type & PERF_SAMPLE_ADDR) {
+		event->sample.addr = (const uint64_t *) pos;
+		pos += 8;
+	}
+
+	if (sample_type & PERF_SAMPLE_ID) {
+		event->sample.id = (const uint64_t *) pos;
+		pos += 8;
+	}
+
+	if (sample_type & PERF_SAMPLE_STREAM_ID) {
+		event->sample.stream_id = (const uint64_t *) pos;
+		pos += 8;
+	}
+
+	if (sample_type & PERF_SAMPLE_CPU) {
+		event->sample.cpu = (const uint32_t *) pos;
+		pos += 8;
+	}
+
+	if (sample_type & PERF_SAMPLE_PERIOD) {
+		event->sample.period = (const uint64_t *) pos;
+		pos += 8;
+	}
+
+	if (end < pos)
+		return -pte_nosync;
+
+	return (int) (pos - begin);
+}
+
 int pev_read(struct pev_event *event, const uint8_t *begin, const uint8_t *end,
 	     const struct pev_config *config)
 {
@@ -217,6 +311,25 @@ int pev_read(struct pev_event *event, const uint8_t *begin, const uint8_t *end,
 		 */
 		return (int) header->size;
 
+	case PERF_RECORD_SAMPLE:
+		size = pev_read_record_samples(event, pos, end, config);
+		if (size < 0)
+			return size;
+
+		/* We skip samples we do not read.  They follow the ones we
+		 * read so the ones we provide are still correct.
+		 */
+		if (config->sample_type & ~pev_record_sample_type)
+			return (int) header->size;
+
+		pos += size;
+
+		size = (int) (pos - begin);
+		if ((uint16_t) size != header->size)
+			return -pte_nosync;
+
+		return size;
+
 	case PERF_RECORD_MMAP: {
 		int slen;
 
@@ -360,6 +473,15 @@ static size_t sample_size(const struct pev_event *event)
 	if (event->sample.identifier)
 		size += sizeof(*event->sample.identifier);
 
+	if (event->sample.ip)
+		size += sizeof(*event->sample.ip);
+
+	if (event->sample.addr)
+		size += sizeof(*event->sample.addr);
+
+	if (event->sample.period)
+		size += sizeof(*event->sample.period);
+
 	return size;
 }
 
@@ -452,6 +574,94 @@ static int write_samples(uint8_t **stream, const struct pev_event *event,
 	return 0;
 }
 
+/* Write a sample @field of a PERF_RECORD_SAMPLE record if @sample_type
+ * contains @flag.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int write_record_sample(uint8_t **stream, uint64_t sample_type,
+			       uint64_t flag, const uint64_t *field)
+{
+	if (!(sample_type & flag))
+		return 0;
+
+	if (!field)
+		return -pte_bad_packet;
+
+	write(stream, field, sizeof(*field));
+
+	return 0;
+}
+
+static int write_record_samples(uint8_t **stream,
+				const struct pev_event *event,
+				const struct pev_config *config)
+{
+	uint64_t sample_type;
+	int errcode;
+
+	if (!event || !config)
+		return -pte_internal;
+
+	if (!pev_config_has(config, sample_type))
+		return -pte_bad_config;
+
+	sample_type = config->sample_type;
+	if (sample_type & ~pev_record_sample_type)
+		return -pte_bad_packet;
+
+	errcode = write_record_sample(stream, sample_type,
+				      PERF_SAMPLE_IDENTIFIER,
+				      event->sample.identifier);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = write_record_sample(stream, sample_type, PERF_SAMPLE_IP,
+				      event->sample.ip);
+	if (errcode < 0)
+		return errcode;
+
+	if (sample_type & PERF_SAMPLE_TID) {
+		if (!event->sample.pid || !event->sample.tid)
+			return -pte_bad_packet;
+
+		write(stream, event->sample.pid, sizeof(*event->sample.pid));
+		write(stream, event->sample.tid, sizeof(*event->sample.tid));
+	}
+
+	errcode = write_record_sample(stream, sample_type, PERF_SAMPLE_TIME,
+				      event->sample.time);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = write_record_sample(stream, sample_type, PERF_SAMPLE_ADDR,
+				      event->sample.addr);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = write_record_sample(stream, sample_type, PERF_SAMPLE_ID,
+				      event->sample.id);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = write_record_sample(stream, sample_type,
+				      PERF_SAMPLE_STREAM_ID,
+				      event->sample.stream_id);
+	if (errcode < 0)
+		return errcode;
+
+	if (sample_type & PERF_SAMPLE_CPU) {
+		if (!event->sample.cpu)
+			return -pte_bad_packet;
+
+		write(stream, event->sample.cpu, sizeof(*event->sample.cpu));
+		clear(stream, sizeof(uint32_t));
+	}
+
+	return write_record_sample(stream, sample_type, PERF_SAMPLE_PERIOD,
+				   event->sample.period);
+}
+
 int pev_write(const struct pev_event *event, uint8_t *begin, uint8_t *end,
 	      const struct pev_config *config)
 {
@@ -475,6 +685,19 @@ int pev_write(const struct pev_event *event, uint8_t *begin, uint8_t *end,
 	default:
 		return -pte_bad_opc;
 
+	case PERF_RECORD_SAMPLE:
+		header.size = (uint16_t) size;
+		if (end < pos + header.size)
+			return -pte_eos;
+
+		write(&pos, &header, sizeof(header));
+
+		errcode = write_record_samples(&pos, event, config);
+		if (errcode < 0)
+			return errcode;
+
+		return (int) (pos - begin);
+
 	case PERF_RECORD_MMAP: {
 		size_t slen, gap;
 
@@ -716,6 +716,70 @@ static struct ptunit_result switch_cpu_wide(struct pev_fixture *pfix,
 	return ptu_passed();
 }
 
+static struct ptunit_result sample(struct pev_fixture *pfix)
+{
+	uint64_t ip, period;
+
+	ip = 0xffffffff81000010ull;
+	period = 0x1000ull;
+
+	pfix->config.sample_type |= (uint64_t) PERF_SAMPLE_IP;
+	pfix->config.sample_type |= (uint64_t) PERF_SAMPLE_PERIOD;
+
+	pfix->event[0].sample.ip = &ip;
+	pfix->event[0].sample.period = &period;
+	pfix->event[0].type = PERF_RECORD_SAMPLE;
+
+	ptu_test(pfix_read_write, pfix);
+	ptu_test(pfix_check_sample, pfix);
+
+	ptu_int_eq(pfix->event[1].type, pfix->event[0].type);
+	ptu_ptr(pfix->event[1].sample.ip);
+	ptu_uint_eq(*pfix->event[1].sample.ip, ip);
+	ptu_ptr(pfix->event[1].sample.period);
+	ptu_uint_eq(*pfix->event[1].sample.period, period);
+	ptu_null(pfix->event[1].sample.addr);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sample_skip(struct pev_fixture *pfix)
+{
+	struct perf_event_header *header;
+	uint8_t *begin, *end;
+	uint64_t ip;
+	int size;
+
+	ip = 0x1000ull;
+
+	pfix->config.sample_type |= (uint64_t) PERF_SAMPLE_IP;
+
+	pfix->event[0].sample.ip = &ip;
+	pfix->event[0].type = PERF_RECORD_SAMPLE;
+
+	begin = pfix->buffer;
+	end = begin + sizeof(pfix->buffer);
+
+	size = pev_write(&pfix->event[0], begin, end, &pfix->config);
+	ptu_int_gt(size, 0);
+
+	/* Pretend there's a call chain following the samples we know. */
+	header = (struct perf_event_header *) begin;
+	header->size += 0x10;
+
+	pfix->config.sample_type |= (uint64_t) PERF_SAMPLE_CALLCHAIN;
+
+	size = pev_read(&pfix->event[1], begin, end, &pfix->config);
+	ptu_int_eq(size, header->size);
+	ptu_ptr(pfix->event[1].sample.ip);
+	ptu_uint_eq(*pfix->event[1].sample.ip, ip);
+
+	size = pev_write(&pfix->event[0], begin, end, &pfix->config);
+	ptu_int_eq(size, -pte_bad_packet);
+
+	return ptu_passed();
+}
+
 int main(int argc, char **argv)
 {
 	struct pev_fixture pfix, pfix_time, pfix_who;
@@ -762,6 +826,8 @@ int main(int argc, char **argv)
 	ptu_run_fp(suite, switch_task, pfix, 1);
 	ptu_run_fp(suite, switch_cpu_wide, pfix, 0);
 	ptu_run_fp(suite, switch_cpu_wide, pfix, 1);
+	ptu_run_f(suite, sample, pfix);
+	ptu_run_f(suite, sample_skip, pfix);
 
 	ptu_run_f(suite, mmap, pfix_time);
 	ptu_run_f(suite, lost, pfix_time);
@@ -778,6 +844,7 @@ int main(int argc, char **argv)
 	ptu_run_fp(suite, switch_task, pfix_time, 1);
 	ptu_run_fp(suite, switch_cpu_wide, pfix_time, 0);
 	ptu_run_fp(suite, switch_cpu_wide, pfix_time, 1);
+	ptu_run_f(suite, sample, pfix_time);
 
 	ptu_run_f(suite, mmap, pfix_who);
 	ptu_run_f(suite, lost, pfix_who);
@@ -794,6 +861,7 @@ int main(int argc, char **argv)
 	ptu_run_fp(suite, switch_task, pfix_who, 1);
 	ptu_run_fp(suite, switch_cpu_wide, pfix_who, 0);
 	ptu_run_fp(suite, switch_cpu_wide, pfix_who, 1);
+	ptu_run_f(suite, sample, pfix_who);
 
 	return ptunit_report(&suite);
 }
@@ -1680,9 +1680,12 @@ static int process_args(int argc, char *argv[],
 #if defined(FEATURE_SIDEBAND)
 			options->sb_dump_flags = 0;
 #endif
-		} else if (strcmp(argv[idx], "--no-pad") == 0)
+		} else if (strcmp(argv[idx], "--no-pad") == 0) {
 			options->no_pad = 1;
-		else if (strcmp(argv[idx], "--no-timing") == 0)
+
+			/* We don't show them, so skip them in bulk. */
+			config->flags.variant.packet.coalesce_pad = 1;
+		} else if (strcmp(argv[idx], "--no-timing") == 0)
 			options->no_timing = 1;
 		else if (strcmp(argv[idx], "--no-cyc") == 0)
 			options->no_cyc = 1;
@@ -44,6 +44,7 @@
 #include <string.h>
 #include <inttypes.h>
 #include <errno.h>
+#include <time.h>
 
 #include <xed-interface.h>
 
@@ -71,6 +72,9 @@ struct ptxed_decoder {
 	/* The image section cache. */
 	struct pt_image_section_cache *iscache;
 
+	/* The code snapshot to record - NULL if we don't record one. */
+	struct pt_code_snapshot *snap;
+
 #if defined(FEATURE_SIDEBAND)
 	/* The sideband session. */
 	struct pt_sb_session *session;
@@ -87,7 +91,53 @@ struct ptxed_options {
 #if defined(FEATURE_SIDEBAND)
 	/* Sideband dump flags. */
 	uint32_t sb_dump_flags;
+
+	/* The minimal size of sections to warm up in the background.
+	 *
+	 * This only applies if @sb_warmup is set.
+	 */
+	uint64_t sb_warmup_size;
 #endif
+	/* The number of instructions to decode per decode step.
+	 *
+	 * This only applies to the block decoder.  Zero means unlimited.
+	 */
+	uint64_t block_budget;
+
+	/* The trace offset of the PSB packet at which to start decoding when
+	 * decoding a single shard of the trace.
+	 *
+	 * This only applies if @have_shard_begin is set.
+	 */
+	uint64_t shard_begin;
+
+	/* The trace offset of the PSB packet at which the next shard begins.
+	 *
+	 * Zero if the shard extends to the end of the trace.
+	 */
+	uint64_t shard_end;
+
+	/* The IP at which the next shard starts decoding.
+	 *
+	 * This only applies if @have_shard_ip is set.
+	 */
+	uint64_t shard_ip;
+
+	/* The number of shards to plan instead of decoding - zero if we are
+	 * decoding.
+	 */
+	uint32_t shard_plan;
+
+	/* The file to which to write the code snapshot - NULL if we don't
+	 * record one.
+	 */
+	const char *snapshot;
+
+	/* The file to which to write the decode cost profile - NULL if we
+	 * don't write one.
+	 */
+	const char *profile;
+
 	/* Do not print the instruction. */
 	uint32_t dont_print_insn:1;
 
@@ -106,6 +156,12 @@ struct ptxed_options {
 	 */
 	uint32_t track_blocks:1;
 
+	/* Show the time annotations of blocks when tracking blocks.
+	 *
+	 * This only applies to the block decoder.
+	 */
+	uint32_t track_block_time:1;
+
 	/* Print in AT&T format. */
 	uint32_t att_format:1;
 
@@ -115,6 +171,9 @@ struct ptxed_options {
 	/* Print the current timestamp. */
 	uint32_t print_time:1;
 
+	/* Calibrate timing over the entire trace before decoding. */
+	uint32_t calibrate:1;
+
 	/* Print the raw bytes for an insn. */
 	uint32_t print_raw_insn:1;
 
@@ -130,9 +189,21 @@ struct ptxed_options {
 	/* Request tick events. */
 	uint32_t enable_tick_events:1;
 
+	/* Request zero-copy instruction bytes. */
+	uint32_t insn_zero_copy:1;
+
+	/* Start decoding at @shard_begin. */
+	uint32_t have_shard_begin:1;
+
+	/* The next shard starts decoding at @shard_ip. */
+	uint32_t have_shard_ip:1;
+
 #if defined(FEATURE_SIDEBAND)
 	/* Print sideband warnings. */
 	uint32_t print_sb_warnings:1;
+
+	/* Warm up newly mapped sections in the background. */
+	uint32_t sb_warmup:1;
 #endif
 };
 
@@ -142,7 +213,54 @@ enum ptxed_stats_flag {
 	ptxed_stat_insn		= (1 << 0),
 
 	/* Collect number of blocks. */
-	ptxed_stat_blocks	= (1 << 1)
+	ptxed_stat_blocks	= (1 << 1),
+
+	/* Collect number of instructions per instruction class. */
+	ptxed_stat_iclass	= (1 << 2),
+
+	/* Collect the code footprint. */
+	ptxed_stat_footprint	= (1 << 3),
+
+	/* Collect the decode cost per PSB segment. */
+	ptxed_stat_profile	= (1 << 4),
+
+	/* Collect the decode cost per PSB segment without printing it. */
+	ptxed_stat_profile_save	= (1 << 5)
+};
+
+/* The decode cost of a single PSB segment. */
+struct ptxed_segment {
+	/* The trace offset of the segment's PSB packet. */
+	uint64_t offset;
+
+	/* The time at the beginning of the segment. */
+	uint64_t tsc;
+
+	/* The processor time spent decoding the segment. */
+	clock_t clocks;
+
+	/* The number of decode errors in the segment. */
+	uint64_t errors;
+
+	/* The block decoder profile counters for the segment. */
+	struct pt_blk_profile profile;
+};
+
+/* A decode cost profile. */
+struct ptxed_profile {
+	/* The PSB segments in the order in which they were decoded. */
+	struct ptxed_segment *segments;
+
+	/* The number of used and allocated segments. */
+	size_t nsegments, capacity;
+
+	/* The block decoder profile counters at the beginning of the current
+	 * segment.
+	 */
+	struct pt_blk_profile begin;
+
+	/* The processor time at the beginning of the current segment. */
+	clock_t start;
 };
 
 /* A collection of statistics. */
@@ -156,6 +274,24 @@ struct ptxed_stats {
 	 */
 	uint64_t blocks;
 
+	/* The instruction mix profile.
+	 *
+	 * This only applies to the block decoder.
+	 */
+	struct pt_insn_mix *mix;
+
+	/* The code footprint analysis.
+	 *
+	 * This only applies to the block decoder.
+	 */
+	struct pt_footprint *fp;
+
+	/* The decode cost profile.
+	 *
+	 * This only applies to the block decoder.
+	 */
+	struct ptxed_profile profile;
+
 	/* A collection of flags saying which statistics to collect/print. */
 	uint32_t flags;
 };
@@ -215,6 +351,7 @@ static void ptxed_free_decoder(struct ptxed_decoder *decoder)
 	pt_sb_free(decoder->session);
 #endif
 
+	pt_snap_free(decoder->snap);
 	pt_iscache_free(decoder->iscache);
 }
 
@@ -229,6 +366,7 @@ static void help(const char *name)
 	printf("  --quiet|-q                           do not print anything (except errors).\n");
 	printf("  --offset                             print the offset into the trace file.\n");
 	printf("  --time                               print the current timestamp.\n");
+	printf("  --time:calibrate                     calibrate timing over the entire trace before decoding.\n");
 	printf("  --raw-insn                           print the raw bytes of each instruction.\n");
 	printf("  --check                              perform checks (expensive).\n");
 	printf("  --iscache-limit <size>               set the image section cache limit to <size> bytes.\n");
@@ -242,6 +380,14 @@ static void help(const char *name)
 	printf("                                       collects all statistics unless one or more are selected.\n");
 	printf("  --stat:insn                          collect number of instructions.\n");
 	printf("  --stat:blocks                        collect number of blocks.\n");
+	printf("  --stat:iclass                        collect number of instructions per class (block decoder only).\n");
+	printf("  --stat:footprint                     collect the code footprint (block decoder only).\n");
+	printf("  --stat:profile                       collect the decode cost per PSB segment (block decoder only).\n");
+	printf("  --stat:profile-save <file>           write the decode cost per PSB segment into <file> (block decoder only).\n");
+	printf("  --footprint:window-insn <n>          report the code footprint every <n> instructions.\n");
+	printf("  --footprint:window-tsc <n>           report the code footprint every <n> tsc ticks (implies --block:timing).\n");
+	printf("  --footprint:icache <sets> <ways>     simulate an instruction cache with <sets> sets and <ways> ways (default: 64 8).\n");
+	printf("  --footprint:itlb <4k> <2m>           simulate instruction tlbs with <4k> and <2m> entries (default: 64 8).\n");
 #if defined(FEATURE_SIDEBAND)
 	printf("  --sb:compact | --sb                  show sideband records in compact format.\n");
 	printf("  --sb:verbose                         show sideband records in verbose format.\n");
@@ -250,6 +396,7 @@ static void help(const char *name)
 	printf("  --sb:time                            show the time on sideband records.\n");
 	printf("  --sb:switch                          print the new image name on context switches.\n");
 	printf("  --sb:warn                            show sideband warnings.\n");
+	printf("  --sb:warmup <size>                   map sections of at least <size> bytes in the background.\n");
 #if defined(FEATURE_PEVENT)
 	printf("  --pevent:primary/secondary <file>[:<from>[-<to>]]\n");
 	printf("                              load a perf_event sideband stream from <file>.\n");
@@ -278,6 +425,8 @@ static void help(const char *name)
 #endif /* defined(FEATURE_ELF) */
 	printf("  --raw <file>[:<from>[-<to>]]:<base>  load a raw binary from <file> at address <base>.\n");
 	printf("                                       an optional offset or range can be given.\n");
+	printf("  --snapshot:load <file>               load the code snapshot <file> (replaces --raw|--elf).\n");
+	printf("  --snapshot:save <file>               record the code pages touched while decoding into <file>.\n");
 	printf("  --cpu none|auto|f/m[/s]              set cpu to the given value and decode according to:\n");
 	printf("                                         none     spec (default)\n");
 	printf("                                         auto     current cpu\n");
@@ -287,15 +436,23 @@ static void help(const char *name)
 	printf("  --cpuid-0x15.eax                     set the value of cpuid[0x15].eax.\n");
 	printf("  --cpuid-0x15.ebx                     set the value of cpuid[0x15].ebx.\n");
 	printf("  --insn-decoder                       use the instruction flow decoder (default).\n");
+	printf("  --insn:zero-copy                     do not copy instruction bytes if possible.\n");
 	printf("  --block-decoder                      use the block decoder.\n");
 	printf("  --block:show-blocks                  show blocks in the output.\n");
 	printf("  --block:end-on-call                  set the end-on-call block decoder flag.\n");
 	printf("  --block:end-on-jump                  set the end-on-jump block decoder flag.\n");
+	printf("  --block:timing                       annotate blocks with timing information (replaces tick events).\n");
+	printf("  --block:prefetch                     prefetch code for upcoming branch targets.\n");
+	printf("  --block:budget <n>                   decode in steps of at most <n> instructions.\n");
+	printf("  --shard:plan <n>                     print a manifest splitting the trace into <n> shards instead of decoding.\n");
+	printf("  --shard:begin <offset>               decode the shard starting at the PSB at <offset> (insn decoder only).\n");
+	printf("  --shard:end <offset>                 end the shard at the PSB at <offset>.\n");
+	printf("  --shard:ip <ip>                      the next shard starts decoding at <ip>.\n");
 	printf("\n");
 #if defined(FEATURE_ELF)
-	printf("You must specify at least one binary or ELF file (--raw|--elf).\n");
+	printf("You must specify at least one binary or ELF file (--raw|--elf|--snapshot:load).\n");
 #else /* defined(FEATURE_ELF) */
-	printf("You must specify at least one binary file (--raw).\n");
+	printf("You must specify at least one binary file (--raw|--snapshot:load).\n");
 #endif /* defined(FEATURE_ELF) */
 	printf("You must specify exactly one processor trace file (--pt).\n");
 }
@@ -577,6 +734,83 @@ static int load_raw(struct pt_image_section_cache *iscache,
 	return 0;
 }
 
+static int load_snapshot(struct pt_image_section_cache *iscache,
+			 struct pt_image *image, const char *arg,
+			 const char *prog)
+{
+	uint8_t *buffer;
+	size_t size;
+	int errcode;
+
+	errcode = load_file(&buffer, &size, arg, 0ull, 0ull, prog);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_snap_load(iscache, image, NULL, buffer, size);
+	free(buffer);
+
+	if (errcode < 0) {
+		fprintf(stderr, "%s: failed to load snapshot %s: %s.\n",
+			prog, arg, pt_errstr(pt_errcode(errcode)));
+		return -1;
+	}
+
+	return 0;
+}
+
+static int save_snapshot(struct pt_code_snapshot *snap, const char *filename,
+			 const char *prog)
+{
+	uint8_t *buffer;
+	size_t size, written;
+	FILE *file;
+	int errcode;
+
+	errcode = pt_snap_size(snap, &size);
+	if (errcode < 0) {
+		fprintf(stderr, "%s: failed to write snapshot %s: %s.\n",
+			prog, filename, pt_errstr(pt_errcode(errcode)));
+		return -1;
+	}
+
+	buffer = malloc(size);
+	if (!buffer) {
+		fprintf(stderr, "%s: failed to allocate memory %s.\n",
+			prog, filename);
+		return -1;
+	}
+
+	errcode = pt_snap_write(snap, buffer, size);
+	if (errcode < 0) {
+		fprintf(stderr, "%s: failed to write snapshot %s: %s.\n",
+			prog, filename, pt_errstr(pt_errcode(errcode)));
+		goto err_buffer;
+	}
+
+	errno = 0;
+	file = fopen(filename, "wb");
+	if (!file) {
+		fprintf(stderr, "%s: failed to open %s: %d.\n",
+			prog, filename, errno);
+		goto err_buffer;
+	}
+
+	written = fwrite(buffer, size, 1u, file);
+	errcode = fclose(file);
+	if ((written != 1) || errcode) {
+		fprintf(stderr, "%s: failed to write %s: %d.\n",
+			prog, filename, errno);
+		goto err_buffer;
+	}
+
+	free(buffer);
+	return 0;
+
+err_buffer:
+	free(buffer);
+	return -1;
+}
+
 static xed_machine_mode_enum_t translate_mode(enum pt_exec_mode mode)
 {
 	switch (mode) {
@@ -743,6 +977,14 @@ static void check_insn_iclass(const xed_inst_t *inst,
 
 }
 
+static const uint8_t *insn_bytes(const struct pt_insn *insn)
+{
+	if (insn->bytes)
+		return insn->bytes;
+
+	return insn->raw;
+}
+
 static void check_insn_decode(xed_decoded_inst_t *inst,
 			      const struct pt_insn *insn, uint64_t offset)
 {
@@ -765,7 +1007,7 @@ static void check_insn_decode(xed_decoded_inst_t *inst,
 	 * while not printing instructions since the latter is too expensive for
 	 * regular use with long traces.
 	 */
-	errcode = xed_decode(inst, insn->raw, insn->size);
+	errcode = xed_decode(inst, insn_bytes(insn), insn->size);
 	if (errcode != XED_ERROR_NONE) {
 		printf("[%" PRIx64 ", %" PRIx64 ": xed error: (%u) %s]\n",
 		       offset, insn->ip, errcode,
@@ -808,6 +1050,7 @@ static void check_insn(const struct pt_insn *insn, uint64_t offset)
 
 static void print_raw_insn(const struct pt_insn *insn)
 {
+	const uint8_t *bytes;
 	uint8_t length, idx;
 
 	if (!insn) {
@@ -819,8 +1062,9 @@ static void print_raw_insn(const struct pt_insn *insn)
 	if (sizeof(insn->raw) < length)
 		length = sizeof(insn->raw);
 
+	bytes = insn_bytes(insn);
 	for (idx = 0; idx < length; ++idx)
-		printf(" %02x", insn->raw[idx]);
+		printf(" %02x", bytes[idx]);
 
 	for (; idx < pt_max_insn_size; ++idx)
 		printf("   ");
@@ -897,7 +1141,7 @@ static void print_insn(const struct pt_insn *insn, xed_state_t *xed,
 		xed_state_set_machine_mode(xed, mode);
 		xed_decoded_inst_zero_set_mode(&inst, xed);
 
-		errcode = xed_decode(&inst, insn->raw, insn->size);
+		errcode = xed_decode(&inst, insn_bytes(insn), insn->size);
 		switch (errcode) {
 		case XED_ERROR_NONE:
 			xed_print_insn(&inst, insn->ip, options);
@@ -1223,13 +1467,189 @@ static int drain_events_insn(struct ptxed_decoder *decoder, uint64_t *time,
 	return status;
 }
 
+/* An instruction that is held back at the end of a shard. */
+struct ptxed_held_insn {
+	/* The instruction. */
+	struct pt_insn insn;
+
+	/* The trace offset and the time at which it was decoded. */
+	uint64_t offset, time;
+};
+
+/* The end of a trace shard.
+ *
+ * When decoding a shard, the decoder crosses the shard's end while it is still
+ * decoding instructions that belong to this shard.  We continue decoding until
+ * we reach the IP at which the next shard starts decoding.
+ *
+ * Instructions decoded after we crossed the shard's end are held back until we
+ * know whether they belong to this or to the next shard.
+ */
+struct ptxed_shard {
+	/* The held instructions. */
+	struct ptxed_held_insn *held;
+
+	/* The number of used and allocated held instructions. */
+	size_t nheld, capacity;
+
+	/* The trace offset at which we crossed the shard's end - zero if we
+	 * have not crossed it, yet.
+	 */
+	uint64_t cross;
+
+	/* A flag saying whether the held instructions begin at the IP at which
+	 * the next shard starts decoding.
+	 */
+	uint32_t at_ip:1;
+};
+
+static void emit_insn(const struct pt_insn *insn, xed_state_t *xed,
+		      const struct ptxed_options *options, uint64_t offset,
+		      uint64_t time, struct ptxed_stats *stats)
+{
+	if (!insn || !options) {
+		printf("[internal error]\n");
+		return;
+	}
+
+	if (!options->quiet)
+		print_insn(insn, xed, options, offset, time);
+
+	if (stats)
+		stats->insn += 1;
+
+	if (options->check)
+		check_insn(insn, offset);
+}
+
+static void ptxed_shard_flush(struct ptxed_shard *shard, xed_state_t *xed,
+			      const struct ptxed_options *options,
+			      struct ptxed_stats *stats)
+{
+	size_t idx;
+
+	if (!shard)
+		return;
+
+	for (idx = 0; idx < shard->nheld; ++idx) {
+		const struct ptxed_held_insn *held;
+
+		held = &shard->held[idx];
+		emit_insn(&held->insn, xed, options, held->offset, held->time,
+			  stats);
+	}
+
+	shard->nheld = 0;
+}
+
+static int ptxed_shard_hold(struct ptxed_shard *shard,
+			    const struct pt_insn *insn, uint64_t offset,
+			    uint64_t time)
+{
+	struct ptxed_held_insn *held;
+
+	if (!shard || !insn)
+		return -pte_internal;
+
+	held = shard->held;
+	if (shard->capacity <= shard->nheld) {
+		size_t capacity;
+
+		capacity = shard->capacity ? shard->capacity * 2 : 64;
+		held = realloc(held, capacity * sizeof(*held));
+		if (!held)
+			return -pte_nomem;
+
+		shard->held = held;
+		shard->capacity = capacity;
+	}
+
+	held += shard->nheld++;
+	held->insn = *insn;
+	held->offset = offset;
+	held->time = time;
+
+	return 0;
+}
+
+/* Emit or hold back @insn depending on whether it belongs to this shard.
+ *
+ * Returns zero if decoding should continue.
+ * Returns a positive integer if the shard has been decoded completely.
+ * Returns a negative error code otherwise.
+ */
+static int ptxed_shard_insn(struct ptxed_shard *shard,
+			    const struct pt_insn *insn, xed_state_t *xed,
+			    const struct ptxed_options *options,
+			    uint64_t offset, uint64_t time,
+			    struct ptxed_stats *stats)
+{
+	if (!shard || !insn || !options)
+		return -pte_internal;
+
+	if (!options->shard_end || (offset < options->shard_end)) {
+		emit_insn(insn, xed, options, offset, time, stats);
+		return 0;
+	}
+
+	/* Once the decoder moved beyond the packets following the next shard's
+	 * PSB, the last time we reached the next shard's IP marks the shard's
+	 * end.
+	 */
+	if (!shard->cross)
+		shard->cross = offset;
+	else if ((shard->cross < offset) &&
+		 (shard->at_ip || !options->have_shard_ip))
+		return 1;
+
+	if (options->have_shard_ip && (insn->ip == options->shard_ip)) {
+		ptxed_shard_flush(shard, xed, options, stats);
+		shard->at_ip = 1;
+	}
+
+	return ptxed_shard_hold(shard, insn, offset, time);
+}
+
+static void ptxed_shard_end(struct ptxed_shard *shard, xed_state_t *xed,
+			    const struct ptxed_options *options,
+			    struct ptxed_stats *stats)
+{
+	if (!shard)
+		return;
+
+	/* Instructions starting at the next shard's IP belong to the next
+	 * shard.
+	 */
+	if (!shard->at_ip)
+		ptxed_shard_flush(shard, xed, options, stats);
+
+	free(shard->held);
+}
+
+static void snapshot_insn(struct ptxed_decoder *decoder,
+			  const struct pt_insn *insn)
+{
+	int errcode;
+
+	if (!decoder || !insn) {
+		printf("[internal error]\n");
+		return;
+	}
+
+	errcode = pt_snap_add_insn(decoder->snap, insn);
+	if (errcode < 0)
+		diagnose(decoder, insn->ip, "snapshot error", errcode);
+}
+
 static void decode_insn(struct ptxed_decoder *decoder,
 			const struct ptxed_options *options,
 			struct ptxed_stats *stats)
 {
 	struct pt_insn_decoder *ptdec;
+	struct ptxed_shard shard;
 	xed_state_t xed;
 	uint64_t offset, sync, time;
+	int first;
 
 	if (!decoder || !options) {
 		printf("[internal error]\n");
@@ -1237,11 +1657,13 @@ static void decode_insn(struct ptxed_decoder *decoder,
 	}
 
 	xed_state_zero(&xed);
+	memset(&shard, 0, sizeof(shard));
 
 	ptdec = decoder->variant.insn;
 	offset = 0ull;
 	sync = 0ull;
 	time = 0ull;
+	first = options->have_shard_begin;
 	for (;;) {
 		struct pt_insn insn;
 		int status;
@@ -1249,7 +1671,12 @@ static void decode_insn(struct ptxed_decoder *decoder,
 		/* Initialize the IP - we use it for error reporting. */
 		insn.ip = 0ull;
 
-		status = pt_insn_sync_forward(ptdec);
+		if (first)
+			status = pt_insn_sync_set(ptdec, options->shard_begin);
+		else
+			status = pt_insn_sync_forward(ptdec);
+
+		first = 0;
 		if (status < 0) {
 			uint64_t new_sync;
 			int errcode;
@@ -1273,7 +1700,21 @@ static void decode_insn(struct ptxed_decoder *decoder,
 			continue;
 		}
 
+		/* When decoding a shard, we're done when we resync beyond the
+		 * shard's end.
+		 */
+		if (options->shard_end) {
+			uint64_t new_sync;
+			int errcode;
+
+			errcode = pt_insn_get_sync_offset(ptdec, &new_sync);
+			if (errcode < 0 || (options->shard_end <= new_sync))
+				break;
+		}
+
 		for (;;) {
+			int errcode;
+
 			status = drain_events_insn(decoder, &time, status,
 						   options);
 			if (status < 0)
@@ -1288,9 +1729,8 @@ static void decode_insn(struct ptxed_decoder *decoder,
 				break;
 			}
 
-			if (options->print_offset || options->check) {
-				int errcode;
-
+			if (options->print_offset || options->check ||
+			    options->shard_end) {
 				errcode = pt_insn_get_offset(ptdec, &offset);
 				if (errcode < 0)
 					break;
@@ -1302,26 +1742,30 @@ static void decode_insn(struct ptxed_decoder *decoder,
 				 * in decoding the current instruction.
 				 */
 				if (insn.iclass != ptic_error) {
-					if (!options->quiet)
-						print_insn(&insn, &xed, options,
-							   offset, time);
-					if (stats)
-						stats->insn += 1;
-
-					if (options->check)
-						check_insn(&insn, offset);
+					if (decoder->snap)
+						snapshot_insn(decoder, &insn);
+
+					errcode = ptxed_shard_insn(&shard, &insn,
+								   &xed,
+								   options,
+								   offset, time,
+								   stats);
+					if (errcode > 0)
+						status = -pte_eos;
 				}
 				break;
 			}
 
-			if (!options->quiet)
-				print_insn(&insn, &xed, options, offset, time);
-
-			if (stats)
-				stats->insn += 1;
+			if (decoder->snap)
+				snapshot_insn(decoder, &insn);
 
-			if (options->check)
-				check_insn(&insn, offset);
+			errcode = ptxed_shard_insn(&shard, &insn, &xed, options,
+						   offset, time, stats);
+			if (errcode != 0) {
+				/* We're done with this shard. */
+				status = (errcode < 0) ? errcode : -pte_eos;
+				break;
+			}
 		}
 
 		/* We shouldn't break out of the loop without an error. */
@@ -1334,6 +1778,8 @@ static void decode_insn(struct ptxed_decoder *decoder,
 
 		diagnose(decoder, insn.ip, "error",  status);
 	}
+
+	ptxed_shard_end(&shard, &xed, options, stats);
 }
 
 static int xed_next_ip(uint64_t *pip, const xed_decoded_inst_t *inst,
@@ -1491,6 +1937,12 @@ static void print_block(struct ptxed_decoder *decoder,
 		printf("[block");
 		if (stats)
 			printf(" %" PRIx64, stats->blocks);
+		if (options->track_block_time) {
+			printf(", %s: %016" PRIx64 "-%016" PRIx64,
+			       block->has_tsc ? "tsc" : "rel",
+			       block->tsc_begin, block->tsc_end);
+			printf(", cyc: %" PRIu64, block->cyc);
+		}
 		printf("]\n");
 	}
 
@@ -1667,46 +2119,247 @@ static int drain_events_block(struct ptxed_decoder *decoder, uint64_t *time,
 	return status;
 }
 
-static void decode_block(struct ptxed_decoder *decoder,
-			 const struct ptxed_options *options,
-			 struct ptxed_stats *stats)
+static void print_fp_stats(const char *name, const struct pt_fp_stats *stats)
 {
-	struct pt_image_section_cache *iscache;
-	struct pt_block_decoder *ptdec;
-	uint64_t offset, sync, time;
-
-	if (!decoder || !options) {
+	if (!name || !stats) {
 		printf("[internal error]\n");
 		return;
 	}
 
-	iscache = decoder->iscache;
-	ptdec = decoder->variant.block;
-	offset = 0ull;
-	sync = 0ull;
-	time = 0ull;
-	for (;;) {
-		struct pt_block block;
-		int status;
+	printf("%s: tsc: %016" PRIx64 "-%016" PRIx64 ", blocks: %" PRIu64
+	       ", insn: %" PRIu64 ".\n", name, stats->tsc_begin,
+	       stats->tsc_end, stats->nblocks, stats->ninsn);
+	printf("%s: lines: %" PRIu64 ", 4k pages: %" PRIu64 ", 2m pages: %"
+	       PRIu64 ".\n", name, stats->lines, stats->pages_4k,
+	       stats->pages_2m);
+	printf("%s: fetches: %" PRIu64 ", icache misses: %" PRIu64
+	       ", 4k itlb misses: %" PRIu64 ", 2m itlb misses: %" PRIu64
+	       ".\n", name, stats->fetches, stats->icache_misses,
+	       stats->itlb_4k_misses, stats->itlb_2m_misses);
+}
 
-		/* Initialize IP and ninsn - we use it for error reporting. */
-		block.ip = 0ull;
-		block.ninsn = 0u;
+static void print_fp_window(const struct pt_footprint *fp)
+{
+	struct pt_fp_stats stats;
+	int errcode;
 
-		status = pt_blk_sync_forward(ptdec);
-		if (status < 0) {
-			uint64_t new_sync;
-			int errcode;
+	errcode = pt_fp_window(fp, &stats, sizeof(stats));
+	if (errcode < 0) {
+		printf("[footprint error: %s]\n",
+		       pt_errstr(pt_errcode(errcode)));
+		return;
+	}
 
-			if (status == -pte_eos)
-				break;
+	print_fp_stats("footprint window", &stats);
+}
 
-			diagnose_block(decoder, "sync error", status, &block);
+static void snapshot_block(struct ptxed_decoder *decoder,
+			   const struct pt_block *block)
+{
+	int errcode;
 
-			/* Let's see if we made any progress.  If we haven't,
-			 * we likely never will.  Bail out.
-			 *
-			 * We intentionally report the error twice to indicate
+	if (!decoder || !block) {
+		printf("[internal error]\n");
+		return;
+	}
+
+	errcode = pt_snap_add_block(decoder->snap, block);
+	if (errcode < 0)
+		diagnose(decoder, block->ip, "snapshot error", errcode);
+}
+
+static void stat_block(struct ptxed_decoder *decoder, struct ptxed_stats *stats,
+		       const struct pt_block *block)
+{
+	if (!stats || !block) {
+		printf("[internal error]\n");
+		return;
+	}
+
+	stats->insn += block->ninsn;
+	stats->blocks += 1;
+
+	if (stats->mix) {
+		int errcode;
+
+		errcode = pt_mix_add_block(stats->mix, block);
+		if (errcode < 0)
+			diagnose(decoder, block->ip, "iclass stat error",
+				 errcode);
+	}
+
+	if (stats->fp) {
+		int status;
+
+		status = pt_fp_add_block(stats->fp, block);
+		if (status < 0)
+			diagnose(decoder, block->ip, "footprint error",
+				 status);
+		else if (status > 0)
+			print_fp_window(stats->fp);
+	}
+}
+
+/* Close the current segment in @profile.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int profile_close(struct ptxed_profile *profile,
+			 const struct pt_block_decoder *ptdec)
+{
+	struct ptxed_segment *segment;
+	struct pt_blk_profile now;
+	int errcode;
+
+	if (!profile)
+		return -pte_internal;
+
+	if (!profile->nsegments)
+		return 0;
+
+	errcode = pt_blk_get_profile(ptdec, &now, sizeof(now));
+	if (errcode < 0)
+		return errcode;
+
+	segment = &profile->segments[profile->nsegments - 1];
+	segment->clocks = clock() - profile->start;
+	segment->profile.nblocks = now.nblocks - profile->begin.nblocks;
+	segment->profile.ninsn = now.ninsn - profile->begin.ninsn;
+	segment->profile.nevents = now.nevents - profile->begin.nevents;
+	segment->profile.noverflows = now.noverflows -
+		profile->begin.noverflows;
+	segment->profile.bcache_misses = now.bcache_misses -
+		profile->begin.bcache_misses;
+	segment->profile.msec_refills = now.msec_refills -
+		profile->begin.msec_refills;
+
+	profile->begin = now;
+	profile->start = clock();
+
+	return 0;
+}
+
+/* Update @profile for the PSB segment @ptdec is currently decoding.
+ *
+ * Closes the current segment and opens a new one when @ptdec moved on to
+ * the next PSB segment.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int profile_update(struct ptxed_profile *profile,
+			  struct pt_block_decoder *ptdec)
+{
+	struct ptxed_segment *segment;
+	uint64_t offset, tsc;
+	int errcode;
+
+	if (!profile)
+		return -pte_internal;
+
+	errcode = pt_blk_get_sync_offset(ptdec, &offset);
+	if (errcode < 0)
+		return errcode;
+
+	if (profile->nsegments) {
+		segment = &profile->segments[profile->nsegments - 1];
+		if (segment->offset == offset)
+			return 0;
+
+		errcode = profile_close(profile, ptdec);
+		if (errcode < 0)
+			return errcode;
+	} else {
+		errcode = pt_blk_get_profile(ptdec, &profile->begin,
+					     sizeof(profile->begin));
+		if (errcode < 0)
+			return errcode;
+
+		profile->start = clock();
+	}
+
+	if (profile->nsegments == profile->capacity) {
+		size_t capacity;
+
+		capacity = profile->capacity ? profile->capacity * 2 : 0x100;
+		segment = realloc(profile->segments,
+				  capacity * sizeof(*segment));
+		if (!segment)
+			return -pte_nomem;
+
+		profile->segments = segment;
+		profile->capacity = capacity;
+	}
+
+	/* Without TSC, we get the time relative to the last synchronization,
+	 * which is still good enough for locating the segment.
+	 */
+	errcode = pt_blk_time(ptdec, &tsc, NULL, NULL);
+	if (errcode < 0 && errcode != -pte_no_time)
+		tsc = 0ull;
+
+	segment = &profile->segments[profile->nsegments++];
+	memset(segment, 0, sizeof(*segment));
+	segment->offset = offset;
+	segment->tsc = tsc;
+
+	return 0;
+}
+
+/* Count a decode error in the current segment of @profile. */
+static void profile_error(struct ptxed_profile *profile)
+{
+	if (!profile || !profile->nsegments)
+		return;
+
+	profile->segments[profile->nsegments - 1].errors += 1;
+}
+
+static void decode_block(struct ptxed_decoder *decoder,
+			 const struct ptxed_options *options,
+			 struct ptxed_stats *stats)
+{
+	struct pt_image_section_cache *iscache;
+	struct pt_block_decoder *ptdec;
+	struct ptxed_profile *profile;
+	uint64_t offset, sync, time;
+
+	if (!decoder || !options) {
+		printf("[internal error]\n");
+		return;
+	}
+
+	iscache = decoder->iscache;
+	ptdec = decoder->variant.block;
+	profile = NULL;
+	if (stats && (stats->flags & (ptxed_stat_profile |
+				      ptxed_stat_profile_save)))
+		profile = &stats->profile;
+	offset = 0ull;
+	sync = 0ull;
+	time = 0ull;
+	for (;;) {
+		struct pt_block block;
+		int status;
+
+		/* Initialize IP and ninsn - we use it for error reporting. */
+		block.ip = 0ull;
+		block.ninsn = 0u;
+
+		status = pt_blk_sync_forward(ptdec);
+		if (status < 0) {
+			uint64_t new_sync;
+			int errcode;
+
+			if (status == -pte_eos)
+				break;
+
+			diagnose_block(decoder, "sync error", status, &block);
+			profile_error(profile);
+
+			/* Let's see if we made any progress.  If we haven't,
+			 * we likely never will.  Bail out.
+			 *
+			 * We intentionally report the error twice to indicate
 			 * that we tried to re-sync.  Maybe it even changed.
 			 */
 			errcode = pt_blk_get_offset(ptdec, &new_sync);
@@ -1717,7 +2370,29 @@ static void decode_block(struct ptxed_decoder *decoder,
 			continue;
 		}
 
+		if (options->block_budget) {
+			int errcode;
+
+			errcode = pt_blk_set_budget(ptdec, options->block_budget,
+						    0ull);
+			if (errcode < 0) {
+				diagnose_block(decoder, "error", errcode,
+					       &block);
+				break;
+			}
+		}
+
 		for (;;) {
+			if (profile) {
+				int errcode;
+
+				errcode = profile_update(profile, ptdec);
+				if (errcode < 0) {
+					status = errcode;
+					break;
+				}
+			}
+
 			status = drain_events_block(decoder, &time, status,
 						    options);
 			if (status < 0)
@@ -1746,10 +2421,12 @@ static void decode_block(struct ptxed_decoder *decoder,
 				 * in decoding some instructions.
 				 */
 				if (block.ninsn) {
-					if (stats) {
-						stats->insn += block.ninsn;
-						stats->blocks += 1;
-					}
+					if (decoder->snap)
+						snapshot_block(decoder, &block);
+
+					if (stats)
+						stat_block(decoder, stats,
+							   &block);
 
 					if (!options->quiet)
 						print_block(decoder, &block,
@@ -1763,10 +2440,11 @@ static void decode_block(struct ptxed_decoder *decoder,
 				break;
 			}
 
-			if (stats) {
-				stats->insn += block.ninsn;
-				stats->blocks += 1;
-			}
+			if (decoder->snap)
+				snapshot_block(decoder, &block);
+
+			if (stats)
+				stat_block(decoder, stats, &block);
 
 			if (!options->quiet)
 				print_block(decoder, &block, options, stats,
@@ -1774,6 +2452,22 @@ static void decode_block(struct ptxed_decoder *decoder,
 
 			if (options->check)
 				check_block(&block, iscache, offset);
+
+			/* Start the next decode step. */
+			if (status & pts_budget) {
+				int errcode;
+
+				if (options->track_blocks && !options->quiet)
+					printf("[budget]\n");
+
+				errcode = pt_blk_set_budget(ptdec,
+							    options->block_budget,
+							    0ull);
+				if (errcode < 0) {
+					status = errcode;
+					break;
+				}
+			}
 		}
 
 		/* We shouldn't break out of the loop without an error. */
@@ -1785,6 +2479,15 @@ static void decode_block(struct ptxed_decoder *decoder,
 			break;
 
 		diagnose_block(decoder, "error", status, &block);
+		profile_error(profile);
+	}
+
+	if (profile) {
+		int errcode;
+
+		errcode = profile_close(profile, ptdec);
+		if (errcode < 0)
+			diagnose(decoder, 0ull, "profile error", errcode);
 	}
 }
 
@@ -1808,6 +2511,231 @@ static void decode(struct ptxed_decoder *decoder,
 	}
 }
 
+/* A PSB segment at which a shard may begin. */
+struct ptxed_shard_psb {
+	/* The trace offset of the PSB packet. */
+	uint64_t offset;
+
+	/* The time at the PSB packet - zero if it is not known. */
+	uint64_t tsc;
+
+	/* The IP at which decoding starts - if @have_ip is set. */
+	uint64_t ip;
+
+	/* A flag saying whether @ip is valid. */
+	int have_ip;
+};
+
+static int ptxed_find_psbs(struct ptxed_shard_psb **ppsb, size_t *npsb,
+			   const struct pt_config *config)
+{
+	struct pt_query_decoder *qry;
+	struct ptxed_shard_psb *psb;
+	size_t size, capacity;
+	uint64_t sync;
+	int errcode;
+
+	if (!ppsb || !npsb || !config)
+		return -pte_internal;
+
+	qry = pt_qry_alloc_decoder(config);
+	if (!qry)
+		return -pte_nomem;
+
+	psb = NULL;
+	size = 0;
+	capacity = 0;
+	sync = 0ull;
+	errcode = 0;
+	for (;;) {
+		uint64_t ip, offset, tsc;
+		int status;
+
+		status = pt_qry_sync_forward(qry, &ip);
+		if (status < 0) {
+			if (status == -pte_eos)
+				break;
+
+			/* Let's see if we made any progress.  If we haven't,
+			 * we likely never will.
+			 */
+			errcode = pt_qry_get_offset(qry, &offset);
+			if (errcode < 0 || (offset <= sync)) {
+				errcode = 0;
+				break;
+			}
+
+			sync = offset;
+			continue;
+		}
+
+		errcode = pt_qry_get_sync_offset(qry, &offset);
+		if (errcode < 0)
+			break;
+
+		if (pt_qry_time(qry, &tsc, NULL, NULL) < 0)
+			tsc = 0ull;
+
+		if (capacity <= size) {
+			struct ptxed_shard_psb *new_psb;
+
+			capacity = capacity ? capacity * 2 : 64;
+			new_psb = realloc(psb, capacity * sizeof(*psb));
+			if (!new_psb) {
+				errcode = -pte_nomem;
+				break;
+			}
+
+			psb = new_psb;
+		}
+
+		psb[size].offset = offset;
+		psb[size].tsc = tsc;
+		psb[size].ip = ip;
+		psb[size].have_ip = !(status & pts_ip_suppressed);
+		size += 1;
+
+		sync = offset;
+	}
+
+	pt_qry_free_decoder(qry);
+
+	if (errcode < 0) {
+		free(psb);
+		return errcode;
+	}
+
+	*ppsb = psb;
+	*npsb = size;
+
+	return 0;
+}
+
+/* Partition the trace into at most @nshards parts of balanced decode cost.
+ *
+ * Provides the trace offset of the first PSB of each part in @bounds.  The
+ * @bounds array must hold @nshards elements.
+ *
+ * Returns the number of parts on success, a negative error code otherwise.
+ */
+static int ptxed_shard_bounds(uint64_t *bounds, uint32_t nshards,
+			      const struct pt_config *config)
+{
+	struct pt_cost_profile *profile;
+	int errcode;
+
+	profile = pt_cost_alloc(config);
+	if (!profile)
+		return -pte_nomem;
+
+	errcode = pt_cost_scan(profile);
+	if (errcode >= 0)
+		errcode = pt_cost_partition(profile, bounds, nshards);
+
+	pt_cost_free(profile);
+
+	return errcode;
+}
+
+/* Find the first PSB at or beyond @offset starting at @psb[@begin]. */
+static size_t ptxed_find_psb(const struct ptxed_shard_psb *psb, size_t npsb,
+			     size_t begin, uint64_t offset)
+{
+	for (; begin < npsb; ++begin) {
+		if (offset <= psb[begin].offset)
+			break;
+	}
+
+	return begin;
+}
+
+/* Print a manifest splitting the trace into at most @nshards shards.
+ *
+ * Each shard starts at a PSB packet and takes about the same time to decode
+ * based on the estimated decode cost of its PSB segments.  The manifest lists
+ * the options to decode each shard with, i.e. our own options without the
+ * planning option.
+ */
+static int ptxed_plan_shards(const struct pt_config *config, uint32_t nshards,
+			     int argc, char *argv[])
+{
+	struct ptxed_shard_psb *psb;
+	uint64_t *bounds;
+	size_t npsb, begin;
+	uint32_t shard;
+	int errcode, arg, nparts, part;
+
+	if (!config || !nshards || !argv)
+		return -pte_internal;
+
+	bounds = malloc(nshards * sizeof(*bounds));
+	if (!bounds)
+		return -pte_nomem;
+
+	nparts = ptxed_shard_bounds(bounds, nshards, config);
+	if (nparts < 0) {
+		free(bounds);
+		return nparts;
+	}
+
+	psb = NULL;
+	npsb = 0;
+	errcode = ptxed_find_psbs(&psb, &npsb, config);
+	if (errcode < 0) {
+		free(bounds);
+		return errcode;
+	}
+
+	printf("# ptxed shard manifest\n");
+	for (arg = 1; arg < argc; ++arg) {
+		if (strcmp(argv[arg], "--shard:plan") == 0) {
+			arg += 1;
+			continue;
+		}
+
+		printf("option %s\n", argv[arg]);
+	}
+
+	/* The decoder may not be able to synchronize onto each PSB the cost
+	 * estimation found.  Each shard starts at the next PSB it can.
+	 */
+	begin = 0;
+	shard = 0;
+	for (part = 1; (begin < npsb) && (part <= nparts); ++part) {
+		size_t end;
+
+		end = npsb;
+		if (part < nparts)
+			end = ptxed_find_psb(psb, npsb, begin, bounds[part]);
+
+		if (end == begin)
+			continue;
+
+		printf("shard %" PRIu32 " 0x%" PRIx64, shard++,
+		       psb[begin].offset);
+
+		if (end < npsb)
+			printf(" 0x%" PRIx64, psb[end].offset);
+		else
+			printf(" -");
+
+		printf(" 0x%" PRIx64, psb[begin].tsc);
+
+		if (end < npsb && psb[end].have_ip)
+			printf(" 0x%" PRIx64, psb[end].ip);
+		else
+			printf(" -");
+
+		printf("\n");
+
+		begin = end;
+	}
+
+	free(psb);
+	free(bounds);
+	return 0;
+}
+
 static int alloc_decoder(struct ptxed_decoder *decoder,
 			 const struct pt_config *conf, struct pt_image *image,
 			 const struct ptxed_options *options, const char *prog)
@@ -1825,6 +2753,9 @@ static int alloc_decoder(struct ptxed_decoder *decoder,
 		if (options->enable_tick_events)
 			config.flags.variant.insn.enable_tick_events = 1;
 
+		if (options->insn_zero_copy)
+			config.flags.variant.insn.enable_zero_copy = 1;
+
 		decoder->variant.insn = pt_insn_alloc_decoder(&config);
 		if (!decoder->variant.insn) {
 			fprintf(stderr,
@@ -1863,6 +2794,151 @@ static int alloc_decoder(struct ptxed_decoder *decoder,
 	return 0;
 }
 
+static int ptxed_calibrate(struct ptxed_decoder *decoder,
+			   const struct pt_config *config)
+{
+	struct pt_time_calibration cal;
+	int errcode;
+
+	if (!decoder)
+		return -pte_internal;
+
+	memset(&cal, 0, sizeof(cal));
+	cal.size = sizeof(cal);
+
+	errcode = pt_time_calibrate(&cal, sizeof(cal), config);
+	if (errcode < 0) {
+		/* The decoder will calibrate itself as far as possible. */
+		if (errcode == -pte_no_time)
+			return 0;
+
+		return errcode;
+	}
+
+	switch (decoder->type) {
+	case pdt_insn_decoder:
+		return pt_insn_set_calibration(decoder->variant.insn, &cal);
+
+	case pdt_block_decoder:
+		return pt_blk_set_calibration(decoder->variant.block, &cal);
+	}
+
+	return -pte_internal;
+}
+
+static void print_profile(const struct ptxed_profile *profile)
+{
+	clock_t max;
+	size_t idx;
+
+	if (!profile) {
+		printf("[internal error]\n");
+		return;
+	}
+
+	max = 0;
+	for (idx = 0; idx < profile->nsegments; ++idx) {
+		if (max < profile->segments[idx].clocks)
+			max = profile->segments[idx].clocks;
+	}
+
+	printf("profile: %-16s  %-16s  %10s  %10s  %8s  %8s  %8s  %6s  %4s  "
+	       "%4s  heat\n", "offset", "time", "us", "insn", "blocks",
+	       "bcache", "msec", "events", "ovf", "err");
+
+	for (idx = 0; idx < profile->nsegments; ++idx) {
+		const struct ptxed_segment *segment;
+		uint64_t us;
+		int heat, bar;
+
+		segment = &profile->segments[idx];
+
+		us = ((uint64_t) segment->clocks * 1000000ull) /
+			(uint64_t) CLOCKS_PER_SEC;
+
+		heat = 0;
+		if (max)
+			heat = (int) (((uint64_t) segment->clocks * 20ull) /
+				      (uint64_t) max);
+
+		printf("profile: %016" PRIx64 "  %016" PRIx64 "  %10" PRIu64
+		       "  %10" PRIu64 "  %8" PRIu64 "  %8" PRIu64 "  %8"
+		       PRIu64 "  %6" PRIu64 "  %4" PRIu64 "  %4" PRIu64 "  |",
+		       segment->offset, segment->tsc, us,
+		       segment->profile.ninsn, segment->profile.nblocks,
+		       segment->profile.bcache_misses,
+		       segment->profile.msec_refills,
+		       segment->profile.nevents, segment->profile.noverflows,
+		       segment->errors);
+
+		for (bar = 0; bar < 20; ++bar)
+			printf("%c", bar < heat ? '#' : ' ');
+
+		printf("|\n");
+	}
+}
+
+/* Write @profile into @filename.
+ *
+ * The profile is written as text with one line per PSB segment in the order
+ * in which the segments were decoded.  Each line holds the same fields that
+ * print_profile() prints as space-separated hexadecimal numbers.
+ *
+ * Returns zero on success, a negative integer otherwise.
+ */
+static int save_profile(const struct ptxed_profile *profile,
+			const char *filename, const char *prog)
+{
+	FILE *file;
+	size_t idx;
+	int errcode;
+
+	if (!profile || !filename || !prog) {
+		fprintf(stderr, "%s: internal error.\n", prog ? prog : "");
+		return -1;
+	}
+
+	errno = 0;
+	file = fopen(filename, "w");
+	if (!file) {
+		fprintf(stderr, "%s: failed to open %s: %d.\n",
+			prog, filename, errno);
+		return -1;
+	}
+
+	fprintf(file, "# offset tsc us insn blocks bcache msec events ovf "
+		"err\n");
+
+	for (idx = 0; idx < profile->nsegments; ++idx) {
+		const struct ptxed_segment *segment;
+		uint64_t us;
+
+		segment = &profile->segments[idx];
+
+		us = ((uint64_t) segment->clocks * 1000000ull) /
+			(uint64_t) CLOCKS_PER_SEC;
+
+		fprintf(file, "%" PRIx64 " %" PRIx64 " %" PRIx64 " %" PRIx64
+			" %" PRIx64 " %" PRIx64 " %" PRIx64 " %" PRIx64
+			" %" PRIx64 " %" PRIx64 "\n", segment->offset,
+			segment->tsc, us, segment->profile.ninsn,
+			segment->profile.nblocks,
+			segment->profile.bcache_misses,
+			segment->profile.msec_refills,
+			segment->profile.nevents, segment->profile.noverflows,
+			segment->errors);
+	}
+
+	errcode = fclose(file);
+	if (errcode) {
+		fprintf(stderr, "%s: failed to write %s: %d.\n",
+			prog, filename, errno);
+		return -1;
+	}
+
+	return 0;
+}
+
 static void print_stats(struct ptxed_stats *stats)
 {
 	if (!stats) {
@@ -1875,6 +2951,64 @@ static void print_stats(struct ptxed_stats *stats)
 
 	if (stats->flags & ptxed_stat_blocks)
 		printf("blocks:\t%" PRIu64 ".\n", stats->blocks);
+
+	if (stats->mix) {
+		static const char * const iclass_names[] = {
+			"error",
+			"other",
+			"call",
+			"return",
+			"jump",
+			"cond jump",
+			"far call",
+			"far return",
+			"far jump",
+			"ptwrite"
+		};
+		struct pt_mix_counts counts;
+		int errcode, iclass;
+
+		errcode = pt_mix_query(stats->mix, &counts, sizeof(counts), 0,
+				       0ull, UINT64_MAX);
+		if (errcode < 0) {
+			printf("[iclass stat error: %s]\n",
+			       pt_errstr(pt_errcode(errcode)));
+			return;
+		}
+
+		for (iclass = 0; iclass < pt_mix_num_iclass; ++iclass) {
+			const char *name;
+
+			name = "unknown";
+			if (iclass < (int) (sizeof(iclass_names) /
+					    sizeof(*iclass_names)))
+				name = iclass_names[iclass];
+
+			printf("iclass %s:\t%" PRIu64 ".\n", name,
+			       counts.iclass[iclass]);
+		}
+	}
+
+	if (stats->fp) {
+		struct pt_fp_stats total;
+		int status;
+
+		status = pt_fp_close_window(stats->fp);
+		if (status > 0)
+			print_fp_window(stats->fp);
+
+		status = pt_fp_total(stats->fp, &total, sizeof(total));
+		if (status < 0) {
+			printf("[footprint error: %s]\n",
+			       pt_errstr(pt_errcode(status)));
+			return;
+		}
+
+		print_fp_stats("footprint", &total);
+	}
+
+	if (stats->flags & ptxed_stat_profile)
+		print_profile(&stats->profile);
 }
 
 #if defined(FEATURE_SIDEBAND)
@@ -2112,6 +3246,7 @@ extern int main(int argc, char *argv[])
 	struct ptxed_decoder decoder;
 	struct ptxed_options options;
 	struct ptxed_stats stats;
+	struct pt_fp_config fpconfig;
 	struct pt_config config;
 	struct pt_image *image;
 	const char *prog;
@@ -2129,6 +3264,7 @@ extern int main(int argc, char *argv[])
 	memset(&stats, 0, sizeof(stats));
 
 	pt_config_init(&config);
+	pt_fp_config_init(&fpconfig);
 
 	errcode = ptxed_init_decoder(&decoder);
 	if (errcode < 0) {
@@ -2212,6 +3348,31 @@ extern int main(int argc, char *argv[])
 
 			continue;
 		}
+		if (strcmp(arg, "--snapshot:load") == 0) {
+			if (argc <= i) {
+				fprintf(stderr, "%s: --snapshot:load: "
+					"missing argument.\n", prog);
+				goto out;
+			}
+			arg = argv[i++];
+
+			errcode = load_snapshot(decoder.iscache, image, arg,
+						prog);
+			if (errcode < 0)
+				goto err;
+
+			continue;
+		}
+		if (strcmp(arg, "--snapshot:save") == 0) {
+			if (argc <= i) {
+				fprintf(stderr, "%s: --snapshot:save: "
+					"missing argument.\n", prog);
+				goto out;
+			}
+
+			options.snapshot = argv[i++];
+			continue;
+		}
 #if defined(FEATURE_ELF)
 		if (strcmp(arg, "--elf") == 0) {
 			uint64_t base;
@@ -2255,6 +3416,10 @@ extern int main(int argc, char *argv[])
 			options.print_time = 1;
 			continue;
 		}
+		if (strcmp(arg, "--time:calibrate") == 0) {
+			options.calibrate = 1;
+			continue;
+		}
 		if (strcmp(arg, "--raw-insn") == 0) {
 			options.print_raw_insn = 1;
 
@@ -2473,6 +3638,69 @@ extern int main(int argc, char *argv[])
 			stats.flags |= ptxed_stat_blocks;
 			continue;
 		}
+		if (strcmp(arg, "--stat:iclass") == 0) {
+			options.print_stats = 1;
+			stats.flags |= ptxed_stat_iclass;
+			continue;
+		}
+		if (strcmp(arg, "--stat:footprint") == 0) {
+			options.print_stats = 1;
+			stats.flags |= ptxed_stat_footprint;
+			continue;
+		}
+		if (strcmp(arg, "--stat:profile") == 0) {
+			options.print_stats = 1;
+			stats.flags |= ptxed_stat_profile;
+			continue;
+		}
+		if (strcmp(arg, "--stat:profile-save") == 0) {
+			if (argc <= i) {
+				fprintf(stderr, "%s: --stat:profile-save: "
+					"missing argument.\n", prog);
+				goto out;
+			}
+
+			options.profile = argv[i++];
+			stats.flags |= ptxed_stat_profile_save;
+			continue;
+		}
+		if (strcmp(arg, "--footprint:window-insn") == 0) {
+			if (!get_arg_uint64(&fpconfig.window_insn, arg,
+					    argv[i++], prog))
+				goto err;
+
+			continue;
+		}
+		if (strcmp(arg, "--footprint:window-tsc") == 0) {
+			if (!get_arg_uint64(&fpconfig.window_tsc, arg,
+					    argv[i++], prog))
+				goto err;
+
+			config.flags.variant.block.enable_block_timing = 1;
+			continue;
+		}
+		if (strcmp(arg, "--footprint:icache") == 0) {
+			if (!get_arg_uint32(&fpconfig.icache_sets, arg,
+					    argv[i++], prog))
+				goto err;
+
+			if (!get_arg_uint32(&fpconfig.icache_ways, arg,
+					    argv[i++], prog))
+				goto err;
+
+			continue;
+		}
+		if (strcmp(arg, "--footprint:itlb") == 0) {
+			if (!get_arg_uint32(&fpconfig.itlb_4k_entries, arg,
+					    argv[i++], prog))
+				goto err;
+
+			if (!get_arg_uint32(&fpconfig.itlb_2m_entries, arg,
+					    argv[i++], prog))
+				goto err;
+
+			continue;
+		}
 #if defined(FEATURE_SIDEBAND)
 		if ((strcmp(arg, "--sb:compact") == 0) ||
 		    (strcmp(arg, "--sb") == 0)) {
@@ -2506,6 +3734,14 @@ extern int main(int argc, char *argv[])
 			options.print_sb_warnings = 1;
 			continue;
 		}
+		if (strcmp(arg, "--sb:warmup") == 0) {
+			if (!get_arg_uint64(&options.sb_warmup_size, arg,
+					    argv[i++], prog))
+				goto err;
+
+			options.sb_warmup = 1;
+			continue;
+		}
 #if defined(FEATURE_PEVENT)
 		if (strcmp(arg, "--pevent:primary") == 0) {
 			arg = argv[i++];
@@ -2748,6 +3984,11 @@ extern int main(int argc, char *argv[])
 			continue;
 		}
 
+		if (strcmp(arg, "--insn:zero-copy") == 0) {
+			options.insn_zero_copy = 1;
+			continue;
+		}
+
 		if (strcmp(arg, "--block-decoder") == 0) {
 			if (ptxed_have_decoder(&decoder)) {
 				fprintf(stderr,
@@ -2775,6 +4016,65 @@ extern int main(int argc, char *argv[])
 			continue;
 		}
 
+		if (strcmp(arg, "--block:prefetch") == 0) {
+			config.flags.variant.block.enable_prefetch = 1;
+			continue;
+		}
+
+		if (strcmp(arg, "--block:timing") == 0) {
+			config.flags.variant.block.enable_block_timing = 1;
+			options.track_block_time = 1;
+			continue;
+		}
+
+		if (strcmp(arg, "--block:budget") == 0) {
+			if (!get_arg_uint64(&options.block_budget, arg,
+					    argv[i++], prog))
+				goto err;
+
+			continue;
+		}
+
+		if (strcmp(arg, "--shard:plan") == 0) {
+			if (!get_arg_uint32(&options.shard_plan, arg,
+					    argv[i++], prog))
+				goto err;
+
+			if (!options.shard_plan) {
+				fprintf(stderr, "%s: %s: bad argument: 0.\n",
+					prog, arg);
+				goto err;
+			}
+
+			continue;
+		}
+
+		if (strcmp(arg, "--shard:begin") == 0) {
+			if (!get_arg_uint64(&options.shard_begin, arg,
+					    argv[i++], prog))
+				goto err;
+
+			options.have_shard_begin = 1;
+			continue;
+		}
+
+		if (strcmp(arg, "--shard:end") == 0) {
+			if (!get_arg_uint64(&options.shard_end, arg,
+					    argv[i++], prog))
+				goto err;
+
+			continue;
+		}
+
+		if (strcmp(arg, "--shard:ip") == 0) {
+			if (!get_arg_uint64(&options.shard_ip, arg,
+					    argv[i++], prog))
+				goto err;
+
+			options.have_shard_ip = 1;
+			continue;
+		}
+
 		fprintf(stderr, "%s: unknown option: %s.\n", prog, arg);
 		goto err;
 	}
@@ -2784,19 +4084,123 @@ extern int main(int argc, char *argv[])
 		goto err;
 	}
 
+	if (options.shard_plan) {
+		if (options.have_shard_begin || options.shard_end ||
+		    options.have_shard_ip) {
+			fprintf(stderr, "%s: --shard:plan cannot be combined "
+				"with other --shard options.\n", prog);
+			goto err;
+		}
+
+		errcode = ptxed_plan_shards(&config, options.shard_plan, argc,
+					    argv);
+		if (errcode < 0) {
+			fprintf(stderr, "%s: error planning shards: %s.\n",
+				prog, pt_errstr(pt_errcode(errcode)));
+			goto err;
+		}
+
+		goto out;
+	}
+
+	if (options.have_shard_begin || options.shard_end ||
+	    options.have_shard_ip) {
+		if (decoder.type != pdt_insn_decoder) {
+			fprintf(stderr, "%s: --shard options require the insn "
+				"decoder.\n", prog);
+			goto err;
+		}
+
+		if (options.shard_end &&
+		    (options.shard_end <= options.shard_begin)) {
+			fprintf(stderr, "%s: --shard:end must lie beyond "
+				"--shard:begin.\n", prog);
+			goto err;
+		}
+	}
+
+	if (options.calibrate) {
+		errcode = ptxed_calibrate(&decoder, &config);
+		if (errcode < 0) {
+			fprintf(stderr, "%s: error calibrating timing: %s.\n",
+				prog, pt_errstr(pt_errcode(errcode)));
+			goto err;
+		}
+	}
+
+	if (options.snapshot) {
+		decoder.snap = pt_snap_alloc(decoder.iscache);
+		if (!decoder.snap) {
+			fprintf(stderr, "%s: failed to allocate code "
+				"snapshot.\n", prog);
+			goto err;
+		}
+	}
+
 	xed_tables_init();
 
 	/* If we didn't select any statistics, select them all depending on the
 	 * decoder type.
 	 */
-	if (options.print_stats && !stats.flags) {
+	if (options.print_stats && !(stats.flags & ~ptxed_stat_profile_save)) {
 		stats.flags |= ptxed_stat_insn;
 
 		if (decoder.type == pdt_block_decoder)
 			stats.flags |= ptxed_stat_blocks;
 	}
 
+	if (stats.flags & ptxed_stat_iclass) {
+		if (decoder.type != pdt_block_decoder) {
+			fprintf(stderr, "%s: --stat:iclass requires the block "
+				"decoder.\n", prog);
+			goto err;
+		}
+
+		stats.mix = pt_mix_alloc(decoder.iscache);
+		if (!stats.mix) {
+			fprintf(stderr, "%s: failed to allocate iclass "
+				"statistics.\n", prog);
+			goto err;
+		}
+	}
+
+	if (stats.flags & ptxed_stat_footprint) {
+		if (decoder.type != pdt_block_decoder) {
+			fprintf(stderr, "%s: --stat:footprint requires the "
+				"block decoder.\n", prog);
+			goto err;
+		}
+
+		stats.fp = pt_fp_alloc(&fpconfig, decoder.iscache);
+		if (!stats.fp) {
+			fprintf(stderr, "%s: failed to allocate footprint "
+				"analysis.\n", prog);
+			goto err;
+		}
+	}
+
+	if (stats.flags & (ptxed_stat_profile | ptxed_stat_profile_save)) {
+		if (decoder.type != pdt_block_decoder) {
+			fprintf(stderr, "%s: --stat:profile requires the "
+				"block decoder.\n", prog);
+			goto err;
+		}
+	}
+
 #if defined(FEATURE_SIDEBAND)
+	if (options.sb_warmup) {
+		/* Block caches are only used by the block decoder. */
+		errcode = pt_sb_enable_warmup(decoder.session,
+					      options.sb_warmup_size,
+					      decoder.type ==
+					      pdt_block_decoder);
+		if (errcode < 0) {
+			fprintf(stderr, "%s: error enabling sideband warm-up: "
+				"%s.\n", prog, pt_errstr(pt_errcode(errcode)));
+			goto err;
+		}
+	}
+
 	errcode = pt_sb_init_decoders(decoder.session);
 	if (errcode < 0) {
 		fprintf(stderr,
@@ -2806,18 +4210,37 @@ extern int main(int argc, char *argv[])
 	}
 #endif /* defined(FEATURE_SIDEBAND) */
 
-	decode(&decoder, &options, options.print_stats ? &stats : NULL);
+	decode(&decoder, &options,
+	       (options.print_stats || options.profile) ? &stats : NULL);
 
 	if (options.print_stats)
 		print_stats(&stats);
 
+	if (options.profile) {
+		errcode = save_profile(&stats.profile, options.profile, prog);
+		if (errcode < 0)
+			goto err;
+	}
+
+	if (decoder.snap) {
+		errcode = save_snapshot(decoder.snap, options.snapshot, prog);
+		if (errcode < 0)
+			goto err;
+	}
+
 out:
+	free(stats.profile.segments);
+	pt_fp_free(stats.fp);
+	pt_mix_free(stats.mix);
 	ptxed_free_decoder(&decoder);
 	pt_image_free(image);
 	free(config.begin);
 	return 0;
 
 err:
+	free(stats.profile.segments);
+	pt_fp_free(stats.fp);
+	pt_mix_free(stats.mix);
 	ptxed_free_decoder(&decoder);
 	pt_image_free(image);
 	free(config.begin);
@@ -0,0 +1,229 @@
+#! /bin/bash
+#
+# Copyright (c) 2018, Intel Corporation
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+#  * Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#  * Neither the name of Intel Corporation nor the names of its contributors
+#    may be used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+set -e
+
+prog=`basename $0`
+
+usage() {
+    cat <<EOF
+usage: $prog [<options>] [-- <ptxed-options>]
+
+Split a trace into PSB segment shards, decode the shards independently, and
+merge the shards' outputs in trace order.
+
+options:
+  -h             this text
+  -x <ptxed>     the ptxed binary (default: ptxed)
+  -n <n>         the number of shards to plan (default: number of processors)
+  -j <n>         decode at most <n> shards in parallel (default: <n> shards)
+  -p             print the shard manifest and exit
+  -m <manifest>  use <manifest> instead of planning shards
+  -s <shard>     decode shard <shard> of the manifest and print its output
+  -o <dir>       keep the shard outputs in <dir>
+  -M <dir>       merge the shard outputs in <dir> and exit
+
+<ptxed-options> are the ptxed options for decoding the entire trace.  They are
+recorded in the manifest and must be omitted when using -m.
+
+To decode on several machines, plan once with -p, decode each shard with -m and
+-s, collect the outputs as <dir>/shard-<shard>.out, and merge them with -M.
+EOF
+}
+
+ptxed="ptxed"
+nshards=`nproc`
+njobs=""
+plan_only=0
+manifest=""
+shard=""
+outdir=""
+merge_dir=""
+while getopts "hx:n:j:pm:s:o:M:" opt; do
+    case $opt in
+        h)
+            usage
+            exit 0
+            ;;
+        x)
+            ptxed="$OPTARG"
+            ;;
+        n)
+            nshards="$OPTARG"
+            ;;
+        j)
+            njobs="$OPTARG"
+            ;;
+        p)
+            plan_only=1
+            ;;
+        m)
+            manifest="$OPTARG"
+            ;;
+        s)
+            shard="$OPTARG"
+            ;;
+        o)
+            outdir="$OPTARG"
+            ;;
+        M)
+            merge_dir="$OPTARG"
+            ;;
+        *)
+            usage
+            exit 1
+            ;;
+    esac
+done
+
+shift $(($OPTIND-1))
+
+
+merge() {
+    local idx
+
+    for (( idx = 0; ; ++idx )); do
+        if [[ ! -e "$1/shard-$idx.out" ]]; then
+            break
+        fi
+
+        cat "$1/shard-$idx.out"
+    done
+}
+
+if [[ -n "$merge_dir" ]]; then
+    merge "$merge_dir"
+    exit 0
+fi
+
+
+tmpdir=`mktemp -d`
+trap 'rm -rf "$tmpdir"' EXIT
+
+if [[ -z "$manifest" ]]; then
+    if [[ $# == 0 ]]; then
+        usage
+        exit 1
+    fi
+
+    manifest="$tmpdir/manifest"
+    "$ptxed" "$@" --shard:plan "$nshards" > "$manifest"
+elif [[ $# != 0 ]]; then
+    usage
+    exit 1
+fi
+
+if [[ "$plan_only" != 0 ]]; then
+    cat "$manifest"
+    exit 0
+fi
+
+
+options=()
+shards=()
+while read -r kind rest; do
+    case "$kind" in
+        option)
+            options+=("$rest")
+            ;;
+        shard)
+            shards+=("$rest")
+            ;;
+    esac
+done < "$manifest"
+
+decode() {
+    local idx begin end tsc ip args
+
+    read -r idx begin end tsc ip <<< "${shards[$1]}"
+
+    args=(--shard:begin "$begin")
+    if [[ "$end" != "-" ]]; then
+        args+=(--shard:end "$end")
+    fi
+    if [[ "$ip" != "-" ]]; then
+        args+=(--shard:ip "$ip")
+    fi
+
+    "$ptxed" "${options[@]}" "${args[@]}"
+}
+
+if [[ -n "$shard" ]]; then
+    if [[ "$shard" -ge "${#shards[@]}" ]]; then
+        echo "$prog: no shard $shard in $manifest."
+        exit 1
+    fi
+
+    decode "$shard"
+    exit 0
+fi
+
+if [[ -z "$outdir" ]]; then
+    outdir="$tmpdir"
+fi
+
+if [[ -z "$njobs" ]]; then
+    njobs="${#shards[@]}"
+fi
+
+if [[ "$njobs" -lt 1 ]]; then
+    njobs=1
+fi
+
+mkdir -p "$outdir"
+
+pids=()
+failed=0
+
+wait_shard() {
+    if ! wait "${pids[$1]}"; then
+        echo "$prog: failed to decode shard $1."
+        failed=1
+    fi
+}
+
+for (( idx = 0; idx < ${#shards[@]}; ++idx )); do
+    if [[ "$idx" -ge "$njobs" ]]; then
+        wait_shard $(( idx - njobs ))
+    fi
+
+    decode "$idx" > "$outdir/shard-$idx.out" &
+    pids+=($!)
+done
+
+for (( idx = ${#pids[@]} - njobs; idx < ${#pids[@]}; ++idx )); do
+    if [[ "$idx" -ge 0 ]]; then
+        wait_shard "$idx"
+    fi
+done
+
+if [[ "$failed" -ne 0 ]]; then
+    exit 1
+fi
+
+merge "$outdir"
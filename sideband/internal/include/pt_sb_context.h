@@ -76,6 +76,15 @@ struct pt_sb_context {
 	 */
 	uint32_t pid;
 
+	/* The number of live threads of that process - zero if unknown.
+	 *
+	 * We only learn about all threads of a process if it was created
+	 * while tracing.
+	 *
+	 * This field is collectively owned by all sideband decoders.
+	 */
+	uint32_t nthreads;
+
 	/* The number of current users.
 	 *
 	 * We remove a context when the process exits but we keep the context
@@ -64,6 +64,15 @@ struct pt_sb_decoder {
 
 	/* A flag saying whether this is a primary or secondary decoder. */
 	uint32_t primary:1;
+
+	/* A flag saying whether @apply reports the decoder's interest. */
+	uint32_t interest:1;
+
+	/* A flag saying whether the decoder reported a pending effect. */
+	uint32_t pending:1;
+
+	/* A bit-vector of event types the decoder is always interested in. */
+	uint32_t events;
 };
 
 #endif /* PT_SB_DECODER_H */
@@ -30,6 +30,7 @@
 #define PT_SB_PEVENT_H
 
 #include "pevent.h"
+#include "pt_sb_context.h"
 
 
 /* The estimated code location. */
@@ -50,6 +51,11 @@ enum pt_sb_pevent_loc {
 	ploc_likely_in_user
 };
 
+enum {
+	/* The maximal number of exited contexts awaiting reclamation. */
+	pt_sb_pevent_nexited	= 8
+};
+
 /* A Linux perf event decoder's private data. */
 struct pt_sb_pevent_priv {
 	/* The sideband filename for printing.
@@ -127,6 +133,19 @@ struct pt_sb_pevent_priv {
 	 */
 	struct pt_sb_context *next_context;
 
+	/* The contexts of exited processes awaiting reclamation.
+	 *
+	 * The exit record is sent while the process is still running inside
+	 * the kernel.  We remove its context from the session once we are no
+	 * longer using it.
+	 *
+	 * Each entry holds a reference to its context (put after use).
+	 */
+	struct pt_sb_context *exited[pt_sb_pevent_nexited];
+
+	/* The number of valid entries in @exited. */
+	uint32_t nexited;
+
 	/* The start address of the kernel.
 	 *
 	 * This is used to distinguish kernel from user addresses:
@@ -147,6 +166,13 @@ struct pt_sb_pevent_priv {
 
 	/* The current code location estimated from previous events. */
 	enum pt_sb_pevent_loc location;
+
+	/* The number of session events @location accounts for.
+	 *
+	 * We are only presented events while we have a context switch pending
+	 * and need to catch up on events we missed in between.
+	 */
+	uint64_t nevents;
 };
 
 extern int pt_sb_pevent_init(struct pt_sb_pevent_priv *priv,
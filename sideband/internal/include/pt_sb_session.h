@@ -29,13 +29,51 @@
 #ifndef PT_SB_SESSION_H
 #define PT_SB_SESSION_H
 
+#include "pt_sb_context.h"
+
 #include "libipt-sb.h"
+#include "intel-pt.h"
 
 struct pt_image_section_cache;
 struct pt_image;
 struct pt_sb_context;
 struct pt_sb_decoder;
+struct pt_sb_warmup;
+
+
+enum {
+	/* The number of most recent events remembered by a session. */
+	pt_sb_nhistory	= 2,
+
+	/* The number of entries in a session's file cache. */
+	pt_sb_nfiles	= 256
+};
 
+/* A file mapped by sideband decoders.
+ *
+ * Hot libraries are mapped many times across processes.  We remember what we
+ * learned about them so we only need to access the file system once.
+ */
+struct pt_sb_file {
+	/* The filename including the system root. */
+	char *path;
+
+	/* The file identity as given in MMAP2 records.
+	 *
+	 * Those are zero for MMAP records.
+	 */
+	uint64_t ino, ino_generation;
+	uint32_t maj, min;
+
+	/* The file's ABI.
+	 *
+	 * This is only valid if @has_abi is set.
+	 */
+	enum pt_sb_abi abi;
+
+	/* A flag saying whether @abi is valid. */
+	uint32_t has_abi:1;
+};
 
 struct pt_sb_session {
 	/* The image section cache to use for new image sections.
@@ -79,6 +117,44 @@ struct pt_sb_session {
 	 */
 	struct pt_sb_decoder *removed;
 
+	/* The number of decoders in @decoders and @retired that shall be
+	 * presented every event in the second round of pt_sb_event().
+	 *
+	 * Those are decoders that did not declare their interest and decoders
+	 * that reported a pending effect.
+	 */
+	uint32_t neager;
+
+	/* A bit-vector of event types, (1 << enum pt_event_type), decoders in
+	 * @decoders and @retired declared their interest in.
+	 *
+	 * This may include event types of decoders that have since been
+	 * removed.
+	 */
+	uint32_t events;
+
+	/* The number of events presented to decoders so far. */
+	uint64_t nevents;
+
+	/* The most recent events indexed by their number modulo
+	 * pt_sb_nhistory.
+	 *
+	 * Decoders that were not interested in those events may use them to
+	 * catch up when their interest changes.
+	 */
+	struct pt_event history[pt_sb_nhistory];
+
+	/* An optional background worker warming up newly mapped sections. */
+	struct pt_sb_warmup *warmup;
+
+	/* The files mapped by sideband decoders indexed by a hash of their
+	 * identity.
+	 *
+	 * A new file replaces the file in its slot.  This bounds the cache to
+	 * pt_sb_nfiles entries shared by all decoders in the session.
+	 */
+	struct pt_sb_file *files[pt_sb_nfiles];
+
 	/* An optional callback function to be called on sideband decode errors
 	 * and warnings.
 	 */
@@ -98,4 +174,27 @@ struct pt_sb_session {
 extern int pt_sb_error(const struct pt_sb_session *session, int errcode,
 		       const char *filename, uint64_t offset);
 
+/* Announce a newly mapped section for warm-up.
+ *
+ * Sideband decoders call this for sections of @size bytes identified by @isid
+ * in @session's image section cache that they add to process images.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+extern int pt_sb_warm(struct pt_sb_session *session, int isid,
+		      uint64_t size);
+
+/* Find or create the file cache entry for a mapped file.
+ *
+ * On success, provides the entry for @path with the given identity in @pfile.
+ * The entry may be replaced on the next call.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @pfile, @session, or @path is NULL.
+ */
+extern int pt_sb_get_file(struct pt_sb_file **pfile,
+			  struct pt_sb_session *session, const char *path,
+			  uint32_t maj, uint32_t min, uint64_t ino,
+			  uint64_t ino_generation);
+
 #endif /* PT_SB_SESSION_H */
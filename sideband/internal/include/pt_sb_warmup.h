@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_SB_WARMUP_H
+#define PT_SB_WARMUP_H
+
+#include <stdint.h>
+
+#if defined(FEATURE_THREADS)
+#  include <threads.h>
+#endif /* defined(FEATURE_THREADS) */
+
+struct pt_image_section_cache;
+
+
+enum {
+	/* The maximal number of sections waiting for warm-up. */
+	pt_sb_warmup_nqueue	= 64
+};
+
+/* A background worker warming up image sections.
+ *
+ * Sideband decoders add sections they add to process images.  The worker maps
+ * them in the image section cache ahead of decode.
+ */
+struct pt_sb_warmup {
+	/* The image section cache containing the sections to warm up. */
+	struct pt_image_section_cache *iscache;
+
+	/* The minimal size of a section worth warming up in bytes. */
+	uint64_t min_size;
+
+	/* A ring buffer of image section identifiers waiting for warm-up. */
+	int queue[pt_sb_warmup_nqueue];
+
+	/* The position of the first entry in @queue. */
+	uint32_t begin;
+
+	/* The number of entries in @queue. */
+	uint32_t nqueued;
+
+	/* A flag saying whether the worker shall stop. */
+	uint32_t stop;
+
+	/* A flag saying whether block caches shall be allocated. */
+	int bcache;
+
+#if defined(FEATURE_THREADS)
+	/* A lock protecting @queue, @begin, @nqueued, and @stop. */
+	mtx_t lock;
+
+	/* A condition signaling new work or a stop request. */
+	cnd_t cond;
+
+	/* The worker thread. */
+	thrd_t thread;
+#endif /* defined(FEATURE_THREADS) */
+};
+
+
+/* Allocate a warm-up worker for @iscache and start its thread.
+ *
+ * Sections smaller than @min_size bytes are ignored.  If @bcache is non-zero,
+ * the worker also allocates block caches.
+ *
+ * Returns the new worker or NULL if out of memory or if the thread can't be
+ * started or if threads are not supported.
+ */
+extern struct pt_sb_warmup *
+pt_sb_warmup_alloc(struct pt_image_section_cache *iscache, uint64_t min_size,
+		   int bcache);
+
+/* Stop @warmup's thread and free @warmup.
+ *
+ * Sections still waiting for warm-up are dropped.
+ */
+extern void pt_sb_warmup_free(struct pt_sb_warmup *warmup);
+
+/* Add a section of @size bytes to @warmup's queue.
+ *
+ * Warm-up is best-effort.  The section is silently ignored if it is too small,
+ * if it is already queued, or if the queue is full.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+extern int pt_sb_warmup_add(struct pt_sb_warmup *warmup, int isid,
+			    uint64_t size);
+
+#endif /* PT_SB_WARMUP_H */
@@ -117,7 +117,7 @@ int pt_sb_ctx_mmap(struct pt_sb_session *session, struct pt_sb_context *context,
 {
 	struct pt_image_section_cache *iscache;
 	struct pt_image *image;
-	int isid;
+	int isid, errcode;
 
 	image = pt_sb_ctx_image(context);
 	if (!image)
@@ -132,7 +132,12 @@ int pt_sb_ctx_mmap(struct pt_sb_session *session, struct pt_sb_context *context,
 	if (isid < 0)
 		return isid;
 
-	return pt_image_add_cached(image, iscache, isid, NULL);
+	errcode = pt_image_add_cached(image, iscache, isid, NULL);
+	if (errcode < 0)
+		return errcode;
+
+	/* We will likely execute the newly mapped code soon. */
+	return pt_sb_warm(session, isid, size);
 }
 
 int pt_sb_ctx_switch_to(struct pt_image **pimage, struct pt_sb_session *session,
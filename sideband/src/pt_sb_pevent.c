@@ -162,21 +162,19 @@ static int pt_sb_pevent_error(const struct pt_sb_session *session, int errcode,
 	return pt_sb_error(session, errcode, filename, offset);
 }
 
-static int pt_sb_pevent_track_abi(struct pt_sb_context *context,
-				  const char *filename)
+static int pt_sb_pevent_read_abi(enum pt_sb_abi *pabi, const char *filename)
 {
 	FILE *file;
 	int abi;
 
-	if (!context || !filename)
+	if (!pabi || !filename)
 		return -pte_internal;
 
-	if (context->abi)
-		return 0;
-
 	file = fopen(filename, "rb");
-	if (!file)
+	if (!file) {
+		*pabi = pt_sb_abi_unknown;
 		return 0;
+	}
 
 	abi = elf_get_abi(file);
 
@@ -185,7 +183,7 @@ static int pt_sb_pevent_track_abi(struct pt_sb_context *context,
 	if (abi < 0)
 		return abi;
 
-	context->abi = (enum pt_sb_abi) abi;
+	*pabi = (enum pt_sb_abi) abi;
 
 	return 0;
 }
@@ -243,6 +241,9 @@ static void pt_sb_pevent_dtor(void *priv_arg)
 	if (context)
 		pt_sb_ctx_put(context);
 
+	while (priv->nexited)
+		pt_sb_ctx_put(priv->exited[--priv->nexited]);
+
 	free(priv->filename);
 	free(priv->sysroot);
 	free(priv->vdso_x64);
@@ -700,6 +701,31 @@ static int pt_sb_pevent_print_event(const struct pev_event *event,
 	}
 		break;
 
+	case PERF_RECORD_SAMPLE: {
+		const uint64_t *ip;
+
+		ip = event->sample.ip;
+
+		if (flags & ptsbp_compact) {
+			fprintf(stream, "PERF_RECORD_SAMPLE");
+			if (ip)
+				fprintf(stream, "  %" PRIx64, *ip);
+		}
+
+		if (flags & ptsbp_verbose) {
+			fprintf(stream, "PERF_RECORD_SAMPLE");
+			if (ip)
+				fprintf(stream, "\n  ip: %" PRIx64, *ip);
+			if (event->sample.addr)
+				fprintf(stream, "\n  addr: %" PRIx64,
+					*event->sample.addr);
+			if (event->sample.period)
+				fprintf(stream, "\n  period: %" PRIx64,
+					*event->sample.period);
+		}
+	}
+		break;
+
 	case PERF_RECORD_SWITCH: {
 		const char *sfx;
 
@@ -893,6 +919,51 @@ static int pt_sb_pevent_print(struct pt_sb_pevent_priv *priv, FILE *stream,
 	return 0;
 }
 
+/* Reclaim the contexts of exited processes we are no longer using.
+ *
+ * Removes them from @session so their images and sections are freed once the
+ * last user puts its reference.
+ */
+static int pt_sb_pevent_reclaim(struct pt_sb_session *session,
+				struct pt_sb_pevent_priv *priv)
+{
+	uint32_t idx, nexited;
+
+	if (!priv)
+		return -pte_internal;
+
+	nexited = priv->nexited;
+	for (idx = 0; idx < nexited;) {
+		struct pt_sb_context *context;
+		int errcode;
+
+		context = priv->exited[idx];
+		if ((context == priv->context) ||
+		    (context == priv->next_context)) {
+			idx += 1;
+			continue;
+		}
+
+		priv->exited[idx] = priv->exited[--nexited];
+		priv->nexited = nexited;
+
+		/* The context may already have been replaced by a new process
+		 * with the same pid.
+		 */
+		errcode = pt_sb_remove_context(session, context);
+		if ((errcode < 0) && (errcode != -pte_nosync)) {
+			(void) pt_sb_ctx_put(context);
+			return errcode;
+		}
+
+		errcode = pt_sb_ctx_put(context);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	return 0;
+}
+
 static int pt_sb_pevent_switch_contexts(struct pt_sb_session *session,
 					struct pt_image **image,
 					struct pt_sb_pevent_priv *priv)
@@ -915,7 +986,14 @@ static int pt_sb_pevent_switch_contexts(struct pt_sb_session *session,
 	priv->next_context = NULL;
 	priv->context = next;
 
-	return prev ? pt_sb_ctx_put(prev) : 0;
+	if (prev) {
+		errcode = pt_sb_ctx_put(prev);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	/* Now that we switched away, we may reclaim exited contexts. */
+	return pt_sb_pevent_reclaim(session, priv);
 }
 
 static int pt_sb_pevent_cancel_context_switch(struct pt_sb_pevent_priv *priv)
@@ -1049,7 +1127,7 @@ static int pt_sb_pevent_fork(struct pt_sb_session *session,
 	if (!record)
 		return -pte_internal;
 
-	/* If this is just creating a new thread, there's nothing to do.
+	/* If this is just creating a new thread, we only need to count it.
 	 *
 	 * We should already have a context for this process.  If we don't, it
 	 * doesn't really help to create a new context with an empty process
@@ -1057,8 +1135,17 @@ static int pt_sb_pevent_fork(struct pt_sb_session *session,
 	 */
 	ppid = record->ppid;
 	pid = record->pid;
-	if (ppid == pid)
+	if (ppid == pid) {
+		context = NULL;
+		errcode = pt_sb_find_context_by_pid(&context, session, pid);
+		if (errcode < 0)
+			return errcode;
+
+		if (context && context->nthreads)
+			context->nthreads += 1;
+
 		return 0;
+	}
 
 	/* We're creating a new process plus the initial thread.
 	 *
@@ -1069,8 +1156,10 @@ static int pt_sb_pevent_fork(struct pt_sb_session *session,
 
 	/* Remove any existing context we might have for @pid.
 	 *
-	 * We're not removing process contexts when we get the exit event since
-	 * that is sent while the process is still running inside the kernel.
+	 * We're not removing process contexts immediately when we get the exit
+	 * event since that is sent while the process is still running inside
+	 * the kernel.  We may not have reclaimed it, yet, or we may have missed
+	 * the exit event.
 	 */
 	errcode = pt_sb_pevent_remove_context_for_pid(session, pid);
 	if (errcode < 0)
@@ -1082,6 +1171,9 @@ static int pt_sb_pevent_fork(struct pt_sb_session *session,
 	if (errcode < 0)
 		return errcode;
 
+	/* We will see all threads of this process. */
+	context->nthreads = 1;
+
 	/* Let's see if we also know about the parent process. */
 	parent = NULL;
 	errcode = pt_sb_find_context_by_pid(&parent, session, ppid);
@@ -1101,6 +1193,68 @@ static int pt_sb_pevent_fork(struct pt_sb_session *session,
 	return pt_image_copy(image, pimage);
 }
 
+static int pt_sb_pevent_exit(struct pt_sb_session *session,
+			     struct pt_sb_pevent_priv *priv,
+			     const struct pev_record_exit *record)
+{
+	struct pt_sb_context *context;
+	uint32_t idx;
+	int errcode;
+
+	if (!priv || !record)
+		return -pte_internal;
+
+	context = NULL;
+	errcode = pt_sb_find_context_by_pid(&context, session, record->pid);
+	if (errcode < 0)
+		return errcode;
+
+	/* The process exits with its last thread, which need not be its initial
+	 * thread.
+	 *
+	 * If we don't know all threads of the process, we leave @context to
+	 * the session.  It will be removed when its pid is reused or when the
+	 * session is freed.
+	 */
+	if (!context || !context->nthreads)
+		return 0;
+
+	context->nthreads -= 1;
+	if (context->nthreads)
+		return 0;
+
+	for (idx = 0; idx < priv->nexited; ++idx) {
+		if (priv->exited[idx] == context)
+			return 0;
+	}
+
+	/* Make room for @context by reclaiming contexts we no longer use.
+	 *
+	 * If that doesn't help, we leave @context to the session.  It will be
+	 * removed when its pid is reused or when the session is freed.
+	 */
+	if (pt_sb_pevent_nexited <= priv->nexited) {
+		errcode = pt_sb_pevent_reclaim(session, priv);
+		if (errcode < 0)
+			return errcode;
+
+		if (pt_sb_pevent_nexited <= priv->nexited)
+			return 0;
+	}
+
+	errcode = pt_sb_ctx_get(context);
+	if (errcode < 0)
+		return errcode;
+
+	priv->exited[priv->nexited++] = context;
+
+	/* We postpone the reclamation until we switched away from @context.
+	 *
+	 * If we're not using @context, we may reclaim it right away.
+	 */
+	return pt_sb_pevent_reclaim(session, priv);
+}
+
 static int pt_sb_pevent_exec(struct pt_sb_session *session,
 			     struct pt_image **image,
 			     struct pt_sb_pevent_priv *priv,
@@ -1173,14 +1327,68 @@ pt_sb_pevent_switch_cpu(struct pt_sb_session *session,
 						  record->next_prev_pid);
 }
 
+/* Map a regular file.
+ *
+ * Repeated mappings of the same file do not access the file system.  The image
+ * section cache already shares repeated mappings of the same file section.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_pevent_map_file(struct pt_sb_session *session,
+				 const struct pt_sb_pevent_priv *priv,
+				 struct pt_sb_context *context,
+				 const char *filename, uint32_t maj,
+				 uint32_t min, uint64_t ino,
+				 uint64_t ino_generation, uint64_t offset,
+				 uint64_t size, uint64_t vaddr)
+{
+	struct pt_sb_file *file;
+	char buffer[FILENAME_MAX];
+	int errcode;
+
+	if (!priv || !context || !filename)
+		return -pte_internal;
+
+	/* Prepend the sysroot. */
+	if (priv->sysroot) {
+		errcode = snprintf(buffer, sizeof(buffer), "%s%s",
+				   priv->sysroot, filename);
+		if (errcode < 0)
+			return -pte_overflow;
+
+		filename = buffer;
+	}
+
+	file = NULL;
+	errcode = pt_sb_get_file(&file, session, filename, maj, min, ino,
+				 ino_generation);
+	if (errcode < 0)
+		return errcode;
+
+	if (!context->abi) {
+		if (!file->has_abi) {
+			errcode = pt_sb_pevent_read_abi(&file->abi,
+							file->path);
+			if (errcode < 0)
+				return errcode;
+
+			file->has_abi = 1;
+		}
+
+		context->abi = file->abi;
+	}
+
+	return pt_sb_ctx_mmap(session, context, file->path, offset, size,
+			      vaddr);
+}
+
 static int pt_sb_pevent_map(struct pt_sb_session *session,
 			    const struct pt_sb_pevent_priv *priv, uint32_t pid,
-			    const char *filename, uint64_t offset,
-			    uint64_t size, uint64_t vaddr)
+			    const char *filename, uint32_t maj, uint32_t min,
+			    uint64_t ino, uint64_t ino_generation,
+			    uint64_t offset, uint64_t size, uint64_t vaddr)
 {
 	struct pt_sb_context *context;
-	const char *sysroot;
-	char buffer[FILENAME_MAX];
 	int errcode;
 
 	if (!priv || !filename)
@@ -1192,9 +1400,6 @@ static int pt_sb_pevent_map(struct pt_sb_session *session,
 	if (errcode < 0)
 		return errcode;
 
-	/* The optional system root directoy. */
-	sysroot = priv->sysroot;
-
 	/* Some filenames do not represent actual files on disk.  We handle
 	 * some of those and ignore the rest.
 	 */
@@ -1210,10 +1415,15 @@ static int pt_sb_pevent_map(struct pt_sb_session *session,
 			if (errcode != 0)
 				return pt_sb_pevent_error(session, errcode,
 							  priv);
-		} else
-			return pt_sb_pevent_error(session, ptse_section_lost,
-						  priv);
 
+			/* We already know the ABI or we wouldn't have found
+			 * the vdso.
+			 */
+			return pt_sb_ctx_mmap(session, context, filename,
+					      offset, size, vaddr);
+		}
+
+		return pt_sb_pevent_error(session, ptse_section_lost, priv);
 
 	} else if (strcmp(filename, "//anon") == 0) {
 		/* Those are anonymous mappings that are, for example, used by
@@ -1232,22 +1442,11 @@ static int pt_sb_pevent_map(struct pt_sb_session *session,
 		 * We will likely fail with -pte_nomap later on.
 		 */
 		return pt_sb_pevent_error(session, ptse_section_lost, priv);
-
-	} else if (sysroot) {
-		/* Prepend the sysroot to normal files. */
-		errcode = snprintf(buffer, sizeof(buffer), "%s%s", sysroot,
-				   filename);
-		if (errcode < 0)
-			return -pte_overflow;
-
-		filename = buffer;
 	}
 
-	errcode = pt_sb_pevent_track_abi(context, filename);
-	if (errcode < 0)
-		return errcode;
-
-	return pt_sb_ctx_mmap(session, context, filename, offset, size, vaddr);
+	return pt_sb_pevent_map_file(session, priv, context, filename, maj,
+				     min, ino, ino_generation, offset, size,
+				     vaddr);
 }
 
 static int pt_sb_pevent_mmap(struct pt_sb_session *session,
@@ -1258,7 +1457,8 @@ static int pt_sb_pevent_mmap(struct pt_sb_session *session,
 		return -pte_internal;
 
 	return pt_sb_pevent_map(session, priv, record->pid, record->filename,
-				record->pgoff, record->len, record->addr);
+				0u, 0u, 0ull, 0ull, record->pgoff,
+				record->len, record->addr);
 }
 
 static int pt_sb_pevent_mmap2(struct pt_sb_session *session,
@@ -1269,7 +1469,9 @@ static int pt_sb_pevent_mmap2(struct pt_sb_session *session,
 		return -pte_internal;
 
 	return pt_sb_pevent_map(session, priv, record->pid, record->filename,
-				record->pgoff, record->len, record->addr);
+				record->maj, record->min, record->ino,
+				record->ino_generation, record->pgoff,
+				record->len, record->addr);
 }
 
 static int pt_sb_pevent_aux(const struct pt_sb_session *session,
@@ -1328,6 +1530,9 @@ static int pt_sb_pevent_apply_event_record(struct pt_sb_session *session,
 	case PERF_RECORD_FORK:
 		return pt_sb_pevent_fork(session, event->record.fork);
 
+	case PERF_RECORD_EXIT:
+		return pt_sb_pevent_exit(session, priv, event->record.exit);
+
 	case PERF_RECORD_COMM:
 		/* We're only interested in COMM.EXEC events. */
 		if (!(event->misc & PERF_RECORD_MISC_COMM_EXEC))
@@ -1545,6 +1750,43 @@ static int ploc_from_event(enum pt_sb_pevent_loc *loc,
 	return 0;
 }
 
+/* Update @priv->location for events presented to @session that we missed.
+ *
+ * The location only depends on the previous location for events with a
+ * suppressed IP.  Since tracing is enabled between two such events, it
+ * suffices to replay the events @session remembers.
+ */
+static int pt_sb_pevent_catch_up(struct pt_sb_pevent_priv *priv,
+				 const struct pt_sb_session *session)
+{
+	uint64_t nevents, end;
+
+	if (!priv || !session)
+		return -pte_internal;
+
+	nevents = priv->nevents;
+	end = session->nevents;
+	if ((nevents + pt_sb_nhistory) < end) {
+		priv->location = ploc_unknown;
+		nevents = end - pt_sb_nhistory;
+	}
+
+	for (; nevents < end; ++nevents) {
+		const struct pt_event *event;
+		int errcode;
+
+		event = &session->history[nevents % pt_sb_nhistory];
+
+		errcode = ploc_from_event(&priv->location, priv, event);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	priv->nevents = end;
+
+	return 0;
+}
+
 static int pt_sb_pevent_apply(struct pt_sb_session *session,
 			      struct pt_image **image,
 			      const struct pt_event *event,
@@ -1590,11 +1832,17 @@ static int pt_sb_pevent_apply(struct pt_sb_session *session,
 	 * We preserve the previous location to detect returns from kernel to
 	 * user space.
 	 */
+	errcode = pt_sb_pevent_catch_up(priv, session);
+	if (errcode < 0)
+		return errcode;
+
 	oldloc = priv->location;
 	errcode = ploc_from_event(&priv->location, priv, event);
 	if (errcode < 0)
 		return errcode;
 
+	priv->nevents += 1;
+
 	/* We postpone context switches until we reach a suitable location in
 	 * the trace.  If we don't have a context switch pending, we're done.
 	 */
@@ -1681,7 +1929,14 @@ static int pt_sb_pevent_apply_callback(struct pt_sb_session *session,
 		return pt_sb_pevent_error(session, errcode,
 					  (struct pt_sb_pevent_priv *) priv);
 
-	return errcode;
+	if (errcode < 0)
+		return errcode;
+
+	/* We only need to see events while a context switch is pending. */
+	if (((struct pt_sb_pevent_priv *) priv)->next_context)
+		return ptsbi_pending;
+
+	return 0;
 }
 
 int pt_sb_alloc_pevent_decoder(struct pt_sb_session *session,
@@ -1711,6 +1966,7 @@ int pt_sb_alloc_pevent_decoder(struct pt_sb_session *session,
 	config.dtor = pt_sb_pevent_dtor;
 	config.priv = priv;
 	config.primary = pev->primary;
+	config.interest = 1;
 
 	errcode = pt_sb_alloc_decoder(session, &config);
 	if (errcode < 0)
@@ -29,6 +29,7 @@
 #include "pt_sb_session.h"
 #include "pt_sb_context.h"
 #include "pt_sb_decoder.h"
+#include "pt_sb_warmup.h"
 
 #include "libipt-sb.h"
 #include "intel-pt.h"
@@ -89,6 +90,23 @@ static void pt_sb_free_decoder_list(struct pt_sb_decoder *list)
 	}
 }
 
+static void pt_sb_free_file(struct pt_sb_file *file)
+{
+	if (!file)
+		return;
+
+	free(file->path);
+	free(file);
+}
+
+static void pt_sb_free_files(struct pt_sb_session *session)
+{
+	int slot;
+
+	for (slot = 0; slot < pt_sb_nfiles; ++slot)
+		pt_sb_free_file(session->files[slot]);
+}
+
 void pt_sb_free(struct pt_sb_session *session)
 {
 	struct pt_sb_context *context;
@@ -96,6 +114,9 @@ void pt_sb_free(struct pt_sb_session *session)
 	if (!session)
 		return;
 
+	pt_sb_warmup_free(session->warmup);
+	pt_sb_free_files(session);
+
 	pt_sb_free_decoder_list(session->decoders);
 	pt_sb_free_decoder_list(session->waiting);
 	pt_sb_free_decoder_list(session->retired);
@@ -132,6 +153,111 @@ struct pt_image *pt_sb_kernel_image(struct pt_sb_session *session)
 	return session->kernel;
 }
 
+int pt_sb_enable_warmup(struct pt_sb_session *session, uint64_t min_size,
+			int bcache)
+{
+	if (!session || !session->iscache)
+		return -pte_invalid;
+
+#if !defined(FEATURE_THREADS)
+	(void) min_size;
+	(void) bcache;
+
+	return -pte_not_supported;
+#else /* !defined(FEATURE_THREADS) */
+	{
+		struct pt_sb_warmup *warmup;
+
+		warmup = pt_sb_warmup_alloc(session->iscache, min_size,
+					    bcache);
+		if (!warmup)
+			return -pte_nomem;
+
+		pt_sb_warmup_free(session->warmup);
+		session->warmup = warmup;
+	}
+
+	return 0;
+#endif /* !defined(FEATURE_THREADS) */
+}
+
+int pt_sb_warm(struct pt_sb_session *session, int isid, uint64_t size)
+{
+	if (!session)
+		return -pte_internal;
+
+	if (!session->warmup)
+		return 0;
+
+	return pt_sb_warmup_add(session->warmup, isid, size);
+}
+
+/* Hash a file's identity for the file cache. */
+static uint32_t pt_sb_hash_file(const char *path, uint64_t ino)
+{
+	uint32_t hash;
+
+	/* We use FNV-1a. */
+	hash = 2166136261u;
+	for (; *path; ++path) {
+		hash ^= (uint8_t) *path;
+		hash *= 16777619u;
+	}
+
+	hash ^= (uint32_t) ino;
+	hash *= 16777619u;
+
+	return hash % pt_sb_nfiles;
+}
+
+int pt_sb_get_file(struct pt_sb_file **pfile, struct pt_sb_session *session,
+		   const char *path, uint32_t maj, uint32_t min, uint64_t ino,
+		   uint64_t ino_generation)
+{
+	struct pt_sb_file *file;
+	uint32_t slot;
+	size_t size;
+
+	if (!pfile || !session || !path)
+		return -pte_internal;
+
+	slot = pt_sb_hash_file(path, ino);
+
+	file = session->files[slot];
+	if (file && (file->ino == ino) &&
+	    (file->ino_generation == ino_generation) &&
+	    (file->maj == maj) && (file->min == min) &&
+	    (strcmp(file->path, path) == 0)) {
+		*pfile = file;
+		return 0;
+	}
+
+	file = malloc(sizeof(*file));
+	if (!file)
+		return -pte_nomem;
+
+	memset(file, 0, sizeof(*file));
+	file->ino = ino;
+	file->ino_generation = ino_generation;
+	file->maj = maj;
+	file->min = min;
+
+	size = strlen(path) + 1;
+	file->path = malloc(size);
+	if (!file->path) {
+		free(file);
+		return -pte_nomem;
+	}
+
+	memcpy(file->path, path, size);
+
+	pt_sb_free_file(session->files[slot]);
+	session->files[slot] = file;
+
+	*pfile = file;
+	return 0;
+}
+
 static int pt_sb_add_context_by_pid(struct pt_sb_context **pcontext,
 				    struct pt_sb_session *session, uint32_t pid)
 {
@@ -247,6 +373,8 @@ int pt_sb_alloc_decoder(struct pt_sb_session *session,
 	decoder->dtor = config->dtor;
 	decoder->priv = config->priv;
 	decoder->primary = config->primary;
+	decoder->interest = config->interest;
+	decoder->events = config->events;
 
 	session->waiting = decoder;
 
@@ -281,6 +409,68 @@ static int pt_sb_add_decoder(struct pt_sb_decoder **list,
 	return 0;
 }
 
+/* Check whether @decoder shall be presented every event. */
+static inline int pt_sb_is_eager(const struct pt_sb_decoder *decoder)
+{
+	return !decoder->interest || decoder->pending;
+}
+
+/* Account for @decoder joining @session's active decoders. */
+static void pt_sb_activate(struct pt_sb_session *session,
+			   const struct pt_sb_decoder *decoder)
+{
+	if (pt_sb_is_eager(decoder))
+		session->neager += 1;
+
+	if (decoder->interest)
+		session->events |= decoder->events;
+}
+
+/* Move an active decoder to @session's removed decoders. */
+static void pt_sb_remove(struct pt_sb_session *session,
+			 struct pt_sb_decoder *decoder)
+{
+	if (pt_sb_is_eager(decoder))
+		session->neager -= 1;
+
+	decoder->next = session->removed;
+	session->removed = decoder;
+}
+
+/* Update @decoder's interest based on the @status returned by @apply. */
+static void pt_sb_update_interest(struct pt_sb_session *session,
+				  struct pt_sb_decoder *decoder, int status)
+{
+	uint32_t pending;
+
+	if (!decoder->interest)
+		return;
+
+	pending = (status & ptsbi_pending) ? 1 : 0;
+	if (pending == decoder->pending)
+		return;
+
+	if (pending)
+		session->neager += 1;
+	else
+		session->neager -= 1;
+
+	decoder->pending = pending;
+}
+
+/* Check whether @event's type is contained in the @events bit-vector. */
+static int pt_sb_event_of_interest(uint32_t events,
+				   const struct pt_event *event)
+{
+	/* We can't represent all event types in our bit-vector.  Let's assume
+	 * everyone is interested in event types we can't represent.
+	 */
+	if ((sizeof(events) * 8) <= (size_t) event->type)
+		return 1;
+
+	return (events & (1u << event->type)) != 0;
+}
+
 static int pt_sb_fetch(struct pt_sb_session *session,
 		       struct pt_sb_decoder *decoder)
 {
@@ -357,6 +547,8 @@ int pt_sb_init_decoders(struct pt_sb_session *session)
 						    decoder);
 			if (errcode < 0)
 				return errcode;
+
+			pt_sb_activate(session, decoder);
 		}
 
 		decoder = session->waiting;
@@ -408,6 +600,13 @@ static int pt_sb_event_present(struct pt_sb_session *session,
 
 	decoder = *pnext;
 	while (decoder) {
+		if (!pt_sb_is_eager(decoder) &&
+		    !pt_sb_event_of_interest(decoder->events, event)) {
+			pnext = &decoder->next;
+			decoder = *pnext;
+			continue;
+		}
+
 		errcode = pt_sb_apply(session, image, decoder, event);
 		if (errcode < 0) {
 			struct pt_sb_decoder *trash;
@@ -416,11 +615,13 @@ static int pt_sb_event_present(struct pt_sb_session *session,
 			decoder = trash->next;
 			*pnext = decoder;
 
-			trash->next = session->removed;
-			session->removed = trash;
+			trash->next = NULL;
+			pt_sb_remove(session, trash);
 			continue;
 		}
 
+		pt_sb_update_interest(session, decoder, errcode);
+
 		pnext = &decoder->next;
 		decoder = *pnext;
 	}
@@ -468,28 +669,26 @@ int pt_sb_event(struct pt_sb_session *session, struct pt_image **image,
 		if (stream) {
 			errcode = pt_sb_print(session, decoder, stream, flags);
 			if (errcode < 0) {
-				decoder->next = session->removed;
-				session->removed = decoder;
+				pt_sb_remove(session, decoder);
 				continue;
 			}
 		}
 
 		errcode = pt_sb_apply(session, image, decoder, &event);
 		if (errcode < 0) {
-			decoder->next = session->removed;
-			session->removed = decoder;
+			pt_sb_remove(session, decoder);
 			continue;
 		}
 
+		pt_sb_update_interest(session, decoder, errcode);
+
 		errcode = pt_sb_fetch(session, decoder);
 		if (errcode < 0) {
 			if (errcode == -pte_eos) {
 				decoder->next = session->retired;
 				session->retired = decoder;
-			} else {
-				decoder->next = session->removed;
-				session->removed = decoder;
-			}
+			} else
+				pt_sb_remove(session, decoder);
 
 			continue;
 		}
@@ -499,17 +698,33 @@ int pt_sb_event(struct pt_sb_session *session, struct pt_image **image,
 			return errcode;
 	}
 
-	/* In the second round, we present the event to all decoders.
+	/* In the second round, we present the event to all interested
+	 * decoders.
 	 *
 	 * This allows decoders to postpone actions until an appropriate event,
 	 * e.g entry into or exit from the kernel.
+	 *
+	 * Most events are of no interest to any decoder.  We skip the round
+	 * entirely in that case.
 	 */
-	errcode = pt_sb_event_present(session, image, &session->decoders,
-				      &event);
-	if (errcode < 0)
-		return errcode;
+	if (session->neager ||
+	    pt_sb_event_of_interest(session->events, &event)) {
+		errcode = pt_sb_event_present(session, image,
+					      &session->decoders, &event);
+		if (errcode < 0)
+			return errcode;
 
-	return pt_sb_event_present(session, image, &session->retired, &event);
+		errcode = pt_sb_event_present(session, image,
+					      &session->retired, &event);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	/* Remember the event for decoders that want to catch up later. */
+	session->history[session->nevents % pt_sb_nhistory] = event;
+	session->nevents += 1;
+
+	return 0;
 }
 
 int pt_sb_dump(struct pt_sb_session *session, FILE *stream, uint32_t flags,
@@ -534,15 +749,13 @@ int pt_sb_dump(struct pt_sb_session *session, FILE *stream, uint32_t flags,
 
 		errcode = pt_sb_print(session, decoder, stream, flags);
 		if (errcode < 0) {
-			decoder->next = session->removed;
-			session->removed = decoder;
+			pt_sb_remove(session, decoder);
 			continue;
 		}
 
 		errcode = pt_sb_fetch(session, decoder);
 		if (errcode < 0) {
-			decoder->next = session->removed;
-			session->removed = decoder;
+			pt_sb_remove(session, decoder);
 			continue;
 		}
 
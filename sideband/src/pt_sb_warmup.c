@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_sb_warmup.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#if !defined(FEATURE_THREADS)
+
+struct pt_sb_warmup *
+pt_sb_warmup_alloc(struct pt_image_section_cache *iscache, uint64_t min_size,
+		   int bcache)
+{
+	(void) iscache;
+	(void) min_size;
+	(void) bcache;
+
+	return NULL;
+}
+
+void pt_sb_warmup_free(struct pt_sb_warmup *warmup)
+{
+	(void) warmup;
+}
+
+int pt_sb_warmup_add(struct pt_sb_warmup *warmup, int isid, uint64_t size)
+{
+	(void) warmup;
+	(void) isid;
+	(void) size;
+
+	return -pte_not_supported;
+}
+
+#else /* !defined(FEATURE_THREADS) */
+
+static int pt_sb_warmup_lock(struct pt_sb_warmup *warmup)
+{
+	int errcode;
+
+	if (!warmup)
+		return -pte_internal;
+
+	errcode = mtx_lock(&warmup->lock);
+	if (errcode != thrd_success)
+		return -pte_bad_lock;
+
+	return 0;
+}
+
+static int pt_sb_warmup_unlock(struct pt_sb_warmup *warmup)
+{
+	int errcode;
+
+	if (!warmup)
+		return -pte_internal;
+
+	errcode = mtx_unlock(&warmup->lock);
+	if (errcode != thrd_success)
+		return -pte_bad_lock;
+
+	return 0;
+}
+
+/* Wait for the next section to warm up.
+ *
+ * On success, provides its identifier in @isid.
+ *
+ * Returns a positive integer if a section is available, zero if @warmup
+ * shall stop, a negative error code otherwise.
+ */
+static int pt_sb_warmup_next(int *isid, struct pt_sb_warmup *warmup)
+{
+	int errcode, status;
+
+	if (!isid || !warmup)
+		return -pte_internal;
+
+	errcode = pt_sb_warmup_lock(warmup);
+	if (errcode < 0)
+		return errcode;
+
+	while (!warmup->nqueued && !warmup->stop) {
+		errcode = cnd_wait(&warmup->cond, &warmup->lock);
+		if (errcode != thrd_success) {
+			(void) pt_sb_warmup_unlock(warmup);
+			return -pte_bad_lock;
+		}
+	}
+
+	status = 0;
+	if (!warmup->stop) {
+		*isid = warmup->queue[warmup->begin];
+
+		warmup->begin = (warmup->begin + 1) % pt_sb_warmup_nqueue;
+		warmup->nqueued -= 1;
+
+		status = 1;
+	}
+
+	errcode = pt_sb_warmup_unlock(warmup);
+	if (errcode < 0)
+		return errcode;
+
+	return status;
+}
+
+static int pt_sb_warmup_worker(void *arg)
+{
+	struct pt_sb_warmup *warmup;
+
+	warmup = (struct pt_sb_warmup *) arg;
+	if (!warmup)
+		return -pte_internal;
+
+	for (;;) {
+		int status, isid;
+
+		isid = 0;
+		status = pt_sb_warmup_next(&isid, warmup);
+		if (status <= 0)
+			return status;
+
+		/* Decoders will run into any errors again when they use the
+		 * section and report them there.
+		 */
+		(void) pt_iscache_warm(warmup->iscache, isid, warmup->bcache);
+	}
+}
+
+struct pt_sb_warmup *
+pt_sb_warmup_alloc(struct pt_image_section_cache *iscache, uint64_t min_size,
+		   int bcache)
+{
+	struct pt_sb_warmup *warmup;
+	int errcode;
+
+	if (!iscache)
+		return NULL;
+
+	warmup = malloc(sizeof(*warmup));
+	if (!warmup)
+		return NULL;
+
+	memset(warmup, 0, sizeof(*warmup));
+	warmup->iscache = iscache;
+	warmup->min_size = min_size;
+	warmup->bcache = bcache;
+
+	errcode = mtx_init(&warmup->lock, mtx_plain);
+	if (errcode != thrd_success)
+		goto out_free;
+
+	errcode = cnd_init(&warmup->cond);
+	if (errcode != thrd_success)
+		goto out_lock;
+
+	errcode = thrd_create(&warmup->thread, pt_sb_warmup_worker, warmup);
+	if (errcode != thrd_success)
+		goto out_cond;
+
+	return warmup;
+
+out_cond:
+	(void) cnd_destroy(&warmup->cond);
+
+out_lock:
+	mtx_destroy(&warmup->lock);
+
+out_free:
+	free(warmup);
+	return NULL;
+}
+
+void pt_sb_warmup_free(struct pt_sb_warmup *warmup)
+{
+	int errcode;
+
+	if (!warmup)
+		return;
+
+	/* If we can't signal the worker, we can't join it, either.  Rather
+	 * than blocking forever, we leak @warmup.
+	 */
+	errcode = pt_sb_warmup_lock(warmup);
+	if (errcode < 0)
+		return;
+
+	warmup->stop = 1;
+
+	errcode = cnd_signal(&warmup->cond);
+
+	(void) pt_sb_warmup_unlock(warmup);
+
+	if (errcode != thrd_success)
+		return;
+
+	(void) thrd_join(&warmup->thread, NULL);
+
+	(void) cnd_destroy(&warmup->cond);
+	mtx_destroy(&warmup->lock);
+	free(warmup);
+}
+
+int pt_sb_warmup_add(struct pt_sb_warmup *warmup, int isid, uint64_t size)
+{
+	uint32_t idx, nqueued;
+	int errcode, status;
+
+	if (!warmup)
+		return -pte_internal;
+
+	if (size < warmup->min_size)
+		return 0;
+
+	errcode = pt_sb_warmup_lock(warmup);
+	if (errcode < 0)
+		return errcode;
+
+	nqueued = warmup->nqueued;
+	for (idx = 0; idx < nqueued; ++idx) {
+		uint32_t pos;
+
+		pos = (warmup->begin + idx) % pt_sb_warmup_nqueue;
+		if (warmup->queue[pos] == isid)
+			break;
+	}
+
+	status = 0;
+	if ((idx == nqueued) && (nqueued < pt_sb_warmup_nqueue)) {
+		uint32_t pos;
+
+		pos = (warmup->begin + nqueued) % pt_sb_warmup_nqueue;
+
+		warmup->queue[pos] = isid;
+		warmup->nqueued = nqueued + 1;
+
+		errcode = cnd_signal(&warmup->cond);
+		if (errcode != thrd_success)
+			status = -pte_bad_lock;
+	}
+
+	errcode = pt_sb_warmup_unlock(warmup);
+	if (errcode < 0)
+		return errcode;
+
+	return status;
+}
+
+#endif /* !defined(FEATURE_THREADS) */
@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+#include "ptunit_mkfile.h"
+
+#include "pt_sb_session.h"
+#include "pt_sb_context.h"
+
+#include "libipt-sb.h"
+#include "intel-pt.h"
+#include "pevent.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+enum {
+	/* The start address of the kernel. */
+	sfix_kernel_start	= 0xffffffff80000000ull,
+
+	/* A user-space address. */
+	sfix_user_ip		= 0x1000ull
+};
+
+/* A test fixture providing a session with a single perf event decoder. */
+struct sb_fixture {
+	/* The perf event records. */
+	uint8_t buffer[1024];
+
+	/* The number of bytes in @buffer. */
+	size_t size;
+
+	/* The perf event configuration for writing @buffer. */
+	struct pev_config pev;
+
+	/* The sideband file containing @buffer. */
+	char *filename;
+
+	/* The sideband session. */
+	struct pt_sb_session *session;
+
+	/* The image of the traced process. */
+	struct pt_image *image;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct sb_fixture *);
+	struct ptunit_result (*fini)(struct sb_fixture *);
+};
+
+/* Add a perf event record to @sfix.
+ *
+ * The record is sampled at @time for @pid.
+ */
+static struct ptunit_result sfix_record(struct sb_fixture *sfix,
+					struct pev_event *event, uint32_t pid,
+					uint64_t time)
+{
+	int size;
+
+	event->sample.pid = &pid;
+	event->sample.tid = &pid;
+	event->sample.time = &time;
+
+	size = pev_write(event, &sfix->buffer[sfix->size],
+			 &sfix->buffer[sizeof(sfix->buffer)], &sfix->pev);
+	ptu_int_gt(size, 0);
+
+	sfix->size += (size_t) size;
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sfix_fork(struct sb_fixture *sfix, uint32_t pid,
+				      uint32_t ppid, uint32_t tid,
+				      uint64_t time)
+{
+	struct pev_record_fork fork;
+	struct pev_event event;
+
+	memset(&fork, 0, sizeof(fork));
+	fork.pid = pid;
+	fork.ppid = ppid;
+	fork.tid = tid;
+	fork.ptid = ppid;
+	fork.time = time;
+
+	pev_event_init(&event);
+	event.type = PERF_RECORD_FORK;
+	event.record.fork = &fork;
+
+	ptu_test(sfix_record, sfix, &event, pid, time);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sfix_exit(struct sb_fixture *sfix, uint32_t pid,
+				      uint32_t tid, uint64_t time)
+{
+	struct pev_record_exit exit;
+	struct pev_event event;
+
+	memset(&exit, 0, sizeof(exit));
+	exit.pid = pid;
+	exit.ppid = pid;
+	exit.tid = tid;
+	exit.ptid = pid;
+	exit.time = time;
+
+	pev_event_init(&event);
+	event.type = PERF_RECORD_EXIT;
+	event.record.exit = &exit;
+
+	ptu_test(sfix_record, sfix, &event, pid, time);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sfix_switch(struct sb_fixture *sfix, uint32_t pid,
+					uint64_t time)
+{
+	struct pev_event event;
+
+	pev_event_init(&event);
+	event.type = PERF_RECORD_SWITCH;
+
+	ptu_test(sfix_record, sfix, &event, pid, time);
+
+	return ptu_passed();
+}
+
+/* Write the records to a file and add a perf event decoder for it. */
+static struct ptunit_result sfix_load(struct sb_fixture *sfix)
+{
+	struct pt_sb_pevent_config config;
+	size_t written;
+	FILE *file;
+	int errcode;
+
+	errcode = ptunit_mkfile(&file, &sfix->filename, "wb");
+	ptu_int_eq(errcode, 0);
+
+	written = fwrite(sfix->buffer, 1, sfix->size, file);
+	fclose(file);
+	ptu_uint_eq(written, sfix->size);
+
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
+	config.filename = sfix->filename;
+	config.sample_type = sfix->pev.sample_type;
+	config.time_shift = sfix->pev.time_shift;
+	config.time_mult = sfix->pev.time_mult;
+	config.time_zero = sfix->pev.time_zero;
+	config.kernel_start = sfix_kernel_start;
+	config.primary = 1;
+
+	errcode = pt_sb_alloc_pevent_decoder(sfix->session, &config);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_sb_init_decoders(sfix->session);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+/* Present @event at @tsc to @sfix's session. */
+static struct ptunit_result sfix_event(struct sb_fixture *sfix,
+				       struct pt_event *event, uint64_t tsc)
+{
+	int errcode;
+
+	event->has_tsc = 1;
+	event->tsc = tsc;
+
+	errcode = pt_sb_event(sfix->session, &sfix->image, event,
+			      sizeof(*event), NULL, 0);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+/* Present an event at @tsc that says we're in user space. */
+static struct ptunit_result sfix_user(struct sb_fixture *sfix, uint64_t tsc)
+{
+	struct pt_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.type = ptev_exec_mode;
+	event.variant.exec_mode.ip = sfix_user_ip;
+	event.variant.exec_mode.mode = ptem_64bit;
+
+	ptu_test(sfix_event, sfix, &event, tsc);
+
+	return ptu_passed();
+}
+
+/* Present an event at @tsc that says we likely entered the kernel. */
+static struct ptunit_result sfix_disable(struct sb_fixture *sfix,
+					 uint64_t tsc)
+{
+	struct pt_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.type = ptev_disabled;
+	event.ip_suppressed = 1;
+
+	ptu_test(sfix_event, sfix, &event, tsc);
+
+	return ptu_passed();
+}
+
+/* Check whether @pid's context is in @sfix's session.
+ *
+ * If it is, check that it is used by @nthreads threads.
+ */
+static struct ptunit_result sfix_context(struct sb_fixture *sfix,
+					 uint32_t pid, int present,
+					 uint32_t nthreads)
+{
+	struct pt_sb_context *context;
+	int errcode;
+
+	context = NULL;
+	errcode = pt_sb_find_context_by_pid(&context, sfix->session, pid);
+	ptu_int_eq(errcode, 0);
+
+	if (!present) {
+		ptu_null(context);
+		return ptu_passed();
+	}
+
+	ptu_ptr(context);
+	ptu_uint_eq(context->nthreads, nthreads);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result reclaim(struct sb_fixture *sfix)
+{
+	ptu_test(sfix_fork, sfix, 2, 1, 2, 1ull);
+	ptu_test(sfix_fork, sfix, 2, 2, 3, 2ull);
+	ptu_test(sfix_exit, sfix, 2, 2, 3ull);
+	ptu_test(sfix_exit, sfix, 2, 3, 4ull);
+	ptu_test(sfix_load, sfix);
+
+	ptu_test(sfix_user, sfix, 2ull);
+	ptu_test(sfix_context, sfix, 2, 1, 2);
+
+	/* The process lives on after its initial thread exits. */
+	ptu_test(sfix_user, sfix, 3ull);
+	ptu_test(sfix_context, sfix, 2, 1, 1);
+
+	/* We're not using it so we reclaim it right away. */
+	ptu_test(sfix_user, sfix, 4ull);
+	ptu_test(sfix_context, sfix, 2, 0, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result reclaim_in_use(struct sb_fixture *sfix)
+{
+	struct pt_sb_context *context;
+	int errcode;
+
+	ptu_test(sfix_fork, sfix, 2, 1, 2, 1ull);
+	ptu_test(sfix_switch, sfix, 2, 2ull);
+	ptu_test(sfix_exit, sfix, 2, 2, 3ull);
+	ptu_test(sfix_switch, sfix, 1, 4ull);
+	ptu_test(sfix_load, sfix);
+
+	ptu_test(sfix_disable, sfix, 2ull);
+
+	context = NULL;
+	errcode = pt_sb_find_context_by_pid(&context, sfix->session, 2);
+	ptu_int_eq(errcode, 0);
+	ptu_ptr(context);
+	ptu_ptr_eq(sfix->image, pt_sb_ctx_image(context));
+
+	/* The exit record is sent while the process is still running.  We
+	 * keep its context until we switched away from it.
+	 */
+	ptu_test(sfix_disable, sfix, 3ull);
+	ptu_test(sfix_context, sfix, 2, 1, 0);
+
+	ptu_test(sfix_disable, sfix, 4ull);
+	ptu_test(sfix_context, sfix, 2, 0, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result catch_up(struct sb_fixture *sfix)
+{
+	struct pt_sb_context *context;
+	struct pt_image *image;
+	int errcode;
+
+	ptu_test(sfix_switch, sfix, 2, 3ull);
+	ptu_test(sfix_load, sfix);
+
+	image = sfix->image;
+
+	/* The decoder is not interested in those events. */
+	ptu_test(sfix_user, sfix, 1ull);
+	ptu_test(sfix_user, sfix, 2ull);
+	ptu_uint_eq(sfix->session->neager, 0);
+
+	/* When it becomes interested, it catches up on the events it missed
+	 * and finds that we're in user space.  It must not switch, yet.
+	 */
+	ptu_test(sfix_user, sfix, 3ull);
+	ptu_uint_eq(sfix->session->neager, 1);
+	ptu_ptr_eq(sfix->image, image);
+
+	ptu_test(sfix_disable, sfix, 4ull);
+	ptu_uint_eq(sfix->session->neager, 0);
+
+	context = NULL;
+	errcode = pt_sb_find_context_by_pid(&context, sfix->session, 2);
+	ptu_int_eq(errcode, 0);
+	ptu_ptr(context);
+	ptu_ptr_eq(sfix->image, pt_sb_ctx_image(context));
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sfix_init(struct sb_fixture *sfix)
+{
+	memset(sfix->buffer, 0, sizeof(sfix->buffer));
+	sfix->size = 0;
+	sfix->filename = NULL;
+	sfix->image = NULL;
+
+	pev_config_init(&sfix->pev);
+	sfix->pev.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME;
+	sfix->pev.time_mult = 1;
+
+	sfix->session = pt_sb_alloc(NULL);
+	ptu_ptr(sfix->session);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sfix_fini(struct sb_fixture *sfix)
+{
+	pt_sb_free(sfix->session);
+	sfix->session = NULL;
+
+	if (sfix->filename) {
+		remove(sfix->filename);
+		free(sfix->filename);
+		sfix->filename = NULL;
+	}
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct sb_fixture sfix;
+	struct ptunit_suite suite;
+
+	sfix.init = sfix_init;
+	sfix.fini = sfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run_f(suite, reclaim, sfix);
+	ptu_run_f(suite, reclaim_in_use, sfix);
+	ptu_run_f(suite, catch_up, sfix);
+
+	return ptunit_report(&suite);
+}
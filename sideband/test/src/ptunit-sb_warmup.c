@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_sb_warmup.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+
+
+enum {
+	/* The minimal size of a section worth warming up. */
+	wfix_min_size	= 0x100,
+
+	/* The maximal number of warmed up sections we record. */
+	wfix_nwarmed	= 2 * pt_sb_warmup_nqueue
+};
+
+/* A warm-up test fixture.
+ *
+ * We pass the fixture as image section cache to the worker.  The mock
+ * pt_iscache_warm() below records the sections it is asked to warm up.
+ */
+struct warmup_fixture {
+	/* The warm-up worker. */
+	struct pt_sb_warmup *warmup;
+
+	/* The sections warmed up so far in the order of warm-up. */
+	int warmed[wfix_nwarmed];
+
+	/* The number of sections warmed up so far. */
+	uint32_t nwarmed;
+
+	/* The @bcache argument of the last warm-up. */
+	int bcache;
+
+	/* A flag saying whether warm-up shall block until it is cleared. */
+	int hold;
+
+	/* A flag saying whether warm-up shall block until the worker is asked
+	 * to stop.
+	 */
+	int hold_until_stop;
+
+#if defined(FEATURE_THREADS)
+	/* A lock protecting the above fields. */
+	mtx_t lock;
+
+	/* A condition signaling a warm-up or a change to @hold. */
+	cnd_t cond;
+#endif /* defined(FEATURE_THREADS) */
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct warmup_fixture *);
+	struct ptunit_result (*fini)(struct warmup_fixture *);
+};
+
+int pt_iscache_warm(struct pt_image_section_cache *iscache, int isid,
+		    int bcache)
+{
+	struct warmup_fixture *wfix;
+
+	wfix = (struct warmup_fixture *) iscache;
+	if (!wfix)
+		return -pte_internal;
+
+#if defined(FEATURE_THREADS)
+	if (mtx_lock(&wfix->lock) != thrd_success)
+		return -pte_bad_lock;
+
+	if (wfix->nwarmed < wfix_nwarmed)
+		wfix->warmed[wfix->nwarmed] = isid;
+
+	wfix->nwarmed += 1;
+	wfix->bcache = bcache;
+
+	(void) cnd_broadcast(&wfix->cond);
+
+	while (wfix->hold)
+		(void) cnd_wait(&wfix->cond, &wfix->lock);
+
+	(void) mtx_unlock(&wfix->lock);
+
+	if (wfix->hold_until_stop) {
+		struct pt_sb_warmup *warmup;
+
+		/* We're running on the worker thread.  The worker is signaled
+		 * on its own condition when it shall stop.
+		 */
+		warmup = wfix->warmup;
+		if (mtx_lock(&warmup->lock) != thrd_success)
+			return -pte_bad_lock;
+
+		while (!warmup->stop)
+			(void) cnd_wait(&warmup->cond, &warmup->lock);
+
+		(void) mtx_unlock(&warmup->lock);
+	}
+#else /* defined(FEATURE_THREADS) */
+	(void) isid;
+	(void) bcache;
+#endif /* defined(FEATURE_THREADS) */
+
+	return 0;
+}
+
+static struct ptunit_result add_null(void)
+{
+	int errcode;
+
+	errcode = pt_sb_warmup_add(NULL, 1, wfix_min_size);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result free_null(void)
+{
+	pt_sb_warmup_free(NULL);
+
+	return ptu_passed();
+}
+
+#if !defined(FEATURE_THREADS)
+
+static struct ptunit_result not_supported(void)
+{
+	struct warmup_fixture wfix;
+	struct pt_sb_warmup *warmup;
+
+	memset(&wfix, 0, sizeof(wfix));
+
+	warmup = pt_sb_warmup_alloc((struct pt_image_section_cache *) &wfix,
+				    wfix_min_size, 0);
+	ptu_null(warmup);
+
+	return ptu_passed();
+}
+
+#else /* !defined(FEATURE_THREADS) */
+
+static struct ptunit_result alloc_null(void)
+{
+	struct pt_sb_warmup *warmup;
+
+	warmup = pt_sb_warmup_alloc(NULL, wfix_min_size, 0);
+	ptu_null(warmup);
+
+	return ptu_passed();
+}
+
+/* Wait until at least @nwarmed sections have been warmed up. */
+static struct ptunit_result wfix_wait(struct warmup_fixture *wfix,
+				      uint32_t nwarmed)
+{
+	int errcode;
+
+	errcode = mtx_lock(&wfix->lock);
+	ptu_int_eq(errcode, thrd_success);
+
+	while (wfix->nwarmed < nwarmed) {
+		errcode = cnd_wait(&wfix->cond, &wfix->lock);
+		ptu_int_eq(errcode, thrd_success);
+	}
+
+	errcode = mtx_unlock(&wfix->lock);
+	ptu_int_eq(errcode, thrd_success);
+
+	return ptu_passed();
+}
+
+/* Let a blocked warm-up proceed. */
+static struct ptunit_result wfix_release(struct warmup_fixture *wfix)
+{
+	int errcode;
+
+	errcode = mtx_lock(&wfix->lock);
+	ptu_int_eq(errcode, thrd_success);
+
+	wfix->hold = 0;
+
+	errcode = cnd_broadcast(&wfix->cond);
+	ptu_int_eq(errcode, thrd_success);
+
+	errcode = mtx_unlock(&wfix->lock);
+	ptu_int_eq(errcode, thrd_success);
+
+	return ptu_passed();
+}
+
+/* Stop the worker and wait for it to finish.
+ *
+ * The fixture's fields are stable afterwards.
+ */
+static struct ptunit_result wfix_stop(struct warmup_fixture *wfix)
+{
+	pt_sb_warmup_free(wfix->warmup);
+	wfix->warmup = NULL;
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_small(struct warmup_fixture *wfix)
+{
+	int errcode;
+
+	errcode = pt_sb_warmup_add(wfix->warmup, 1, wfix_min_size - 1);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(wfix_stop, wfix);
+	ptu_uint_eq(wfix->nwarmed, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result drain(struct warmup_fixture *wfix)
+{
+	int errcode, isid;
+
+	for (isid = 1; isid <= 3; ++isid) {
+		errcode = pt_sb_warmup_add(wfix->warmup, isid, wfix_min_size);
+		ptu_int_eq(errcode, 0);
+	}
+
+	ptu_test(wfix_wait, wfix, 3);
+	ptu_test(wfix_stop, wfix);
+
+	ptu_uint_eq(wfix->nwarmed, 3);
+	ptu_int_eq(wfix->warmed[0], 1);
+	ptu_int_eq(wfix->warmed[1], 2);
+	ptu_int_eq(wfix->warmed[2], 3);
+	ptu_int_eq(wfix->bcache, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result duplicate(struct warmup_fixture *wfix)
+{
+	int errcode;
+
+	/* Keep the worker busy warming up the first section. */
+	wfix->hold = 1;
+
+	errcode = pt_sb_warmup_add(wfix->warmup, 1, wfix_min_size);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(wfix_wait, wfix, 1);
+
+	errcode = pt_sb_warmup_add(wfix->warmup, 2, wfix_min_size);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_sb_warmup_add(wfix->warmup, 2, wfix_min_size);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_sb_warmup_add(wfix->warmup, 3, wfix_min_size);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(wfix->warmup->nqueued, 2);
+
+	ptu_test(wfix_release, wfix);
+	ptu_test(wfix_wait, wfix, 3);
+	ptu_test(wfix_stop, wfix);
+
+	ptu_uint_eq(wfix->nwarmed, 3);
+	ptu_int_eq(wfix->warmed[0], 1);
+	ptu_int_eq(wfix->warmed[1], 2);
+	ptu_int_eq(wfix->warmed[2], 3);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result full(struct warmup_fixture *wfix)
+{
+	int errcode, isid;
+
+	/* Keep the worker busy warming up the first section. */
+	wfix->hold = 1;
+
+	errcode = pt_sb_warmup_add(wfix->warmup, 1, wfix_min_size);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(wfix_wait, wfix, 1);
+
+	/* Sections that do not fit into the queue are dropped. */
+	for (isid = 2; isid < pt_sb_warmup_nqueue + 10; ++isid) {
+		errcode = pt_sb_warmup_add(wfix->warmup, isid, wfix_min_size);
+		ptu_int_eq(errcode, 0);
+	}
+
+	ptu_uint_eq(wfix->warmup->nqueued, pt_sb_warmup_nqueue);
+
+	ptu_test(wfix_release, wfix);
+	ptu_test(wfix_wait, wfix, pt_sb_warmup_nqueue + 1);
+	ptu_test(wfix_stop, wfix);
+
+	ptu_uint_eq(wfix->nwarmed, pt_sb_warmup_nqueue + 1);
+	for (isid = 1; isid <= pt_sb_warmup_nqueue + 1; ++isid)
+		ptu_int_eq(wfix->warmed[isid - 1], isid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result stop(struct warmup_fixture *wfix)
+{
+	int errcode, isid;
+
+	/* Keep the worker busy warming up the first section until we stop
+	 * it.
+	 */
+	wfix->hold_until_stop = 1;
+
+	for (isid = 1; isid <= 3; ++isid) {
+		errcode = pt_sb_warmup_add(wfix->warmup, isid, wfix_min_size);
+		ptu_int_eq(errcode, 0);
+	}
+
+	ptu_test(wfix_wait, wfix, 1);
+	ptu_test(wfix_stop, wfix);
+
+	/* Sections still waiting are dropped. */
+	ptu_uint_eq(wfix->nwarmed, 1);
+	ptu_int_eq(wfix->warmed[0], 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result wfix_init(struct warmup_fixture *wfix)
+{
+	int errcode;
+
+	wfix->nwarmed = 0;
+	wfix->bcache = 0;
+	wfix->hold = 0;
+	wfix->hold_until_stop = 0;
+
+	errcode = mtx_init(&wfix->lock, mtx_plain);
+	ptu_int_eq(errcode, thrd_success);
+
+	errcode = cnd_init(&wfix->cond);
+	ptu_int_eq(errcode, thrd_success);
+
+	wfix->warmup =
+		pt_sb_warmup_alloc((struct pt_image_section_cache *) wfix,
+				   wfix_min_size, 1);
+	ptu_ptr(wfix->warmup);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result wfix_fini(struct warmup_fixture *wfix)
+{
+	/* Let the worker finish in case a test failed while holding it. */
+	wfix->hold_until_stop = 0;
+	ptu_test(wfix_release, wfix);
+	ptu_test(wfix_stop, wfix);
+
+	cnd_destroy(&wfix->cond);
+	mtx_destroy(&wfix->lock);
+
+	return ptu_passed();
+}
+
+#endif /* !defined(FEATURE_THREADS) */
+
+int main(int argc, char **argv)
+{
+	struct ptunit_suite suite;
+#if defined(FEATURE_THREADS)
+	struct warmup_fixture wfix;
+
+	wfix.init = wfix_init;
+	wfix.fini = wfix_fini;
+#endif /* defined(FEATURE_THREADS) */
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, add_null);
+	ptu_run(suite, free_null);
+
+#if !defined(FEATURE_THREADS)
+	ptu_run(suite, not_supported);
+#else /* !defined(FEATURE_THREADS) */
+	ptu_run(suite, alloc_null);
+	ptu_run_f(suite, add_small, wfix);
+	ptu_run_f(suite, drain, wfix);
+	ptu_run_f(suite, duplicate, wfix);
+	ptu_run_f(suite, full, wfix);
+	ptu_run_f(suite, stop, wfix);
+#endif /* !defined(FEATURE_THREADS) */
+
+	return ptunit_report(&suite);
+}